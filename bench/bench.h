@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+/*
+ * Shared helpers of the benchmark programs in this directory.
+ *
+ * The benchmark programs are not part of the `usockit` binary; they are built and run by the `bench` make target.
+ * Each one of them spawns a real `usockit` server (whose child program is the `sink` benchmark program), drives it
+ * over the socket and prints a single JSON object to stdout, so that the results of different builds can be compared.
+ *
+ * Source files that include this header must define `_POSIX_C_SOURCE` to at least 200809L.
+ */
+
+#ifndef USOCKIT_BENCH_H
+#define USOCKIT_BENCH_H
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <usockit/cross_support.h>
+#include <usockit/protocol.h>
+#include <usockit/support_types.h>
+#include <usockit/utils.h>
+
+enum {
+	BENCH_SERVER_STARTUP_TIMEOUT_MS = 5000,
+};
+
+#define BENCH_SOCKET_PATHNAME_SIZE  (sizeof ((struct sockaddr_un){ 0 }).sun_path)
+
+struct bench_latency_stats {
+	size_t count;
+	double p50_us;
+	double p90_us;
+	double p99_us;
+	double p999_us;
+	double max_us;
+	double mean_us;
+};
+
+
+cross_support_nodiscard
+static inline uint64_t bench_now_ns(void)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
+
+static inline uint64_t bench_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (((uint64_t)(ts.tv_sec) * UINT64_C(1000000000)) + (uint64_t)(ts.tv_nsec));
+}
+
+static inline void bench_sleep_ns(uint64_t ns) {
+	struct timespec ts = {
+		.tv_sec  = (time_t)(ns / UINT64_C(1000000000)),
+		.tv_nsec = (long)(ns % UINT64_C(1000000000)),
+	};
+
+	while((nanosleep(&ts, &ts) != 0) && (errno == EINTR));
+}
+
+
+/**
+ * Parses an option of the form `<name>=<number>[K|M|G]` (binary suffixes).
+ *
+ * Returns `true` if `arg` starts with `<name>=`, regardless of whether or not the number is valid.
+ * If the number is invalid, the program exits.
+ */
+cross_support_nodiscard
+static inline bool bench_parse_size_option(const_cstr_t arg, const_cstr_t name, size_t* out)
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+static inline bool bench_parse_size_option(const const_cstr_t arg, const const_cstr_t name, size_t* const out) {
+	const size_t name_len = strlen(name);
+	if((strncmp(arg, name, name_len) != 0) || (arg[name_len] != '=')) {
+		return false;
+	}
+
+	const const_cstr_t value = (arg + name_len + 1);
+
+	char* end;
+	errno = 0;
+	const unsigned long long n = strtoull(value, &end, 10);
+
+	unsigned long long multiplier = 1;
+	switch(*end) {
+		case 'K': multiplier = (1ULL << 10); ++end; break;
+		case 'M': multiplier = (1ULL << 20); ++end; break;
+		case 'G': multiplier = (1ULL << 30); ++end; break;
+		default: break;
+	}
+
+	cross_support_if_unlikely((errno != 0) || (end == value) || (*end != '\0')) {
+		fprintf(stderr, "%s: invalid number: %s\n", name, value);
+		exit(2);
+	}
+
+	*out = (size_t)(n * multiplier);
+	return true;
+}
+
+cross_support_nodiscard
+static inline bool bench_parse_str_option(const_cstr_t arg, const_cstr_t name, const_cstr_t* out)
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+static inline bool bench_parse_str_option(const const_cstr_t arg, const const_cstr_t name, const_cstr_t* const out) {
+	const size_t name_len = strlen(name);
+	if((strncmp(arg, name, name_len) != 0) || (arg[name_len] != '=')) {
+		return false;
+	}
+
+	*out = (arg + name_len + 1);
+	return true;
+}
+
+
+static int bench_compare_u64(const void* const a, const void* const b) {
+	const uint64_t x = *(const uint64_t*)a;
+	const uint64_t y = *(const uint64_t*)b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * Sorts `latencies_ns` in place.
+ */
+static inline struct bench_latency_stats bench_latency_stats_compute(uint64_t* const latencies_ns, const size_t count) {
+	struct bench_latency_stats stats;
+	zeroset_lvalue(stats);
+
+	stats.count = count;
+	if(count == 0) {
+		return stats;
+	}
+
+	qsort(latencies_ns, count, sizeof *latencies_ns, &bench_compare_u64);
+
+	#define BENCH_PERCENTILE_US(permille) \
+		((double)(latencies_ns[(((count - 1) * (size_t)(permille)) / 1000)]) / 1000.0)
+
+	stats.p50_us  = BENCH_PERCENTILE_US(500);
+	stats.p90_us  = BENCH_PERCENTILE_US(900);
+	stats.p99_us  = BENCH_PERCENTILE_US(990);
+	stats.p999_us = BENCH_PERCENTILE_US(999);
+	stats.max_us  = ((double)(latencies_ns[count - 1]) / 1000.0);
+
+	#undef BENCH_PERCENTILE_US
+
+	double sum = 0.0;
+	for(size_t i = 0; i < count; ++i) {
+		sum += (double)(latencies_ns[i]);
+	}
+	stats.mean_us = ((sum / (double)count) / 1000.0);
+
+	return stats;
+}
+
+static inline void bench_latency_stats_print_json(FILE* const stream, const struct bench_latency_stats stats) {
+	fprintf(
+		stream,
+		"{ \"count\": %zu, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"p999\": %.3f,"
+		" \"max\": %.3f }",
+		stats.count,
+		stats.mean_us,
+		stats.p50_us,
+		stats.p90_us,
+		stats.p99_us,
+		stats.p999_us,
+		stats.max_us
+	);
+}
+
+
+/**
+ * Creates a fresh temporary directory and stores the pathname of a socket inside of it in `socket_pathname`.
+ */
+static inline void bench_make_socket_pathname(char (*const socket_pathname)[BENCH_SOCKET_PATHNAME_SIZE]) {
+	char dir_template[] = "/tmp/usockit-bench.XXXXXX";
+
+	cross_support_if_unlikely(mkdtemp(dir_template) == cross_support_nullptr) {
+		perror("mkdtemp(3)");
+		exit(1);
+	}
+
+	snprintf(*socket_pathname, sizeof *socket_pathname, "%s/sock", dir_template);
+}
+
+static inline void bench_remove_socket_pathname(const const_cstr_t socket_pathname) {
+	unlink(socket_pathname);
+
+	char dir_pathname[BENCH_SOCKET_PATHNAME_SIZE];
+	strcpy(dir_pathname, socket_pathname);
+
+	char* const last_slash = strrchr(dir_pathname, '/');
+	if(last_slash != cross_support_nullptr) {
+		*last_slash = '\0';
+		rmdir(dir_pathname);
+	}
+}
+
+/**
+ * Connects to the socket at `socket_pathname`.
+ *
+ * Returns -1 and sets errno on failure.
+ */
+cross_support_nodiscard
+static inline int bench_connect(const_cstr_t socket_pathname)
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+static inline int bench_connect(const const_cstr_t socket_pathname) {
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd == -1) {
+		return -1;
+	}
+
+	struct sockaddr_un addr;
+	zeroset_lvalue(addr);
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_pathname);
+
+	if(connect(fd, (const struct sockaddr*)&addr, sizeof addr) != 0) {
+		errno_push();
+		close(fd);
+		errno_pop();
+		return -1;
+	}
+
+	return fd;
+}
+
+enum bench_reply {
+	/**
+	 * Nothing but messages of an admitted client so far, if anything at all.
+	 */
+	BENCH_REPLY_NONE,
+	BENCH_REPLY_REJECTED,
+	/**
+	 * The server closed the connection without rejecting it.
+	 */
+	BENCH_REPLY_CLOSED,
+};
+
+/**
+ * Keeps track of where in the stream of messages from the server a connection is. (see `usockit/protocol.h`)
+ */
+struct bench_reply_reader {
+	unsigned char header[USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE];
+	size_t header_size;
+	uint32_t payload_remaining_size;
+};
+
+/**
+ * Reads everything that the server sent to `socket_fd` so far without blocking, skipping over the messages.
+ * Only the plain rejection string, in place of a message, counts as a rejection.
+ */
+cross_support_nodiscard
+static inline enum bench_reply bench_read_replies(struct bench_reply_reader* reader, int socket_fd)
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+static inline enum bench_reply bench_read_replies(struct bench_reply_reader* const reader, const int socket_fd) {
+	do {
+		unsigned char buffer[4096];
+		const ssize_t readc = recv(socket_fd, buffer, sizeof buffer, MSG_DONTWAIT);
+
+		if(readc == 0) {
+			return BENCH_REPLY_CLOSED;
+		}
+
+		if(readc < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				return BENCH_REPLY_NONE;
+			}
+
+			if(errno == ECONNRESET) {
+				return BENCH_REPLY_CLOSED;
+			}
+
+			perror("recv(2)");
+			exit(1);
+		}
+
+		for(size_t i = 0; i < (size_t)readc; ++i) {
+			if(reader->payload_remaining_size > 0) {
+				size_t n = ((size_t)readc - i);
+				if(n > reader->payload_remaining_size) {
+					n = reader->payload_remaining_size;
+				}
+
+				reader->payload_remaining_size -= (uint32_t)n;
+				i += (n - 1);
+				continue;
+			}
+
+			if((reader->header_size == 0) && (buffer[i] == (unsigned char)(USOCKIT_PROTOCOL_FUCK_OFF_STRING[0]))) {
+				return BENCH_REPLY_REJECTED;
+			}
+
+			reader->header[reader->header_size] = buffer[i];
+			++(reader->header_size);
+
+			if(reader->header_size == USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE) {
+				reader->payload_remaining_size = usockit_protocol_decode_message_payload_size(reader->header);
+				reader->header_size = 0;
+			}
+		}
+	} while(true);
+}
+
+/**
+ * Spawns `<usockit_pathname> <socket_pathname> -- <child_argv...>` with its stdout redirected to `stdout_fd` (which
+ * the child program then inherits) and waits until the server accepts connections.
+ *
+ * The connection that gets through is served like a client that sent nothing; it is only closed once the server closed
+ * its end, so that it doesn't take up the client slot anymore when the benchmark connects.
+ */
+cross_support_nodiscard
+static inline pid_t bench_spawn_server(const_cstr_t usockit_pathname,
+                                       const_cstr_t socket_pathname,
+                                       const const_cstr_t* child_argv,
+                                       int stdout_fd)
+	cross_support_attr_nonnull(1, 2, 3)
+	cross_support_attr_warn_unused_result;
+
+static inline pid_t bench_spawn_server(
+	const const_cstr_t usockit_pathname,
+	const const_cstr_t socket_pathname,
+	const const_cstr_t* const child_argv,
+	const int stdout_fd
+) {
+	size_t child_argc = 0;
+	while(child_argv[child_argc] != cross_support_nullptr) {
+		++child_argc;
+	}
+
+	const_cstr_t* const argv = calloc(child_argc + 4, sizeof *argv);
+	cross_support_if_unlikely(argv == cross_support_nullptr) {
+		perror("calloc(3)");
+		exit(1);
+	}
+
+	argv[0] = usockit_pathname;
+	argv[1] = socket_pathname;
+	argv[2] = "--";
+	for(size_t i = 0; i < child_argc; ++i) {
+		argv[3 + i] = child_argv[i];
+	}
+	argv[3 + child_argc] = cross_support_nullptr;
+
+	const pid_t pid = fork();
+	cross_support_if_unlikely(pid == -1) {
+		perror("fork(2)");
+		exit(1);
+	}
+
+	if(pid == 0) {
+		if(stdout_fd != -1) {
+			dup2(stdout_fd, STDOUT_FILENO);
+		}
+
+		execv(usockit_pathname, (char* const*)argv);
+		perror("execv(3)");
+		_exit(127);
+	}
+
+	free(argv);
+
+	const uint64_t deadline_ns = (bench_now_ns() + ((uint64_t)BENCH_SERVER_STARTUP_TIMEOUT_MS * UINT64_C(1000000)));
+	do {
+		const int fd = bench_connect(socket_pathname);
+		if(fd != -1) {
+			(void)shutdown(fd, SHUT_WR);
+
+			struct bench_reply_reader reader;
+			zeroset_lvalue(reader);
+
+			enum bench_reply reply = BENCH_REPLY_NONE;
+			while((reply == BENCH_REPLY_NONE) && (bench_now_ns() < deadline_ns)) {
+				struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+				(void)poll(&pfd, 1, 10);
+
+				reply = bench_read_replies(&reader, fd);
+			}
+
+			close(fd);
+
+			if(reply == BENCH_REPLY_NONE) {
+				break;
+			}
+
+			return pid;
+		}
+
+		bench_sleep_ns(UINT64_C(1000000));
+	} while(bench_now_ns() < deadline_ns);
+
+	fprintf(stderr, "%s: server did not start serving in time\n", socket_pathname);
+	kill(pid, SIGKILL);
+	waitpid(pid, cross_support_nullptr, 0);
+	exit(1);
+}
+
+#endif /* USOCKIT_BENCH_H */
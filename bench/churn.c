@@ -0,0 +1,480 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+/*
+ * Connection churn benchmark.
+ *
+ * Spawns a server with the sink as its child program and lets `--clients` concurrent clients repeatedly connect, send a
+ * single line and disconnect again for `--duration-ms` milliseconds.
+ * A connection counts as admitted once the sink acknowledged its line and as rejected once the server sent it the
+ * rejection. A connection that is neither in time (or that the server closes without either) counts as a stall.
+ *
+ * Reports the rate of admitted and rejected connections, the latency from connect(2) until admission or rejection and
+ * the CPU time that each of the server's threads burned during the run.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+#include <dirent.h>
+#include <poll.h>
+#include <pthread.h>
+
+enum {
+	CHURN_TAG_MAX_LENGTH = 31,
+	CHURN_ADMISSION_TIMEOUT_MS = 1000,
+	CHURN_MAX_SERVER_THREADS = 64,
+};
+
+struct churn_params {
+	const_cstr_t usockit_pathname;
+	const_cstr_t sink_pathname;
+	size_t clients;
+	size_t duration_ms;
+};
+
+struct churn_latencies {
+	uint64_t* data;
+	size_t size;
+	size_t capacity;
+};
+
+struct churn_client {
+	struct churn_params* params;
+	const_cstr_t socket_pathname;
+	uint64_t deadline_ns;
+	size_t index;
+
+	/**
+	 * The ack reader writes the sequence number of every acknowledged line of this client into this pipe.
+	 */
+	int ack_pipe[2];
+
+	struct churn_latencies admission_latencies;
+	struct churn_latencies rejection_latencies;
+	size_t stalls;
+};
+
+struct churn_ack_reader_arg {
+	int ack_fd;
+	struct churn_client* clients;
+	size_t clients_count;
+};
+
+struct churn_thread_cpu {
+	char name[16];
+	pid_t tid;
+	uint64_t ticks;
+};
+
+
+static inline void churn_latencies_append(struct churn_latencies* const latencies, const uint64_t latency_ns) {
+	if(latencies->size == latencies->capacity) {
+		const size_t new_capacity = ((latencies->capacity == 0) ? 1024 : (latencies->capacity * 2));
+
+		uint64_t* const tmp = realloc(latencies->data, (new_capacity * sizeof *tmp));
+		cross_support_if_unlikely(tmp == cross_support_nullptr) {
+			perror("realloc(3)");
+			exit(1);
+		}
+
+		latencies->data = tmp;
+		latencies->capacity = new_capacity;
+	}
+
+	latencies->data[latencies->size] = latency_ns;
+	++(latencies->size);
+}
+
+static inline void churn_latencies_concat(struct churn_latencies* const dest, const struct churn_latencies* const src) {
+	for(size_t i = 0; i < src->size; ++i) {
+		churn_latencies_append(dest, src->data[i]);
+	}
+}
+
+
+static void* churn_ack_reader_routine(void* const arg_ptr) {
+	const struct churn_ack_reader_arg arg = *(const struct churn_ack_reader_arg*)arg_ptr;
+
+	char tag[CHURN_TAG_MAX_LENGTH + 1];
+	size_t tag_len = 0;
+
+	do {
+		unsigned char buffer[4096];
+		const ssize_t readc = read(arg.ack_fd, buffer, array_size(buffer));
+
+		if(readc == 0) {
+			break;
+		}
+
+		if(readc < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			perror("read(2)");
+			exit(1);
+		}
+
+		for(size_t i = 0; i < (size_t)readc; ++i) {
+			if(buffer[i] != '\n') {
+				if(tag_len < CHURN_TAG_MAX_LENGTH) {
+					tag[tag_len] = (char)(buffer[i]);
+					++tag_len;
+				}
+				continue;
+			}
+
+			tag[tag_len] = '\0';
+			tag_len = 0;
+
+			unsigned long client;
+			uint32_t seq;
+			if((sscanf(tag, "%lu.%" SCNu32, &client, &seq) != 2) || (client >= arg.clients_count)) {
+				fprintf(stderr, "churn: malformed acknowledgement: %s\n", tag);
+				exit(1);
+			}
+
+			// writes of this size to a pipe are atomic
+			if(write_all(arg.clients[client].ack_pipe[1], &seq, sizeof seq) != RET_STATUS_SUCCESS) {
+				perror("write(2)");
+				exit(1);
+			}
+		}
+	} while(true);
+
+	return cross_support_nullptr;
+}
+
+static void* churn_client_routine(void* const arg_ptr) {
+	struct churn_client* const client = (struct churn_client*)arg_ptr;
+
+	uint32_t seq = 0;
+
+	while(bench_now_ns() < client->deadline_ns) {
+		++seq;
+
+		char line[CHURN_TAG_MAX_LENGTH + 16];
+		const int line_len = snprintf(line, sizeof line, "%zu.%" PRIu32 " churn\n", client->index, seq);
+
+		const uint64_t start_ns = bench_now_ns();
+
+		const int socket_fd = bench_connect(client->socket_pathname);
+		if(socket_fd == -1) {
+			perror("connect(2)");
+			exit(1);
+		}
+
+		struct bench_reply_reader reply_reader;
+		zeroset_lvalue(reply_reader);
+
+		bool rejected = false;
+		bool admitted = false;
+		bool closed = false;
+
+		if(write_all(socket_fd, line, (size_t)line_len) != RET_STATUS_SUCCESS) {
+			// most likely, the server rejected us and closed the connection right away
+			rejected = (bench_read_replies(&reply_reader, socket_fd) == BENCH_REPLY_REJECTED);
+			closed = !rejected;
+		}
+
+		while(!rejected && !admitted && !closed) {
+			struct pollfd pfds[2] = {
+				{ .fd = socket_fd,              .events = POLLIN },
+				{ .fd = client->ack_pipe[0],    .events = POLLIN },
+			};
+
+			const int ret = poll(pfds, array_size(pfds), CHURN_ADMISSION_TIMEOUT_MS);
+			if(ret == 0) {
+				break;
+			}
+
+			if(ret < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+
+				perror("poll(2)");
+				exit(1);
+			}
+
+			if(pfds[1].revents != 0) {
+				uint32_t acked_seq;
+				if(read(client->ack_pipe[0], &acked_seq, sizeof acked_seq) != (ssize_t)(sizeof acked_seq)) {
+					perror("read(2)");
+					exit(1);
+				}
+
+				// acknowledgements of earlier, stalled connections are ignored
+				admitted = (acked_seq == seq);
+				continue;
+			}
+
+			const enum bench_reply reply = bench_read_replies(&reply_reader, socket_fd);
+			rejected = (reply == BENCH_REPLY_REJECTED);
+			closed = (reply == BENCH_REPLY_CLOSED);
+		}
+
+		const uint64_t latency_ns = (bench_now_ns() - start_ns);
+
+		close(socket_fd);
+
+		if(admitted) {
+			churn_latencies_append(&(client->admission_latencies), latency_ns);
+			continue;
+		}
+
+		if(rejected) {
+			churn_latencies_append(&(client->rejection_latencies), latency_ns);
+			continue;
+		}
+
+		++(client->stalls);
+	}
+
+	return cross_support_nullptr;
+}
+
+
+/**
+ * Reads the name & CPU time (in clock ticks) of all threads of process `pid`.
+ */
+static inline size_t churn_read_thread_cpus(const pid_t pid, struct churn_thread_cpu* const thread_cpus) {
+	size_t count = 0;
+
+	char task_dir_pathname[64];
+	snprintf(task_dir_pathname, sizeof task_dir_pathname, "/proc/%ld/task", (long)pid);
+
+	DIR* const task_dir = opendir(task_dir_pathname);
+	if(task_dir == cross_support_nullptr) {
+		return 0;
+	}
+
+	const struct dirent* entry;
+	while(((entry = readdir(task_dir)) != cross_support_nullptr) && (count < CHURN_MAX_SERVER_THREADS)) {
+		if(entry->d_name[0] == '.') {
+			continue;
+		}
+
+		char pathname[512];
+		snprintf(pathname, sizeof pathname, "%s/%s/stat", task_dir_pathname, entry->d_name);
+
+		FILE* const stat_file = fopen(pathname, "r");
+		if(stat_file == cross_support_nullptr) {
+			continue;
+		}
+
+		char stat_line[1024];
+		const bool got_line = (fgets(stat_line, sizeof stat_line, stat_file) != cross_support_nullptr);
+		fclose(stat_file);
+
+		if(!got_line) {
+			continue;
+		}
+
+		// format: "<tid> (<comm>) <state> <fields 4..13> <utime> <stime> ..."
+		const char* const comm_begin = strchr(stat_line, '(');
+		const char* const comm_end = strrchr(stat_line, ')');
+		if((comm_begin == cross_support_nullptr) || (comm_end == cross_support_nullptr)) {
+			continue;
+		}
+
+		struct churn_thread_cpu* const thread_cpu = &(thread_cpus[count]);
+		zeroset_lvalue(*thread_cpu);
+
+		size_t name_len = (size_t)(comm_end - comm_begin - 1);
+		if(name_len >= sizeof thread_cpu->name) {
+			name_len = (sizeof thread_cpu->name - 1);
+		}
+		memcpy(thread_cpu->name, (comm_begin + 1), name_len);
+
+		unsigned long long utime;
+		unsigned long long stime;
+		if(sscanf(comm_end + 2, "%*c %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %llu %llu", &utime, &stime) != 2) {
+			continue;
+		}
+
+		thread_cpu->tid = (pid_t)atol(entry->d_name);
+		thread_cpu->ticks = (uint64_t)(utime + stime);
+		++count;
+	}
+
+	closedir(task_dir);
+
+	return count;
+}
+
+
+static inline void churn_print_usage(const const_cstr_t argv0) {
+	fprintf(stderr, "usage: %s --usockit=<path> --sink=<path> [--clients=<n>] [--duration-ms=<n>]\n", argv0);
+}
+
+int main(const int argc, const cstr_t* const argv) {
+	struct churn_params params = {
+		.usockit_pathname = cross_support_nullptr,
+		.sink_pathname    = cross_support_nullptr,
+		.clients          = 16,
+		.duration_ms      = 2000,
+	};
+
+	for(int i = 1; i < argc; ++i) {
+		const cstr_t arg = argv[i];
+
+		if(bench_parse_str_option(arg, "--usockit", &(params.usockit_pathname)) ||
+		   bench_parse_str_option(arg, "--sink", &(params.sink_pathname)) ||
+		   bench_parse_size_option(arg, "--clients", &(params.clients)) ||
+		   bench_parse_size_option(arg, "--duration-ms", &(params.duration_ms))) {
+
+			continue;
+		}
+
+		fprintf(stderr, "%s: %s: unknown argument\n", argv[0], arg);
+		churn_print_usage(argv[0]);
+		return 2;
+	}
+
+	cross_support_if_unlikely((params.usockit_pathname == cross_support_nullptr) ||
+	                          (params.sink_pathname == cross_support_nullptr) ||
+	                          (params.clients == 0) || (params.duration_ms == 0)) {
+
+		churn_print_usage(argv[0]);
+		return 2;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	int server_stdout_pipe[2];
+	if(pipe(server_stdout_pipe) != 0) {
+		perror("pipe(2)");
+		return 1;
+	}
+
+	char socket_pathname[BENCH_SOCKET_PATHNAME_SIZE];
+	bench_make_socket_pathname(&socket_pathname);
+
+	const const_cstr_t child_argv[] = { params.sink_pathname, cross_support_nullptr };
+	const pid_t server_pid =
+		bench_spawn_server(params.usockit_pathname, socket_pathname, child_argv, server_stdout_pipe[1]);
+	close(server_stdout_pipe[1]);
+
+	struct churn_client* const clients = calloc(params.clients, sizeof *clients);
+	pthread_t* const client_threads = calloc(params.clients, sizeof *client_threads);
+	cross_support_if_unlikely((clients == cross_support_nullptr) || (client_threads == cross_support_nullptr)) {
+		perror("calloc(3)");
+		return 1;
+	}
+
+	struct churn_ack_reader_arg ack_reader_arg = {
+		.ack_fd = server_stdout_pipe[0],
+		.clients = clients,
+		.clients_count = params.clients,
+	};
+
+	for(size_t i = 0; i < params.clients; ++i) {
+		if(pipe(clients[i].ack_pipe) != 0) {
+			perror("pipe(2)");
+			return 1;
+		}
+	}
+
+	pthread_t ack_reader_thread;
+	pthread_create(&ack_reader_thread, cross_support_nullptr, &churn_ack_reader_routine, &ack_reader_arg);
+
+	struct churn_thread_cpu thread_cpus_before[CHURN_MAX_SERVER_THREADS];
+	const size_t thread_cpus_before_count = churn_read_thread_cpus(server_pid, thread_cpus_before);
+
+	const uint64_t start_ns = bench_now_ns();
+	const uint64_t deadline_ns = (start_ns + ((uint64_t)(params.duration_ms) * UINT64_C(1000000)));
+
+	for(size_t i = 0; i < params.clients; ++i) {
+		clients[i].params = &params;
+		clients[i].socket_pathname = socket_pathname;
+		clients[i].deadline_ns = deadline_ns;
+		clients[i].index = i;
+		pthread_create(&(client_threads[i]), cross_support_nullptr, &churn_client_routine, &(clients[i]));
+	}
+
+	for(size_t i = 0; i < params.clients; ++i) {
+		pthread_join(client_threads[i], cross_support_nullptr);
+	}
+
+	const double elapsed_s = ((double)(bench_now_ns() - start_ns) / 1e9);
+
+	struct churn_thread_cpu thread_cpus_after[CHURN_MAX_SERVER_THREADS];
+	const size_t thread_cpus_after_count = churn_read_thread_cpus(server_pid, thread_cpus_after);
+
+	kill(server_pid, SIGTERM);
+	waitpid(server_pid, cross_support_nullptr, 0);
+	bench_remove_socket_pathname(socket_pathname);
+
+	pthread_join(ack_reader_thread, cross_support_nullptr);
+	close(server_stdout_pipe[0]);
+
+	struct churn_latencies admission_latencies = { .data = cross_support_nullptr, .size = 0, .capacity = 0 };
+	struct churn_latencies rejection_latencies = { .data = cross_support_nullptr, .size = 0, .capacity = 0 };
+	size_t stalls = 0;
+
+	for(size_t i = 0; i < params.clients; ++i) {
+		churn_latencies_concat(&admission_latencies, &(clients[i].admission_latencies));
+		churn_latencies_concat(&rejection_latencies, &(clients[i].rejection_latencies));
+		stalls += clients[i].stalls;
+
+		free(clients[i].rejection_latencies.data);
+		free(clients[i].admission_latencies.data);
+		close(clients[i].ack_pipe[1]);
+		close(clients[i].ack_pipe[0]);
+	}
+
+	const struct bench_latency_stats admission_stats =
+		bench_latency_stats_compute(admission_latencies.data, admission_latencies.size);
+	const struct bench_latency_stats rejection_stats =
+		bench_latency_stats_compute(rejection_latencies.data, rejection_latencies.size);
+
+	const double clock_ticks_per_s = (double)sysconf(_SC_CLK_TCK);
+
+	printf("{\n");
+	printf("\t\"benchmark\": \"churn\",\n");
+	printf("\t\"params\": { \"clients\": %zu, \"duration_ms\": %zu },\n", params.clients, params.duration_ms);
+	printf("\t\"elapsed_s\": %.6f,\n", elapsed_s);
+	printf("\t\"connections\": %zu,\n", admission_stats.count);
+	printf("\t\"connections_per_s\": %.1f,\n", ((double)(admission_stats.count) / elapsed_s));
+	printf("\t\"rejections\": %zu,\n", rejection_stats.count);
+	printf("\t\"rejections_per_s\": %.1f,\n", ((double)(rejection_stats.count) / elapsed_s));
+	printf("\t\"stalls\": %zu,\n", stalls);
+	printf("\t\"admission_latency_us\": ");
+	bench_latency_stats_print_json(stdout, admission_stats);
+	printf(",\n");
+	printf("\t\"rejection_latency_us\": ");
+	bench_latency_stats_print_json(stdout, rejection_stats);
+	printf(",\n");
+	printf("\t\"server_threads_cpu_s\": [");
+
+	for(size_t i = 0; i < thread_cpus_after_count; ++i) {
+		uint64_t ticks = thread_cpus_after[i].ticks;
+		for(size_t j = 0; j < thread_cpus_before_count; ++j) {
+			if(thread_cpus_before[j].tid == thread_cpus_after[i].tid) {
+				ticks -= thread_cpus_before[j].ticks;
+				break;
+			}
+		}
+
+		printf(
+			"%s { \"name\": \"%s\", \"cpu_s\": %.3f }",
+			((i == 0) ? "" : ","),
+			thread_cpus_after[i].name,
+			((double)ticks / clock_ticks_per_s)
+		);
+	}
+
+	printf(" ]\n");
+	printf("}\n");
+
+	free(rejection_latencies.data);
+	free(admission_latencies.data);
+	free(client_threads);
+	free(clients);
+
+	return 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+/*
+ * Shutdown latency benchmark.
+ *
+ * Spawns a server with the sink as its child program `--iterations` times. Every time, a client connects, tells the
+ * sink to exit and stays connected (so that the server still serves it while shutting down).
+ *
+ * Reports the latency from the exit of the child program until the exit of the server.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+#include <poll.h>
+
+enum {
+	SHUTDOWN_REJECTION_BACKOFF_NS = 1000000,
+	SHUTDOWN_EXIT_TIMEOUT_MS = 5000,
+};
+
+struct shutdown_params {
+	const_cstr_t usockit_pathname;
+	const_cstr_t sink_pathname;
+	size_t iterations;
+};
+
+
+/**
+ * Reads the `exit <timestamp>` line of the sink from `stdout_fd` and returns the timestamp.
+ */
+static inline uint64_t shutdown_read_child_exit_ns(const int stdout_fd) {
+	char line[64];
+	size_t line_len = 0;
+
+	do {
+		struct pollfd pfd = { .fd = stdout_fd, .events = POLLIN };
+		cross_support_if_unlikely(poll(&pfd, 1, SHUTDOWN_EXIT_TIMEOUT_MS) <= 0) {
+			fprintf(stderr, "shutdown: the sink did not exit in time\n");
+			exit(1);
+		}
+
+		const ssize_t readc = read(stdout_fd, (line + line_len), (sizeof line - line_len - 1));
+		cross_support_if_unlikely(readc <= 0) {
+			fprintf(stderr, "shutdown: the sink closed its stdout without exiting\n");
+			exit(1);
+		}
+
+		line_len += (size_t)readc;
+		line[line_len] = '\0';
+	} while(strchr(line, '\n') == cross_support_nullptr);
+
+	uint64_t child_exit_ns;
+	cross_support_if_unlikely(sscanf(line, "exit %" SCNu64, &child_exit_ns) != 1) {
+		fprintf(stderr, "shutdown: unexpected output of the sink: %s", line);
+		exit(1);
+	}
+
+	return child_exit_ns;
+}
+
+/**
+ * Connects to the server and sends the exit line, retrying until the server admits the connection.
+ * The connection counts as admitted once the sink wrote something to `stdout_fd`.
+ *
+ * Returns the connected socket, which the caller keeps open while the server shuts down.
+ */
+static inline int shutdown_send_exit(const const_cstr_t socket_pathname,
+                                     const int stdout_fd,
+                                     size_t* const rejections_ptr) {
+	static const char exit_line[] = "exit\n";
+
+	do {
+		const int socket_fd = bench_connect(socket_pathname);
+		if(socket_fd == -1) {
+			perror("connect(2)");
+			exit(1);
+		}
+
+		struct bench_reply_reader reply_reader;
+		zeroset_lvalue(reply_reader);
+
+		enum bench_reply reply = BENCH_REPLY_NONE;
+
+		if(write_all(socket_fd, exit_line, (array_size(exit_line) - 1)) == RET_STATUS_SUCCESS) {
+			do {
+				struct pollfd pfds[2] = {
+					{ .fd = stdout_fd, .events = POLLIN },
+					{ .fd = socket_fd, .events = POLLIN },
+				};
+
+				cross_support_if_unlikely(poll(pfds, array_size(pfds), SHUTDOWN_EXIT_TIMEOUT_MS) <= 0) {
+					fprintf(stderr, "shutdown: the server neither admitted nor rejected the connection in time\n");
+					exit(1);
+				}
+
+				if(pfds[0].revents != 0) {
+					return socket_fd;
+				}
+
+				reply = bench_read_replies(&reply_reader, socket_fd);
+			} while(reply == BENCH_REPLY_NONE);
+		} else {
+			// most likely, the server rejected us and closed the connection right away
+			reply = bench_read_replies(&reply_reader, socket_fd);
+		}
+
+		cross_support_if_unlikely(reply != BENCH_REPLY_REJECTED) {
+			fprintf(stderr, "shutdown: the server closed the connection without admitting or rejecting it\n");
+			exit(1);
+		}
+
+		close(socket_fd);
+		++(*rejections_ptr);
+
+		bench_sleep_ns(SHUTDOWN_REJECTION_BACKOFF_NS);
+	} while(true);
+}
+
+
+static inline void shutdown_print_usage(const const_cstr_t argv0) {
+	fprintf(stderr, "usage: %s --usockit=<path> --sink=<path> [--iterations=<n>]\n", argv0);
+}
+
+int main(const int argc, const cstr_t* const argv) {
+	struct shutdown_params params = {
+		.usockit_pathname = cross_support_nullptr,
+		.sink_pathname    = cross_support_nullptr,
+		.iterations       = 50,
+	};
+
+	for(int i = 1; i < argc; ++i) {
+		const cstr_t arg = argv[i];
+
+		if(bench_parse_str_option(arg, "--usockit", &(params.usockit_pathname)) ||
+		   bench_parse_str_option(arg, "--sink", &(params.sink_pathname)) ||
+		   bench_parse_size_option(arg, "--iterations", &(params.iterations))) {
+
+			continue;
+		}
+
+		fprintf(stderr, "%s: %s: unknown argument\n", argv[0], arg);
+		shutdown_print_usage(argv[0]);
+		return 2;
+	}
+
+	cross_support_if_unlikely((params.usockit_pathname == cross_support_nullptr) ||
+	                          (params.sink_pathname == cross_support_nullptr) ||
+	                          (params.iterations == 0)) {
+
+		shutdown_print_usage(argv[0]);
+		return 2;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	uint64_t* const latencies_ns = calloc(params.iterations, sizeof *latencies_ns);
+	cross_support_if_unlikely(latencies_ns == cross_support_nullptr) {
+		perror("calloc(3)");
+		return 1;
+	}
+
+	size_t rejections = 0;
+
+	for(size_t i = 0; i < params.iterations; ++i) {
+		int stdout_pipe[2];
+		if(pipe(stdout_pipe) != 0) {
+			perror("pipe(2)");
+			return 1;
+		}
+
+		char socket_pathname[BENCH_SOCKET_PATHNAME_SIZE];
+		bench_make_socket_pathname(&socket_pathname);
+
+		const const_cstr_t child_argv[] = { params.sink_pathname, cross_support_nullptr };
+		const pid_t server_pid =
+			bench_spawn_server(params.usockit_pathname, socket_pathname, child_argv, stdout_pipe[1]);
+		close(stdout_pipe[1]);
+
+		const int socket_fd = shutdown_send_exit(socket_pathname, stdout_pipe[0], &rejections);
+
+		const uint64_t child_exit_ns = shutdown_read_child_exit_ns(stdout_pipe[0]);
+
+		waitpid(server_pid, cross_support_nullptr, 0);
+		latencies_ns[i] = (bench_now_ns() - child_exit_ns);
+
+		close(socket_fd);
+		close(stdout_pipe[0]);
+		bench_remove_socket_pathname(socket_pathname);
+	}
+
+	const struct bench_latency_stats stats = bench_latency_stats_compute(latencies_ns, params.iterations);
+
+	printf(
+		"{ \"benchmark\": \"shutdown\", \"params\": { \"iterations\": %zu }, \"rejections\": %zu,"
+		" \"child_exit_to_server_exit_us\": ",
+		params.iterations,
+		rejections
+	);
+	bench_latency_stats_print_json(stdout, stats);
+	printf(" }\n");
+
+	free(latencies_ns);
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+/*
+ * Child program of the benchmarks.
+ *
+ * Reads lines of the form `<tag> <padding...>\n` from stdin and acknowledges every line by writing `<tag>\n` to
+ * stdout. All acknowledgements for the data of one read(2) call are written with a single write(2) call.
+ *
+ * A line with the tag `exit` is not acknowledged; instead the sink writes `exit <timestamp>\n`, where the timestamp is
+ * the value of the monotonic clock in nanoseconds right before exiting, and exits.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+
+enum {
+	SINK_BUFFER_SIZE = (64 * 1024),
+	SINK_TAG_MAX_LENGTH = 31,
+};
+
+#define SINK_EXIT_TAG  "exit"
+#define SINK_EXIT_TAG_LENGTH  (array_size(SINK_EXIT_TAG) - 1)
+
+static int sink_exit(const unsigned char* const out_buffer, const size_t out_len) {
+	if(write_all(STDOUT_FILENO, out_buffer, out_len) != RET_STATUS_SUCCESS) {
+		perror("write(2)");
+		return 1;
+	}
+
+	char line[64];
+	const int line_len = snprintf(line, sizeof line, SINK_EXIT_TAG " %" PRIu64 "\n", bench_now_ns());
+
+	if(write_all(STDOUT_FILENO, line, (size_t)line_len) != RET_STATUS_SUCCESS) {
+		perror("write(2)");
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(void) {
+	static unsigned char in_buffer[SINK_BUFFER_SIZE];
+	// every input byte results in at most one output byte (either a tag byte or a newline)
+	static unsigned char out_buffer[SINK_BUFFER_SIZE];
+
+	// whether or not we're still inside the tag of the current line
+	bool in_tag = true;
+	size_t tag_len = 0;
+
+	do {
+		const ssize_t readc = read(STDIN_FILENO, in_buffer, array_size(in_buffer));
+
+		if(readc == 0) {
+			break;
+		}
+
+		if(readc < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			perror("read(2)");
+			return 1;
+		}
+
+		size_t out_len = 0;
+		for(size_t i = 0; i < (size_t)readc; ++i) {
+			const unsigned char c = in_buffer[i];
+
+			if(c == '\n') {
+				if((tag_len == SINK_EXIT_TAG_LENGTH) &&
+				   (memcmp((out_buffer + out_len - tag_len), SINK_EXIT_TAG, SINK_EXIT_TAG_LENGTH) == 0)) {
+
+					out_len -= tag_len;
+					return sink_exit(out_buffer, out_len);
+				}
+
+				out_buffer[out_len] = '\n';
+				++out_len;
+
+				in_tag = true;
+				tag_len = 0;
+				continue;
+			}
+
+			if(!in_tag) {
+				continue;
+			}
+
+			if((c == ' ') || (tag_len == SINK_TAG_MAX_LENGTH)) {
+				in_tag = false;
+				continue;
+			}
+
+			out_buffer[out_len] = c;
+			++out_len;
+			++tag_len;
+		}
+
+		if(out_len == 0) {
+			continue;
+		}
+
+		if(write_all(STDOUT_FILENO, out_buffer, out_len) != RET_STATUS_SUCCESS) {
+			perror("write(2)");
+			return 1;
+		}
+	} while(true);
+
+	return 0;
+}
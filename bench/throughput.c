@@ -0,0 +1,484 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+/*
+ * Throughput & latency benchmark.
+ *
+ * Spawns a server with the sink as its child program and lets `--clients` concurrent clients each send `--commands`
+ * lines of `--payload-size` bytes (newline included) to it, using write(2) calls of `--chunk-size` bytes.
+ * Since the server only serves one client at a time, the clients compete for the slot and retry after being rejected.
+ *
+ * The latency of a command is measured from the write(2) call that completes its line until the sink's
+ * acknowledgement for that line is read back from the sink's stdout.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+#include <poll.h>
+#include <pthread.h>
+
+enum {
+	// "<client>.<seq>" plus the separating space and the newline
+	THROUGHPUT_TAG_MAX_LENGTH = 31,
+	THROUGHPUT_MIN_PAYLOAD_SIZE = (THROUGHPUT_TAG_MAX_LENGTH + 2),
+
+	THROUGHPUT_ACK_TIMEOUT_S = 60,
+	THROUGHPUT_REJECTION_BACKOFF_NS = 1000000,
+	THROUGHPUT_ADMISSION_TIMEOUT_MS = 1000,
+};
+
+struct throughput_params {
+	const_cstr_t usockit_pathname;
+	const_cstr_t sink_pathname;
+	size_t clients;
+	size_t commands;
+	size_t payload_size;
+	size_t chunk_size;
+};
+
+struct throughput_state {
+	struct throughput_params params;
+	char socket_pathname[BENCH_SOCKET_PATHNAME_SIZE];
+	int ack_fd;
+
+	/**
+	 * Both indexed by `(client * params.commands) + seq`.
+	 */
+	uint64_t* send_ns;
+	uint64_t* latencies_ns;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	size_t* acked_counts; // indexed by client
+	size_t total_acked;
+	uint64_t last_ack_ns;
+	size_t rejections;
+	size_t admission_timeouts;
+};
+
+struct throughput_client_arg {
+	struct throughput_state* state;
+	size_t client;
+};
+
+
+static inline void throughput_record_ack(struct throughput_state* const state, const_cstr_t const tag) {
+	unsigned long client;
+	unsigned long seq;
+	if(sscanf(tag, "%lu.%lu", &client, &seq) != 2) {
+		fprintf(stderr, "throughput: malformed acknowledgement: %s\n", tag);
+		exit(1);
+	}
+
+	cross_support_if_unlikely((client >= state->params.clients) || (seq >= state->params.commands)) {
+		fprintf(stderr, "throughput: acknowledgement out of range: %s\n", tag);
+		exit(1);
+	}
+
+	const uint64_t now_ns = bench_now_ns();
+	const size_t index = (((size_t)client * state->params.commands) + (size_t)seq);
+	state->latencies_ns[index] = (now_ns - state->send_ns[index]);
+
+	pthread_mutex_lock(&(state->mutex));
+	++(state->acked_counts[client]);
+	++(state->total_acked);
+	state->last_ack_ns = now_ns;
+	pthread_mutex_unlock(&(state->mutex));
+	pthread_cond_broadcast(&(state->cond));
+}
+
+static void* throughput_ack_reader_routine(void* const arg_ptr) {
+	struct throughput_state* const state = (struct throughput_state*)arg_ptr;
+
+	char tag[THROUGHPUT_TAG_MAX_LENGTH + 1];
+	size_t tag_len = 0;
+
+	do {
+		unsigned char buffer[64 * 1024];
+		const ssize_t readc = read(state->ack_fd, buffer, array_size(buffer));
+
+		if(readc == 0) {
+			break;
+		}
+
+		if(readc < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			perror("read(2)");
+			exit(1);
+		}
+
+		for(size_t i = 0; i < (size_t)readc; ++i) {
+			if(buffer[i] != '\n') {
+				if(tag_len < THROUGHPUT_TAG_MAX_LENGTH) {
+					tag[tag_len] = (char)(buffer[i]);
+					++tag_len;
+				}
+				continue;
+			}
+
+			tag[tag_len] = '\0';
+			tag_len = 0;
+
+			throughput_record_ack(state, tag);
+		}
+	} while(true);
+
+	return cross_support_nullptr;
+}
+
+
+/**
+ * Fills `chunk` with the next bytes of the line stream of a client, recording the send time of every line that gets
+ * completed in this chunk.
+ */
+static inline size_t throughput_fill_chunk(
+	struct throughput_state* const state,
+	const size_t client,
+	unsigned char* const chunk,
+	char* const line,
+	size_t* const seq_ptr,
+	size_t* const line_offset_ptr
+) {
+	const size_t payload_size = state->params.payload_size;
+
+	size_t chunk_len = 0;
+	const uint64_t now_ns = bench_now_ns();
+
+	while((chunk_len < state->params.chunk_size) && (*seq_ptr < state->params.commands)) {
+		if(*line_offset_ptr == 0) {
+			const int tag_len = snprintf(line, payload_size, "%zu.%zu ", client, *seq_ptr);
+			memset((line + tag_len), 'x', (payload_size - (size_t)tag_len - 1));
+			line[payload_size - 1] = '\n';
+		}
+
+		size_t n = (payload_size - *line_offset_ptr);
+		if(n > (state->params.chunk_size - chunk_len)) {
+			n = (state->params.chunk_size - chunk_len);
+		}
+
+		memcpy((chunk + chunk_len), (line + *line_offset_ptr), n);
+		chunk_len += n;
+		*line_offset_ptr += n;
+
+		if(*line_offset_ptr == payload_size) {
+			state->send_ns[(client * state->params.commands) + *seq_ptr] = now_ns;
+			++(*seq_ptr);
+			*line_offset_ptr = 0;
+		}
+	}
+
+	return chunk_len;
+}
+
+enum throughput_admission {
+	THROUGHPUT_ADMISSION_ADMITTED,
+	THROUGHPUT_ADMISSION_REJECTED,
+	THROUGHPUT_ADMISSION_TIMED_OUT,
+};
+
+/**
+ * Waits until either the first line of `client` got acknowledged or the server rejected the connection.
+ *
+ * A connection that is neither admitted nor rejected in time, or that the server closes without either, is given up
+ * on; this happens when the server lost track of the connection.
+ */
+static inline enum throughput_admission throughput_wait_for_admission(
+	struct throughput_state* const state,
+	const size_t client,
+	const int socket_fd,
+	struct bench_reply_reader* const reply_reader
+) {
+	const uint64_t deadline_ns = (bench_now_ns() + ((uint64_t)THROUGHPUT_ADMISSION_TIMEOUT_MS * UINT64_C(1000000)));
+
+	do {
+		pthread_mutex_lock(&(state->mutex));
+		const bool acked = (state->acked_counts[client] > 0);
+		pthread_mutex_unlock(&(state->mutex));
+
+		if(acked) {
+			return THROUGHPUT_ADMISSION_ADMITTED;
+		}
+
+		struct pollfd pfd = { .fd = socket_fd, .events = POLLIN };
+		if(poll(&pfd, 1, 1) > 0) {
+			const enum bench_reply reply = bench_read_replies(reply_reader, socket_fd);
+
+			if(reply == BENCH_REPLY_REJECTED) {
+				return THROUGHPUT_ADMISSION_REJECTED;
+			}
+
+			if(reply == BENCH_REPLY_CLOSED) {
+				return THROUGHPUT_ADMISSION_TIMED_OUT;
+			}
+		}
+	} while(bench_now_ns() < deadline_ns);
+
+	return THROUGHPUT_ADMISSION_TIMED_OUT;
+}
+
+static void* throughput_client_routine(void* const arg_ptr) {
+	const struct throughput_client_arg arg = *(const struct throughput_client_arg*)arg_ptr;
+	struct throughput_state* const state = arg.state;
+
+	unsigned char* const chunk = malloc(state->params.chunk_size);
+	char* const line = malloc(state->params.payload_size);
+	cross_support_if_unlikely((chunk == cross_support_nullptr) || (line == cross_support_nullptr)) {
+		perror("malloc(3)");
+		exit(1);
+	}
+
+	do {
+		const int socket_fd = bench_connect(state->socket_pathname);
+		if(socket_fd == -1) {
+			perror("connect(2)");
+			exit(1);
+		}
+
+		size_t seq = 0;
+		size_t line_offset = 0;
+		bool admitted = false;
+		enum throughput_admission admission = THROUGHPUT_ADMISSION_ADMITTED;
+
+		struct bench_reply_reader reply_reader;
+		zeroset_lvalue(reply_reader);
+
+		do {
+			const size_t chunk_len = throughput_fill_chunk(state, arg.client, chunk, line, &seq, &line_offset);
+			if(chunk_len == 0) {
+				break;
+			}
+
+			if(write_all(socket_fd, chunk, chunk_len) != RET_STATUS_SUCCESS) {
+				cross_support_if_unlikely(admitted) {
+					fprintf(stderr, "throughput: the server closed the connection of client %zu\n", arg.client);
+					exit(1);
+				}
+
+				// most likely, the server rejected us and closed the connection right away
+				admission =
+					((bench_read_replies(&reply_reader, socket_fd) == BENCH_REPLY_REJECTED)
+					 ? THROUGHPUT_ADMISSION_REJECTED
+					 : THROUGHPUT_ADMISSION_TIMED_OUT);
+				break;
+			}
+
+			// as soon as the first line is out, hold off with the rest until we know whether we got the slot
+			if(!admitted && (seq > 0)) {
+				admission = throughput_wait_for_admission(state, arg.client, socket_fd, &reply_reader);
+				if(admission != THROUGHPUT_ADMISSION_ADMITTED) {
+					break;
+				}
+
+				admitted = true;
+			}
+
+			// the acknowledgements & credit that the server sends have to be taken, or else it disconnects us
+			cross_support_if_unlikely(admitted &&
+			                          (bench_read_replies(&reply_reader, socket_fd) != BENCH_REPLY_NONE)) {
+				fprintf(stderr, "throughput: the server closed the connection of client %zu\n", arg.client);
+				exit(1);
+			}
+		} while(true);
+
+		close(socket_fd);
+
+		if(admission == THROUGHPUT_ADMISSION_ADMITTED) {
+			break;
+		}
+
+		pthread_mutex_lock(&(state->mutex));
+		if(admission == THROUGHPUT_ADMISSION_REJECTED) {
+			++(state->rejections);
+		} else {
+			++(state->admission_timeouts);
+		}
+		pthread_mutex_unlock(&(state->mutex));
+
+		bench_sleep_ns(THROUGHPUT_REJECTION_BACKOFF_NS);
+	} while(true);
+
+	free(line);
+	free(chunk);
+
+	return cross_support_nullptr;
+}
+
+
+static inline void throughput_print_usage(const const_cstr_t argv0) {
+	fprintf(
+		stderr,
+		"usage: %s --usockit=<path> --sink=<path> [--clients=<n>] [--commands=<n>] [--payload-size=<bytes>]"
+		" [--chunk-size=<bytes>]\n",
+		argv0
+	);
+}
+
+int main(const int argc, const cstr_t* const argv) {
+	struct throughput_params params = {
+		.usockit_pathname = cross_support_nullptr,
+		.sink_pathname    = cross_support_nullptr,
+		.clients          = 1,
+		.commands         = 100000,
+		.payload_size     = 64,
+		.chunk_size       = 4096,
+	};
+
+	for(int i = 1; i < argc; ++i) {
+		const cstr_t arg = argv[i];
+
+		if(bench_parse_str_option(arg, "--usockit", &(params.usockit_pathname)) ||
+		   bench_parse_str_option(arg, "--sink", &(params.sink_pathname)) ||
+		   bench_parse_size_option(arg, "--clients", &(params.clients)) ||
+		   bench_parse_size_option(arg, "--commands", &(params.commands)) ||
+		   bench_parse_size_option(arg, "--payload-size", &(params.payload_size)) ||
+		   bench_parse_size_option(arg, "--chunk-size", &(params.chunk_size))) {
+
+			continue;
+		}
+
+		fprintf(stderr, "%s: %s: unknown argument\n", argv[0], arg);
+		throughput_print_usage(argv[0]);
+		return 2;
+	}
+
+	cross_support_if_unlikely((params.usockit_pathname == cross_support_nullptr) ||
+	                          (params.sink_pathname == cross_support_nullptr) ||
+	                          (params.clients == 0) || (params.commands == 0) || (params.chunk_size == 0) ||
+	                          (params.payload_size < THROUGHPUT_MIN_PAYLOAD_SIZE)) {
+
+		throughput_print_usage(argv[0]);
+		fprintf(stderr, "(the payload size must be at least %d)\n", THROUGHPUT_MIN_PAYLOAD_SIZE);
+		return 2;
+	}
+
+	// rejected clients would otherwise be killed when writing to their closed socket
+	signal(SIGPIPE, SIG_IGN);
+
+	struct throughput_state state;
+	zeroset_lvalue(state);
+	state.params = params;
+
+	state.send_ns = calloc(params.clients * params.commands, sizeof *(state.send_ns));
+	state.latencies_ns = calloc(params.clients * params.commands, sizeof *(state.latencies_ns));
+	state.acked_counts = calloc(params.clients, sizeof *(state.acked_counts));
+	cross_support_if_unlikely((state.send_ns == cross_support_nullptr) ||
+	                          (state.latencies_ns == cross_support_nullptr) ||
+	                          (state.acked_counts == cross_support_nullptr)) {
+		perror("calloc(3)");
+		return 1;
+	}
+
+	pthread_mutex_init(&(state.mutex), cross_support_nullptr);
+	pthread_cond_init(&(state.cond), cross_support_nullptr);
+
+	int ack_pipe[2];
+	if(pipe(ack_pipe) != 0) {
+		perror("pipe(2)");
+		return 1;
+	}
+
+	bench_make_socket_pathname(&(state.socket_pathname));
+
+	const const_cstr_t child_argv[] = { params.sink_pathname, cross_support_nullptr };
+	const pid_t server_pid =
+		bench_spawn_server(params.usockit_pathname, state.socket_pathname, child_argv, ack_pipe[1]);
+	close(ack_pipe[1]);
+	state.ack_fd = ack_pipe[0];
+
+	pthread_t ack_reader_thread;
+	pthread_create(&ack_reader_thread, cross_support_nullptr, &throughput_ack_reader_routine, &state);
+
+	pthread_t* const client_threads = calloc(params.clients, sizeof *client_threads);
+	struct throughput_client_arg* const client_args = calloc(params.clients, sizeof *client_args);
+	cross_support_if_unlikely((client_threads == cross_support_nullptr) || (client_args == cross_support_nullptr)) {
+		perror("calloc(3)");
+		return 1;
+	}
+
+	const uint64_t start_ns = bench_now_ns();
+
+	for(size_t client = 0; client < params.clients; ++client) {
+		client_args[client].state = &state;
+		client_args[client].client = client;
+		pthread_create(
+			&(client_threads[client]),
+			cross_support_nullptr,
+			&throughput_client_routine,
+			&(client_args[client])
+		);
+	}
+
+	for(size_t client = 0; client < params.clients; ++client) {
+		pthread_join(client_threads[client], cross_support_nullptr);
+	}
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += THROUGHPUT_ACK_TIMEOUT_S;
+
+	const size_t expected_acks = (params.clients * params.commands);
+
+	pthread_mutex_lock(&(state.mutex));
+	int wait_ret = 0;
+	while((state.total_acked < expected_acks) && (wait_ret == 0)) {
+		wait_ret = pthread_cond_timedwait(&(state.cond), &(state.mutex), &deadline);
+	}
+	const size_t total_acked = state.total_acked;
+	const uint64_t end_ns = state.last_ack_ns;
+	const size_t rejections = state.rejections;
+	const size_t admission_timeouts = state.admission_timeouts;
+	pthread_mutex_unlock(&(state.mutex));
+
+	kill(server_pid, SIGTERM);
+	waitpid(server_pid, cross_support_nullptr, 0);
+	bench_remove_socket_pathname(state.socket_pathname);
+
+	cross_support_if_unlikely(total_acked < expected_acks) {
+		fprintf(stderr, "%s: only %zu out of %zu commands were acknowledged\n", argv[0], total_acked, expected_acks);
+		return 1;
+	}
+
+	// the sink exits once the server is gone, which closes the last write end of the pipe
+	pthread_join(ack_reader_thread, cross_support_nullptr);
+	close(state.ack_fd);
+
+	const double elapsed_s = ((double)(end_ns - start_ns) / 1e9);
+	const double total_bytes = ((double)expected_acks * (double)(params.payload_size));
+
+	const struct bench_latency_stats latency_stats = bench_latency_stats_compute(state.latencies_ns, expected_acks);
+
+	printf("{\n");
+	printf("\t\"benchmark\": \"throughput\",\n");
+	printf(
+		"\t\"params\": { \"clients\": %zu, \"commands\": %zu, \"payload_size\": %zu, \"chunk_size\": %zu },\n",
+		params.clients,
+		params.commands,
+		params.payload_size,
+		params.chunk_size
+	);
+	printf("\t\"bytes\": %.0f,\n", total_bytes);
+	printf("\t\"elapsed_s\": %.6f,\n", elapsed_s);
+	printf("\t\"mb_per_s\": %.3f,\n", ((total_bytes / 1e6) / elapsed_s));
+	printf("\t\"commands_per_s\": %.1f,\n", ((double)expected_acks / elapsed_s));
+	printf("\t\"rejections\": %zu,\n", rejections);
+	printf("\t\"admission_timeouts\": %zu,\n", admission_timeouts);
+	printf("\t\"latency_us\": ");
+	bench_latency_stats_print_json(stdout, latency_stats);
+	printf("\n}\n");
+
+	free(client_args);
+	free(client_threads);
+	pthread_cond_destroy(&(state.cond));
+	pthread_mutex_destroy(&(state.mutex));
+	free(state.acked_counts);
+	free(state.latencies_ns);
+	free(state.send_ns);
+
+	return 0;
+}
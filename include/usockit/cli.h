@@ -23,6 +23,137 @@ enum {
 struct usockit_cli {
 	const_cstr_t socket_pathname;
 
+	/**
+	 * Whether or not the '--report-memory' argument was given.
+	 */
+	bool report_memory;
+
+	/**
+	 * Whether or not the '--pty' argument was given.
+	 */
+	bool pty;
+
+	/**
+	 * Value of the '--observer-socket=<path>' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t observer_socket_pathname;
+
+	/**
+	 * Value of the '--control-socket=<path>' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t control_socket_pathname;
+
+	/**
+	 * Values of the '--rate-limit=<limit>', '--line-limit=<limit>', '--global-rate-limit=<limit>' and
+	 * '--global-line-limit=<limit>' arguments or null pointers if the arguments were not given.
+	 */
+	const_cstr_t rate_limit;
+	const_cstr_t line_limit;
+	const_cstr_t global_rate_limit;
+	const_cstr_t global_line_limit;
+	/**
+	 * Value of the '--credit-window=<size>' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t credit_window;
+
+	/**
+	 * Whether or not the '--restart' or '--restart=<backoff>' argument was given.
+	 */
+	bool restart;
+	/**
+	 * Value of the '--restart=<backoff>' argument or a null pointer if the argument was not given with a value.
+	 */
+	const_cstr_t restart_backoff;
+	/**
+	 * Value of the '--restart-queue=<size>' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t restart_queue_size;
+	/**
+	 * Whether or not the '--standby' argument was given.
+	 */
+	bool standby;
+	/**
+	 * Value of the '--workers=<n>' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t workers;
+	/**
+	 * Value of the '--wait-queue=<length>[:<seconds>]' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t wait_queue;
+	/**
+	 * Value of the '--idle-timeout=<seconds>' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t idle_timeout;
+	/**
+	 * Value of the '--heartbeat=<seconds>' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t heartbeat;
+	/**
+	 * Value of the '--stdin-file=<path>' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t stdin_file;
+	/**
+	 * File descriptor given with the '--stdin-fd=<fd>' argument or -1 if the argument was not given.
+	 */
+	int stdin_fd;
+
+	/**
+	 * Whether or not the '--read-only' argument was given.
+	 */
+	bool read_only;
+	/**
+	 * Value of the '--expect=<pattern>' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t expect;
+	/**
+	 * Value of the '--timeout=<seconds>' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t timeout;
+	/**
+	 * Whether or not the '--sync' argument was given.
+	 */
+	bool sync;
+	/**
+	 * Value of the '--linger=<seconds>' argument or a null pointer if the argument was not given.
+	 * Valid for both servers and clients.
+	 */
+	const_cstr_t linger;
+	/**
+	 * Whether or not the '--wait' argument was given.
+	 */
+	bool wait;
+
+	/**
+	 * Whether or not the '--broadcast' or '--broadcast=<max>' argument was given.
+	 */
+	bool broadcast;
+	/**
+	 * Value of the '--broadcast=<max>' argument or a null pointer if the argument was not given with a value.
+	 */
+	const_cstr_t broadcast_max_in_flight;
+	/**
+	 * The socket paths (or patterns) given with the '--broadcast' argument, which are all of the arguments from the
+	 * first socket path on. `socket_pathname` is left unset.
+	 */
+	const cstr_t* broadcast_socket_pathnames;
+	size_t broadcast_socket_pathnames_count;
+
+	/**
+	 * Value of the '--control=<command>' argument or a null pointer if the argument was not given.
+	 */
+	const_cstr_t control;
+
+	/**
+	 * File descriptor given with the '--listen-fd=<fd>' argument or -1 if the argument was not given.
+	 */
+	int listen_fd;
+
+	/**
+	 * Value of the internal '--resume=<state>' argument, which a server passes to itself when it re-executes itself for
+	 * an upgrade, or a null pointer if the argument was not given.
+	 */
+	const_cstr_t resume_state;
+
 	/**
 	 * Whether or not the '--' argument was given.
 	 */
@@ -100,6 +231,39 @@ static inline struct usockit_cli usockit_cli_create() {
 	return (struct usockit_cli){
 		.socket_pathname = cross_support_nullptr,
 
+		.report_memory = false,
+		.pty = false,
+		.observer_socket_pathname = cross_support_nullptr,
+		.control_socket_pathname = cross_support_nullptr,
+		.rate_limit = cross_support_nullptr,
+		.line_limit = cross_support_nullptr,
+		.global_rate_limit = cross_support_nullptr,
+		.global_line_limit = cross_support_nullptr,
+		.credit_window = cross_support_nullptr,
+		.restart = false,
+		.restart_backoff = cross_support_nullptr,
+		.restart_queue_size = cross_support_nullptr,
+		.standby = false,
+		.workers = cross_support_nullptr,
+		.wait_queue = cross_support_nullptr,
+		.idle_timeout = cross_support_nullptr,
+		.heartbeat = cross_support_nullptr,
+		.stdin_file = cross_support_nullptr,
+		.stdin_fd = -1,
+		.read_only = false,
+		.expect = cross_support_nullptr,
+		.timeout = cross_support_nullptr,
+		.sync = false,
+		.linger = cross_support_nullptr,
+		.wait = false,
+		.broadcast = false,
+		.broadcast_max_in_flight = cross_support_nullptr,
+		.broadcast_socket_pathnames = cross_support_nullptr,
+		.broadcast_socket_pathnames_count = 0,
+		.control = cross_support_nullptr,
+		.listen_fd = -1,
+		.resume_state = cross_support_nullptr,
+
 		.child_program = false,
 	};
 }
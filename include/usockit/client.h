@@ -6,18 +6,95 @@
 #ifndef USOCKIT_CLIENT_H
 #define USOCKIT_CLIENT_H
 
+#include <stdbool.h>
+#include <usockit/client/child_exit.h>
+#include <usockit/client/expect.h>
 #include <usockit/cross_support.h>
 #include <usockit/support_types.h>
 
 enum usockit_client_ret_status {
 	USOCKIT_CLIENT_RET_STATUS_SUCCESS_EOF,
 	USOCKIT_CLIENT_RET_STATUS_SUCCESS_FUCK_OFF,
+	/**
+	 * The server closed the connection. (e.g.: because the child program died)
+	 */
+	USOCKIT_CLIENT_RET_STATUS_SUCCESS_SERVER_CLOSED,
+	/**
+	 * The server told us that the child program exited; `*child_exit_ptr` says how.
+	 */
+	USOCKIT_CLIENT_RET_STATUS_SUCCESS_CHILD_EXITED,
+	/**
+	 * The output of the child program matched `options->expect`.
+	 */
+	USOCKIT_CLIENT_RET_STATUS_SUCCESS_EXPECT_MATCHED,
+	/**
+	 * The output of the child program didn't match `options->expect` within `options->expect_timeout_ms`.
+	 */
+	USOCKIT_CLIENT_RET_STATUS_EXPECT_TIMEOUT,
+	/**
+	 * The server acknowledged that everything that was read from stdin was written into the stdin of the child program.
+	 */
+	USOCKIT_CLIENT_RET_STATUS_SUCCESS_ACKNOWLEDGED,
+	/**
+	 * The server is busy with another client and put us into its queue, but `options->wait` is `false`.
+	 */
+	USOCKIT_CLIENT_RET_STATUS_SUCCESS_QUEUED,
+	/**
+	 * The server disconnected us because we didn't send anything for too long.
+	 */
+	USOCKIT_CLIENT_RET_STATUS_IDLE_TIMEOUT,
 	USOCKIT_CLIENT_RET_STATUS_UNKNOWN, // TODO: remove this
 };
 
+struct usockit_client_options {
+	/**
+	 * Whether or not to only receive the output of the child program, without reading anything from stdin. (e.g.: for
+	 * connecting to the observer socket of a server)
+	 */
+	bool read_only;
+
+	/**
+	 * If not a null pointer, the client doesn't exit once stdin reached its end, but once the output of the child
+	 * program matched (or the server closed the connection). Only output that is sent after the client connected is
+	 * matched, not the snapshot of the screen.
+	 */
+	struct usockit_client_expect* expect;
+	/**
+	 * How long to wait for the output to match, counted from the connection, or 0 to wait forever.
+	 */
+	unsigned long expect_timeout_ms;
+
+	/**
+	 * Whether or not to wait, once stdin reached its end, until the server acknowledged that everything that was read
+	 * from stdin was written into the stdin of the child program, instead of exiting right away.
+	 * Not valid together with `read_only` or `expect`.
+	 */
+	bool sync;
+
+	/**
+	 * If greater than 0, the client shuts down the sending side of the socket once stdin reached its end, but keeps
+	 * receiving until the server closes the connection or until `linger_ms` milliseconds passed, so that it doesn't
+	 * miss what the child program sends back. Not valid together with `read_only`, `expect` or `sync`.
+	 */
+	unsigned long linger_ms;
+
+	/**
+	 * Whether or not to stay in the queue if the server is busy with another client, instead of giving up right away.
+	 * Once stdin reached its end, the client waits until the server acknowledged everything that was read from stdin,
+	 * the same as with `sync`, since input would otherwise be lost if it's still waiting. Not valid together with
+	 * `linger_ms`.
+	 */
+	bool wait;
+};
+
+/**
+ * `*child_exit_ptr` is only set if `USOCKIT_CLIENT_RET_STATUS_SUCCESS_CHILD_EXITED` is returned.
+ */
 cross_support_nodiscard
-extern enum usockit_client_ret_status usockit_client(const_cstr_t socket_pathname)
-	cross_support_attr_nonnull_all
-	cross_support_attr_warn_unused_result;
+extern enum usockit_client_ret_status usockit_client(const_cstr_t socket_pathname,
+                                                     const struct usockit_client_options* options,
+                                                     struct usockit_client_child_exit* child_exit_ptr)
+	                                                     cross_support_attr_nonnull_all
+	                                                     cross_support_attr_warn_unused_result;
 
 #endif /* USOCKIT_CLIENT_H */
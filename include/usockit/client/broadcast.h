@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#ifndef USOCKIT_CLIENT_BROADCAST_H
+#define USOCKIT_CLIENT_BROADCAST_H
+
+#include <stddef.h>
+#include <usockit/cross_support.h>
+#include <usockit/support_types.h>
+
+enum usockit_client_broadcast_ret_status {
+	USOCKIT_CLIENT_BROADCAST_RET_STATUS_ALL_DELIVERED,
+	/**
+	 * At least one server didn't receive the payload; the reasons were printed.
+	 */
+	USOCKIT_CLIENT_BROADCAST_RET_STATUS_NOT_ALL_DELIVERED,
+	USOCKIT_CLIENT_BROADCAST_RET_STATUS_UNKNOWN, // TODO: remove this
+};
+
+struct usockit_client_broadcast_options {
+	/**
+	 * How many connections may be open at the same time; at least 1.
+	 */
+	size_t max_in_flight;
+	/**
+	 * How long every server has to receive the payload, counted from the first connection attempt.
+	 */
+	unsigned long timeout_ms;
+};
+
+/**
+ * Reads stdin until its end and then sends what was read to the servers of all of the `socket_pathnames_count`
+ * sockets, with up to `options->max_in_flight` connections at the same time, all from the calling thread.
+ *
+ * A server received the payload once it closed the connection after it read all of it, at which point the server has
+ * written the payload into the stdin of the child program. A server that already has a client connected rejects us,
+ * unless it lets us wait for our turn (which counts towards the timeout).
+ *
+ * The outcome and the latency of every socket is printed to stdout as soon as it is known, followed by a summary.
+ */
+cross_support_nodiscard
+extern enum usockit_client_broadcast_ret_status usockit_client_broadcast(
+	const const_cstr_t socket_pathnames[],
+	size_t socket_pathnames_count,
+	const struct usockit_client_broadcast_options* options
+) cross_support_attr_nonnull(3)
+  cross_support_attr_warn_unused_result;
+
+#endif /* USOCKIT_CLIENT_BROADCAST_H */
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#ifndef USOCKIT_CLIENT_CHILD_EXIT_H
+#define USOCKIT_CLIENT_CHILD_EXIT_H
+
+#include <stdbool.h>
+
+/**
+ * How the child program exited, as told by the server.
+ */
+struct usockit_client_child_exit {
+	/**
+	 * Whether the child program was killed by a signal, instead of exiting on its own.
+	 */
+	bool signaled;
+	/**
+	 * The exit status of the child program, or the number of the signal that killed it if `signaled` is set.
+	 */
+	int value;
+};
+
+#endif /* USOCKIT_CLIENT_CHILD_EXIT_H */
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#ifndef USOCKIT_CLIENT_CONTROL_H
+#define USOCKIT_CLIENT_CONTROL_H
+
+#include <usockit/cross_support.h>
+#include <usockit/support_types.h>
+
+enum usockit_client_control_ret_status {
+	/**
+	 * The server replied with "ok".
+	 */
+	USOCKIT_CLIENT_CONTROL_RET_STATUS_OK,
+	/**
+	 * The server replied with "error:" (or with nothing at all, e.g.: because the command took too long to send).
+	 */
+	USOCKIT_CLIENT_CONTROL_RET_STATUS_ERROR,
+	USOCKIT_CLIENT_CONTROL_RET_STATUS_UNKNOWN, // TODO: remove this
+};
+
+/**
+ * Sends `command` to the server behind the control socket `socket_pathname` and writes the reply to stdout.
+ */
+cross_support_nodiscard
+extern enum usockit_client_control_ret_status usockit_client_control(const_cstr_t socket_pathname,
+                                                                     const_cstr_t command)
+	                                                                     cross_support_attr_nonnull_all
+	                                                                     cross_support_attr_warn_unused_result;
+
+#endif /* USOCKIT_CLIENT_CONTROL_H */
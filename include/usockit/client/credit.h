@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#ifndef USOCKIT_CLIENT_CREDIT_H
+#define USOCKIT_CLIENT_CREDIT_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <usockit/cross_support.h>
+#include <usockit/support_types.h>
+
+/**
+ * Credit that the server granted us; shared by the receiving thread, which grants it, and the sending thread, which
+ * waits for it.
+ */
+struct usockit_client_credit {
+	/**
+	 * The byte (counted from the start of the connection) up to which we may send, or UINT64_MAX as long as the server
+	 * didn't grant any credit, in which case there is no limit.
+	 */
+	_Atomic(uint64_t) limit;
+
+	/**
+	 * Either both the same eventfd or the read & write end of a pipe.
+	 */
+	int wakeup_fds[2];
+};
+
+cross_support_nodiscard
+extern ret_status_t usockit_client_credit_init(struct usockit_client_credit* credit)
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+extern void usockit_client_credit_destroy(struct usockit_client_credit* credit)
+	cross_support_attr_nonnull_all;
+
+/**
+ * Raises the limit to `limit` and wakes up the thread waiting in usockit_client_credit_await(); a limit that is lower
+ * than the current one is ignored, unless it's the first one.
+ */
+extern void usockit_client_credit_grant(struct usockit_client_credit* credit, uint64_t limit)
+	cross_support_attr_nonnull_all;
+
+/**
+ * Blocks until the limit is past `sent_size` and sets `*allowance_ptr` to the number of bytes that may be sent then.
+ * On failure, errno is set.
+ */
+cross_support_nodiscard
+extern ret_status_t usockit_client_credit_await(struct usockit_client_credit* credit,
+                                                uint64_t sent_size,
+                                                uint64_t* allowance_ptr)
+	                                                cross_support_attr_nonnull_all
+	                                                cross_support_attr_warn_unused_result;
+
+#endif /* USOCKIT_CLIENT_CREDIT_H */
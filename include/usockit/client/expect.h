@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#ifndef USOCKIT_CLIENT_EXPECT_H
+#define USOCKIT_CLIENT_EXPECT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <usockit/cross_support.h>
+#include <usockit/support_types.h>
+
+/**
+ * Size of the buffer that usockit_client_expect_create() writes the description of an invalid pattern into.
+ */
+#define USOCKIT_CLIENT_EXPECT_ERROR_MESSAGE_SIZE  128
+
+/**
+ * Longest line that is matched as a whole.
+ */
+#define USOCKIT_CLIENT_EXPECT_LINE_MAX_SIZE  ((size_t)(4 * 1024))
+
+/**
+ * Matcher of an extended regular expression (see regex(7)) against the output of the child program, which arrives in
+ * chunks of any size.
+ *
+ * The output is matched line by line, so only the current line is ever held on to, never the whole output. A line that
+ * isn't complete yet is matched as well, so that prompts without a newline character can be waited for.
+ * A carriage return at the end of a line is not part of the line. Lines longer than
+ * `USOCKIT_CLIENT_EXPECT_LINE_MAX_SIZE` bytes are only matched by their end.
+ *
+ * Not thread-safe.
+ */
+struct usockit_client_expect;
+
+/**
+ * Returns a null pointer and sets errno on failure.
+ * If `pattern` is invalid, errno is set to EINVAL and a description of what is wrong with it is written into
+ * `error_message`.
+ */
+cross_support_nodiscard
+extern struct usockit_client_expect* usockit_client_expect_create(
+	const_cstr_t pattern,
+	char error_message[USOCKIT_CLIENT_EXPECT_ERROR_MESSAGE_SIZE]
+) cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+extern void usockit_client_expect_destroy(struct usockit_client_expect* expect)
+	cross_support_attr_nonnull_all;
+
+/**
+ * Matches the next chunk of output. Returns `true` once the pattern matched; from then on, the output isn't looked at
+ * anymore.
+ */
+cross_support_nodiscard
+extern bool usockit_client_expect_feed(struct usockit_client_expect* expect, const void* data, size_t size)
+	cross_support_attr_nonnull(1)
+	cross_support_attr_warn_unused_result;
+
+#endif /* USOCKIT_CLIENT_EXPECT_H */
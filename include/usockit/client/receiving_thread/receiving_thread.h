@@ -7,19 +7,39 @@
 #define USOCKIT_CLIENT_RECEIVING_THREAD_RECEIVING_THREAD_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <usockit/client/credit.h>
+#include <usockit/client/expect.h>
 #include <usockit/client/threads_result.h>
 #include <usockit/cross_support.h>
 #include <usockit/support_types.h>
 
 cross_support_nodiscard
 /**
- * The receiving thread will read data from the socket and perform certain actions. (currently just exiting when the
- * string "fuck off" is received)
+ * The receiving thread will read messages from the socket and perform certain actions. (writing the output of the child
+ * program to stdout and exiting when the string "fuck off" is received or the server closes the connection)
+ *
+ * If `expect` is not a null pointer, the output is also matched against it and the thread exits once it matched.
+ * The thread doesn't take ownership of `expect`.
+ *
+ * If `sent_size_ptr` is not a null pointer, the thread exits once the server acknowledged at least `*sent_size_ptr`
+ * bytes, which the sending thread stores once it sent everything.
+ *
+ * Credit that the server grants is passed on to `*credit`.
+ *
+ * If the server puts us into the queue of connections that wait for the current client to leave, the thread exits
+ * right away, unless `wait_for_slot` is `true`.
  */
 extern ret_status_t usockit_client_receiving_thread_create(pthread_t* restrict thread,
                                                            int socket_fd,
+                                                           struct usockit_client_expect* expect,
+                                                           const _Atomic(uint64_t)* sent_size_ptr,
+                                                           struct usockit_client_credit* credit,
+                                                           bool wait_for_slot,
                                                            struct usockit_client_threads_result_dest* result_dest_ptr)
-	                                                           cross_support_attr_nonnull(1, 3)
+	                                                           cross_support_attr_nonnull(1, 5, 7)
 	                                                           cross_support_attr_warn_unused_result;
 
 #endif /* USOCKIT_CLIENT_RECEIVING_THREAD_RECEIVING_THREAD_H */
@@ -6,12 +6,42 @@
 #ifndef USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_H
 #define USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_H
 
+#include <usockit/client/child_exit.h>
+
 enum usockit_client_receiving_thread_result_type {
 	/**
 	 * Server sent "fuck off" - a client is already connected.
 	 */
 	USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_FUCK_OFF,
+	/**
+	 * Server closed the connection.
+	 */
+	USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_EOF,
 	USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_READ_FAILURE,
+	/**
+	 * Writing output of the child program to stdout failed.
+	 */
+	USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_WRITE_FAILURE,
+	/**
+	 * The output of the child program matched the pattern that the client waited for.
+	 */
+	USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_EXPECT_MATCHED,
+	/**
+	 * Server told us that the child program exited.
+	 */
+	USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_CHILD_EXITED,
+	/**
+	 * Server acknowledged everything that the sending thread sent.
+	 */
+	USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_ACKNOWLEDGED,
+	/**
+	 * Server put us into the queue of connections that wait for the current client to leave.
+	 */
+	USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_QUEUED,
+	/**
+	 * Server disconnected us for not sending anything for too long.
+	 */
+	USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_IDLE_TIMEOUT,
 };
 struct usockit_client_receiving_thread_result {
 	enum usockit_client_receiving_thread_result_type type;
@@ -20,6 +50,16 @@ struct usockit_client_receiving_thread_result {
 	 * Is only initialized if `type` is `USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_READ_FAILURE`.
 	 */
 	int read_errno;
+
+	/**
+	 * Is only initialized if `type` is `USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_WRITE_FAILURE`.
+	 */
+	int write_errno;
+
+	/**
+	 * Is only initialized if `type` is `USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_CHILD_EXITED`.
+	 */
+	struct usockit_client_child_exit child_exit;
 };
 
 #endif /* USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_H */
@@ -7,6 +7,10 @@
 #define USOCKIT_CLIENT_SENDING_THREAD_SENDING_THREAD_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <usockit/client/credit.h>
 #include <usockit/client/threads_result.h>
 #include <usockit/cross_support.h>
 #include <usockit/support_types.h>
@@ -14,6 +18,18 @@
 cross_support_nodiscard
 /**
  * The sending thread will read data from stdin and forward it to the socket.
+ * If `dispatch_eof` is `false`, the thread exits without dispatching a result once stdin reached its end, so that the
+ * result of the receiving thread is waited for instead.
+ *
+ * If `sent_size_ptr` is not a null pointer, the thread counts the bytes that it sent and, once stdin reached its end,
+ * stores the count in `*sent_size_ptr` and shuts down the sending side of the socket, so that the server sends its
+ * final acknowledgement. (`dispatch_eof` must be `false` then)
+ *
+ * If `linger_ms` is greater than 0, the thread also shuts down the sending side of the socket once stdin reached its
+ * end, but only dispatches its result `linger_ms` milliseconds later, so that the receiving thread can still receive
+ * what the server sends in the meantime.
+ *
+ * The thread never sends past the credit that the server granted in `*credit`.
  *
  * On success, do not obtain the return value of `*thread`, (i.e.: do no call pthread_join() with the second argument
  * not being a null pointer) as it will be undefined.
@@ -21,8 +37,12 @@ cross_support_nodiscard
  */
 extern ret_status_t usockit_client_sending_thread_create(pthread_t* restrict thread,
                                                          int socket_fd,
+                                                         bool dispatch_eof,
+                                                         unsigned long linger_ms,
+                                                         _Atomic(uint64_t)* sent_size_ptr,
+                                                         struct usockit_client_credit* credit,
                                                          struct usockit_client_threads_result_dest* result_dest_ptr)
-	                                                         cross_support_attr_nonnull(1, 3)
+	                                                         cross_support_attr_nonnull(1, 6, 7)
 	                                                         cross_support_attr_warn_unused_result;
 
 #endif /* USOCKIT_CLIENT_SENDING_THREAD_SENDING_THREAD_H */
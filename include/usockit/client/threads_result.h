@@ -6,10 +6,12 @@
 #ifndef USOCKIT_CLIENT_THREADS_RESULT_H
 #define USOCKIT_CLIENT_THREADS_RESULT_H
 
-#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <usockit/client/receiving_thread/result.h>
 #include <usockit/client/sending_thread/result.h>
 #include <usockit/cross_support.h>
+#include <usockit/support_types.h>
 
 enum usockit_client_threads_result_origin {
 	USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_NONE,
@@ -29,14 +31,68 @@ struct usockit_client_threads_result {
 	} thread_union;
 };
 
+/**
+ * Lock-free destination of the results of the sending & receiving thread.
+ *
+ * Every thread writes its result exactly once into its own slot and then publishes it by swapping its origin into
+ * `origin`. A result that is already published can only be replaced by a result that takes precedence over it.
+ * The first publication wakes up the thread waiting in usockit_client_threads_await_result().
+ */
 struct usockit_client_threads_result_dest {
-	pthread_mutex_t mutex;
-	struct usockit_client_threads_result result;
-	pthread_cond_t cond;
+	/**
+	 * Holds a value of `enum usockit_client_threads_result_origin`; the origin of the currently published result.
+	 */
+	atomic_int origin;
+
+	struct usockit_client_sending_thread_result   sending;
+	struct usockit_client_receiving_thread_result receiving;
+
+	/**
+	 * Either both the same eventfd or the read & write end of a pipe.
+	 */
+	int wakeup_fds[2];
 };
 
+cross_support_nodiscard
+extern ret_status_t usockit_client_threads_result_dest_init(struct usockit_client_threads_result_dest* result_dest_ptr)
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+extern void usockit_client_threads_result_dest_destroy(struct usockit_client_threads_result_dest* result_dest_ptr)
+	cross_support_attr_nonnull_all;
+
 extern void usockit_client_threads_dispatch_result(struct usockit_client_threads_result_dest* result_dest_ptr,
                                                    struct usockit_client_threads_result result)
 	                                                   cross_support_attr_nonnull(1);
 
+/**
+ * Blocks until at least one result has been dispatched.
+ */
+cross_support_nodiscard
+extern ret_status_t usockit_client_threads_await_result(struct usockit_client_threads_result_dest* result_dest_ptr)
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Same as usockit_client_threads_await_result(), but gives up after `timeout_ms` milliseconds, in which case
+ * `*timed_out_ptr` is set to `true`.
+ */
+cross_support_nodiscard
+extern ret_status_t usockit_client_threads_await_result_timeout(
+	struct usockit_client_threads_result_dest* result_dest_ptr,
+	unsigned long timeout_ms,
+	bool* timed_out_ptr
+) cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+/**
+ * Returns the currently published result.
+ * Only stable once both threads are either joined or won't dispatch anymore.
+ */
+cross_support_nodiscard
+extern struct usockit_client_threads_result usockit_client_threads_get_result(
+	struct usockit_client_threads_result_dest* result_dest_ptr
+) cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
 #endif /* USOCKIT_CLIENT_THREADS_RESULT_H */
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+/*
+ * Everything that the server sends to a client that it admitted is a message; a header followed by a payload.
+ * The header is made up of the type of the message (1 byte) and the size of the payload (4 bytes, big-endian).
+ *
+ * A client that is rejected receives the plain string "fuck off" instead, which can be told apart from a message by
+ * its first byte, since there is no message type with the value of 'f'. The rejection may also come right after a
+ * `USOCKIT_PROTOCOL_MESSAGE_TYPE_QUEUED` message.
+ *
+ * Clients still send raw data to the server.
+ */
+
+#ifndef USOCKIT_PROTOCOL_H
+#define USOCKIT_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <usockit/cross_support.h>
+
+#define USOCKIT_PROTOCOL_FUCK_OFF_STRING  "fuck off"
+
+#define USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE  5
+
+enum usockit_protocol_message_type {
+	/**
+	 * Output of the child program; the payload is the data exactly as the child program wrote it.
+	 */
+	USOCKIT_PROTOCOL_MESSAGE_TYPE_OUTPUT = 1,
+	/**
+	 * Redraws the screen as the child program drew it so far (pty mode only); the first message that a client receives.
+	 * Displayed the same way as output, but it doesn't contain anything new.
+	 */
+	USOCKIT_PROTOCOL_MESSAGE_TYPE_SNAPSHOT = 2,
+	/**
+	 * The child program exited; the last message that a client receives before the server closes the connection.
+	 * The payload is `USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE` bytes big: how the child program exited (one of
+	 * `enum usockit_protocol_child_exit_kind`) followed by its exit status or the number of the signal that killed it.
+	 */
+	USOCKIT_PROTOCOL_MESSAGE_TYPE_CHILD_EXIT = 3,
+	/**
+	 * How much of what the client sent was written into the stdin of the child program; the payload is the number of
+	 * bytes (`USOCKIT_PROTOCOL_ACK_PAYLOAD_SIZE` bytes, big-endian), counted from the start of the connection.
+	 * Sent every now and then while the client sends data and once more after the client shut down its sending side.
+	 */
+	USOCKIT_PROTOCOL_MESSAGE_TYPE_ACK = 4,
+	/**
+	 * Up to which byte (counted from the start of the connection, the same as acknowledgements) the client may send;
+	 * the payload is `USOCKIT_PROTOCOL_CREDIT_PAYLOAD_SIZE` bytes big, big-endian.
+	 * Sent right after the client connected and again whenever the server took in enough of what the client sent.
+	 * A client that never received credit may send as much as it likes. Credit is never taken back; a smaller limit
+	 * than the one before is ignored.
+	 */
+	USOCKIT_PROTOCOL_MESSAGE_TYPE_CREDIT = 5,
+	/**
+	 * Another client occupies the server, so the connection was put into the queue of connections that wait for it;
+	 * the payload is the position in the queue (`USOCKIT_PROTOCOL_QUEUED_PAYLOAD_SIZE` bytes, big-endian, 1 being
+	 * next). Only ever the first message. Once it's the connection's turn, the messages of an admitted client follow;
+	 * if it waited for too long, the rejection follows instead.
+	 */
+	USOCKIT_PROTOCOL_MESSAGE_TYPE_QUEUED = 6,
+	/**
+	 * Sent every now and then while the client doesn't send anything, so that the server notices when the client stops
+	 * taking what it's sent; the payload is empty. Clients don't need to respond to it.
+	 */
+	USOCKIT_PROTOCOL_MESSAGE_TYPE_HEARTBEAT = 7,
+	/**
+	 * The client didn't send anything for too long; the last message that the client receives before the server closes
+	 * the connection. The payload is empty.
+	 */
+	USOCKIT_PROTOCOL_MESSAGE_TYPE_IDLE_TIMEOUT = 8,
+};
+
+#define USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE  2
+
+/**
+ * Size of the payloads that are made up of a single count, encoded with `usockit_protocol_encode_size_payload`.
+ */
+#define USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE  8
+
+#define USOCKIT_PROTOCOL_ACK_PAYLOAD_SIZE     USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE
+#define USOCKIT_PROTOCOL_CREDIT_PAYLOAD_SIZE  USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE
+#define USOCKIT_PROTOCOL_QUEUED_PAYLOAD_SIZE  USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE
+
+enum usockit_protocol_child_exit_kind {
+	USOCKIT_PROTOCOL_CHILD_EXIT_KIND_EXITED   = 0,
+	USOCKIT_PROTOCOL_CHILD_EXIT_KIND_SIGNALED = 1,
+};
+
+
+static inline void usockit_protocol_encode_message_header(
+	unsigned char header[USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE],
+	enum usockit_protocol_message_type type,
+	uint32_t payload_size
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all;
+
+static inline void usockit_protocol_encode_message_header(
+	unsigned char header[const USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE],
+	const enum usockit_protocol_message_type type,
+	const uint32_t payload_size
+) {
+	header[0] = (unsigned char)type;
+	header[1] = (unsigned char)((payload_size >> 24) & 0xFF);
+	header[2] = (unsigned char)((payload_size >> 16) & 0xFF);
+	header[3] = (unsigned char)((payload_size >>  8) & 0xFF);
+	header[4] = (unsigned char)( payload_size        & 0xFF);
+}
+
+cross_support_nodiscard
+static inline uint32_t usockit_protocol_decode_message_payload_size(
+	const unsigned char header[USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE]
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+static inline uint32_t usockit_protocol_decode_message_payload_size(
+	const unsigned char header[const USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE]
+) {
+	return (((uint32_t)(header[1]) << 24) |
+	        ((uint32_t)(header[2]) << 16) |
+	        ((uint32_t)(header[3]) <<  8) |
+	         (uint32_t)(header[4]));
+}
+
+static inline void usockit_protocol_encode_size_payload(
+	unsigned char payload[USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE],
+	uint64_t size
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all;
+
+static inline void usockit_protocol_encode_size_payload(
+	unsigned char payload[const USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE],
+	const uint64_t size
+) {
+	for(size_t i = 0; i < USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE; ++i) {
+		payload[i] = (unsigned char)((size >> ((USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE - 1 - i) * 8)) & 0xFF);
+	}
+}
+
+cross_support_nodiscard
+static inline uint64_t usockit_protocol_decode_size_payload(
+	const unsigned char payload[USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE]
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+static inline uint64_t usockit_protocol_decode_size_payload(
+	const unsigned char payload[const USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE]
+) {
+	uint64_t size = 0;
+	for(size_t i = 0; i < USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE; ++i) {
+		size = ((size << 8) | (uint64_t)(payload[i]));
+	}
+
+	return size;
+}
+
+#endif /* USOCKIT_PROTOCOL_H */
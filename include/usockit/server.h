@@ -6,26 +6,282 @@
 #ifndef USOCKIT_SERVER_H
 #define USOCKIT_SERVER_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <sys/types.h>
 #include <usockit/cross_support.h>
 #include <usockit/support_types.h>
 
 enum usockit_server_ret_status {
 	USOCKIT_SERVER_RET_STATUS_SUCCESS,
 	USOCKIT_SERVER_RET_STATUS_OUT_OF_MEMORY,
+	USOCKIT_SERVER_RET_STATUS_NOT_A_LISTENING_SOCKET,
+	USOCKIT_SERVER_RET_STATUS_PTY_UNSUPPORTED,
 	USOCKIT_SERVER_RET_STATUS_UNKNOWN, // TODO: remove this
 };
 
+/**
+ * State handed from a server to the server binary that it re-executed itself with for an upgrade.
+ */
+struct usockit_server_resume_state {
+	/**
+	 * PID of the still running child program. (a process stays the parent of its children across exec(3))
+	 */
+	pid_t child_pid;
+	/**
+	 * File descriptor of the write end of the pipe connected to the child program's stdin.
+	 */
+	int child_stdin_fd;
+	/**
+	 * File descriptor of the client that was being served during the upgrade or -1 if there was none.
+	 */
+	int client_fd;
+	/**
+	 * File descriptor of the listening observer socket or -1 if there is none.
+	 */
+	int observer_listen_fd;
+	/**
+	 * PID of the still running standby child program and the file descriptor of the write end of the pipe connected
+	 * to its stdin, or both -1 if there is none.
+	 */
+	pid_t standby_pid;
+	int standby_stdin_fd;
+	/**
+	 * File descriptor of the listening control socket or -1 if there is none.
+	 */
+	int control_listen_fd;
+	/**
+	 * How many bytes of what the client sent were written into the stdin of the child program, or -1 if some of it was
+	 * lost; the acknowledgements that the client is sent carry on from there.
+	 */
+	long long client_delivered_size;
+	/**
+	 * How many bytes were read from the client, which the credit that it is granted is counted from.
+	 */
+	unsigned long long client_consumed_size;
+};
+
+enum usockit_server_rate_limit_kind {
+	/**
+	 * Limits of the client that is currently connected; a client that connects starts out with a full burst.
+	 */
+	USOCKIT_SERVER_RATE_LIMIT_CONNECTION_BYTES,
+	USOCKIT_SERVER_RATE_LIMIT_CONNECTION_LINES,
+	/**
+	 * Limits of all clients together; a client that reconnects doesn't get a new burst.
+	 */
+	USOCKIT_SERVER_RATE_LIMIT_GLOBAL_BYTES,
+	USOCKIT_SERVER_RATE_LIMIT_GLOBAL_LINES,
+
+	USOCKIT_SERVER_RATE_LIMITS_COUNT,
+};
+
+struct usockit_server_rate_limit {
+	/**
+	 * Bytes or lines per second, or 0 for no limit.
+	 */
+	unsigned long rate;
+	/**
+	 * Bytes or lines that may be sent at once, after the client was quiet for long enough. Not 0 if `rate` isn't 0.
+	 */
+	unsigned long burst;
+};
+
+struct usockit_server_restart_options {
+	/**
+	 * How long to wait before restarting the child program the first time after it failed. Every time that it fails
+	 * again right away, the wait doubles, up to `backoff_max_ms`. Once it ran for longer than `backoff_max_ms`, the
+	 * wait starts over at `backoff_min_ms`.
+	 */
+	unsigned long backoff_min_ms;
+	unsigned long backoff_max_ms;
+	/**
+	 * Maximum number of bytes of input that is held for the child program while it is down. Not less than 1024.
+	 */
+	size_t queue_size;
+	/**
+	 * Whether or not to keep a standby child program running next to the child program. The standby is started the
+	 * same way, but its stdin isn't written to until the child program fails; then it takes over right away, queued
+	 * input first, and a new standby is started in its place. A standby that fails itself is restarted with the same
+	 * backoff as the child program. Once the server shuts down, the stdin of the standby is closed.
+	 */
+	bool standby;
+};
+
+struct usockit_server_options {
+	/**
+	 * Whether or not to print the memory footprint of the server (RSS, VSZ & thread count) to stderr once the child
+	 * program is running.
+	 */
+	bool report_memory;
+
+	/**
+	 * Whether or not the child program runs in a pseudo-terminal (stdin, stdout & stderr) instead of just reading from
+	 * a pipe. The output of the child program is then forwarded to stdout of the server and to the connected client,
+	 * which first receives a snapshot of the screen as the child program drew it so far.
+	 *
+	 * Most programs only line-buffer their output when it is a terminal, so this gets output out as soon as a line is
+	 * complete instead of once a whole buffer is full.
+	 */
+	bool pty;
+
+	/**
+	 * Pathname of a second socket that observers connect to, or a null pointer to not create one. Only valid in pty
+	 * mode.
+	 *
+	 * Observers receive the same output as the connected client does (starting with a snapshot of the screen), but
+	 * anything they send is refused, and they don't occupy the client slot. Observers that fall too far behind the
+	 * output are disconnected.
+	 */
+	const_cstr_t observer_socket_pathname;
+
+	/**
+	 * Pathname of a socket for operators to control the server with, or a null pointer to not create one.
+	 *
+	 * A control client sends a single command line and receives a single reply line, starting with either "ok" or
+	 * "error:". Commands are handled by a thread of their own right away, even while the stdin of the child program is
+	 * full and the client that is connected is blocked:
+	 *
+	 * - "status": the PID of the child program, whether a client is connected, how much input is waiting in the
+	 *   stdin pipe of the child program and, in supervisor mode, in the queue
+	 * - "kill": sends SIGKILL to the child program (or to all workers)
+	 * - "signal <signal>": sends a signal, given by name (e.g.: "TERM" or "SIGTERM") or number, to the child program
+	 *   (or to all workers)
+	 * - "flush": discards the input that is queued while the child program is down (supervisor mode only)
+	 * - "resize <rows> <cols>": sets the window size of the pty, which sends SIGWINCH to the child program, and of the
+	 *   screen that snapshots are drawn from (pty mode only)
+	 */
+	const_cstr_t control_socket_pathname;
+
+	/**
+	 * Limits of the data that clients send to the child program, indexed by `enum usockit_server_rate_limit_kind`.
+	 * A line counts once its newline character is sent.
+	 *
+	 * A client that goes over a limit isn't read from until it is within all limits again, so that it is held back by
+	 * the socket filling up, without the server buffering or dropping anything. The number of times and the time that
+	 * clients were held back is printed to stderr when a client disconnects and when the server exits.
+	 */
+	struct usockit_server_rate_limit rate_limits[USOCKIT_SERVER_RATE_LIMITS_COUNT];
+
+	/**
+	 * How many bytes a client may send ahead of what the server read from it, or 0 to let clients send as much as they
+	 * like.
+	 *
+	 * The server grants clients credit up to `credit_window` bytes past what it read from them so far, and grants it
+	 * again once it read half of that, so that at most `credit_window` bytes of a client sit in the socket while the
+	 * stdin of the child program is full, instead of as much as the socket buffers hold. Clients that don't know about
+	 * credit aren't held to it.
+	 */
+	size_t credit_window;
+
+	/**
+	 * How long a client that shut down its sending side stays connected, so that it can still receive what the child
+	 * program sends back, or 0 to close the connection right away.
+	 *
+	 * The connection is closed earlier once the client closes its end. A lingering client still occupies the server, so
+	 * other clients are rejected in the meantime.
+	 */
+	unsigned long linger_ms;
+
+	/**
+	 * How many connections may wait for the client that occupies the server to leave, or 0 to reject them right away.
+	 *
+	 * Waiting connections are told their position (see `USOCKIT_PROTOCOL_MESSAGE_TYPE_QUEUED`) and are admitted in the
+	 * order that they arrived in; a connection that waited for `wait_timeout_ms` milliseconds is rejected after all.
+	 * Once the queue is full, connections are rejected right away again. How long connections waited is printed to
+	 * stderr when the server exits.
+	 */
+	size_t wait_queue_length;
+	unsigned long wait_timeout_ms;
+
+	/**
+	 * How long the connected client may not send anything before it is disconnected, or 0 to never disconnect it for
+	 * that. The client is told why (see `USOCKIT_PROTOCOL_MESSAGE_TYPE_IDLE_TIMEOUT`), and the next waiting connection
+	 * is admitted.
+	 */
+	unsigned long idle_timeout_ms;
+
+	/**
+	 * How often the connected client is sent a heartbeat while it doesn't send anything, or 0 to send none.
+	 *
+	 * A client that doesn't take its heartbeats (because its process is stuck, for example) is disconnected. Outside of
+	 * pty mode, a client that didn't read any of the last heartbeat by the time that the next one is due counts as
+	 * stuck as well.
+	 */
+	unsigned long heartbeat_interval_ms;
+
+	/**
+	 * If not a null pointer, the server supervises the child program: whenever the child program fails (exits with a
+	 * non-zero status or is killed by a signal), it is started again instead of the server shutting down. Only a child
+	 * program that exits with status 0 shuts down the server. Not valid in pty mode.
+	 *
+	 * While the child program is down, clients are still accepted and what they send is held in a queue, which is
+	 * written into the stdin of the restarted child program before anything else. Once the queue is full, clients are
+	 * not read from anymore until the child program is back up. Input that the child program didn't read before it
+	 * died is lost.
+	 */
+	const struct usockit_server_restart_options* restart;
+
+	/**
+	 * Number of copies of the child program ("workers") to start, each with a stdin of its own, or 0 or 1 for just the
+	 * one child program. Not valid in pty mode, in supervisor mode or when resuming, and `executable_pathname` must be
+	 * a null pointer, since the workers can't be handed over to an upgraded server.
+	 *
+	 * Input from clients is spread across the workers line by line; every line goes as a whole to the worker whose
+	 * stdin pipe has the least unread data in it. The server shuts down once all workers exited, with the status of the
+	 * first one that failed, or of the last one if none of them failed.
+	 */
+	size_t workers_count;
+
+	/**
+	 * File descriptor of input that the child program is given before any client, or -1.
+	 *
+	 * Everything up to its end is written into the stdin of the child program right after it was started, and only
+	 * then are connections accepted; connections made in the meantime wait in the socket's backlog. The server closes
+	 * the file descriptor afterwards and prints how long it took to stderr. Not valid in supervisor mode, with workers
+	 * or when resuming.
+	 */
+	int stdin_preload_fd;
+
+	/**
+	 * File descriptor of an already bound & listening socket (e.g.: passed down by a supervisor) or -1.
+	 *
+	 * If not -1, the server neither creates nor removes a socket itself and the socket pathname is ignored.
+	 * (unless `resume` is set, see there)
+	 */
+	int listen_fd;
+
+	/**
+	 * Pathname (or name to search for in PATH) of the usockit executable that the server re-executes itself with when
+	 * it receives SIGUSR2, or a null pointer if the server can't be upgraded (with workers), in which case SIGUSR2 is
+	 * ignored with a note on stderr.
+	 */
+	const_cstr_t executable_pathname;
+
+	/**
+	 * If not a null pointer, the server resumes where the server that re-executed itself for an upgrade left off,
+	 * instead of starting a new child program.
+	 *
+	 * `listen_fd` must not be -1 and the socket pathname, if given, is the one that the previous server created; it is
+	 * removed again once the server exits.
+	 */
+	const struct usockit_server_resume_state* resume;
+};
+
+/**
+ * `socket_pathname` may only be a null pointer if `options->listen_fd` is not -1.
+ */
 cross_support_nodiscard
 extern enum usockit_server_ret_status usockit_server(const_cstr_t socket_pathname,
                                                      #ifndef NDEBUG
                                                      size_t child_program_argc,
                                                      #endif
-                                                     const cstr_t* child_program_argv)
+                                                     const cstr_t* child_program_argv,
+                                                     const struct usockit_server_options* options)
 	                                                     #ifndef NDEBUG
-	                                                     cross_support_attr_nonnull(1, 3)
+	                                                     cross_support_attr_nonnull(3, 4)
 	                                                     #else
-	                                                     cross_support_attr_nonnull_all
+	                                                     cross_support_attr_nonnull(2, 3)
 	                                                     #endif
 	                                                     cross_support_attr_warn_unused_result;
 
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#ifndef USOCKIT_SERVER_OUTPUT_RING_H
+#define USOCKIT_SERVER_OUTPUT_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <usockit/cross_support.h>
+
+/**
+ * Ring buffer of the most recent output, which any number of readers read from, each one at its own offset, without
+ * copying the data out of the ring. (the readers hand the data to writev(2) straight from the ring)
+ *
+ * Offsets count the bytes that were ever appended, so they keep growing past the capacity of the ring; a reader that
+ * falls behind by more than the capacity has lost the data at its offset to newer output.
+ *
+ * Not thread-safe.
+ */
+struct usockit_server_output_ring;
+
+/**
+ * Returns a null pointer and sets errno on failure.
+ */
+cross_support_nodiscard
+extern struct usockit_server_output_ring* usockit_server_output_ring_create(size_t capacity)
+	cross_support_attr_warn_unused_result;
+
+extern void usockit_server_output_ring_destroy(struct usockit_server_output_ring* ring)
+	cross_support_attr_nonnull_all;
+
+/**
+ * `size` must not be bigger than the capacity of the ring.
+ */
+extern void usockit_server_output_ring_append(struct usockit_server_output_ring* ring, const void* data, size_t size)
+	cross_support_attr_nonnull(1);
+
+/**
+ * Returns the offset right after the most recent output, which is where a reader that only wants new output starts.
+ */
+cross_support_nodiscard
+extern uint64_t usockit_server_output_ring_end(const struct usockit_server_output_ring* ring)
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Points `iov` at the output from `offset` up to the end of the ring, which takes two vectors when it wraps around.
+ *
+ * Returns the number of vectors used, which is 0 if there is no output after `offset`, or -1 if the output at `offset`
+ * was already overwritten.
+ */
+cross_support_nodiscard
+extern int usockit_server_output_ring_peek(const struct usockit_server_output_ring* ring,
+                                           uint64_t offset,
+                                           struct iovec iov[2])
+	                                           cross_support_attr_nonnull_all
+	                                           cross_support_attr_warn_unused_result;
+
+#endif /* USOCKIT_SERVER_OUTPUT_RING_H */
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#ifndef USOCKIT_SERVER_SCREEN_H
+#define USOCKIT_SERVER_SCREEN_H
+
+#include <stddef.h>
+#include <usockit/cross_support.h>
+#include <usockit/support_types.h>
+
+/**
+ * Model of the terminal screen that the child program draws on in pty mode; the cells (character, colors &
+ * attributes), the cursor and the handful of terminal modes that matter to a client that attaches later on.
+ *
+ * The model is only ever updated incrementally with the output of the child program and is good enough to redraw
+ * what the child program drew, not to emulate a terminal. Every character is assumed to be one cell wide.
+ *
+ * Not thread-safe.
+ */
+struct usockit_server_screen;
+
+/**
+ * Returns a null pointer and sets errno on failure.
+ */
+cross_support_nodiscard
+extern struct usockit_server_screen* usockit_server_screen_create(unsigned short rows, unsigned short cols)
+	cross_support_attr_warn_unused_result;
+
+extern void usockit_server_screen_destroy(struct usockit_server_screen* screen)
+	cross_support_attr_nonnull_all;
+
+/**
+ * Keeps the top left part of the cells that fits into the new size.
+ * On failure, errno is set and the screen is left unchanged.
+ */
+cross_support_nodiscard
+extern ret_status_t usockit_server_screen_resize(struct usockit_server_screen* screen,
+                                                 unsigned short rows,
+                                                 unsigned short cols)
+	                                                 cross_support_attr_nonnull_all
+	                                                 cross_support_attr_warn_unused_result;
+
+/**
+ * Updates the screen with output of the child program. Escape sequences and UTF-8 sequences may be split across calls.
+ */
+extern void usockit_server_screen_feed(struct usockit_server_screen* screen, const void* data, size_t size)
+	cross_support_attr_nonnull(1);
+
+/**
+ * Renders the screen as output that, written to a terminal of the same size, redraws it from scratch and puts the
+ * terminal into the same state that the child program put its terminal in.
+ *
+ * `*data_ptr` is allocated with malloc(3) and has to be free'd by the caller.
+ * Returns RET_STATUS_FAILURE and sets errno if the allocation failed.
+ */
+cross_support_nodiscard
+extern ret_status_t usockit_server_screen_render(const struct usockit_server_screen* screen,
+                                                 unsigned char** data_ptr,
+                                                 size_t* size_ptr)
+	                                                 cross_support_attr_nonnull_all
+	                                                 cross_support_attr_warn_unused_result;
+
+#endif /* USOCKIT_SERVER_SCREEN_H */
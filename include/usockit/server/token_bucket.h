@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#ifndef USOCKIT_SERVER_TOKEN_BUCKET_H
+#define USOCKIT_SERVER_TOKEN_BUCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <usockit/cross_support.h>
+
+/**
+ * Rate limit of `rate` units per second on average, of which up to `burst` units may be used at once.
+ * The bucket starts out full and refills continuously; every unit that passes takes one token out of it.
+ *
+ * Time is given in nanoseconds of any monotonic clock.
+ */
+struct usockit_server_token_bucket {
+	double rate;
+	double burst;
+	double tokens;
+	uint64_t refill_ns;
+};
+
+extern void usockit_server_token_bucket_init(struct usockit_server_token_bucket* bucket,
+                                             unsigned long rate,
+                                             unsigned long burst,
+                                             uint64_t now_ns)
+	                                             cross_support_attr_nonnull_all;
+
+/**
+ * Adds the tokens that accumulated since the last refill, up to the burst size.
+ */
+extern void usockit_server_token_bucket_refill(struct usockit_server_token_bucket* bucket, uint64_t now_ns)
+	cross_support_attr_nonnull_all;
+
+/**
+ * Returns the number of whole units that may pass right now.
+ */
+cross_support_nodiscard
+extern size_t usockit_server_token_bucket_available(const struct usockit_server_token_bucket* bucket)
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * `count` must not be more than what usockit_server_token_bucket_available() returned.
+ */
+extern void usockit_server_token_bucket_take(struct usockit_server_token_bucket* bucket, size_t count)
+	cross_support_attr_nonnull_all;
+
+/**
+ * Returns how long it takes until at least one whole unit may pass, which is 0 if one may already.
+ */
+cross_support_nodiscard
+extern uint64_t usockit_server_token_bucket_wait_ns(const struct usockit_server_token_bucket* bucket)
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+#endif /* USOCKIT_SERVER_TOKEN_BUCKET_H */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#ifndef USOCKIT_THREADS_H
+#define USOCKIT_THREADS_H
+
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <usockit/cross_support.h>
+
+/**
+ * Stack space reserved for the libc functions called by the thread routines, on top of the routines' own frames.
+ *
+ * The largest consumer is perror(3); printing to the unbuffered stderr stream formats the message into a
+ * BUFSIZ-sized buffer on the stack.
+ */
+#define USOCKIT_THREAD_STACK_LIBC_RESERVE  ((size_t)(48 * 1024))
+
+/**
+ * Stack size of a thread whose routine's own frames use at most `routine_frames_size` bytes.
+ * (see the `.su` files generated by compiling with `-fstack-usage`)
+ */
+#define USOCKIT_THREAD_STACK_SIZE(routine_frames_size) \
+	(USOCKIT_THREAD_STACK_LIBC_RESERVE + (size_t)(routine_frames_size))
+
+/**
+ * Same as pthread_create(), except that the stack of the new thread is `stack_size` bytes big instead of the default
+ * size (which is usually 8 MiB).
+ *
+ * `stack_size` is rounded up to whole pages and to at least `PTHREAD_STACK_MIN`.
+ *
+ * Returns 0 on success or an error number on failure.
+ */
+cross_support_nodiscard
+static inline int usockit_thread_create(pthread_t* thread,
+                                        size_t stack_size,
+                                        void* (*start_routine)(void*),
+                                        void* arg)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull(1, 3)
+	cross_support_attr_warn_unused_result;
+
+static inline int usockit_thread_create(
+	pthread_t* const thread,
+	size_t stack_size,
+	void* (* const start_routine)(void*),
+	void* const arg
+) {
+	assert(thread != cross_support_nullptr);
+	assert(start_routine != cross_support_nullptr);
+
+	const long page_size = sysconf(_SC_PAGESIZE);
+	if(page_size > 0) {
+		stack_size = (((stack_size + (size_t)page_size - 1) / (size_t)page_size) * (size_t)page_size);
+	}
+
+	#ifdef PTHREAD_STACK_MIN
+	if(stack_size < (size_t)(PTHREAD_STACK_MIN)) {
+		stack_size = (size_t)(PTHREAD_STACK_MIN);
+	}
+	#endif
+
+	pthread_attr_t attr;
+
+	int ret = pthread_attr_init(&attr);
+	if(ret != 0) {
+		return ret;
+	}
+
+	ret = pthread_attr_setstacksize(&attr, stack_size);
+	if(ret != 0) {
+		pthread_attr_destroy(&attr);
+		return ret;
+	}
+
+	ret = pthread_create(thread, &attr, start_routine, arg);
+
+	pthread_attr_destroy(&attr);
+
+	return ret;
+}
+
+#endif /* USOCKIT_THREADS_H */
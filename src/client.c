@@ -6,7 +6,9 @@
 #include <assert.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
@@ -14,6 +16,7 @@
 #include <sys/un.h>
 #include <unistd.h>
 #include <usockit/client.h>
+#include <usockit/client/credit.h>
 #include <usockit/client/receiving_thread/receiving_thread.h>
 #include <usockit/client/sending_thread/sending_thread.h>
 #include <usockit/client/threads_result.h>
@@ -28,15 +31,22 @@
 
 
 cross_support_nodiscard
-static inline enum usockit_client_ret_status usockit_client_connect(int socket_fd, const_cstr_t socket_pathname)
-	cross_support_attr_always_inline
-	cross_support_attr_warn_unused_result;
+static inline enum usockit_client_ret_status usockit_client_connect(int socket_fd,
+                                                                    const_cstr_t socket_pathname,
+                                                                    const struct usockit_client_options* options,
+                                                                    struct usockit_client_child_exit* child_exit_ptr)
+	                                                                    cross_support_attr_always_inline
+	                                                                    cross_support_attr_warn_unused_result;
 
 
-enum usockit_client_ret_status usockit_client(const const_cstr_t socket_pathname) {
+enum usockit_client_ret_status usockit_client(const const_cstr_t socket_pathname,
+                                              const struct usockit_client_options* const options,
+                                              struct usockit_client_child_exit* const child_exit_ptr) {
 	#ifndef NDEBUG
 	// extra `#ifndef NDEBUG` here so that the strlen(3) call is not executed on release builds
 	{
+		assert(options != NULL);
+		assert(child_exit_ptr != NULL);
 		assert(socket_pathname != NULL);
 		const size_t socket_pathname_len = strlen(socket_pathname);
 		assert((socket_pathname_len > 0) && (socket_pathname_len <= USOCKIT_SOCKET_PATHNAME_MAX_LENGTH));
@@ -55,7 +65,8 @@ enum usockit_client_ret_status usockit_client(const const_cstr_t socket_pathname
 		return USOCKIT_CLIENT_RET_STATUS_UNKNOWN;
 	}
 
-	const enum usockit_client_ret_status ret_status = usockit_client_connect(socket_fd, socket_pathname);
+	const enum usockit_client_ret_status ret_status =
+		usockit_client_connect(socket_fd, socket_pathname, options, child_exit_ptr);
 
 	close(socket_fd);
 
@@ -65,7 +76,9 @@ enum usockit_client_ret_status usockit_client(const const_cstr_t socket_pathname
 
 static inline enum usockit_client_ret_status usockit_client_connect(
 	const int socket_fd,
-	const const_cstr_t socket_pathname
+	const const_cstr_t socket_pathname,
+	const struct usockit_client_options* const options,
+	struct usockit_client_child_exit* const child_exit_ptr
 ) {
 	struct usockit_client_threads_result_dest* threads_result_dest_ptr;
 	threads_result_dest_ptr = calloc(1, sizeof *threads_result_dest_ptr);
@@ -75,29 +88,17 @@ static inline enum usockit_client_ret_status usockit_client_connect(
 		return USOCKIT_CLIENT_RET_STATUS_UNKNOWN;
 	}
 
-	int ret = pthread_mutex_init(&(threads_result_dest_ptr->mutex), cross_support_nullptr);
-	if(ret != 0) {
-		free(threads_result_dest_ptr);
-
-		// TODO: pthread_mutex_init() error handling
-		errno = 0;
-		perror("pthread_mute_init");
-		return USOCKIT_CLIENT_RET_STATUS_UNKNOWN;
-	}
-
-	ret = pthread_cond_init(&(threads_result_dest_ptr->cond), cross_support_nullptr);
-	if(ret != 0) {
-		pthread_mutex_destroy(&(threads_result_dest_ptr->mutex));
+	ret_status_t ret_status = usockit_client_threads_result_dest_init(threads_result_dest_ptr);
+	if(ret_status != RET_STATUS_SUCCESS) {
+		errno_push();
 		free(threads_result_dest_ptr);
+		errno_pop();
 
-		// TODO: pthread_cond_init() error handling
-		errno = 0;
-		perror("pthread_cond_init");
+		// TODO: usockit_client_threads_result_dest_init() error handling
+		perror("usockit_client_threads_result_dest_init");
 		return USOCKIT_CLIENT_RET_STATUS_UNKNOWN;
 	}
 
-	threads_result_dest_ptr->result.origin = USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_NONE;
-
 
 	struct sockaddr_un addr;
 	zeroset_lvalue(addr);
@@ -106,11 +107,12 @@ static inline enum usockit_client_ret_status usockit_client_connect(
 	strcpy(addr.sun_path, socket_pathname);
 
 	errno = 0;
-	ret = connect(socket_fd, (const struct sockaddr*)&addr, sizeof addr);
+	const int ret = connect(socket_fd, (const struct sockaddr*)&addr, sizeof addr);
 	if(ret != 0) {
-		pthread_cond_destroy(&(threads_result_dest_ptr->cond));
-		pthread_mutex_destroy(&(threads_result_dest_ptr->mutex));
+		errno_push();
+		usockit_client_threads_result_dest_destroy(threads_result_dest_ptr);
 		free(threads_result_dest_ptr);
+		errno_pop();
 
 		// TODO: connect(2) error handling
 		perror("connect(2)");
@@ -118,68 +120,119 @@ static inline enum usockit_client_ret_status usockit_client_connect(
 	}
 
 
-	pthread_t receiving_thread;
-	ret_status_t ret_status =
-		usockit_client_receiving_thread_create(
-			&receiving_thread,
-			socket_fd,
-			threads_result_dest_ptr
-		);
+	// the sending thread stores how much it sent once it's done; nothing is acknowledged up to UINT64_MAX before that
+	_Atomic(uint64_t) sent_size;
+	atomic_init(&sent_size, UINT64_MAX);
+	// a client that waits in the queue must not leave before it got its turn, which the acknowledgement tells us
+	const bool await_ack = (options->sync || (options->wait && (options->expect == cross_support_nullptr)));
+	_Atomic(uint64_t)* const sent_size_ptr = (await_ack ? &sent_size : cross_support_nullptr);
+
+	struct usockit_client_credit credit;
+	ret_status = usockit_client_credit_init(&credit);
 	if(ret_status != RET_STATUS_SUCCESS) {
-		pthread_cond_destroy(&(threads_result_dest_ptr->cond));
-		pthread_mutex_destroy(&(threads_result_dest_ptr->mutex));
+		errno_push();
+		usockit_client_threads_result_dest_destroy(threads_result_dest_ptr);
 		free(threads_result_dest_ptr);
+		errno_pop();
 
-		// TODO: usockit_client_receiving_thread_create() error handling
-		perror("usockit_client_receiving_thread_create");
+		// TODO: usockit_client_credit_init() error handling
+		perror("usockit_client_credit_init");
 		return USOCKIT_CLIENT_RET_STATUS_UNKNOWN;
 	}
 
-	pthread_t sending_thread;
+	pthread_t receiving_thread;
 	ret_status =
-		usockit_client_sending_thread_create(
-			&sending_thread,
+		usockit_client_receiving_thread_create(
+			&receiving_thread,
 			socket_fd,
+			options->expect,
+			sent_size_ptr,
+			&credit,
+			options->wait,
 			threads_result_dest_ptr
 		);
 	if(ret_status != RET_STATUS_SUCCESS) {
-		pthread_cancel(receiving_thread);
-		pthread_join(receiving_thread, cross_support_nullptr);
-
-		pthread_cond_destroy(&(threads_result_dest_ptr->cond));
-		pthread_mutex_destroy(&(threads_result_dest_ptr->mutex));
+		errno_push();
+		usockit_client_credit_destroy(&credit);
+		usockit_client_threads_result_dest_destroy(threads_result_dest_ptr);
 		free(threads_result_dest_ptr);
+		errno_pop();
 
-		// TODO: usockit_client_sending_thread_create() error handling
-		perror("usockit_client_sending_thread_create");
+		// TODO: usockit_client_receiving_thread_create() error handling
+		perror("usockit_client_receiving_thread_create");
 		return USOCKIT_CLIENT_RET_STATUS_UNKNOWN;
 	}
 
+	// a read-only client simply has no sending thread; stdin is never touched
+	pthread_t sending_thread;
+	if(!(options->read_only)) {
+		ret_status =
+			usockit_client_sending_thread_create(
+				&sending_thread,
+				socket_fd,
+				((sent_size_ptr == cross_support_nullptr) && (options->expect == cross_support_nullptr)),
+				options->linger_ms,
+				sent_size_ptr,
+				&credit,
+				threads_result_dest_ptr
+			);
+		if(ret_status != RET_STATUS_SUCCESS) {
+			pthread_cancel(receiving_thread);
+			pthread_join(receiving_thread, cross_support_nullptr);
+
+			errno_push();
+			usockit_client_credit_destroy(&credit);
+			usockit_client_threads_result_dest_destroy(threads_result_dest_ptr);
+			free(threads_result_dest_ptr);
+			errno_pop();
+
+			// TODO: usockit_client_sending_thread_create() error handling
+			perror("usockit_client_sending_thread_create");
+			return USOCKIT_CLIENT_RET_STATUS_UNKNOWN;
+		}
+	}
 
-	struct usockit_client_threads_result threads_result;
 
-	pthread_mutex_lock(&(threads_result_dest_ptr->mutex));
-	while(threads_result_dest_ptr->result.origin == USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_NONE) {
-		pthread_cond_wait(&(threads_result_dest_ptr->cond), &(threads_result_dest_ptr->mutex));
+	bool timed_out = false;
+	if((options->expect != cross_support_nullptr) && (options->expect_timeout_ms > 0)) {
+		ret_status =
+			usockit_client_threads_await_result_timeout(
+				threads_result_dest_ptr,
+				options->expect_timeout_ms,
+				&timed_out
+			);
+	} else {
+		ret_status = usockit_client_threads_await_result(threads_result_dest_ptr);
+	}
+	cross_support_if_unlikely(ret_status != RET_STATUS_SUCCESS) {
+		// TODO: usockit_client_threads_await_result() error handling
+		perror("usockit_client_threads_await_result");
+		abort();
 	}
 
-	threads_result = threads_result_dest_ptr->result;
-
-	// cancel threads while they're still (potentially) waiting on the mutex
 	pthread_cancel(receiving_thread);
-	pthread_cancel(sending_thread);
-
-	pthread_mutex_unlock(&(threads_result_dest_ptr->mutex));
+	if(!(options->read_only)) {
+		pthread_cancel(sending_thread);
+	}
 
-	// join after unlocking mutex so we don't get deadlocks
 	pthread_join(receiving_thread, cross_support_nullptr);
-	pthread_join(sending_thread, cross_support_nullptr);
+	if(!(options->read_only)) {
+		pthread_join(sending_thread, cross_support_nullptr);
+	}
+
+	// only read the result *after* joining with the threads; a result that takes precedence over the one that woke us
+	// up may have been dispatched in the meantime
+	const struct usockit_client_threads_result threads_result =
+		usockit_client_threads_get_result(threads_result_dest_ptr);
 
-	// destroy the threads result destination *after* joining with the threads
-	pthread_cond_destroy(&(threads_result_dest_ptr->cond));
-	pthread_mutex_destroy(&(threads_result_dest_ptr->mutex));
+	usockit_client_credit_destroy(&credit);
+	usockit_client_threads_result_dest_destroy(threads_result_dest_ptr);
 	free(threads_result_dest_ptr);
 
+	if(timed_out && (threads_result.origin == USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_NONE)) {
+		return USOCKIT_CLIENT_RET_STATUS_EXPECT_TIMEOUT;
+	}
+
 	switch(threads_result.origin) {
 		case USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_SENDING: {
 			const struct usockit_client_sending_thread_result sending_thread_result =
@@ -215,11 +268,37 @@ static inline enum usockit_client_ret_status usockit_client_connect(
 				case USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_FUCK_OFF: {
 					return USOCKIT_CLIENT_RET_STATUS_SUCCESS_FUCK_OFF;
 				}
+				case USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_EOF: {
+					return USOCKIT_CLIENT_RET_STATUS_SUCCESS_SERVER_CLOSED;
+				}
+				case USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_EXPECT_MATCHED: {
+					return USOCKIT_CLIENT_RET_STATUS_SUCCESS_EXPECT_MATCHED;
+				}
+				case USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_CHILD_EXITED: {
+					*child_exit_ptr = receiving_thread_result.child_exit;
+					return USOCKIT_CLIENT_RET_STATUS_SUCCESS_CHILD_EXITED;
+				}
+				case USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_ACKNOWLEDGED: {
+					return USOCKIT_CLIENT_RET_STATUS_SUCCESS_ACKNOWLEDGED;
+				}
+				case USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_QUEUED: {
+					return USOCKIT_CLIENT_RET_STATUS_SUCCESS_QUEUED;
+				}
+				case USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_IDLE_TIMEOUT: {
+					return USOCKIT_CLIENT_RET_STATUS_IDLE_TIMEOUT;
+				}
 				case USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_READ_FAILURE: {
 					// TODO: read() error handling
+					errno = receiving_thread_result.read_errno;
 					perror("read");
 					return USOCKIT_CLIENT_RET_STATUS_UNKNOWN;
 				}
+				case USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_WRITE_FAILURE: {
+					// TODO: write() error handling
+					errno = receiving_thread_result.write_errno;
+					perror("write");
+					return USOCKIT_CLIENT_RET_STATUS_UNKNOWN;
+				}
 				default: {
 					cross_support_unreachable();
 				}
@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#define _POSIX_C_SOURCE  200809L // for MSG_NOSIGNAL
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <usockit/client/broadcast.h>
+#include <usockit/cross_support.h>
+#include <usockit/memtrace.h>
+#include <usockit/protocol.h>
+#include <usockit/shared.h>
+#include <usockit/support_types.h>
+#include <usockit/utils.h>
+
+#include <stdio.h>  // TODO: remove this. just required for perror(3)
+
+#define USOCKIT_CLIENT_BROADCAST_FUCK_OFF_STRING_SIZE \
+	(array_size(USOCKIT_PROTOCOL_FUCK_OFF_STRING) - 1)
+
+/**
+ * A server that is busy with another client may put us into its queue first; the rejection then comes after that.
+ */
+#define USOCKIT_CLIENT_BROADCAST_QUEUED_MESSAGE_SIZE \
+	(USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE + USOCKIT_PROTOCOL_QUEUED_PAYLOAD_SIZE)
+
+#define USOCKIT_CLIENT_BROADCAST_PAYLOAD_INIT_CAPACITY  ((size_t)(4 * 1024))
+
+enum {
+	/**
+	 * How long to wait before connecting again to a server whose queue of pending connections was full.
+	 */
+	USOCKIT_CLIENT_BROADCAST_CONNECT_RETRY_INTERVAL_MS = 10,
+};
+
+enum usockit_client_broadcast_phase {
+	/**
+	 * The queue of pending connections of the server was full; there is no socket until the next attempt.
+	 */
+	USOCKIT_CLIENT_BROADCAST_PHASE_CONNECT_RETRY,
+	USOCKIT_CLIENT_BROADCAST_PHASE_CONNECTING,
+	USOCKIT_CLIENT_BROADCAST_PHASE_SENDING,
+	/**
+	 * The payload was sent (or the server stopped taking it); waiting for the server to acknowledge all of it or to
+	 * close the connection.
+	 */
+	USOCKIT_CLIENT_BROADCAST_PHASE_RECEIVING,
+};
+
+enum usockit_client_broadcast_outcome {
+	USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING,
+	USOCKIT_CLIENT_BROADCAST_OUTCOME_DELIVERED,
+	USOCKIT_CLIENT_BROADCAST_OUTCOME_REJECTED,
+	USOCKIT_CLIENT_BROADCAST_OUTCOME_TIMED_OUT,
+	/**
+	 * `failed_func` and `failed_errno` of the connection tell why.
+	 */
+	USOCKIT_CLIENT_BROADCAST_OUTCOME_FAILED,
+};
+
+struct usockit_client_broadcast_connection {
+	const_cstr_t socket_pathname;
+	enum usockit_client_broadcast_phase phase;
+	int fd;
+	uint64_t started_ns;
+	uint64_t retry_at_ns;
+	size_t sent_size;
+	/**
+	 * The errno of send(2) if the server stopped taking the payload, which only matters if the server didn't reject
+	 * us; in that case, the rejection is what it sent before closing the connection.
+	 */
+	int send_errno;
+	/**
+	 * The beginning of what the server sent, to tell whether it rejected us.
+	 */
+	unsigned char received[USOCKIT_CLIENT_BROADCAST_QUEUED_MESSAGE_SIZE +
+	                       USOCKIT_CLIENT_BROADCAST_FUCK_OFF_STRING_SIZE];
+	size_t received_size;
+
+	/**
+	 * The message that is being received, of which only acknowledgements are looked into; a server that lingers (or an
+	 * older one that sends no acknowledgements) only tells us that it took everything by closing the connection.
+	 * `unframed` is set once the server sent something that isn't a message. (i.e.: the rejection)
+	 */
+	unsigned char message_header[USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE];
+	size_t message_header_size;
+	unsigned char message_payload[USOCKIT_PROTOCOL_ACK_PAYLOAD_SIZE];
+	uint32_t message_payload_received_size;
+	bool unframed;
+
+	const_cstr_t failed_func;
+	int failed_errno;
+};
+
+/**
+ * `*payload_ptr` is allocated with malloc(3) and has to be free'd by the caller.
+ * Returns RET_STATUS_FAILURE and sets errno if either reading or the allocation failed.
+ */
+cross_support_nodiscard
+static inline ret_status_t usockit_client_broadcast_read_payload(unsigned char** payload_ptr, size_t* size_ptr)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+cross_support_nodiscard
+static inline enum usockit_client_broadcast_outcome usockit_client_broadcast_connect(
+	struct usockit_client_broadcast_connection* connection,
+	uint64_t now_ns
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+/**
+ * Called once the socket of the connection is ready for its current phase.
+ */
+cross_support_nodiscard
+static inline enum usockit_client_broadcast_outcome usockit_client_broadcast_advance(
+	struct usockit_client_broadcast_connection* connection,
+	const unsigned char payload[],
+	size_t payload_size,
+	uint64_t now_ns
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull(1)
+  cross_support_attr_warn_unused_result;
+
+/**
+ * Returns `true` if the server acknowledged that all `payload_size` bytes were written into the stdin of the child
+ * program.
+ */
+cross_support_nodiscard
+static inline bool usockit_client_broadcast_receive_messages(
+	struct usockit_client_broadcast_connection* connection,
+	const unsigned char data[],
+	size_t size,
+	size_t payload_size
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+static inline void usockit_client_broadcast_report(const struct usockit_client_broadcast_connection* connection,
+                                                   enum usockit_client_broadcast_outcome outcome,
+                                                   uint64_t now_ns)
+	                                                   cross_support_attr_always_inline
+	                                                   cross_support_attr_nonnull_all;
+
+cross_support_nodiscard
+static inline uint64_t usockit_client_broadcast_now_ns(void)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
+
+
+enum usockit_client_broadcast_ret_status usockit_client_broadcast(
+	const const_cstr_t socket_pathnames[const],
+	const size_t socket_pathnames_count,
+	const struct usockit_client_broadcast_options* const options
+) {
+	assert((socket_pathnames != cross_support_nullptr) || (socket_pathnames_count == 0));
+	assert(options != cross_support_nullptr);
+	assert(options->max_in_flight > 0);
+
+	unsigned char* payload;
+	size_t payload_size;
+	ret_status_t ret_status = usockit_client_broadcast_read_payload(&payload, &payload_size);
+	if(ret_status != RET_STATUS_SUCCESS) {
+		// TODO: usockit_client_broadcast_read_payload() error handling
+		perror("usockit_client_broadcast_read_payload");
+		return USOCKIT_CLIENT_BROADCAST_RET_STATUS_UNKNOWN;
+	}
+
+	size_t max_in_flight = options->max_in_flight;
+	if((socket_pathnames_count > 0) && (max_in_flight > socket_pathnames_count)) {
+		max_in_flight = socket_pathnames_count;
+	}
+
+	errno = 0;
+	struct usockit_client_broadcast_connection* const connections = calloc(max_in_flight, sizeof *connections);
+	struct pollfd* const pfds = calloc(max_in_flight, sizeof *pfds);
+	cross_support_if_unlikely((connections == cross_support_nullptr) || (pfds == cross_support_nullptr)) {
+		errno_push();
+		free(pfds);
+		free(connections);
+		free(payload);
+		errno_pop();
+
+		// TODO: calloc() error handling
+		perror("calloc");
+		return USOCKIT_CLIENT_BROADCAST_RET_STATUS_UNKNOWN;
+	}
+
+	const uint64_t timeout_ns = ((uint64_t)(options->timeout_ms) * 1000000);
+	const uint64_t broadcast_started_ns = usockit_client_broadcast_now_ns();
+
+	size_t next_index = 0;
+	size_t in_flight = 0;
+	size_t delivered_count = 0;
+	ret_status = RET_STATUS_SUCCESS;
+
+	while((next_index < socket_pathnames_count) || (in_flight > 0)) {
+		while((in_flight < max_in_flight) && (next_index < socket_pathnames_count)) {
+			struct usockit_client_broadcast_connection* const connection = &(connections[in_flight]);
+			zeroset_lvalue(*connection);
+			connection->socket_pathname = socket_pathnames[next_index];
+			connection->fd = -1;
+			connection->started_ns = usockit_client_broadcast_now_ns();
+			++next_index;
+
+			const enum usockit_client_broadcast_outcome outcome =
+				usockit_client_broadcast_connect(connection, connection->started_ns);
+
+			if(outcome != USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING) {
+				usockit_client_broadcast_report(connection, outcome, usockit_client_broadcast_now_ns());
+				continue;
+			}
+
+			++in_flight;
+		}
+
+		if(in_flight == 0) {
+			continue;
+		}
+
+		// waits for whichever comes first; a socket becoming ready, a connection timing out or a retry being due
+		uint64_t now_ns = usockit_client_broadcast_now_ns();
+		int timeout_ms = -1;
+
+		for(size_t i = 0; i < in_flight; ++i) {
+			const struct usockit_client_broadcast_connection* const connection = &(connections[i]);
+
+			uint64_t wakeup_ns = (connection->started_ns + timeout_ns);
+			if((connection->phase == USOCKIT_CLIENT_BROADCAST_PHASE_CONNECT_RETRY) &&
+			   (connection->retry_at_ns < wakeup_ns)) {
+
+				wakeup_ns = connection->retry_at_ns;
+			}
+
+			const uint64_t remaining_ms = ((wakeup_ns > now_ns) ? (((wakeup_ns - now_ns) + 999999) / 1000000) : 0);
+			if((timeout_ms == -1) || (remaining_ms < (uint64_t)timeout_ms)) {
+				timeout_ms = ((remaining_ms > INT_MAX) ? INT_MAX : (int)remaining_ms);
+			}
+
+			// poll(2) ignores negative file descriptors
+			pfds[i].fd = connection->fd;
+			pfds[i].events =
+				((connection->phase == USOCKIT_CLIENT_BROADCAST_PHASE_RECEIVING) ? POLLIN : POLLOUT);
+			pfds[i].revents = 0;
+		}
+
+		errno = 0;
+		const int ret = poll(pfds, (nfds_t)in_flight, timeout_ms);
+		cross_support_if_unlikely((ret == -1) && (errno != EINTR)) {
+			// TODO: poll(2) error handling
+			perror("poll(2)");
+			ret_status = RET_STATUS_FAILURE;
+			break;
+		}
+
+		now_ns = usockit_client_broadcast_now_ns();
+
+		// backwards, since finishing a connection moves the last one into its place
+		for(size_t i = in_flight; i > 0; --i) {
+			struct usockit_client_broadcast_connection* const connection = &(connections[i - 1]);
+			enum usockit_client_broadcast_outcome outcome = USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING;
+
+			if((ret > 0) && (pfds[i - 1].revents != 0)) {
+				outcome = usockit_client_broadcast_advance(connection, payload, payload_size, now_ns);
+			} else if((connection->phase == USOCKIT_CLIENT_BROADCAST_PHASE_CONNECT_RETRY) &&
+			          (now_ns >= connection->retry_at_ns)) {
+
+				outcome = usockit_client_broadcast_connect(connection, now_ns);
+			}
+
+			if((outcome == USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING) &&
+			   (now_ns >= (connection->started_ns + timeout_ns))) {
+
+				outcome = USOCKIT_CLIENT_BROADCAST_OUTCOME_TIMED_OUT;
+			}
+
+			if(outcome == USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING) {
+				continue;
+			}
+
+			if(connection->fd != -1) {
+				close(connection->fd);
+			}
+
+			usockit_client_broadcast_report(connection, outcome, now_ns);
+
+			if(outcome == USOCKIT_CLIENT_BROADCAST_OUTCOME_DELIVERED) {
+				++delivered_count;
+			}
+
+			--in_flight;
+			*connection = connections[in_flight];
+		}
+	}
+
+	for(size_t i = 0; i < in_flight; ++i) {
+		if(connections[i].fd != -1) {
+			close(connections[i].fd);
+		}
+	}
+
+	free(pfds);
+	free(connections);
+	free(payload);
+
+	if(ret_status != RET_STATUS_SUCCESS) {
+		return USOCKIT_CLIENT_BROADCAST_RET_STATUS_UNKNOWN;
+	}
+
+	printf(
+		"%zu of %zu delivered (%.1f ms)\n",
+		delivered_count,
+		socket_pathnames_count,
+		((double)(usockit_client_broadcast_now_ns() - broadcast_started_ns) / 1e6)
+	);
+
+	return ((delivered_count == socket_pathnames_count)
+	        ? USOCKIT_CLIENT_BROADCAST_RET_STATUS_ALL_DELIVERED
+	        : USOCKIT_CLIENT_BROADCAST_RET_STATUS_NOT_ALL_DELIVERED);
+}
+
+
+static inline ret_status_t usockit_client_broadcast_read_payload(unsigned char** const payload_ptr,
+                                                                 size_t* const size_ptr) {
+	assert(payload_ptr != cross_support_nullptr);
+	assert(size_ptr != cross_support_nullptr);
+
+	size_t capacity = USOCKIT_CLIENT_BROADCAST_PAYLOAD_INIT_CAPACITY;
+	size_t size = 0;
+
+	errno = 0;
+	unsigned char* payload = malloc(capacity);
+	cross_support_if_unlikely(payload == cross_support_nullptr) {
+		return RET_STATUS_FAILURE;
+	}
+
+	ret_status_t ret_status = RET_STATUS_SUCCESS;
+
+	do {
+		if(size == capacity) {
+			errno = 0;
+			unsigned char* const tmp = realloc(payload, (capacity * 2));
+			cross_support_if_unlikely(tmp == cross_support_nullptr) {
+				ret_status = RET_STATUS_FAILURE;
+				break;
+			}
+
+			payload = tmp;
+			capacity *= 2;
+		}
+
+		errno = 0;
+		const ssize_t readc = read(STDIN_FILENO, (payload + size), (capacity - size));
+
+		if(readc > 0) {
+			size += (size_t)readc;
+			continue;
+		}
+
+		if((readc < 0) && (errno == EINTR)) {
+			continue;
+		}
+
+		if(readc < 0) {
+			ret_status = RET_STATUS_FAILURE;
+		}
+		break;
+	} while(true);
+
+	if(ret_status != RET_STATUS_SUCCESS) {
+		errno_push();
+		free(payload);
+		errno_pop();
+
+		return RET_STATUS_FAILURE;
+	}
+
+	*payload_ptr = payload;
+	*size_ptr = size;
+
+	return RET_STATUS_SUCCESS;
+}
+
+static inline enum usockit_client_broadcast_outcome usockit_client_broadcast_connect(
+	struct usockit_client_broadcast_connection* const connection,
+	const uint64_t now_ns
+) {
+	assert(connection != cross_support_nullptr);
+
+	// globbed paths are never checked by the command line parsing
+	if(strlen(connection->socket_pathname) > USOCKIT_SOCKET_PATHNAME_MAX_LENGTH) {
+		connection->failed_func = "connect(2)";
+		connection->failed_errno = ENAMETOOLONG;
+		return USOCKIT_CLIENT_BROADCAST_OUTCOME_FAILED;
+	}
+
+	errno = 0;
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd == -1) {
+		connection->failed_func = "socket(2)";
+		connection->failed_errno = errno;
+		return USOCKIT_CLIENT_BROADCAST_OUTCOME_FAILED;
+	}
+
+	// so that a single slow server doesn't hold up all of the others
+	errno = 0;
+	const int flags = fcntl(fd, F_GETFL);
+	if((flags == -1) || (fcntl(fd, F_SETFL, (flags | O_NONBLOCK)) == -1)) {
+		connection->failed_func = "fcntl(2)";
+		connection->failed_errno = errno;
+		close(fd);
+		return USOCKIT_CLIENT_BROADCAST_OUTCOME_FAILED;
+	}
+
+	struct sockaddr_un addr;
+	zeroset_lvalue(addr);
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, connection->socket_pathname);
+
+	errno = 0;
+	const int ret = connect(fd, (const struct sockaddr*)&addr, sizeof addr);
+
+	if(ret == 0) {
+		connection->fd = fd;
+		connection->phase = USOCKIT_CLIENT_BROADCAST_PHASE_SENDING;
+		return USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING;
+	}
+
+	// a non-blocking connect(2) that is interrupted carries on in the background
+	if((errno == EINPROGRESS) || (errno == EINTR)) {
+		connection->fd = fd;
+		connection->phase = USOCKIT_CLIENT_BROADCAST_PHASE_CONNECTING;
+		return USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING;
+	}
+
+	const int connect_errno = errno;
+	close(fd);
+
+	// the server only has room for a single pending connection, which is taken until it got around to accepting it
+	if(connect_errno == EAGAIN) {
+		connection->fd = -1;
+		connection->phase = USOCKIT_CLIENT_BROADCAST_PHASE_CONNECT_RETRY;
+		connection->retry_at_ns = (now_ns + ((uint64_t)USOCKIT_CLIENT_BROADCAST_CONNECT_RETRY_INTERVAL_MS * 1000000));
+		return USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING;
+	}
+
+	connection->failed_func = "connect(2)";
+	connection->failed_errno = connect_errno;
+	return USOCKIT_CLIENT_BROADCAST_OUTCOME_FAILED;
+}
+
+static inline enum usockit_client_broadcast_outcome usockit_client_broadcast_advance(
+	struct usockit_client_broadcast_connection* const connection,
+	const unsigned char payload[const],
+	const size_t payload_size,
+	const uint64_t now_ns
+) {
+	assert(connection != cross_support_nullptr);
+	assert((payload != cross_support_nullptr) || (payload_size == 0));
+
+	if(connection->phase == USOCKIT_CLIENT_BROADCAST_PHASE_CONNECTING) {
+		int connect_errno = 0;
+		socklen_t connect_errno_size = sizeof connect_errno;
+
+		errno = 0;
+		if(getsockopt(connection->fd, SOL_SOCKET, SO_ERROR, &connect_errno, &connect_errno_size) != 0) {
+			connect_errno = errno;
+		}
+
+		if(connect_errno != 0) {
+			close(connection->fd);
+			connection->fd = -1;
+
+			if(connect_errno == EAGAIN) {
+				connection->phase = USOCKIT_CLIENT_BROADCAST_PHASE_CONNECT_RETRY;
+				connection->retry_at_ns =
+					(now_ns + ((uint64_t)USOCKIT_CLIENT_BROADCAST_CONNECT_RETRY_INTERVAL_MS * 1000000));
+				return USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING;
+			}
+
+			connection->failed_func = "connect(2)";
+			connection->failed_errno = connect_errno;
+			return USOCKIT_CLIENT_BROADCAST_OUTCOME_FAILED;
+		}
+
+		connection->phase = USOCKIT_CLIENT_BROADCAST_PHASE_SENDING;
+	}
+
+	if(connection->phase == USOCKIT_CLIENT_BROADCAST_PHASE_SENDING) {
+		while(connection->sent_size < payload_size) {
+			// a server that closed the connection would otherwise kill us with SIGPIPE
+			errno = 0;
+			const ssize_t sendc =
+				send(
+					connection->fd,
+					(payload + connection->sent_size),
+					(payload_size - connection->sent_size),
+					MSG_NOSIGNAL
+				);
+
+			if(sendc >= 0) {
+				connection->sent_size += (size_t)sendc;
+				continue;
+			}
+
+			if(errno == EINTR) {
+				continue;
+			}
+
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				return USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING;
+			}
+
+			if((errno != EPIPE) && (errno != ECONNRESET)) {
+				connection->failed_func = "send(2)";
+				connection->failed_errno = errno;
+				return USOCKIT_CLIENT_BROADCAST_OUTCOME_FAILED;
+			}
+
+			// the server closed the connection; what it sent before that (if anything) tells why
+			connection->send_errno = errno;
+			break;
+		}
+
+		// the server closes the connection once it read everything up to here
+		(void)shutdown(connection->fd, SHUT_WR);
+
+		connection->phase = USOCKIT_CLIENT_BROADCAST_PHASE_RECEIVING;
+		return USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING;
+	}
+
+	assert(connection->phase == USOCKIT_CLIENT_BROADCAST_PHASE_RECEIVING);
+
+	do {
+		// output of the child program (in pty mode) is of no interest
+		unsigned char buffer[1024];
+
+		errno = 0;
+		const ssize_t readc = read(connection->fd, buffer, array_size(buffer));
+
+		if(readc > 0) {
+			size_t count = (array_size(connection->received) - connection->received_size);
+			if(count > (size_t)readc) {
+				count = (size_t)readc;
+			}
+
+			memcpy((connection->received + connection->received_size), buffer, count);
+			connection->received_size += count;
+
+			if((connection->send_errno == 0) &&
+			   usockit_client_broadcast_receive_messages(connection, buffer, (size_t)readc, payload_size)) {
+
+				return USOCKIT_CLIENT_BROADCAST_OUTCOME_DELIVERED;
+			}
+
+			continue;
+		}
+
+		// a server that closes the connection with data of ours still unread makes us read ECONNRESET instead of the
+		// end of the stream, but only after everything that it sent
+		if((readc == 0) || (errno == ECONNRESET)) {
+			break;
+		}
+
+		if(errno == EINTR) {
+			continue;
+		}
+
+		if((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+			return USOCKIT_CLIENT_BROADCAST_OUTCOME_PENDING;
+		}
+
+		connection->failed_func = "read(2)";
+		connection->failed_errno = errno;
+		return USOCKIT_CLIENT_BROADCAST_OUTCOME_FAILED;
+	} while(true);
+
+	// waiting in the queue counts towards the timeout, but getting our turn after all is the same as being admitted
+	size_t rejection_offset = 0;
+	if((connection->received_size >= USOCKIT_CLIENT_BROADCAST_QUEUED_MESSAGE_SIZE) &&
+	   (connection->received[0] == (unsigned char)USOCKIT_PROTOCOL_MESSAGE_TYPE_QUEUED) &&
+	   (usockit_protocol_decode_message_payload_size(connection->received) == USOCKIT_PROTOCOL_QUEUED_PAYLOAD_SIZE)) {
+
+		rejection_offset = USOCKIT_CLIENT_BROADCAST_QUEUED_MESSAGE_SIZE;
+	}
+
+	if((connection->received_size >= (rejection_offset + USOCKIT_CLIENT_BROADCAST_FUCK_OFF_STRING_SIZE)) &&
+	   (memcmp((connection->received + rejection_offset),
+	           USOCKIT_PROTOCOL_FUCK_OFF_STRING,
+	           USOCKIT_CLIENT_BROADCAST_FUCK_OFF_STRING_SIZE) == 0)) {
+
+		return USOCKIT_CLIENT_BROADCAST_OUTCOME_REJECTED;
+	}
+
+	if(connection->send_errno != 0) {
+		connection->failed_func = "send(2)";
+		connection->failed_errno = connection->send_errno;
+		return USOCKIT_CLIENT_BROADCAST_OUTCOME_FAILED;
+	}
+
+	return USOCKIT_CLIENT_BROADCAST_OUTCOME_DELIVERED;
+}
+
+static inline bool usockit_client_broadcast_receive_messages(
+	struct usockit_client_broadcast_connection* const connection,
+	const unsigned char data[const],
+	const size_t size,
+	const size_t payload_size
+) {
+	assert(connection != cross_support_nullptr);
+	assert(data != cross_support_nullptr);
+
+	bool acked = false;
+	size_t i = 0;
+
+	while((i < size) && !(connection->unframed)) {
+		if(connection->message_header_size < USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE) {
+			if((connection->message_header_size == 0) && (data[i] == (unsigned char)USOCKIT_PROTOCOL_FUCK_OFF_STRING[0])) {
+				connection->unframed = true;
+				break;
+			}
+
+			connection->message_header[connection->message_header_size] = data[i];
+			++(connection->message_header_size);
+			++i;
+
+			connection->message_payload_received_size = 0;
+		} else {
+			const uint32_t message_payload_size =
+				usockit_protocol_decode_message_payload_size(connection->message_header);
+
+			size_t count = (message_payload_size - connection->message_payload_received_size);
+			if(count > (size - i)) {
+				count = (size - i);
+			}
+
+			// only the payloads of acknowledgements are kept, everything else is skipped over
+			if(message_payload_size == USOCKIT_PROTOCOL_ACK_PAYLOAD_SIZE) {
+				memcpy((connection->message_payload + connection->message_payload_received_size), (data + i), count);
+			}
+
+			connection->message_payload_received_size += (uint32_t)count;
+			i += count;
+		}
+
+		if((connection->message_header_size < USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE) ||
+		   (connection->message_payload_received_size <
+		    usockit_protocol_decode_message_payload_size(connection->message_header))) {
+
+			continue;
+		}
+
+		// the message is complete
+		if((connection->message_header[0] == (unsigned char)USOCKIT_PROTOCOL_MESSAGE_TYPE_ACK) &&
+		   (connection->message_payload_received_size == USOCKIT_PROTOCOL_ACK_PAYLOAD_SIZE) &&
+		   (usockit_protocol_decode_size_payload(connection->message_payload) >= (uint64_t)payload_size)) {
+
+			acked = true;
+		}
+
+		connection->message_header_size = 0;
+	}
+
+	return acked;
+}
+
+static inline void usockit_client_broadcast_report(const struct usockit_client_broadcast_connection* const connection,
+                                                   const enum usockit_client_broadcast_outcome outcome,
+                                                   const uint64_t now_ns) {
+	assert(connection != cross_support_nullptr);
+
+	const double latency_ms = ((double)(now_ns - connection->started_ns) / 1e6);
+
+	switch(outcome) {
+		case USOCKIT_CLIENT_BROADCAST_OUTCOME_DELIVERED: {
+			printf("%s: delivered (%.1f ms)\n", connection->socket_pathname, latency_ms);
+			break;
+		}
+		case USOCKIT_CLIENT_BROADCAST_OUTCOME_REJECTED: {
+			printf("%s: rejected; another client is connected (%.1f ms)\n", connection->socket_pathname, latency_ms);
+			break;
+		}
+		case USOCKIT_CLIENT_BROADCAST_OUTCOME_TIMED_OUT: {
+			printf("%s: timed out (%.1f ms)\n", connection->socket_pathname, latency_ms);
+			break;
+		}
+		case USOCKIT_CLIENT_BROADCAST_OUTCOME_FAILED: {
+			printf(
+				"%s: %s: %s (%.1f ms)\n",
+				connection->socket_pathname,
+				connection->failed_func,
+				strerror(connection->failed_errno),
+				latency_ms
+			);
+			break;
+		}
+		default: {
+			cross_support_unreachable();
+		}
+	}
+
+	// so that whoever watches the progress sees every outcome right away, even through a pipe
+	fflush(stdout);
+}
+
+static inline uint64_t usockit_client_broadcast_now_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (((uint64_t)(now.tv_sec) * 1000000000) + (uint64_t)(now.tv_nsec));
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#define _POSIX_C_SOURCE  200809L // for MSG_NOSIGNAL
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <usockit/client/control.h>
+#include <usockit/cross_support.h>
+#ifndef NDEBUG
+	#include <usockit/shared.h>
+#endif
+#include <usockit/support_types.h>
+#include <usockit/utils.h>
+
+#include <stdio.h>  // TODO: remove this. just required for perror(3)
+
+enum {
+	/**
+	 * The server never replies with more than this; anything beyond it is passed through, but not looked at.
+	 */
+	USOCKIT_CLIENT_CONTROL_REPLY_BUFFER_SIZE = 256,
+};
+
+
+/**
+ * Like `write_all()`, but with MSG_NOSIGNAL, since a server that closed the connection would otherwise kill us with
+ * SIGPIPE.
+ */
+cross_support_nodiscard
+static inline ret_status_t usockit_client_control_send_all(int socket_fd, const void* buf, size_t count)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull(2)
+	cross_support_attr_warn_unused_result;
+
+cross_support_nodiscard
+static inline enum usockit_client_control_ret_status usockit_client_control_exchange(
+	int socket_fd,
+	const_cstr_t socket_pathname,
+	const_cstr_t command
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+
+enum usockit_client_control_ret_status usockit_client_control(const const_cstr_t socket_pathname,
+                                                              const const_cstr_t command) {
+	#ifndef NDEBUG
+	// extra `#ifndef NDEBUG` here so that the strlen(3) call is not executed on release builds
+	{
+		assert(socket_pathname != NULL);
+		assert(command != NULL);
+		const size_t socket_pathname_len = strlen(socket_pathname);
+		assert((socket_pathname_len > 0) && (socket_pathname_len <= USOCKIT_SOCKET_PATHNAME_MAX_LENGTH));
+	}
+	#endif
+
+	errno = 0;
+	const int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(socket_fd == -1) {
+		// TODO: socket(2) error handling
+		perror("socket(2)");
+		return USOCKIT_CLIENT_CONTROL_RET_STATUS_UNKNOWN;
+	}
+
+	const enum usockit_client_control_ret_status ret_status =
+		usockit_client_control_exchange(socket_fd, socket_pathname, command);
+
+	close(socket_fd);
+
+	return ret_status;
+}
+
+
+static inline enum usockit_client_control_ret_status usockit_client_control_exchange(
+	const int socket_fd,
+	const const_cstr_t socket_pathname,
+	const const_cstr_t command
+) {
+	struct sockaddr_un addr;
+	zeroset_lvalue(addr);
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_pathname);
+
+	errno = 0;
+	int ret = connect(socket_fd, (const struct sockaddr*)&addr, sizeof addr);
+	if(ret != 0) {
+		// TODO: connect(2) error handling
+		perror("connect(2)");
+		return USOCKIT_CLIENT_CONTROL_RET_STATUS_UNKNOWN;
+	}
+
+	// the command and its newline character are sent separately, so that the command doesn't have to be copied only to
+	// append one character
+	ret_status_t send_ret_status = usockit_client_control_send_all(socket_fd, command, strlen(command));
+	if(send_ret_status == RET_STATUS_SUCCESS) {
+		send_ret_status = usockit_client_control_send_all(socket_fd, "\n", 1);
+	}
+
+	// the server replies and closes the connection when the command is too long, which fails sending the rest of it
+	if((send_ret_status != RET_STATUS_SUCCESS) && (errno != EPIPE) && (errno != ECONNRESET)) {
+		// TODO: send(2) error handling
+		perror("send(2)");
+		return USOCKIT_CLIENT_CONTROL_RET_STATUS_UNKNOWN;
+	}
+
+	(void)shutdown(socket_fd, SHUT_WR);
+
+	char reply[USOCKIT_CLIENT_CONTROL_REPLY_BUFFER_SIZE];
+
+	// the first two bytes of the reply; they may arrive in separate reads
+	char reply_prefix[2];
+	size_t reply_size = 0;
+
+	do {
+		errno = 0;
+		const ssize_t readc = read(socket_fd, reply, sizeof reply);
+
+		if(readc < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			if(errno == ECONNRESET) {
+				break;
+			}
+
+			// TODO: read(2) error handling
+			perror("read(2)");
+			return USOCKIT_CLIENT_CONTROL_RET_STATUS_UNKNOWN;
+		}
+
+		if(readc == 0) {
+			break;
+		}
+
+		for(size_t i = 0; (i < (size_t)readc) && (reply_size < sizeof reply_prefix); ++i) {
+			reply_prefix[reply_size] = reply[i];
+			++reply_size;
+		}
+
+		const ret_status_t ret_status = write_all(STDOUT_FILENO, reply, (size_t)readc);
+		if(ret_status != RET_STATUS_SUCCESS) {
+			// TODO: write(2) error handling
+			perror("write(2)");
+			return USOCKIT_CLIENT_CONTROL_RET_STATUS_UNKNOWN;
+		}
+	} while(true);
+
+	if((reply_size == sizeof reply_prefix) && (memcmp(reply_prefix, "ok", sizeof reply_prefix) == 0)) {
+		return USOCKIT_CLIENT_CONTROL_RET_STATUS_OK;
+	}
+
+	return USOCKIT_CLIENT_CONTROL_RET_STATUS_ERROR;
+}
+
+static inline ret_status_t usockit_client_control_send_all(const int socket_fd,
+                                                           const void* const buf,
+                                                           const size_t count) {
+	assert(buf != cross_support_nullptr);
+
+	size_t sentc = 0;
+
+	while(sentc < count) {
+		errno = 0;
+		const ssize_t ret = send(socket_fd, ((const unsigned char*)buf + sentc), (count - sentc), MSG_NOSIGNAL);
+
+		if(ret < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			return RET_STATUS_FAILURE;
+		}
+
+		sentc += (size_t)ret;
+	}
+
+	return RET_STATUS_SUCCESS;
+}
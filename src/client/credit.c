@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#define _POSIX_C_SOURCE  200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <usockit/client/credit.h>
+#include <usockit/cross_support.h>
+#include <usockit/support_types.h>
+#include <usockit/utils.h>
+
+#define USOCKIT_CLIENT_CREDIT_EVENTFD_SUPPORT \
+	(CROSS_SUPPORT_LINUX_LEAST(2,6,22) && CROSS_SUPPORT_GLIBC_LEAST(2,8))
+
+#if USOCKIT_CLIENT_CREDIT_EVENTFD_SUPPORT
+	#include <sys/eventfd.h>
+#endif
+
+#define PIPE_READ_INDEX   0
+#define PIPE_WRITE_INDEX  1
+
+
+ret_status_t usockit_client_credit_init(struct usockit_client_credit* const credit) {
+	assert(credit != cross_support_nullptr);
+
+	atomic_init(&(credit->limit), UINT64_MAX);
+
+	#if USOCKIT_CLIENT_CREDIT_EVENTFD_SUPPORT
+	errno = 0;
+	const int fd = eventfd(0, 0);
+	if(fd == -1) {
+		return RET_STATUS_FAILURE;
+	}
+
+	credit->wakeup_fds[PIPE_READ_INDEX]  = fd;
+	credit->wakeup_fds[PIPE_WRITE_INDEX] = fd;
+	#else
+	errno = 0;
+	if(pipe(credit->wakeup_fds) != 0) {
+		return RET_STATUS_FAILURE;
+	}
+
+	// every grant writes a byte; the waiting thread only needs one of them, so a full pipe doesn't matter
+	errno = 0;
+	const int flags = fcntl(credit->wakeup_fds[PIPE_WRITE_INDEX], F_GETFL);
+	if((flags == -1) || (fcntl(credit->wakeup_fds[PIPE_WRITE_INDEX], F_SETFL, (flags | O_NONBLOCK)) == -1)) {
+		errno_push();
+		close(credit->wakeup_fds[PIPE_READ_INDEX]);
+		close(credit->wakeup_fds[PIPE_WRITE_INDEX]);
+		errno_pop();
+
+		return RET_STATUS_FAILURE;
+	}
+	#endif
+
+	return RET_STATUS_SUCCESS;
+}
+
+void usockit_client_credit_destroy(struct usockit_client_credit* const credit) {
+	assert(credit != cross_support_nullptr);
+
+	close(credit->wakeup_fds[PIPE_READ_INDEX]);
+
+	#if !(USOCKIT_CLIENT_CREDIT_EVENTFD_SUPPORT)
+	close(credit->wakeup_fds[PIPE_WRITE_INDEX]);
+	#endif
+}
+
+
+void usockit_client_credit_grant(struct usockit_client_credit* const credit, const uint64_t limit) {
+	assert(credit != cross_support_nullptr);
+
+	// only the receiving thread grants credit, so there's no other writer to race with
+	const uint64_t current_limit = atomic_load(&(credit->limit));
+	if((current_limit != UINT64_MAX) && (limit <= current_limit)) {
+		return;
+	}
+
+	atomic_store(&(credit->limit), limit);
+
+	#if USOCKIT_CLIENT_CREDIT_EVENTFD_SUPPORT
+	const uint64_t value = 1;
+	#else
+	const unsigned char value = 1;
+	#endif
+
+	// the eventfd counter doesn't overflow in practice and a full pipe already wakes up the waiting thread
+	ssize_t writec;
+	do {
+		writec = write(credit->wakeup_fds[PIPE_WRITE_INDEX], &value, sizeof value);
+	} while((writec < 0) && (errno == EINTR));
+}
+
+ret_status_t usockit_client_credit_await(struct usockit_client_credit* const credit,
+                                         const uint64_t sent_size,
+                                         uint64_t* const allowance_ptr) {
+	assert(credit != cross_support_nullptr);
+	assert(allowance_ptr != cross_support_nullptr);
+
+	#if USOCKIT_CLIENT_CREDIT_EVENTFD_SUPPORT
+	uint64_t value;
+	#else
+	unsigned char value[64];
+	#endif
+
+	do {
+		// a grant that comes in right after this check leaves the wakeup fd readable, so it isn't missed
+		const uint64_t limit = atomic_load(&(credit->limit));
+		if(limit > sent_size) {
+			*allowance_ptr = (limit - sent_size);
+			return RET_STATUS_SUCCESS;
+		}
+
+		errno = 0;
+		const ssize_t readc = read(credit->wakeup_fds[PIPE_READ_INDEX], &value, sizeof value);
+
+		if(readc > 0) {
+			continue;
+		}
+
+		if((readc < 0) && (errno == EINTR)) {
+			continue;
+		}
+
+		if(readc == 0) {
+			errno = EPIPE;
+		}
+
+		return RET_STATUS_FAILURE;
+	} while(true);
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#define _POSIX_C_SOURCE  200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <regex.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <usockit/client/expect.h>
+#include <usockit/cross_support.h>
+#include <usockit/memtrace.h>
+#include <usockit/support_types.h>
+#include <usockit/utils.h>
+
+struct usockit_client_expect {
+	regex_t regex;
+
+	/**
+	 * The current line; `USOCKIT_CLIENT_EXPECT_LINE_MAX_SIZE` bytes big, plus the null terminator that regexec(3)
+	 * needs.
+	 */
+	char* line;
+	size_t line_len;
+
+	bool matched;
+};
+
+/**
+ * Appends `size` bytes to the current line, dropping the beginning of the line if it gets too long.
+ */
+static inline void usockit_client_expect_append(struct usockit_client_expect* expect, const char* data, size_t size)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
+
+cross_support_nodiscard
+static inline bool usockit_client_expect_match_line(struct usockit_client_expect* expect)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+
+struct usockit_client_expect* usockit_client_expect_create(
+	const const_cstr_t pattern,
+	char error_message[const USOCKIT_CLIENT_EXPECT_ERROR_MESSAGE_SIZE]
+) {
+	assert(pattern != cross_support_nullptr);
+	assert(error_message != cross_support_nullptr);
+
+	errno = 0;
+	struct usockit_client_expect* const expect = calloc(1, sizeof *expect);
+	cross_support_if_unlikely(expect == cross_support_nullptr) {
+		return cross_support_nullptr;
+	}
+
+	errno = 0;
+	expect->line = malloc(USOCKIT_CLIENT_EXPECT_LINE_MAX_SIZE + 1);
+	cross_support_if_unlikely(expect->line == cross_support_nullptr) {
+		errno_push();
+		free(expect);
+		errno_pop();
+
+		return cross_support_nullptr;
+	}
+
+	const int ret = regcomp(&(expect->regex), pattern, (REG_EXTENDED | REG_NOSUB));
+	if(ret != 0) {
+		if(ret == REG_ESPACE) {
+			errno = ENOMEM;
+		} else {
+			(void)regerror(ret, &(expect->regex), error_message, USOCKIT_CLIENT_EXPECT_ERROR_MESSAGE_SIZE);
+			errno = EINVAL;
+		}
+
+		errno_push();
+		free(expect->line);
+		free(expect);
+		errno_pop();
+
+		return cross_support_nullptr;
+	}
+
+	expect->line_len = 0;
+	expect->matched = false;
+
+	return expect;
+}
+
+void usockit_client_expect_destroy(struct usockit_client_expect* const expect) {
+	assert(expect != cross_support_nullptr);
+
+	regfree(&(expect->regex));
+	free(expect->line);
+	free(expect);
+}
+
+bool usockit_client_expect_feed(struct usockit_client_expect* const expect, const void* const data, size_t size) {
+	assert(expect != cross_support_nullptr);
+	assert((data != cross_support_nullptr) || (size == 0));
+
+	if(expect->matched) {
+		return true;
+	}
+
+	const char* chunk = data;
+
+	while(size > 0) {
+		const char* const newline = memchr(chunk, '\n', size);
+		if(newline == cross_support_nullptr) {
+			usockit_client_expect_append(expect, chunk, size);
+			break;
+		}
+
+		const size_t segment_size = (size_t)(newline - chunk);
+		usockit_client_expect_append(expect, chunk, segment_size);
+
+		if(usockit_client_expect_match_line(expect)) {
+			return true;
+		}
+
+		expect->line_len = 0;
+
+		chunk = (newline + 1);
+		size -= (segment_size + 1);
+	}
+
+	// the line may not be finished, but it might be all that there is to wait for (e.g.: a prompt)
+	return ((expect->line_len > 0) && usockit_client_expect_match_line(expect));
+}
+
+
+static inline void usockit_client_expect_append(struct usockit_client_expect* const expect,
+                                                const char* data,
+                                                size_t size) {
+	assert(expect != cross_support_nullptr);
+	assert(data != cross_support_nullptr);
+
+	if(size >= USOCKIT_CLIENT_EXPECT_LINE_MAX_SIZE) {
+		data += (size - USOCKIT_CLIENT_EXPECT_LINE_MAX_SIZE);
+		size = USOCKIT_CLIENT_EXPECT_LINE_MAX_SIZE;
+		expect->line_len = 0;
+	} else if((expect->line_len + size) > USOCKIT_CLIENT_EXPECT_LINE_MAX_SIZE) {
+		const size_t dropped_len = ((expect->line_len + size) - USOCKIT_CLIENT_EXPECT_LINE_MAX_SIZE);
+		memmove(expect->line, (expect->line + dropped_len), (expect->line_len - dropped_len));
+		expect->line_len -= dropped_len;
+	}
+
+	memcpy((expect->line + expect->line_len), data, size);
+	expect->line_len += size;
+}
+
+static inline bool usockit_client_expect_match_line(struct usockit_client_expect* const expect) {
+	assert(expect != cross_support_nullptr);
+
+	size_t len = expect->line_len;
+	if((len > 0) && (expect->line[len - 1] == '\r')) {
+		--len;
+	}
+
+	expect->line[len] = '\0';
+
+	expect->matched = (regexec(&(expect->regex), expect->line, 0, cross_support_nullptr, 0) == 0);
+
+	return expect->matched;
+}
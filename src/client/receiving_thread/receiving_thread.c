@@ -6,35 +6,162 @@
 #include <assert.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <usockit/client/credit.h>
+#include <usockit/client/expect.h>
 #include <usockit/client/receiving_thread/receiving_thread.h>
 #include <usockit/client/receiving_thread/result.h>
 #include <usockit/client/threads_result.h>
 #include <usockit/cross_support.h>
 #include <usockit/memtrace.h>
+#include <usockit/protocol.h>
 #include <usockit/support_types.h>
+#include <usockit/threads.h>
 #include <usockit/utils.h>
 
-#define USOCKIT_CLIENT_RECEIVING_THREAD_FUCK_OFF_STRING  "fuck off"
 #define USOCKIT_CLIENT_RECEIVING_THREAD_FUCK_OFF_STRING_SIZE \
-	(array_size(USOCKIT_CLIENT_RECEIVING_THREAD_FUCK_OFF_STRING) - 1)
+	(array_size(USOCKIT_PROTOCOL_FUCK_OFF_STRING) - 1)
+
+/**
+ * Size of the buffer that data is read from the socket into. A single read takes in as many messages as fit into it and
+ * all of their payloads are then written to stdout at once.
+ */
+#define USOCKIT_CLIENT_RECEIVING_THREAD_BUFFER_SIZE  ((size_t)(64 * 1024))
+
+// the routine's own frames are about 400 bytes, the buffer is allocated on the heap
+#define USOCKIT_CLIENT_RECEIVING_THREAD_STACK_SIZE  USOCKIT_THREAD_STACK_SIZE(1 * 1024)
 
 struct usockit_client_receiving_thread_routine_arg {
 	int socket_fd;
+	struct usockit_client_expect* expect;
+	const _Atomic(uint64_t)* sent_size_ptr;
+	struct usockit_client_credit* credit;
+	bool wait_for_slot;
 	struct usockit_client_threads_result_dest* result_dest_ptr;
+
+	/**
+	 * Owned by the thread; `USOCKIT_CLIENT_RECEIVING_THREAD_BUFFER_SIZE` bytes big.
+	 */
+	unsigned char* buffer;
 };
 static void* usockit_client_receiving_thread_routine(void* arg_ptr) cross_support_attr_nonnull_all;
 
+/**
+ * Cleanup handler of the routine, since the thread is usually cancelled.
+ */
+static void usockit_client_receiving_thread_free_buffer(void* buffer) cross_support_attr_nonnull_all;
+
+/**
+ * State of the parsing of the stream of messages, which is read in chunks that don't line up with the messages.
+ */
+struct usockit_client_receiving_thread_parser {
+	/**
+	 * Large enough for either a message header or the rejection.
+	 */
+	unsigned char header[USOCKIT_CLIENT_RECEIVING_THREAD_FUCK_OFF_STRING_SIZE];
+	size_t header_len;
+
+	/**
+	 * Is `USOCKIT_CLIENT_RECEIVING_THREAD_FUCK_OFF_STRING_SIZE` while the rejection is being read.
+	 */
+	size_t header_size;
+
+	/**
+	 * Stays `true` after the queued message, since the rejection may still come after it.
+	 */
+	bool first_message;
+	/**
+	 * Set once the queued message was read.
+	 */
+	bool queued;
+
+	uint32_t payload_remaining;
+	bool forward_payload;
+	/**
+	 * Only set if stdout is a terminal; anywhere else, the escape sequences that draw the snapshot are just noise in
+	 * front of the output.
+	 */
+	bool forward_snapshot;
+
+	/**
+	 * Null pointer if there is nothing to wait for. Only output is matched against, not the snapshot.
+	 */
+	struct usockit_client_expect* expect;
+	bool expect_payload;
+	bool expect_matched;
+
+	/**
+	 * The payload of the child exit message is collected here, since it may be split across reads.
+	 */
+	bool child_exit_payload;
+	unsigned char child_exit[USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE];
+	size_t child_exit_len;
+	bool child_exited;
+
+	/**
+	 * Null pointer if there is nothing to wait for. The payload of an acknowledgement is collected the same way as the
+	 * one of the child exit message.
+	 */
+	const _Atomic(uint64_t)* sent_size_ptr;
+	bool ack_payload;
+	unsigned char ack[USOCKIT_PROTOCOL_ACK_PAYLOAD_SIZE];
+	size_t ack_len;
+	bool acknowledged;
+
+	/**
+	 * Credit is passed on as soon as its payload is complete.
+	 */
+	struct usockit_client_credit* credit;
+	bool credit_payload;
+	unsigned char credit_limit[USOCKIT_PROTOCOL_CREDIT_PAYLOAD_SIZE];
+	size_t credit_limit_len;
+
+	/**
+	 * Set once the server told us that it disconnects us for being idle.
+	 */
+	bool idle_timed_out;
+};
+
+/**
+ * Parses the `size` bytes that were read into `buffer` and moves the payloads that are to be written to stdout to the
+ * beginning of `buffer`. Returns the number of bytes of those payloads.
+ *
+ * Sets `parser->expect_matched` to `true` once the output matched, `parser->child_exited` to `true` once the child
+ * exit message was read, `parser->acknowledged` to `true` once everything that was sent was acknowledged and
+ * `parser->idle_timed_out` to `true` once the idle timeout message was read, but still parses the rest of the bytes.
+ *
+ * Sets `*rejected_ptr` to `true` and stops parsing once the rejection (or something that looked like it at first) was
+ * read completely; `*fuck_off_ptr` tells whether it actually was the rejection.
+ */
+cross_support_nodiscard
+static inline size_t usockit_client_receiving_thread_parse(struct usockit_client_receiving_thread_parser* parser,
+                                                           unsigned char* buffer,
+                                                           size_t size,
+                                                           bool* rejected_ptr,
+                                                           bool* fuck_off_ptr)
+	                                                           cross_support_attr_always_inline
+	                                                           cross_support_attr_nonnull_all
+	                                                           cross_support_attr_warn_unused_result;
+
+
 
 ret_status_t usockit_client_receiving_thread_create(
 	pthread_t* const restrict thread,
 	const int socket_fd,
+	struct usockit_client_expect* const expect,
+	const _Atomic(uint64_t)* const sent_size_ptr,
+	struct usockit_client_credit* const credit,
+	const bool wait_for_slot,
 	struct usockit_client_threads_result_dest* const result_dest_ptr
 ) {
 	assert(thread != cross_support_nullptr);
+	assert(credit != cross_support_nullptr);
 	assert(result_dest_ptr != cross_support_nullptr);
 
 
@@ -46,25 +173,42 @@ ret_status_t usockit_client_receiving_thread_create(
 		return RET_STATUS_FAILURE;
 	}
 
+	errno = 0;
+	unsigned char* const buffer = malloc(USOCKIT_CLIENT_RECEIVING_THREAD_BUFFER_SIZE);
+	cross_support_if_unlikely(buffer == cross_support_nullptr) {
+		errno_push();
+		free(thread_routine_arg_ptr);
+		errno_pop();
+
+		return RET_STATUS_FAILURE;
+	}
+
 	thread_routine_arg_ptr->socket_fd = socket_fd;
+	thread_routine_arg_ptr->expect = expect;
+	thread_routine_arg_ptr->sent_size_ptr = sent_size_ptr;
+	thread_routine_arg_ptr->credit = credit;
+	thread_routine_arg_ptr->wait_for_slot = wait_for_slot;
 	thread_routine_arg_ptr->result_dest_ptr = result_dest_ptr;
+	thread_routine_arg_ptr->buffer = buffer;
 
 
 	const int ret =
-		pthread_create(
+		usockit_thread_create(
 			thread,
-			cross_support_nullptr,
+			USOCKIT_CLIENT_RECEIVING_THREAD_STACK_SIZE,
 			&usockit_client_receiving_thread_routine,
 			thread_routine_arg_ptr
 		);
 	if(ret != 0) {
+		free(buffer);
 		free(thread_routine_arg_ptr);
 
 		errno = ret;
 		return RET_STATUS_FAILURE;
 	}
 
-	// no need to free `thread_routine_arg_ptr` here, it will be free'd in usockit_client_receiving_thread_routine()
+	// no need to free `thread_routine_arg_ptr` or `buffer` here, they will be free'd in
+	// usockit_client_receiving_thread_routine()
 
 	return RET_STATUS_SUCCESS;
 }
@@ -78,59 +222,222 @@ void* usockit_client_receiving_thread_routine(void* const arg_ptr) {
 
 	free(arg_ptr);
 
+	pthread_cleanup_push(&usockit_client_receiving_thread_free_buffer, arg.buffer);
+
 	struct usockit_client_threads_result result;
 	zeroset_lvalue(result);
 	result.origin = USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_RECEIVING;
 
-	do {
-		unsigned char buffer[USOCKIT_CLIENT_RECEIVING_THREAD_FUCK_OFF_STRING_SIZE];
-		const ssize_t readc = read(arg.socket_fd, buffer, array_size(buffer));
+	struct usockit_client_receiving_thread_parser parser;
+	zeroset_lvalue(parser);
+	parser.header_size = USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE;
+	parser.first_message = true;
+	parser.forward_snapshot = (isatty(STDOUT_FILENO) == 1);
+	parser.expect = arg.expect;
+	parser.sent_size_ptr = arg.sent_size_ptr;
+	parser.credit = arg.credit;
 
-		if((readc == USOCKIT_CLIENT_RECEIVING_THREAD_FUCK_OFF_STRING_SIZE) &&
-		   (memcmp(
-			    buffer,
-			    USOCKIT_CLIENT_RECEIVING_THREAD_FUCK_OFF_STRING,
-			    USOCKIT_CLIENT_RECEIVING_THREAD_FUCK_OFF_STRING_SIZE
-		    ) == 0)) {
+	do {
+		errno = 0;
+		const ssize_t readc = read(arg.socket_fd, arg.buffer, USOCKIT_CLIENT_RECEIVING_THREAD_BUFFER_SIZE);
 
-			result.thread_union.receiving.type = USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_FUCK_OFF;
+		if(readc == 0) {
+			result.thread_union.receiving.type = USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_EOF;
 			break;
 		}
 
-		if(readc == 0) { // EOF
-			// TODO: will this even happen?
-			abort();
-		}
+		if(readc < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
 
-		if(readc < 0) { // failure
 			result.thread_union.receiving.type = USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_READ_FAILURE;
 			result.thread_union.receiving.read_errno = errno;
 			break;
 		}
-	} while(1);
 
-	pthread_mutex_lock(&(arg.result_dest_ptr->mutex));
-
-	// special case: if the sending thread already signalled write() EPIPE - then we override it with our "fuck off"
-	// TODO: this is a hack, a better way to do this is via handshakes;
-	//       once the protocol is set up, we'll have server & client send handshakes, and only once the server gives the
-	//       all clear that the client may send data, we'll signal the sending thread, which will then, only after the
-	//       handshake is done, start reading from stdin.
-	//       while waiting we can show a message like "Connecting with server..." (only when stderr is tty)
-	//       once all of this is implemented, we can use the usockit_client_threads_dispatch_result() function here as
-	//       well
-	if((arg.result_dest_ptr->result.origin == USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_NONE) ||
-	   ((result.thread_union.receiving.type == USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_FUCK_OFF) &&
-	    (arg.result_dest_ptr->result.origin == USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_SENDING) &&
-	    (arg.result_dest_ptr->result.thread_union.sending.status == EPIPE) &&
-	    (arg.result_dest_ptr->result.thread_union.sending.func == USOCKIT_CLIENT_SENDING_THREAD_RESULT_FUNC_WRITE))) {
-
-		arg.result_dest_ptr->result = result;
-	}
+		bool rejected = false;
+		bool fuck_off = false;
+		const size_t output_size =
+			usockit_client_receiving_thread_parse(&parser, arg.buffer, (size_t)readc, &rejected, &fuck_off);
+
+		if(output_size > 0) {
+			const ret_status_t ret_status = write_all(STDOUT_FILENO, arg.buffer, output_size);
+			if(ret_status != RET_STATUS_SUCCESS) {
+				result.thread_union.receiving.type = USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_WRITE_FAILURE;
+				result.thread_union.receiving.write_errno = errno;
+				break;
+			}
+		}
+
+		if(parser.expect_matched) {
+			result.thread_union.receiving.type = USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_EXPECT_MATCHED;
+			break;
+		}
+
+		// the final acknowledgement comes before the child exit message, if the child exited right after
+		if(parser.acknowledged) {
+			result.thread_union.receiving.type = USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_ACKNOWLEDGED;
+			break;
+		}
+
+		if(parser.child_exited) {
+			// no need to wait for the server to close the connection
+			result.thread_union.receiving.type = USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_CHILD_EXITED;
+			result.thread_union.receiving.child_exit.signaled =
+				(parser.child_exit[0] == (unsigned char)USOCKIT_PROTOCOL_CHILD_EXIT_KIND_SIGNALED);
+			result.thread_union.receiving.child_exit.value = (int)(parser.child_exit[1]);
+			break;
+		}
+
+		if(parser.idle_timed_out) {
+			result.thread_union.receiving.type = USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_IDLE_TIMEOUT;
+			break;
+		}
 
-	pthread_mutex_unlock(&(arg.result_dest_ptr->mutex));
+		if(rejected) {
+			result.thread_union.receiving.type =
+				(fuck_off
+					 ? USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_FUCK_OFF
+					 : USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_EOF);
+			break;
+		}
+
+		if(parser.queued && !(arg.wait_for_slot)) {
+			// closing the connection takes us out of the queue
+			result.thread_union.receiving.type = USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_QUEUED;
+			break;
+		}
+	} while(1);
 
-	pthread_cond_signal(&(arg.result_dest_ptr->cond));
+	usockit_client_threads_dispatch_result(arg.result_dest_ptr, result);
+
+	pthread_cleanup_pop(1);
 
 	return cross_support_nullptr;
 }
+
+static void usockit_client_receiving_thread_free_buffer(void* const buffer) {
+	free(buffer);
+}
+
+static inline size_t usockit_client_receiving_thread_parse(
+	struct usockit_client_receiving_thread_parser* const parser,
+	unsigned char* const buffer,
+	const size_t size,
+	bool* const rejected_ptr,
+	bool* const fuck_off_ptr
+) {
+	size_t output_size = 0;
+	size_t i = 0;
+
+	while(i < size) {
+		if(parser->payload_remaining > 0) {
+			size_t count = (size - i);
+			if(count > parser->payload_remaining) {
+				count = parser->payload_remaining;
+			}
+
+			if(parser->forward_payload) {
+				// the payloads are compacted in place so that they can be written to stdout with a single call
+				if(output_size != i) {
+					memmove((buffer + output_size), (buffer + i), count);
+				}
+
+				if(parser->expect_payload && !(parser->expect_matched)) {
+					parser->expect_matched = usockit_client_expect_feed(parser->expect, (buffer + output_size), count);
+				}
+
+				output_size += count;
+			} else if(parser->child_exit_payload) {
+				memcpy((parser->child_exit + parser->child_exit_len), (buffer + i), count);
+				parser->child_exit_len += count;
+				parser->child_exited = (parser->child_exit_len == USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE);
+			} else if(parser->ack_payload) {
+				memcpy((parser->ack + parser->ack_len), (buffer + i), count);
+				parser->ack_len += count;
+
+				// until the sending thread is done, the sent size is UINT64_MAX, which is never reached
+				if((parser->ack_len == USOCKIT_PROTOCOL_ACK_PAYLOAD_SIZE) &&
+				   (usockit_protocol_decode_size_payload(parser->ack) >= atomic_load(parser->sent_size_ptr))) {
+
+					parser->acknowledged = true;
+				}
+			} else if(parser->credit_payload) {
+				memcpy((parser->credit_limit + parser->credit_limit_len), (buffer + i), count);
+				parser->credit_limit_len += count;
+
+				if(parser->credit_limit_len == USOCKIT_PROTOCOL_CREDIT_PAYLOAD_SIZE) {
+					const uint64_t limit = usockit_protocol_decode_size_payload(parser->credit_limit);
+					usockit_client_credit_grant(parser->credit, limit);
+				}
+			}
+
+			i += count;
+			parser->payload_remaining -= (uint32_t)count;
+			continue;
+		}
+
+		parser->header[parser->header_len] = buffer[i];
+		++(parser->header_len);
+		++i;
+
+		if(parser->first_message && (parser->header_len == 1) &&
+		   (parser->header[0] == (unsigned char)(USOCKIT_PROTOCOL_FUCK_OFF_STRING[0]))) {
+
+			// not a message, but the rejection
+			parser->header_size = USOCKIT_CLIENT_RECEIVING_THREAD_FUCK_OFF_STRING_SIZE;
+		}
+
+		if(parser->header_len < parser->header_size) {
+			continue;
+		}
+
+		if(parser->header_size == USOCKIT_CLIENT_RECEIVING_THREAD_FUCK_OFF_STRING_SIZE) {
+			*rejected_ptr = true;
+			*fuck_off_ptr =
+				(memcmp(parser->header, USOCKIT_PROTOCOL_FUCK_OFF_STRING, parser->header_size) == 0);
+			break;
+		}
+
+		parser->header_len = 0;
+
+		// the payload (the position in the queue) isn't needed
+		const bool queued =
+			(parser->first_message &&
+			 (parser->header[0] == (unsigned char)USOCKIT_PROTOCOL_MESSAGE_TYPE_QUEUED) &&
+			 (usockit_protocol_decode_message_payload_size(parser->header) == USOCKIT_PROTOCOL_QUEUED_PAYLOAD_SIZE));
+		parser->queued = (parser->queued || queued);
+		parser->first_message = queued;
+
+		// heartbeats are skipped like messages of unknown types; the server only wants to see that we take them
+		parser->idle_timed_out =
+			(parser->idle_timed_out ||
+			 (parser->header[0] == (unsigned char)USOCKIT_PROTOCOL_MESSAGE_TYPE_IDLE_TIMEOUT));
+
+		// messages of unknown types are skipped
+		parser->forward_payload = ((parser->header[0] == (unsigned char)USOCKIT_PROTOCOL_MESSAGE_TYPE_OUTPUT) ||
+		                           (parser->forward_snapshot &&
+		                            (parser->header[0] == (unsigned char)USOCKIT_PROTOCOL_MESSAGE_TYPE_SNAPSHOT)));
+		// the snapshot may still show output from before the client connected
+		parser->expect_payload = ((parser->expect != cross_support_nullptr) &&
+		                          (parser->header[0] == (unsigned char)USOCKIT_PROTOCOL_MESSAGE_TYPE_OUTPUT));
+		parser->payload_remaining = usockit_protocol_decode_message_payload_size(parser->header);
+		// a payload of any other size would be from a newer protocol that we don't understand
+		parser->child_exit_payload =
+			((parser->header[0] == (unsigned char)USOCKIT_PROTOCOL_MESSAGE_TYPE_CHILD_EXIT) &&
+			 (parser->payload_remaining == USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE));
+		parser->child_exit_len = 0;
+		parser->ack_payload =
+			((parser->sent_size_ptr != cross_support_nullptr) &&
+			 (parser->header[0] == (unsigned char)USOCKIT_PROTOCOL_MESSAGE_TYPE_ACK) &&
+			 (parser->payload_remaining == USOCKIT_PROTOCOL_ACK_PAYLOAD_SIZE));
+		parser->ack_len = 0;
+		parser->credit_payload =
+			((parser->header[0] == (unsigned char)USOCKIT_PROTOCOL_MESSAGE_TYPE_CREDIT) &&
+			 (parser->payload_remaining == USOCKIT_PROTOCOL_CREDIT_PAYLOAD_SIZE));
+		parser->credit_limit_len = 0;
+	}
+
+	return output_size;
+}
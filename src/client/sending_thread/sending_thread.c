@@ -9,31 +9,54 @@
 #include <errno.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
+#include <usockit/client/credit.h>
 #include <usockit/client/sending_thread/result.h>
 #include <usockit/client/sending_thread/sending_thread.h>
 #include <usockit/client/threads_result.h>
 #include <usockit/cross_support.h>
 #include <usockit/memtrace.h>
 #include <usockit/support_types.h>
+#include <usockit/threads.h>
 #include <usockit/utils.h>
 
+// the routine's own frames are about 1.2 KiB, most of it being the read buffer
+#define USOCKIT_CLIENT_SENDING_THREAD_STACK_SIZE  USOCKIT_THREAD_STACK_SIZE(4 * 1024)
+
 struct usockit_client_sending_thread_routine_arg {
 	int socket_fd;
+	bool dispatch_eof;
+	unsigned long linger_ms;
+	_Atomic(uint64_t)* sent_size_ptr;
+	struct usockit_client_credit* credit;
 	struct usockit_client_threads_result_dest* result_dest_ptr;
 };
 static void* usockit_client_sending_thread_routine(void* arg_ptr) cross_support_attr_nonnull_all;
 
+static inline void usockit_client_sending_thread_sleep_ms(unsigned long ms)
+	cross_support_attr_always_inline;
+
 
 ret_status_t usockit_client_sending_thread_create(
 	pthread_t* const restrict thread,
 	const int socket_fd,
+	const bool dispatch_eof,
+	const unsigned long linger_ms,
+	_Atomic(uint64_t)* const sent_size_ptr,
+	struct usockit_client_credit* const credit,
 	struct usockit_client_threads_result_dest* const result_dest_ptr
 ) {
 	assert(thread != cross_support_nullptr);
+	assert(credit != cross_support_nullptr);
 	assert(result_dest_ptr != cross_support_nullptr);
+	assert((sent_size_ptr == cross_support_nullptr) || !dispatch_eof);
 
 
 	struct usockit_client_sending_thread_routine_arg* thread_routine_arg_ptr;
@@ -45,13 +68,17 @@ ret_status_t usockit_client_sending_thread_create(
 	}
 
 	thread_routine_arg_ptr->socket_fd = socket_fd;
+	thread_routine_arg_ptr->dispatch_eof = dispatch_eof;
+	thread_routine_arg_ptr->linger_ms = linger_ms;
+	thread_routine_arg_ptr->sent_size_ptr = sent_size_ptr;
+	thread_routine_arg_ptr->credit = credit;
 	thread_routine_arg_ptr->result_dest_ptr = result_dest_ptr;
 
 
 	const int ret =
-		pthread_create(
+		usockit_thread_create(
 			thread,
-			cross_support_nullptr,
+			USOCKIT_CLIENT_SENDING_THREAD_STACK_SIZE,
 			&usockit_client_sending_thread_routine,
 			thread_routine_arg_ptr
 		);
@@ -87,15 +114,42 @@ void* usockit_client_sending_thread_routine(void* const arg_ptr) {
 	zeroset_lvalue(result);
 	result.origin = USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_SENDING;
 
+	uint64_t sent_size = 0;
+
 	do {
 		unsigned char buffer[1024];
 		const ssize_t readc = read(STDIN_FILENO, buffer, array_size(buffer));
 
 		if(readc > 0) { // success
-			const ret_status_t ret_status = write_all(arg.socket_fd, buffer, (size_t)readc);
+			size_t offset = 0;
+			ret_status_t ret_status = RET_STATUS_SUCCESS;
+
+			while(offset < (size_t)readc) {
+				// waiting for credit instead of in write() keeps what we have in flight down to what the server allows
+				uint64_t allowance;
+				ret_status = usockit_client_credit_await(arg.credit, sent_size, &allowance);
+				if(ret_status != RET_STATUS_SUCCESS) {
+					result.thread_union.sending.func = USOCKIT_CLIENT_SENDING_THREAD_RESULT_FUNC_READ;
+					break;
+				}
+
+				size_t size = ((size_t)readc - offset);
+				if(size > allowance) {
+					size = (size_t)allowance;
+				}
+
+				ret_status = write_all(arg.socket_fd, (buffer + offset), size);
+				if(ret_status != RET_STATUS_SUCCESS) {
+					result.thread_union.sending.func = USOCKIT_CLIENT_SENDING_THREAD_RESULT_FUNC_WRITE;
+					break;
+				}
+
+				offset += size;
+				sent_size += (uint64_t)size;
+			}
+
 			if(ret_status != RET_STATUS_SUCCESS) {
 				result.thread_union.sending.status = errno;
-				result.thread_union.sending.func = USOCKIT_CLIENT_SENDING_THREAD_RESULT_FUNC_WRITE;
 				break;
 			}
 
@@ -103,6 +157,30 @@ void* usockit_client_sending_thread_routine(void* const arg_ptr) {
 		}
 
 		if(readc == 0) { // EOF
+			if((arg.sent_size_ptr != cross_support_nullptr) || (arg.linger_ms > 0)) {
+				// stored before the shutdown, so that it's there by the time that the final acknowledgement arrives
+				if(arg.sent_size_ptr != cross_support_nullptr) {
+					atomic_store(arg.sent_size_ptr, sent_size);
+				}
+
+				errno = 0;
+				if(shutdown(arg.socket_fd, SHUT_WR) != 0) {
+					result.thread_union.sending.status = errno;
+					result.thread_union.sending.func = USOCKIT_CLIENT_SENDING_THREAD_RESULT_FUNC_WRITE;
+					break;
+				}
+			}
+
+			if(!(arg.dispatch_eof)) {
+				return cross_support_nullptr;
+			}
+
+			if(arg.linger_ms > 0) {
+				// whatever the receiving thread dispatches in the meantime (e.g.: because the server closed the
+				// connection) ends the client before us; nanosleep(2) is a cancellation point
+				usockit_client_sending_thread_sleep_ms(arg.linger_ms);
+			}
+
 			// no need to set `result.thread_union.sending.status` to 0, we memset'd the entire struct to 0 before
 			break;
 		}
@@ -117,3 +195,12 @@ void* usockit_client_sending_thread_routine(void* const arg_ptr) {
 	usockit_client_threads_dispatch_result(arg.result_dest_ptr, result);
 	return cross_support_nullptr;
 }
+
+static inline void usockit_client_sending_thread_sleep_ms(const unsigned long ms) {
+	struct timespec remaining = {
+		.tv_sec = (time_t)(ms / 1000),
+		.tv_nsec = (long)((ms % 1000) * 1000000),
+	};
+
+	while((nanosleep(&remaining, &remaining) != 0) && (errno == EINTR));
+}
@@ -3,10 +3,84 @@
  * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
  */
 
+#define _POSIX_C_SOURCE  200809L
+
 #include <assert.h>
-#include <pthread.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
 #include <usockit/client/threads_result.h>
 #include <usockit/cross_support.h>
+#include <usockit/support_types.h>
+#include <usockit/utils.h>
+
+#define USOCKIT_CLIENT_THREADS_RESULT_EVENTFD_SUPPORT \
+	(CROSS_SUPPORT_LINUX_LEAST(2,6,22) && CROSS_SUPPORT_GLIBC_LEAST(2,8))
+
+#if USOCKIT_CLIENT_THREADS_RESULT_EVENTFD_SUPPORT
+	#include <sys/eventfd.h>
+#endif
+
+#define PIPE_READ_INDEX   0
+#define PIPE_WRITE_INDEX  1
+
+
+cross_support_nodiscard
+static inline struct usockit_client_threads_result usockit_client_threads_result_load(
+	const struct usockit_client_threads_result_dest* result_dest_ptr,
+	enum usockit_client_threads_result_origin origin
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+cross_support_nodiscard
+static inline bool usockit_client_threads_result_takes_precedence(struct usockit_client_threads_result result,
+                                                                  struct usockit_client_threads_result other)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
+
+
+ret_status_t usockit_client_threads_result_dest_init(struct usockit_client_threads_result_dest* const result_dest_ptr) {
+	assert(result_dest_ptr != cross_support_nullptr);
+
+	atomic_init(&(result_dest_ptr->origin), USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_NONE);
+
+	#if USOCKIT_CLIENT_THREADS_RESULT_EVENTFD_SUPPORT
+	errno = 0;
+	const int fd = eventfd(0, 0);
+	if(fd == -1) {
+		return RET_STATUS_FAILURE;
+	}
+
+	result_dest_ptr->wakeup_fds[PIPE_READ_INDEX]  = fd;
+	result_dest_ptr->wakeup_fds[PIPE_WRITE_INDEX] = fd;
+	#else
+	errno = 0;
+	if(pipe(result_dest_ptr->wakeup_fds) != 0) {
+		return RET_STATUS_FAILURE;
+	}
+	#endif
+
+	return RET_STATUS_SUCCESS;
+}
+
+void usockit_client_threads_result_dest_destroy(struct usockit_client_threads_result_dest* const result_dest_ptr) {
+	assert(result_dest_ptr != cross_support_nullptr);
+
+	close(result_dest_ptr->wakeup_fds[PIPE_READ_INDEX]);
+
+	#if !(USOCKIT_CLIENT_THREADS_RESULT_EVENTFD_SUPPORT)
+	close(result_dest_ptr->wakeup_fds[PIPE_WRITE_INDEX]);
+	#endif
+}
+
 
 void usockit_client_threads_dispatch_result(
 	struct usockit_client_threads_result_dest* const result_dest_ptr,
@@ -14,13 +88,181 @@ void usockit_client_threads_dispatch_result(
 ) {
 	assert(result_dest_ptr != cross_support_nullptr);
 
-	pthread_mutex_lock(&(result_dest_ptr->mutex));
+	// every origin has its own slot, which is only ever written to by the thread of that origin, once, *before* the
+	// result is published. this way there is no need to synchronize the writes
+	switch(result.origin) {
+		case USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_SENDING: {
+			result_dest_ptr->sending = result.thread_union.sending;
+			break;
+		}
+		case USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_RECEIVING: {
+			result_dest_ptr->receiving = result.thread_union.receiving;
+			break;
+		}
+		default: {
+			cross_support_unreachable();
+		}
+	}
+
+	int published_origin = USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_NONE;
+	while(!atomic_compare_exchange_weak(&(result_dest_ptr->origin), &published_origin, (int)(result.origin))) {
+		if(published_origin == USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_NONE) {
+			// spurious failure
+			continue;
+		}
+
+		const struct usockit_client_threads_result published_result =
+			usockit_client_threads_result_load(
+				result_dest_ptr,
+				(enum usockit_client_threads_result_origin)published_origin
+			);
+
+		if(!usockit_client_threads_result_takes_precedence(result, published_result)) {
+			return;
+		}
+	}
+
+	if(published_origin != USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_NONE) {
+		// the waiting thread was already woken up by the result we just replaced
+		return;
+	}
+
+	#if USOCKIT_CLIENT_THREADS_RESULT_EVENTFD_SUPPORT
+	const uint64_t value = 1;
+	#else
+	const unsigned char value = 1;
+	#endif
+
+	const ret_status_t ret_status = write_all(result_dest_ptr->wakeup_fds[PIPE_WRITE_INDEX], &value, sizeof value);
+	cross_support_if_unlikely(ret_status != RET_STATUS_SUCCESS) {
+		// TODO: write() error handling
+		abort();
+	}
+}
+
+ret_status_t usockit_client_threads_await_result(struct usockit_client_threads_result_dest* const result_dest_ptr) {
+	assert(result_dest_ptr != cross_support_nullptr);
+
+	#if USOCKIT_CLIENT_THREADS_RESULT_EVENTFD_SUPPORT
+	uint64_t value;
+	#else
+	unsigned char value;
+	#endif
+
+	do {
+		errno = 0;
+		const ssize_t readc = read(result_dest_ptr->wakeup_fds[PIPE_READ_INDEX], &value, sizeof value);
+
+		if(readc > 0) {
+			return RET_STATUS_SUCCESS;
+		}
+
+		if((readc < 0) && (errno == EINTR)) {
+			continue;
+		}
+
+		return RET_STATUS_FAILURE;
+	} while(1);
+}
+
+ret_status_t usockit_client_threads_await_result_timeout(
+	struct usockit_client_threads_result_dest* const result_dest_ptr,
+	const unsigned long timeout_ms,
+	bool* const timed_out_ptr
+) {
+	assert(result_dest_ptr != cross_support_nullptr);
+	assert(timed_out_ptr != cross_support_nullptr);
+
+	*timed_out_ptr = false;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	const uint64_t deadline_ms =
+		(((uint64_t)(now.tv_sec) * 1000) + ((uint64_t)(now.tv_nsec) / 1000000) + (uint64_t)timeout_ms);
+
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		const uint64_t now_ms = (((uint64_t)(now.tv_sec) * 1000) + ((uint64_t)(now.tv_nsec) / 1000000));
+
+		if(now_ms >= deadline_ms) {
+			*timed_out_ptr = true;
+			return RET_STATUS_SUCCESS;
+		}
+
+		const uint64_t remaining_ms = (deadline_ms - now_ms);
+
+		struct pollfd pfd = { .fd = result_dest_ptr->wakeup_fds[PIPE_READ_INDEX], .events = POLLIN };
+		errno = 0;
+		const int ret = poll(&pfd, 1, ((remaining_ms > INT_MAX) ? INT_MAX : (int)remaining_ms));
+
+		if(ret > 0) {
+			return usockit_client_threads_await_result(result_dest_ptr);
+		}
+
+		if((ret < 0) && (errno != EINTR)) {
+			return RET_STATUS_FAILURE;
+		}
+	} while(1);
+}
+
+struct usockit_client_threads_result usockit_client_threads_get_result(
+	struct usockit_client_threads_result_dest* const result_dest_ptr
+) {
+	assert(result_dest_ptr != cross_support_nullptr);
+
+	const int origin = atomic_load(&(result_dest_ptr->origin));
 
-	if(result_dest_ptr->result.origin == USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_NONE) {
-		result_dest_ptr->result = result;
+	return usockit_client_threads_result_load(result_dest_ptr, (enum usockit_client_threads_result_origin)origin);
+}
+
+
+static inline struct usockit_client_threads_result usockit_client_threads_result_load(
+	const struct usockit_client_threads_result_dest* const result_dest_ptr,
+	const enum usockit_client_threads_result_origin origin
+) {
+	assert(result_dest_ptr != cross_support_nullptr);
+
+	struct usockit_client_threads_result result;
+	zeroset_lvalue(result);
+	result.origin = origin;
+
+	switch(origin) {
+		case USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_NONE: {
+			break;
+		}
+		case USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_SENDING: {
+			result.thread_union.sending = result_dest_ptr->sending;
+			break;
+		}
+		case USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_RECEIVING: {
+			result.thread_union.receiving = result_dest_ptr->receiving;
+			break;
+		}
+		default: {
+			cross_support_unreachable();
+		}
 	}
 
-	pthread_mutex_unlock(&(result_dest_ptr->mutex));
+	return result;
+}
 
-	pthread_cond_signal(&(result_dest_ptr->cond));
+static inline bool usockit_client_threads_result_takes_precedence(
+	const struct usockit_client_threads_result result,
+	const struct usockit_client_threads_result other
+) {
+	// when the server tells us to fuck off, it closes the connection right after, so the sending thread may fail with
+	// write() EPIPE before the receiving thread got to read the message. the message is the actual reason though.
+	// the same goes for the server closing the connection on its own, for the child program exiting and for the server
+	// disconnecting us for being idle
+	// TODO: this should be replaced by a handshake once the protocol is set up; only once the server gives the all
+	//       clear that the client may send data, the sending thread should start reading from stdin.
+	//       while waiting we can show a message like "Connecting with server..." (only when stderr is tty)
+	return ((result.origin == USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_RECEIVING) &&
+	        ((result.thread_union.receiving.type == USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_FUCK_OFF) ||
+	         (result.thread_union.receiving.type == USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_EOF) ||
+	         (result.thread_union.receiving.type == USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_CHILD_EXITED) ||
+	         (result.thread_union.receiving.type == USOCKIT_CLIENT_RECEIVING_THREAD_RESULT_TYPE_IDLE_TIMEOUT)) &&
+	        (other.origin == USOCKIT_CLIENT_THREADS_RESULT_ORIGIN_SENDING) &&
+	        (other.thread_union.sending.status == EPIPE) &&
+	        (other.thread_union.sending.func == USOCKIT_CLIENT_SENDING_THREAD_RESULT_FUNC_WRITE));
 }
@@ -3,37 +3,261 @@
  * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
  */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <usockit/cli.h>
 #include <usockit/client.h>
+#include <usockit/client/broadcast.h>
+#include <usockit/client/control.h>
 #include <usockit/cross_support.h>
 #include <usockit/server.h>
 #include <usockit/shared.h>
 #include <usockit/utils.h>
 #include <usockit/version.h>
 
-#define USAGE_STRING_SERVER "<socket_path> -- <program> [<args>...]"
-#define USAGE_STRING_CLIENT "<socket_path>"
+#define USAGE_STRING_SERVER \
+	"[--report-memory] [--pty [--observer-socket=<path>]] [--rate-limit=<limit>] [--line-limit=<limit>]" \
+	" [--global-rate-limit=<limit>] [--global-line-limit=<limit>] [--credit-window=<size>]" \
+	" [--linger=<seconds>] [--restart[=<backoff>] [--restart-queue=<size>]" \
+	" [--standby]] [--workers=<n>] [--wait-queue=<length>[:<seconds>]] [--idle-timeout=<seconds>]" \
+	" [--heartbeat=<seconds>] [--stdin-file=<path> | --stdin-fd=<fd>] [--control-socket=<path>] [--listen-fd=<fd>]" \
+	" [<socket_path>] -- <program> [<args>...]"
+#define USAGE_STRING_CLIENT \
+	"[--read-only] [--expect=<pattern> --timeout=<seconds>] [--sync] [--linger=<seconds>] [--wait]" \
+	" <socket_path>"
+#define USAGE_STRING_BROADCAST "--broadcast[=<max>] [--timeout=<seconds>] <socket_path>..."
+#define USAGE_STRING_CONTROL "--control=<command> <control_socket_path>"
+
+#define OBSERVER_SOCKET_ARG_PREFIX "--observer-socket="
+#define CONTROL_SOCKET_ARG_PREFIX "--control-socket="
+#define RATE_LIMIT_ARG_PREFIX "--rate-limit="
+#define LINE_LIMIT_ARG_PREFIX "--line-limit="
+#define GLOBAL_RATE_LIMIT_ARG_PREFIX "--global-rate-limit="
+#define GLOBAL_LINE_LIMIT_ARG_PREFIX "--global-line-limit="
+#define CREDIT_WINDOW_ARG_PREFIX "--credit-window="
+#define RESTART_ARG_PREFIX "--restart="
+#define RESTART_QUEUE_ARG_PREFIX "--restart-queue="
+#define WORKERS_ARG_PREFIX "--workers="
+#define WAIT_QUEUE_ARG_PREFIX "--wait-queue="
+#define IDLE_TIMEOUT_ARG_PREFIX "--idle-timeout="
+#define HEARTBEAT_ARG_PREFIX "--heartbeat="
+#define STDIN_FILE_ARG_PREFIX "--stdin-file="
+#define STDIN_FD_ARG_PREFIX "--stdin-fd="
+#define LISTEN_FD_ARG_PREFIX "--listen-fd="
+#define RESUME_ARG_PREFIX "--resume="
+#define EXPECT_ARG_PREFIX "--expect="
+#define TIMEOUT_ARG_PREFIX "--timeout="
+#define LINGER_ARG_PREFIX "--linger="
+#define BROADCAST_ARG_PREFIX "--broadcast="
+#define CONTROL_ARG_PREFIX "--control="
+
+/**
+ * First file descriptor passed down by the socket activation protocol (`LISTEN_FDS` & `LISTEN_PID`).
+ */
+#define SOCKET_ACTIVATION_FIRST_FD 3
+
+#define RESTART_DEFAULT_BACKOFF_MIN_MS  100UL
+#define RESTART_DEFAULT_BACKOFF_MAX_MS  30000UL
+#define RESTART_DEFAULT_QUEUE_SIZE      ((size_t)(64 * 1024))
+#define RESTART_MIN_QUEUE_SIZE          ((size_t)1024)
+
+#define CREDIT_DEFAULT_WINDOW_SIZE  ((size_t)(64 * 1024))
+#define CREDIT_MIN_WINDOW_SIZE      ((size_t)1024)
+
+#define WORKERS_MAX  ((size_t)1024)
+
+#define WAIT_QUEUE_MAX_LENGTH          ((size_t)1024)
+#define WAIT_QUEUE_DEFAULT_TIMEOUT_MS  60000UL
+
+#define BROADCAST_DEFAULT_MAX_IN_FLIGHT  ((size_t)64)
+#define BROADCAST_DEFAULT_TIMEOUT_MS     10000UL
 
 
 static inline void print_usage(const_cstr_t argv0)
 	cross_support_attr_always_inline
 	cross_support_attr_nonnull_all;
 
+/**
+ * Parses the decimal number at the start of `str` into `*out`; it must be from `min` up to `max`.
+ * Unlike strtoull(3), this accepts neither leading whitespace nor signs.
+ *
+ * Returns a pointer to the first character after the number, or a null pointer if `str` doesn't start with such a
+ * number.
+ */
+cross_support_nodiscard
+static inline const_cstr_t parse_uint_prefix(const_cstr_t str,
+                                             unsigned long long min,
+                                             unsigned long long max,
+                                             unsigned long long* out)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Same as `parse_uint_prefix()`, except that all of `str` must be the number.
+ *
+ * Returns `false` if it isn't such a number.
+ */
+cross_support_nodiscard
+static inline bool parse_uint_option(const_cstr_t str,
+                                     unsigned long long min,
+                                     unsigned long long max,
+                                     unsigned long long* out)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Parses `str` as a non-negative decimal number that fits into an `int`.
+ *
+ * Returns -1 if `str` is not such a number.
+ */
+cross_support_nodiscard
+static inline int parse_fd(const_cstr_t str)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Checks whether or not this process was passed a socket by the socket activation protocol and, if so, returns it and
+ * removes the protocol's environment variables, so that the child program won't pick them up.
+ *
+ * Returns -1 if no socket was passed and -2 if more than one socket was passed.
+ */
+cross_support_nodiscard
+static inline int take_socket_activation_fd(void)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Parses the value of one of the rate limit arguments, which has the format `<rate>[:<burst>]`; both positive decimal
+ * numbers. The burst defaults to the rate, i.e.: one second worth.
+ *
+ * A null pointer `str` (the argument was not given) results in no limit.
+ */
+cross_support_nodiscard
+static inline bool parse_rate_limit(const_cstr_t str, struct usockit_server_rate_limit* rate_limit)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull(2)
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Parses the values of the '--restart=<backoff>' argument, which has the format `<min_ms>[:<max_ms>]`, and the
+ * '--restart-queue=<size>' argument into `restart_options`. Null pointers stand for the defaults.
+ *
+ * Returns a pointer to the invalid one of the two on failure, or a null pointer on success.
+ */
+cross_support_nodiscard
+static inline const_cstr_t parse_restart_options(const_cstr_t backoff_str,
+                                                 const_cstr_t queue_size_str,
+                                                 struct usockit_server_restart_options* restart_options)
+	                                                 cross_support_attr_always_inline
+	                                                 cross_support_attr_nonnull(3)
+	                                                 cross_support_attr_warn_unused_result;
+
+/**
+ * Parses the value of the '--credit-window=<size>' argument; either 0 or a decimal number of at least
+ * `CREDIT_MIN_WINDOW_SIZE`.
+ *
+ * Returns `false` if `str` is neither.
+ */
+cross_support_nodiscard
+static inline bool parse_credit_window(const_cstr_t str, size_t* credit_window_ptr)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Parses the value of the '--workers=<n>' argument; a decimal number from 1 up to `WORKERS_MAX`.
+ *
+ * Returns 0 if `str` is not such a number.
+ */
+cross_support_nodiscard
+static inline size_t parse_workers_count(const_cstr_t str)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Parses the value of the '--wait-queue=<length>[:<seconds>]' argument; a decimal number from 1 up to
+ * `WAIT_QUEUE_MAX_LENGTH`, optionally followed by a positive decimal number. The timeout defaults to
+ * `WAIT_QUEUE_DEFAULT_TIMEOUT_MS`.
+ *
+ * Returns `false` if `str` doesn't have that format.
+ */
+cross_support_nodiscard
+static inline bool parse_wait_queue(const_cstr_t str, size_t* length_ptr, unsigned long* timeout_ms_ptr)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Parses the value of the '--resume' argument, which has the format
+ * `<child_pid>,<child_stdin_fd>,<client_fd>,<observer_listen_fd>[,<standby_pid>,<standby_stdin_fd>[,<control_fd>
+ * [,<client_delivered_size>[,<client_consumed_size>]]]]`.
+ * Missing values, as well as -1, stand for things that the old server didn't have.
+ */
+cross_support_nodiscard
+static inline bool parse_resume_state(const_cstr_t str, struct usockit_server_resume_state* resume_state)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Parses the value of the '--timeout=<seconds>' argument; a positive decimal number.
+ *
+ * Returns the timeout in milliseconds, or 0 if `str` is not such a number.
+ */
+cross_support_nodiscard
+static inline unsigned long parse_timeout_ms(const_cstr_t str)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Parses the value of the '--broadcast=<max>' argument; a positive decimal number.
+ *
+ * Returns 0 if `str` is not such a number.
+ */
+cross_support_nodiscard
+static inline size_t parse_broadcast_max_in_flight(const_cstr_t str)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
 cross_support_nodiscard
 static inline int main_server(const_cstr_t argv0, struct usockit_cli* cli)
 	cross_support_attr_always_inline
 	cross_support_attr_warn_unused_result;
 
 cross_support_nodiscard
-static inline int main_client(const_cstr_t socket_pathname)
+static inline int main_client(const_cstr_t argv0, const struct usockit_cli* cli)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+cross_support_nodiscard
+static inline int main_broadcast(const_cstr_t argv0, const struct usockit_cli* cli)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+cross_support_nodiscard
+static inline int main_control(const_cstr_t argv0, const struct usockit_cli* cli)
 	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
 	cross_support_attr_warn_unused_result;
 
 
@@ -92,6 +316,240 @@ int main(const int argc, const cstr_t* const argv) {
 			return 0;
 		}
 
+		if(strequ(arg, "--report-memory")) {
+			cli.report_memory = true;
+			continue;
+		}
+
+		if(strequ(arg, "--pty")) {
+			cli.pty = true;
+			continue;
+		}
+
+		if(strequ(arg, "--read-only")) {
+			cli.read_only = true;
+			continue;
+		}
+
+		if(strequ(arg, "--sync")) {
+			cli.sync = true;
+			continue;
+		}
+
+		if(strequ(arg, "--wait")) {
+			cli.wait = true;
+			continue;
+		}
+
+		if(strncmp(arg, EXPECT_ARG_PREFIX, (array_size(EXPECT_ARG_PREFIX) - 1)) == 0) {
+			cli.expect = (arg + (array_size(EXPECT_ARG_PREFIX) - 1));
+
+			cross_support_if_unlikely(str_empty(cli.expect)) {
+				usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+				fprintf(stderr, "%s: %s: invalid argument: must not be empty\n", argv[0], arg);
+				print_usage(argv[0]);
+				return 9;
+			}
+
+			continue;
+		}
+
+		if(strncmp(arg, TIMEOUT_ARG_PREFIX, (array_size(TIMEOUT_ARG_PREFIX) - 1)) == 0) {
+			cli.timeout = (arg + (array_size(TIMEOUT_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strncmp(arg, LINGER_ARG_PREFIX, (array_size(LINGER_ARG_PREFIX) - 1)) == 0) {
+			cli.linger = (arg + (array_size(LINGER_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strequ(arg, "--broadcast")) {
+			cli.broadcast = true;
+			continue;
+		}
+
+		if(strncmp(arg, BROADCAST_ARG_PREFIX, (array_size(BROADCAST_ARG_PREFIX) - 1)) == 0) {
+			cli.broadcast = true;
+			cli.broadcast_max_in_flight = (arg + (array_size(BROADCAST_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strncmp(arg, OBSERVER_SOCKET_ARG_PREFIX, (array_size(OBSERVER_SOCKET_ARG_PREFIX) - 1)) == 0) {
+			cli.observer_socket_pathname = (arg + (array_size(OBSERVER_SOCKET_ARG_PREFIX) - 1));
+
+			cross_support_if_unlikely(str_empty(cli.observer_socket_pathname)) {
+				usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+				fprintf(stderr, "%s: %s: invalid argument: must not be empty\n", argv[0], arg);
+				print_usage(argv[0]);
+				return 9;
+			}
+
+			continue;
+		}
+
+		if(strncmp(arg, CONTROL_SOCKET_ARG_PREFIX, (array_size(CONTROL_SOCKET_ARG_PREFIX) - 1)) == 0) {
+			cli.control_socket_pathname = (arg + (array_size(CONTROL_SOCKET_ARG_PREFIX) - 1));
+
+			cross_support_if_unlikely(str_empty(cli.control_socket_pathname)) {
+				usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+				fprintf(stderr, "%s: %s: invalid argument: must not be empty\n", argv[0], arg);
+				print_usage(argv[0]);
+				return 9;
+			}
+
+			continue;
+		}
+
+		if(strncmp(arg, CONTROL_ARG_PREFIX, (array_size(CONTROL_ARG_PREFIX) - 1)) == 0) {
+			cli.control = (arg + (array_size(CONTROL_ARG_PREFIX) - 1));
+
+			cross_support_if_unlikely(str_empty(cli.control)) {
+				usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+				fprintf(stderr, "%s: %s: invalid argument: must not be empty\n", argv[0], arg);
+				print_usage(argv[0]);
+				return 9;
+			}
+
+			continue;
+		}
+
+		if(strncmp(arg, RATE_LIMIT_ARG_PREFIX, (array_size(RATE_LIMIT_ARG_PREFIX) - 1)) == 0) {
+			cli.rate_limit = (arg + (array_size(RATE_LIMIT_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strncmp(arg, LINE_LIMIT_ARG_PREFIX, (array_size(LINE_LIMIT_ARG_PREFIX) - 1)) == 0) {
+			cli.line_limit = (arg + (array_size(LINE_LIMIT_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strncmp(arg, GLOBAL_RATE_LIMIT_ARG_PREFIX, (array_size(GLOBAL_RATE_LIMIT_ARG_PREFIX) - 1)) == 0) {
+			cli.global_rate_limit = (arg + (array_size(GLOBAL_RATE_LIMIT_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strncmp(arg, GLOBAL_LINE_LIMIT_ARG_PREFIX, (array_size(GLOBAL_LINE_LIMIT_ARG_PREFIX) - 1)) == 0) {
+			cli.global_line_limit = (arg + (array_size(GLOBAL_LINE_LIMIT_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strncmp(arg, CREDIT_WINDOW_ARG_PREFIX, (array_size(CREDIT_WINDOW_ARG_PREFIX) - 1)) == 0) {
+			cli.credit_window = (arg + (array_size(CREDIT_WINDOW_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strequ(arg, "--restart")) {
+			cli.restart = true;
+			continue;
+		}
+
+		if(strncmp(arg, RESTART_ARG_PREFIX, (array_size(RESTART_ARG_PREFIX) - 1)) == 0) {
+			cli.restart = true;
+			cli.restart_backoff = (arg + (array_size(RESTART_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strncmp(arg, RESTART_QUEUE_ARG_PREFIX, (array_size(RESTART_QUEUE_ARG_PREFIX) - 1)) == 0) {
+			cli.restart_queue_size = (arg + (array_size(RESTART_QUEUE_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strequ(arg, "--standby")) {
+			cli.standby = true;
+			continue;
+		}
+
+		if(strncmp(arg, WORKERS_ARG_PREFIX, (array_size(WORKERS_ARG_PREFIX) - 1)) == 0) {
+			cli.workers = (arg + (array_size(WORKERS_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strncmp(arg, WAIT_QUEUE_ARG_PREFIX, (array_size(WAIT_QUEUE_ARG_PREFIX) - 1)) == 0) {
+			cli.wait_queue = (arg + (array_size(WAIT_QUEUE_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strncmp(arg, IDLE_TIMEOUT_ARG_PREFIX, (array_size(IDLE_TIMEOUT_ARG_PREFIX) - 1)) == 0) {
+			cli.idle_timeout = (arg + (array_size(IDLE_TIMEOUT_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strncmp(arg, HEARTBEAT_ARG_PREFIX, (array_size(HEARTBEAT_ARG_PREFIX) - 1)) == 0) {
+			cli.heartbeat = (arg + (array_size(HEARTBEAT_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(strncmp(arg, STDIN_FILE_ARG_PREFIX, (array_size(STDIN_FILE_ARG_PREFIX) - 1)) == 0) {
+			cli.stdin_file = (arg + (array_size(STDIN_FILE_ARG_PREFIX) - 1));
+
+			cross_support_if_unlikely(str_empty(cli.stdin_file)) {
+				usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+				fprintf(stderr, "%s: %s: invalid argument: must not be empty\n", argv[0], arg);
+				print_usage(argv[0]);
+				return 9;
+			}
+
+			continue;
+		}
+
+		if(strncmp(arg, STDIN_FD_ARG_PREFIX, (array_size(STDIN_FD_ARG_PREFIX) - 1)) == 0) {
+			cli.stdin_fd = parse_fd(arg + (array_size(STDIN_FD_ARG_PREFIX) - 1));
+
+			cross_support_if_unlikely(cli.stdin_fd == -1) {
+				usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+				fprintf(stderr, "%s: %s: invalid argument: not a file descriptor\n", argv[0], arg);
+				print_usage(argv[0]);
+				return 7;
+			}
+
+			continue;
+		}
+
+		if(strncmp(arg, LISTEN_FD_ARG_PREFIX, (array_size(LISTEN_FD_ARG_PREFIX) - 1)) == 0) {
+			cli.listen_fd = parse_fd(arg + (array_size(LISTEN_FD_ARG_PREFIX) - 1));
+
+			cross_support_if_unlikely(cli.listen_fd == -1) {
+				usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+				fprintf(stderr, "%s: %s: invalid argument: not a file descriptor\n", argv[0], arg);
+				print_usage(argv[0]);
+				return 7;
+			}
+
+			continue;
+		}
+
+		if(strncmp(arg, RESUME_ARG_PREFIX, (array_size(RESUME_ARG_PREFIX) - 1)) == 0) {
+			cli.resume_state = (arg + (array_size(RESUME_ARG_PREFIX) - 1));
+			continue;
+		}
+
+		if(cli.broadcast) {
+			// every argument from here on is a socket path (or a pattern of them)
+			cli.broadcast_socket_pathnames = (argv + i);
+			cli.broadcast_socket_pathnames_count = (size_t)(argc - i);
+
+			for(size_t j = 0; j < cli.broadcast_socket_pathnames_count; ++j) {
+				cross_support_if_unlikely(strequ(cli.broadcast_socket_pathnames[j], "--")) {
+					usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+					fprintf(stderr, "%s: --broadcast: invalid argument: only valid when connecting to servers\n",
+					        argv[0]);
+					print_usage(argv[0]);
+					return 7;
+				}
+			}
+
+			break;
+		}
+
 		cross_support_if_unlikely(cli.socket_pathname != cross_support_nullptr) {
 			usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
 
@@ -116,62 +574,654 @@ int main(const int argc, const cstr_t* const argv) {
 		return 9;
 	}
 
-	cross_support_if_unlikely(cli.socket_pathname == cross_support_nullptr) {
+	cross_support_if_unlikely(cli.pty && !(cli.child_program)) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --pty: invalid argument: only valid when starting a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.observer_socket_pathname != cross_support_nullptr) && !(cli.pty)) {
 		usockit_cli_destroy(&cli);
 
-		fprintf(stderr, "%s: missing argument: <socket_path>\n", argv[0]);
+		fprintf(stderr, "%s: --observer-socket: invalid argument: only valid together with --pty\n", argv[0]);
 		print_usage(argv[0]);
-		return 3;
+		return 7;
 	}
 
-	cross_support_if_unlikely(strlen(cli.socket_pathname) > USOCKIT_SOCKET_PATHNAME_MAX_LENGTH) {
+	cross_support_if_unlikely((cli.observer_socket_pathname != cross_support_nullptr) &&
+	                          (strlen(cli.observer_socket_pathname) > USOCKIT_SOCKET_PATHNAME_MAX_LENGTH)) {
+
 		usockit_cli_destroy(&cli);
 
 		fprintf(
 			stderr,
 			"%s: %s: path too long: socket path length must not be more than %zu\n",
 			argv[0],
-			cli.socket_pathname,
+			cli.observer_socket_pathname,
 			USOCKIT_SOCKET_PATHNAME_MAX_LENGTH
 		);
 		return 48;
 	}
 
-	if(cli.child_program) {
-		const int exit_code = main_server(argv[0], &cli);
-		usockit_cli_destroy_definitely_init_child_program_argv(&cli);
-		return exit_code;
-	} else {
-		const int exit_code = main_client(cli.socket_pathname);
+	cross_support_if_unlikely((cli.control_socket_pathname != cross_support_nullptr) && !(cli.child_program)) {
 		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
-		return exit_code;
+
+		fprintf(stderr, "%s: --control-socket: invalid argument: only valid when starting a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
 	}
-}
 
+	cross_support_if_unlikely((cli.control_socket_pathname != cross_support_nullptr) &&
+	                          (strlen(cli.control_socket_pathname) > USOCKIT_SOCKET_PATHNAME_MAX_LENGTH)) {
 
-static inline int main_client(const const_cstr_t socket_pathname) {
-	const enum usockit_client_ret_status ret_status = usockit_client(socket_pathname);
+		usockit_cli_destroy(&cli);
 
-	switch(ret_status) {
-		case USOCKIT_CLIENT_RET_STATUS_SUCCESS_EOF: {
-			return 0;
-		}
-		case USOCKIT_CLIENT_RET_STATUS_SUCCESS_FUCK_OFF: {
-			bool joke_msg = false;
-			if(isatty(STDERR_FILENO)) {
-				srand((unsigned int)(time(cross_support_nullptr)));
-				joke_msg = ((rand() % 20) == 0);
-			}
+		fprintf(
+			stderr,
+			"%s: %s: path too long: socket path length must not be more than %zu\n",
+			argv[0],
+			cli.control_socket_pathname,
+			USOCKIT_SOCKET_PATHNAME_MAX_LENGTH
+		);
+		return 48;
+	}
 
-			if(!joke_msg) {
-				fputs("Server rejected connection; maximum amount of clients already connected.\n", stderr);
-			} else {
-				fputs("Server told us to fuck off, they already have enough clients connected... rude.\n", stderr);
-			}
+	cross_support_if_unlikely(((cli.rate_limit != cross_support_nullptr) ||
+	                           (cli.line_limit != cross_support_nullptr) ||
+	                           (cli.global_rate_limit != cross_support_nullptr) ||
+	                           (cli.global_line_limit != cross_support_nullptr)) && !(cli.child_program)) {
 
-			return 48;
-		}
-		case USOCKIT_CLIENT_RET_STATUS_UNKNOWN: {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: rate limits are only valid when starting a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.credit_window != cross_support_nullptr) && !(cli.child_program)) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --credit-window: invalid argument: only valid when starting a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(cli.restart && !(cli.child_program)) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --restart: invalid argument: only valid when starting a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(cli.restart && cli.pty) {
+		usockit_cli_destroy(&cli);
+
+		fprintf(stderr, "%s: --restart: invalid argument: not supported together with --pty\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.restart_queue_size != cross_support_nullptr) && !(cli.restart)) {
+		usockit_cli_destroy(&cli);
+
+		fprintf(stderr, "%s: --restart-queue: invalid argument: only valid together with --restart\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(cli.standby && !(cli.restart)) {
+		usockit_cli_destroy(&cli);
+
+		fprintf(stderr, "%s: --standby: invalid argument: only valid together with --restart\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.workers != cross_support_nullptr) && !(cli.child_program)) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --workers: invalid argument: only valid when starting a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.workers != cross_support_nullptr) && (cli.pty || cli.restart)) {
+		usockit_cli_destroy(&cli);
+
+		fprintf(
+			stderr,
+			"%s: --workers: invalid argument: not supported together with %s\n",
+			argv[0],
+			(cli.pty ? "--pty" : "--restart")
+		);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.wait_queue != cross_support_nullptr) && !(cli.child_program)) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --wait-queue: invalid argument: only valid when starting a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.idle_timeout != cross_support_nullptr) && !(cli.child_program)) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --idle-timeout: invalid argument: only valid when starting a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.heartbeat != cross_support_nullptr) && !(cli.child_program)) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --heartbeat: invalid argument: only valid when starting a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(((cli.stdin_file != cross_support_nullptr) || (cli.stdin_fd != -1)) &&
+	                          !(cli.child_program)) {
+
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(
+			stderr,
+			"%s: %s: invalid argument: only valid when starting a server\n",
+			argv[0],
+			((cli.stdin_file != cross_support_nullptr) ? "--stdin-file" : "--stdin-fd")
+		);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.stdin_file != cross_support_nullptr) && (cli.stdin_fd != -1)) {
+		usockit_cli_destroy(&cli);
+
+		fprintf(stderr, "%s: --stdin-fd: invalid argument: not valid together with --stdin-file\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(((cli.stdin_file != cross_support_nullptr) || (cli.stdin_fd != -1)) &&
+	                          (cli.restart || (cli.workers != cross_support_nullptr))) {
+
+		usockit_cli_destroy(&cli);
+
+		fprintf(
+			stderr,
+			"%s: %s: invalid argument: not supported together with %s\n",
+			argv[0],
+			((cli.stdin_file != cross_support_nullptr) ? "--stdin-file" : "--stdin-fd"),
+			(cli.restart ? "--restart" : "--workers")
+		);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(cli.read_only && cli.child_program) {
+		usockit_cli_destroy_definitely_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --read-only: invalid argument: only valid when connecting to a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.expect != cross_support_nullptr) && cli.child_program) {
+		usockit_cli_destroy_definitely_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --expect: invalid argument: only valid when connecting to a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(cli.broadcast && cli.child_program) {
+		usockit_cli_destroy_definitely_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --broadcast: invalid argument: only valid when connecting to servers\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(cli.broadcast && (cli.read_only || (cli.expect != cross_support_nullptr))) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(
+			stderr,
+			"%s: --broadcast: invalid argument: not valid together with %s\n",
+			argv[0],
+			(cli.read_only ? "--read-only" : "--expect")
+		);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.control != cross_support_nullptr) && (cli.child_program || cli.broadcast)) {
+		usockit_cli_destroy(&cli);
+
+		fprintf(
+			stderr,
+			"%s: --control: invalid argument: not valid together with %s\n",
+			argv[0],
+			(cli.child_program ? "--" : "--broadcast")
+		);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.control != cross_support_nullptr) &&
+	                          (cli.read_only || (cli.expect != cross_support_nullptr) ||
+	                           (cli.timeout != cross_support_nullptr))) {
+
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(
+			stderr,
+			"%s: --control: invalid argument: not valid together with %s\n",
+			argv[0],
+			(cli.read_only ? "--read-only" : ((cli.expect != cross_support_nullptr) ? "--expect" : "--timeout"))
+		);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(cli.sync &&
+	                          (cli.child_program || cli.broadcast || (cli.control != cross_support_nullptr))) {
+
+		usockit_cli_destroy(&cli);
+
+		fprintf(stderr, "%s: --sync: invalid argument: only valid when connecting to a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(cli.sync && (cli.read_only || (cli.expect != cross_support_nullptr))) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(
+			stderr,
+			"%s: --sync: invalid argument: not valid together with %s\n",
+			argv[0],
+			(cli.read_only ? "--read-only" : "--expect")
+		);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(cli.wait &&
+	                          (cli.child_program || cli.broadcast || (cli.control != cross_support_nullptr))) {
+
+		usockit_cli_destroy(&cli);
+
+		fprintf(stderr, "%s: --wait: invalid argument: only valid when connecting to a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely(cli.wait && (cli.linger != cross_support_nullptr)) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --wait: invalid argument: not valid together with --linger\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.linger != cross_support_nullptr) &&
+	                          (cli.broadcast || (cli.control != cross_support_nullptr))) {
+
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(
+			stderr,
+			"%s: --linger: invalid argument: not valid together with %s\n",
+			argv[0],
+			(cli.broadcast ? "--broadcast" : "--control")
+		);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.linger != cross_support_nullptr) &&
+	                          (cli.read_only || (cli.expect != cross_support_nullptr) || cli.sync)) {
+
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(
+			stderr,
+			"%s: --linger: invalid argument: not valid together with %s\n",
+			argv[0],
+			(cli.read_only ? "--read-only" : ((cli.expect != cross_support_nullptr) ? "--expect" : "--sync"))
+		);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.timeout != cross_support_nullptr) &&
+	                          (cli.expect == cross_support_nullptr) &&
+	                          !(cli.broadcast)) {
+
+		usockit_cli_destroy(&cli);
+
+		fprintf(stderr, "%s: --timeout: invalid argument: only valid together with --expect or --broadcast\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	// the output of servers without a pty never reaches the client, so without a timeout it would wait forever
+	cross_support_if_unlikely((cli.expect != cross_support_nullptr) && (cli.timeout == cross_support_nullptr)) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --expect: invalid argument: only valid together with --timeout\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.listen_fd != -1) && !(cli.child_program)) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --listen-fd: invalid argument: only valid when starting a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	cross_support_if_unlikely((cli.resume_state != cross_support_nullptr) &&
+	                          (!(cli.child_program) || (cli.listen_fd == -1))) {
+
+		usockit_cli_destroy(&cli);
+
+		fprintf(stderr, "%s: --resume: invalid argument: only valid together with --listen-fd\n", argv[0]);
+		return 7;
+	}
+
+	if(cli.child_program && (cli.listen_fd == -1)) {
+		cli.listen_fd = take_socket_activation_fd();
+
+		cross_support_if_unlikely(cli.listen_fd == -2) {
+			usockit_cli_destroy_definitely_init_child_program_argv(&cli);
+
+			fprintf(stderr, "%s: LISTEN_FDS: more than one socket was passed; only one is supported\n", argv[0]);
+			return 7;
+		}
+	}
+
+	// with an inherited socket, the pathname is optional and only informational
+	cross_support_if_unlikely((cli.socket_pathname == cross_support_nullptr) &&
+	                          (cli.listen_fd == -1) &&
+	                          (cli.broadcast_socket_pathnames_count == 0)) {
+
+		usockit_cli_destroy(&cli);
+
+		fprintf(stderr, "%s: missing argument: <socket_path>\n", argv[0]);
+		print_usage(argv[0]);
+		return 3;
+	}
+
+	cross_support_if_unlikely((cli.socket_pathname != cross_support_nullptr) &&
+	                          (strlen(cli.socket_pathname) > USOCKIT_SOCKET_PATHNAME_MAX_LENGTH)) {
+
+
+		usockit_cli_destroy(&cli);
+
+		fprintf(
+			stderr,
+			"%s: %s: path too long: socket path length must not be more than %zu\n",
+			argv[0],
+			cli.socket_pathname,
+			USOCKIT_SOCKET_PATHNAME_MAX_LENGTH
+		);
+		return 48;
+	}
+
+	cross_support_if_unlikely(cli.report_memory && !(cli.child_program)) {
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+
+		fprintf(stderr, "%s: --report-memory: invalid argument: only valid when starting a server\n", argv[0]);
+		print_usage(argv[0]);
+		return 7;
+	}
+
+	if(cli.child_program) {
+		const int exit_code = main_server(argv[0], &cli);
+		usockit_cli_destroy_definitely_init_child_program_argv(&cli);
+		return exit_code;
+	} else if(cli.broadcast) {
+		const int exit_code = main_broadcast(argv[0], &cli);
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+		return exit_code;
+	} else if(cli.control != cross_support_nullptr) {
+		const int exit_code = main_control(argv[0], &cli);
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+		return exit_code;
+	} else {
+		const int exit_code = main_client(argv[0], &cli);
+		usockit_cli_destroy_definitely_no_init_child_program_argv(&cli);
+		return exit_code;
+	}
+}
+
+
+static inline int main_client(const const_cstr_t argv0, const struct usockit_cli* const cli) {
+	unsigned long expect_timeout_ms = 0;
+	if(cli->timeout != cross_support_nullptr) {
+		expect_timeout_ms = parse_timeout_ms(cli->timeout);
+
+		cross_support_if_unlikely(expect_timeout_ms == 0) {
+			fprintf(stderr, "%s: --timeout=%s: invalid argument: must be a positive number of seconds\n",
+			        argv0, cli->timeout);
+			return 7;
+		}
+	}
+
+	unsigned long linger_ms = 0;
+	if(cli->linger != cross_support_nullptr) {
+		linger_ms = parse_timeout_ms(cli->linger);
+
+		cross_support_if_unlikely(linger_ms == 0) {
+			fprintf(stderr, "%s: --linger=%s: invalid argument: must be a positive number of seconds\n",
+			        argv0, cli->linger);
+			return 7;
+		}
+	}
+
+	struct usockit_client_expect* expect = cross_support_nullptr;
+	if(cli->expect != cross_support_nullptr) {
+		char error_message[USOCKIT_CLIENT_EXPECT_ERROR_MESSAGE_SIZE];
+
+		expect = usockit_client_expect_create(cli->expect, error_message);
+
+		cross_support_if_unlikely(expect == cross_support_nullptr) {
+			if(errno == EINVAL) {
+				fprintf(stderr, "%s: --expect=%s: invalid argument: %s\n", argv0, cli->expect, error_message);
+				return 7;
+			}
+
+			fprintf(stderr, "%s: out of heap memory\n", argv0);
+			return 101;
+		}
+	}
+
+	const struct usockit_client_options client_options = {
+		.read_only = cli->read_only,
+		.expect = expect,
+		.expect_timeout_ms = expect_timeout_ms,
+		.sync = cli->sync,
+		.linger_ms = linger_ms,
+		.wait = cli->wait,
+	};
+
+	struct usockit_client_child_exit child_exit;
+	const enum usockit_client_ret_status ret_status =
+		usockit_client(cli->socket_pathname, &client_options, &child_exit);
+
+	if(expect != cross_support_nullptr) {
+		usockit_client_expect_destroy(expect);
+	}
+
+	// the connection may also end without the final acknowledgement, e.g.: because the child program died or because
+	// the server is too old to send acknowledgements
+	if(cli->sync &&
+	   (ret_status != USOCKIT_CLIENT_RET_STATUS_SUCCESS_ACKNOWLEDGED) &&
+	   (ret_status != USOCKIT_CLIENT_RET_STATUS_SUCCESS_FUCK_OFF) &&
+	   (ret_status != USOCKIT_CLIENT_RET_STATUS_SUCCESS_QUEUED) &&
+	   (ret_status != USOCKIT_CLIENT_RET_STATUS_IDLE_TIMEOUT) &&
+	   (ret_status != USOCKIT_CLIENT_RET_STATUS_UNKNOWN)) {
+
+		fprintf(stderr, "%s: --sync: not all input was confirmed to have reached the child program\n", argv0);
+		return 1;
+	}
+
+	switch(ret_status) {
+		case USOCKIT_CLIENT_RET_STATUS_SUCCESS_EOF: {
+			return 0;
+		}
+		case USOCKIT_CLIENT_RET_STATUS_SUCCESS_FUCK_OFF: {
+			bool joke_msg = false;
+			if(isatty(STDERR_FILENO)) {
+				srand((unsigned int)(time(cross_support_nullptr)));
+				joke_msg = ((rand() % 20) == 0);
+			}
+
+			if(!joke_msg) {
+				fputs("Server rejected connection; maximum amount of clients already connected.\n", stderr);
+			} else {
+				fputs("Server told us to fuck off, they already have enough clients connected... rude.\n", stderr);
+			}
+
+			return 48;
+		}
+		case USOCKIT_CLIENT_RET_STATUS_SUCCESS_QUEUED: {
+			fputs("Server is busy with another client; not waiting for it to finish (see --wait).\n", stderr);
+			return 48;
+		}
+		case USOCKIT_CLIENT_RET_STATUS_IDLE_TIMEOUT: {
+			fputs("Server disconnected us; nothing was sent for too long.\n", stderr);
+			return 1;
+		}
+		case USOCKIT_CLIENT_RET_STATUS_SUCCESS_SERVER_CLOSED: {
+			// waiting for output that never came isn't a success
+			return ((cli->expect != cross_support_nullptr) ? 1 : 0);
+		}
+		case USOCKIT_CLIENT_RET_STATUS_SUCCESS_CHILD_EXITED: {
+			if(cli->expect != cross_support_nullptr) {
+				return 1;
+			}
+
+			// same as a shell does it
+			return (child_exit.signaled ? (128 + child_exit.value) : child_exit.value);
+		}
+		case USOCKIT_CLIENT_RET_STATUS_SUCCESS_EXPECT_MATCHED: {
+			return 0;
+		}
+		case USOCKIT_CLIENT_RET_STATUS_EXPECT_TIMEOUT: {
+			fprintf(stderr, "%s: --expect=%s: timed out\n", argv0, cli->expect);
+			return 124;
+		}
+		case USOCKIT_CLIENT_RET_STATUS_SUCCESS_ACKNOWLEDGED: {
+			return 0;
+		}
+		case USOCKIT_CLIENT_RET_STATUS_UNKNOWN: {
+			return 125;
+		}
+		// TODO: client error handling
+		default: {
+			cross_support_unreachable();
+		}
+	}
+}
+
+static inline int main_broadcast(const const_cstr_t argv0, const struct usockit_cli* const cli) {
+	struct usockit_client_broadcast_options broadcast_options = {
+		.max_in_flight = BROADCAST_DEFAULT_MAX_IN_FLIGHT,
+		.timeout_ms = BROADCAST_DEFAULT_TIMEOUT_MS,
+	};
+
+	if(cli->broadcast_max_in_flight != cross_support_nullptr) {
+		broadcast_options.max_in_flight = parse_broadcast_max_in_flight(cli->broadcast_max_in_flight);
+
+		cross_support_if_unlikely(broadcast_options.max_in_flight == 0) {
+			fprintf(stderr, "%s: --broadcast=%s: invalid argument: must be a positive number\n",
+			        argv0, cli->broadcast_max_in_flight);
+			return 7;
+		}
+	}
+
+	if(cli->timeout != cross_support_nullptr) {
+		broadcast_options.timeout_ms = parse_timeout_ms(cli->timeout);
+
+		cross_support_if_unlikely(broadcast_options.timeout_ms == 0) {
+			fprintf(stderr, "%s: --timeout=%s: invalid argument: must be a positive number of seconds\n",
+			        argv0, cli->timeout);
+			return 7;
+		}
+	}
+
+	// patterns are expanded here, so that they can be given quoted when there are more sockets than the shell can pass
+	// as arguments; a pattern that matches nothing is kept as it is and fails to connect
+	glob_t socket_pathnames;
+	zeroset_lvalue(socket_pathnames);
+
+	for(size_t i = 0; i < cli->broadcast_socket_pathnames_count; ++i) {
+		const int ret =
+			glob(
+				cli->broadcast_socket_pathnames[i],
+				(GLOB_NOCHECK | ((i > 0) ? GLOB_APPEND : 0)),
+				cross_support_nullptr,
+				&socket_pathnames
+			);
+
+		cross_support_if_unlikely(ret == GLOB_NOSPACE) {
+			if(i > 0) {
+				globfree(&socket_pathnames);
+			}
+
+			fprintf(stderr, "%s: out of heap memory\n", argv0);
+			return 101;
+		}
+	}
+
+	const enum usockit_client_broadcast_ret_status ret_status =
+		usockit_client_broadcast(
+			(const const_cstr_t*)(socket_pathnames.gl_pathv),
+			socket_pathnames.gl_pathc,
+			&broadcast_options
+		);
+
+	globfree(&socket_pathnames);
+
+	switch(ret_status) {
+		case USOCKIT_CLIENT_BROADCAST_RET_STATUS_ALL_DELIVERED: {
+			return 0;
+		}
+		case USOCKIT_CLIENT_BROADCAST_RET_STATUS_NOT_ALL_DELIVERED: {
+			return 1;
+		}
+		case USOCKIT_CLIENT_BROADCAST_RET_STATUS_UNKNOWN: {
+			return 125;
+		}
+		default: {
+			cross_support_unreachable();
+		}
+	}
+}
+
+static inline int main_control(const const_cstr_t argv0, const struct usockit_cli* const cli) {
+	const enum usockit_client_control_ret_status ret_status =
+		usockit_client_control(cli->socket_pathname, cli->control);
+
+	switch(ret_status) {
+		case USOCKIT_CLIENT_CONTROL_RET_STATUS_OK: {
+			return 0;
+		}
+		case USOCKIT_CLIENT_CONTROL_RET_STATUS_ERROR: {
+			return 1;
+		}
+		case USOCKIT_CLIENT_CONTROL_RET_STATUS_UNKNOWN: {
+			fprintf(stderr, "%s: --control=%s: failed to reach the server\n", argv0, cli->control);
 			return 125;
 		}
 		// TODO: client error handling
@@ -194,19 +1244,201 @@ static inline int main_server(const const_cstr_t argv0, struct usockit_cli* cons
 		return 101;
 	}
 
+	struct usockit_server_resume_state resume_state;
+	if(cli->resume_state != cross_support_nullptr) {
+		cross_support_if_unlikely(!parse_resume_state(cli->resume_state, &resume_state)) {
+			fprintf(stderr, "%s: --resume=%s: invalid argument: malformed state\n", argv0, cli->resume_state);
+			return 7;
+		}
+	}
+
+	const struct {
+		const_cstr_t arg_prefix;
+		const_cstr_t value;
+	} rate_limit_args[USOCKIT_SERVER_RATE_LIMITS_COUNT] = {
+		[USOCKIT_SERVER_RATE_LIMIT_CONNECTION_BYTES] = { RATE_LIMIT_ARG_PREFIX,        cli->rate_limit },
+		[USOCKIT_SERVER_RATE_LIMIT_CONNECTION_LINES] = { LINE_LIMIT_ARG_PREFIX,        cli->line_limit },
+		[USOCKIT_SERVER_RATE_LIMIT_GLOBAL_BYTES]     = { GLOBAL_RATE_LIMIT_ARG_PREFIX, cli->global_rate_limit },
+		[USOCKIT_SERVER_RATE_LIMIT_GLOBAL_LINES]     = { GLOBAL_LINE_LIMIT_ARG_PREFIX, cli->global_line_limit },
+	};
+
+	struct usockit_server_options server_options = {
+		.report_memory = cli->report_memory,
+		.pty = cli->pty,
+		.observer_socket_pathname = cli->observer_socket_pathname,
+		.control_socket_pathname = cli->control_socket_pathname,
+		.credit_window = CREDIT_DEFAULT_WINDOW_SIZE,
+		.stdin_preload_fd = -1,
+		.listen_fd = cli->listen_fd,
+		.executable_pathname = argv0,
+		.resume = ((cli->resume_state != cross_support_nullptr) ? &resume_state : cross_support_nullptr),
+	};
+
+	cross_support_if_unlikely((cli->credit_window != cross_support_nullptr) &&
+	                          !parse_credit_window(cli->credit_window, &(server_options.credit_window))) {
+
+		fprintf(
+			stderr,
+			"%s: --credit-window=%s: invalid argument: expected a number of bytes, 0 or at least %zu\n",
+			argv0,
+			cli->credit_window,
+			CREDIT_MIN_WINDOW_SIZE
+		);
+		return 7;
+	}
+
+	if(cli->linger != cross_support_nullptr) {
+		server_options.linger_ms = parse_timeout_ms(cli->linger);
+
+		cross_support_if_unlikely(server_options.linger_ms == 0) {
+			fprintf(stderr, "%s: --linger=%s: invalid argument: must be a positive number of seconds\n",
+			        argv0, cli->linger);
+			return 7;
+		}
+	}
+
+	struct usockit_server_restart_options restart_options;
+	if(cli->restart) {
+		const const_cstr_t invalid_str =
+			parse_restart_options(cli->restart_backoff, cli->restart_queue_size, &restart_options);
+
+		cross_support_if_unlikely((invalid_str != cross_support_nullptr) && (invalid_str == cli->restart_backoff)) {
+			fprintf(
+				stderr,
+				"%s: --restart=%s: invalid argument: expected <min_ms>[:<max_ms>] (positive numbers, min <= max)\n",
+				argv0,
+				cli->restart_backoff
+			);
+			return 7;
+		}
+
+		cross_support_if_unlikely(invalid_str != cross_support_nullptr) {
+			fprintf(
+				stderr,
+				"%s: --restart-queue=%s: invalid argument: expected a number of bytes, at least %zu\n",
+				argv0,
+				cli->restart_queue_size,
+				RESTART_MIN_QUEUE_SIZE
+			);
+			return 7;
+		}
+
+		restart_options.standby = cli->standby;
+		server_options.restart = &restart_options;
+	}
+
+	if(cli->workers != cross_support_nullptr) {
+		server_options.workers_count = parse_workers_count(cli->workers);
+
+		cross_support_if_unlikely(server_options.workers_count == 0) {
+			fprintf(
+				stderr,
+				"%s: --workers=%s: invalid argument: expected a number from 1 to %zu\n",
+				argv0,
+				cli->workers,
+				WORKERS_MAX
+			);
+			return 7;
+		}
+
+		// the workers can't be handed over to an upgraded server
+		if(server_options.workers_count > 1) {
+			server_options.executable_pathname = cross_support_nullptr;
+		}
+	}
+
+	cross_support_if_unlikely((cli->wait_queue != cross_support_nullptr) &&
+	                          !parse_wait_queue(cli->wait_queue,
+	                                            &(server_options.wait_queue_length),
+	                                            &(server_options.wait_timeout_ms))) {
+
+		fprintf(
+			stderr,
+			"%s: --wait-queue=%s: invalid argument: expected <length>[:<seconds>] (length from 1 to %zu)\n",
+			argv0,
+			cli->wait_queue,
+			WAIT_QUEUE_MAX_LENGTH
+		);
+		return 7;
+	}
+
+	if(cli->idle_timeout != cross_support_nullptr) {
+		server_options.idle_timeout_ms = parse_timeout_ms(cli->idle_timeout);
+
+		cross_support_if_unlikely(server_options.idle_timeout_ms == 0) {
+			fprintf(stderr, "%s: --idle-timeout=%s: invalid argument: must be a positive number of seconds\n",
+			        argv0, cli->idle_timeout);
+			return 7;
+		}
+	}
+
+	if(cli->heartbeat != cross_support_nullptr) {
+		server_options.heartbeat_interval_ms = parse_timeout_ms(cli->heartbeat);
+
+		cross_support_if_unlikely(server_options.heartbeat_interval_ms == 0) {
+			fprintf(stderr, "%s: --heartbeat=%s: invalid argument: must be a positive number of seconds\n",
+			        argv0, cli->heartbeat);
+			return 7;
+		}
+	}
+
+	for(size_t kind = 0; kind < USOCKIT_SERVER_RATE_LIMITS_COUNT; ++kind) {
+		cross_support_if_unlikely(!parse_rate_limit(rate_limit_args[kind].value, &(server_options.rate_limits[kind]))) {
+			fprintf(
+				stderr,
+				"%s: %s%s: invalid argument: expected <rate>[:<burst>] (positive numbers)\n",
+				argv0,
+				rate_limit_args[kind].arg_prefix,
+				rate_limit_args[kind].value
+			);
+			return 7;
+		}
+	}
+
+	// opened last, so that nothing above leaves it open. the child program must not inherit it, since it wouldn't see
+	// the end of a pipe otherwise
+	if(cli->stdin_file != cross_support_nullptr) {
+		errno = 0;
+		server_options.stdin_preload_fd = open(cli->stdin_file, O_RDONLY);
+
+		cross_support_if_unlikely(server_options.stdin_preload_fd == -1) {
+			fprintf(stderr, "%s: --stdin-file=%s: %s\n", argv0, cli->stdin_file, strerror(errno));
+			return 7;
+		}
+	} else if(cli->stdin_fd != -1) {
+		server_options.stdin_preload_fd = cli->stdin_fd;
+	}
+
+	if(server_options.stdin_preload_fd != -1) {
+		errno = 0;
+		cross_support_if_unlikely(fcntl(server_options.stdin_preload_fd, F_SETFD, FD_CLOEXEC) == -1) {
+			fprintf(stderr, "%s: %i: not a file descriptor\n", argv0, server_options.stdin_preload_fd);
+			return 7;
+		}
+	}
+
 	const enum usockit_server_ret_status server_ret_status =
 		usockit_server(
 			cli->socket_pathname,
 			#ifndef NDEBUG
 			cli->child_program_argv_size,
 			#endif
-			cli->child_program_argv
+			cli->child_program_argv,
+			&server_options
 		);
 
 	switch(server_ret_status) {
 		case USOCKIT_SERVER_RET_STATUS_SUCCESS: {
 			return 0;
 		}
+		case USOCKIT_SERVER_RET_STATUS_PTY_UNSUPPORTED: {
+			fprintf(stderr, "%s: --pty: not supported on this platform\n", argv0);
+			return 7;
+		}
+		case USOCKIT_SERVER_RET_STATUS_NOT_A_LISTENING_SOCKET: {
+			fprintf(stderr, "%s: %i: not a listening socket\n", argv0, cli->listen_fd);
+			return 7;
+		}
 		case USOCKIT_SERVER_RET_STATUS_UNKNOWN: {
 			return 125;
 		}
@@ -219,11 +1451,325 @@ static inline int main_server(const const_cstr_t argv0, struct usockit_cli* cons
 	return 0;
 }
 
+static inline const_cstr_t parse_uint_prefix(const const_cstr_t str,
+                                             const unsigned long long min,
+                                             const unsigned long long max,
+                                             unsigned long long* const out) {
+	// strtoull(3) would accept leading whitespace and signs
+	if((*str < '0') || (*str > '9')) {
+		return cross_support_nullptr;
+	}
+
+	char* end;
+	errno = 0;
+	const unsigned long long n = strtoull(str, &end, 10);
+	if((errno != 0) || (n < min) || (n > max)) {
+		return cross_support_nullptr;
+	}
+
+	*out = n;
+	return end;
+}
+
+static inline bool parse_uint_option(const const_cstr_t str,
+                                     const unsigned long long min,
+                                     const unsigned long long max,
+                                     unsigned long long* const out) {
+	unsigned long long n;
+	const const_cstr_t end = parse_uint_prefix(str, min, max, &n);
+	if((end == cross_support_nullptr) || (*end != '\0')) {
+		return false;
+	}
+
+	*out = n;
+	return true;
+}
+
+static inline unsigned long parse_timeout_ms(const const_cstr_t str) {
+	unsigned long long seconds;
+	if(!parse_uint_option(str, 1, (ULONG_MAX / 1000), &seconds)) {
+		return 0;
+	}
+
+	return (unsigned long)(seconds * 1000);
+}
+
+static inline size_t parse_broadcast_max_in_flight(const const_cstr_t str) {
+	unsigned long long max_in_flight;
+	if(!parse_uint_option(str, 1, SIZE_MAX, &max_in_flight)) {
+		return 0;
+	}
+
+	return (size_t)max_in_flight;
+}
+
+static inline bool parse_credit_window(const const_cstr_t str, size_t* const credit_window_ptr) {
+	unsigned long long credit_window;
+	if(!parse_uint_option(str, 0, SIZE_MAX, &credit_window) ||
+	   ((credit_window != 0) && (credit_window < CREDIT_MIN_WINDOW_SIZE))) {
+
+		return false;
+	}
+
+	*credit_window_ptr = (size_t)credit_window;
+	return true;
+}
+
+static inline size_t parse_workers_count(const const_cstr_t str) {
+	unsigned long long workers_count;
+	if(!parse_uint_option(str, 1, WORKERS_MAX, &workers_count)) {
+		return 0;
+	}
+
+	return (size_t)workers_count;
+}
+
+static inline bool parse_wait_queue(const const_cstr_t str,
+                                    size_t* const length_ptr,
+                                    unsigned long* const timeout_ms_ptr) {
+	unsigned long long length;
+	const const_cstr_t end = parse_uint_prefix(str, 1, WAIT_QUEUE_MAX_LENGTH, &length);
+	if((end == cross_support_nullptr) || ((*end != '\0') && (*end != ':'))) {
+		return false;
+	}
+
+	unsigned long timeout_ms = WAIT_QUEUE_DEFAULT_TIMEOUT_MS;
+	if(*end == ':') {
+		timeout_ms = parse_timeout_ms(end + 1);
+		if(timeout_ms == 0) {
+			return false;
+		}
+	}
+
+	*length_ptr = (size_t)length;
+	*timeout_ms_ptr = timeout_ms;
+	return true;
+}
+
+static inline int parse_fd(const const_cstr_t str) {
+	unsigned long long n;
+	if(!parse_uint_option(str, 0, INT_MAX, &n)) {
+		return -1;
+	}
+
+	return (int)n;
+}
+
+static inline bool parse_rate_limit(const const_cstr_t str, struct usockit_server_rate_limit* const rate_limit) {
+	if(str == cross_support_nullptr) {
+		rate_limit->rate = 0;
+		rate_limit->burst = 0;
+		return true;
+	}
+
+	unsigned long long rate;
+	const const_cstr_t end = parse_uint_prefix(str, 1, ULONG_MAX, &rate);
+	if((end == cross_support_nullptr) || ((*end != '\0') && (*end != ':'))) {
+		return false;
+	}
+
+	unsigned long long burst = rate;
+	if((*end == ':') && !parse_uint_option(end + 1, 1, ULONG_MAX, &burst)) {
+		return false;
+	}
+
+	rate_limit->rate = (unsigned long)rate;
+	rate_limit->burst = (unsigned long)burst;
+
+	return true;
+}
+
+static inline const_cstr_t parse_restart_options(const const_cstr_t backoff_str,
+                                                 const const_cstr_t queue_size_str,
+                                                 struct usockit_server_restart_options* const restart_options) {
+	restart_options->backoff_min_ms = RESTART_DEFAULT_BACKOFF_MIN_MS;
+	restart_options->backoff_max_ms = RESTART_DEFAULT_BACKOFF_MAX_MS;
+	restart_options->queue_size = RESTART_DEFAULT_QUEUE_SIZE;
+
+	if(backoff_str != cross_support_nullptr) {
+		unsigned long long backoff_min_ms;
+		const const_cstr_t end = parse_uint_prefix(backoff_str, 1, ULONG_MAX, &backoff_min_ms);
+		if((end == cross_support_nullptr) || ((*end != '\0') && (*end != ':'))) {
+			return backoff_str;
+		}
+
+		unsigned long long backoff_max_ms = restart_options->backoff_max_ms;
+		if(*end == ':') {
+			if(!parse_uint_option(end + 1, backoff_min_ms, ULONG_MAX, &backoff_max_ms)) {
+				return backoff_str;
+			}
+		} else if(backoff_max_ms < backoff_min_ms) {
+			backoff_max_ms = backoff_min_ms;
+		}
+
+		restart_options->backoff_min_ms = (unsigned long)backoff_min_ms;
+		restart_options->backoff_max_ms = (unsigned long)backoff_max_ms;
+	}
+
+	if(queue_size_str != cross_support_nullptr) {
+		unsigned long long queue_size;
+		if(!parse_uint_option(queue_size_str, RESTART_MIN_QUEUE_SIZE, SIZE_MAX, &queue_size)) {
+			return queue_size_str;
+		}
+
+		restart_options->queue_size = (size_t)queue_size;
+	}
+
+	return cross_support_nullptr;
+}
+
+static inline bool parse_resume_state(const const_cstr_t str,
+                                      struct usockit_server_resume_state* const resume_state) {
+	char* end;
+
+	errno = 0;
+	const long long child_pid = strtoll(str, &end, 10);
+	if((errno != 0) || (end == str) || (*end != ',') || (child_pid <= 0)) {
+		return false;
+	}
+
+	const const_cstr_t child_stdin_fd_str = (end + 1);
+	errno = 0;
+	const long child_stdin_fd = strtol(child_stdin_fd_str, &end, 10);
+	if((errno != 0) || (end == child_stdin_fd_str) || (*end != ',') || (child_stdin_fd < 0) ||
+	   (child_stdin_fd > INT_MAX)) {
+
+		return false;
+	}
+
+	const const_cstr_t client_fd_str = (end + 1);
+	errno = 0;
+	const long client_fd = strtol(client_fd_str, &end, 10);
+	if((errno != 0) || (end == client_fd_str) || (*end != ',') || (client_fd < -1) || (client_fd > INT_MAX)) {
+		return false;
+	}
+
+	const const_cstr_t observer_listen_fd_str = (end + 1);
+	errno = 0;
+	const long observer_listen_fd = strtol(observer_listen_fd_str, &end, 10);
+	if((errno != 0) || (end == observer_listen_fd_str) || ((*end != '\0') && (*end != ',')) ||
+	   (observer_listen_fd < -1) || (observer_listen_fd > INT_MAX)) {
+
+		return false;
+	}
+
+	// the standby and the control socket are optional, so that older servers can still hand over to this version
+	long long standby_pid = -1;
+	long standby_stdin_fd = -1;
+	if(*end == ',') {
+		const const_cstr_t standby_pid_str = (end + 1);
+		errno = 0;
+		standby_pid = strtoll(standby_pid_str, &end, 10);
+		if((errno != 0) || (end == standby_pid_str) || (*end != ',') || ((standby_pid <= 0) && (standby_pid != -1))) {
+			return false;
+		}
+
+		const const_cstr_t standby_stdin_fd_str = (end + 1);
+		errno = 0;
+		standby_stdin_fd = strtol(standby_stdin_fd_str, &end, 10);
+		if((errno != 0) || (end == standby_stdin_fd_str) || ((*end != '\0') && (*end != ',')) ||
+		   (standby_stdin_fd < -1) || (standby_stdin_fd > INT_MAX) ||
+		   ((standby_pid == -1) != (standby_stdin_fd == -1))) {
+
+			return false;
+		}
+	}
+
+	long control_listen_fd = -1;
+	if(*end == ',') {
+		const const_cstr_t control_listen_fd_str = (end + 1);
+		errno = 0;
+		control_listen_fd = strtol(control_listen_fd_str, &end, 10);
+		if((errno != 0) || (end == control_listen_fd_str) || ((*end != '\0') && (*end != ',')) ||
+		   (control_listen_fd < -1) || (control_listen_fd > INT_MAX)) {
+
+			return false;
+		}
+	}
+
+	long long client_delivered_size = 0;
+	if(*end == ',') {
+		const const_cstr_t client_delivered_size_str = (end + 1);
+		errno = 0;
+		client_delivered_size = strtoll(client_delivered_size_str, &end, 10);
+		if((errno != 0) || (end == client_delivered_size_str) || ((*end != '\0') && (*end != ',')) ||
+		   (client_delivered_size < -1)) {
+
+			return false;
+		}
+	}
+
+	unsigned long long client_consumed_size = 0;
+	if(*end == ',') {
+		const const_cstr_t client_consumed_size_str = (end + 1);
+		if((*client_consumed_size_str < '0') || (*client_consumed_size_str > '9')) {
+			return false;
+		}
+
+		errno = 0;
+		client_consumed_size = strtoull(client_consumed_size_str, &end, 10);
+		if((errno != 0) || (*end != '\0')) {
+			return false;
+		}
+	}
+
+	resume_state->child_pid = (pid_t)child_pid;
+	resume_state->child_stdin_fd = (int)child_stdin_fd;
+	resume_state->client_fd = (int)client_fd;
+	resume_state->observer_listen_fd = (int)observer_listen_fd;
+	resume_state->standby_pid = (pid_t)standby_pid;
+	resume_state->standby_stdin_fd = (int)standby_stdin_fd;
+	resume_state->control_listen_fd = (int)control_listen_fd;
+	resume_state->client_delivered_size = client_delivered_size;
+	resume_state->client_consumed_size = client_consumed_size;
+
+	return true;
+}
+
+static inline int take_socket_activation_fd(void) {
+	const const_cstr_t listen_pid_str = getenv("LISTEN_PID");
+	const const_cstr_t listen_fds_str = getenv("LISTEN_FDS");
+
+	if((listen_pid_str == cross_support_nullptr) || (listen_fds_str == cross_support_nullptr)) {
+		return -1;
+	}
+
+	char* end;
+	errno = 0;
+	const long long listen_pid = strtoll(listen_pid_str, &end, 10);
+	if((errno != 0) || (*end != '\0') || (listen_pid != (long long)getpid())) {
+		// meant for some other process (e.g.: our parent forgot to unset them)
+		return -1;
+	}
+
+	const int listen_fds = parse_fd(listen_fds_str);
+	if(listen_fds < 1) {
+		return -1;
+	}
+
+	unsetenv("LISTEN_PID");
+	unsetenv("LISTEN_FDS");
+	unsetenv("LISTEN_FDNAMES");
+
+	if(listen_fds > 1) {
+		return -2;
+	}
+
+	return SOCKET_ACTIVATION_FIRST_FD;
+}
+
 static inline void print_usage(const const_cstr_t argv0) {
 	fprintf(
 		stderr,
 		"usage: %s " USAGE_STRING_SERVER "\n"
-		"   or: %s " USAGE_STRING_CLIENT "\n",
+		"   or: %s " USAGE_STRING_CLIENT "\n"
+		"   or: %s " USAGE_STRING_BROADCAST "\n"
+		"   or: %s " USAGE_STRING_CONTROL "\n"
+		"\n"
+		"Only servers started with --pty send the output of the child program to clients; against any other server,\n"
+		"--linger only waits for the exit status of the child program and --expect never matches.\n",
+		argv0,
+		argv0,
 		argv0,
 		argv0
 	);
@@ -8,33 +8,63 @@
 #include <usockit/cross_support_core.h>
 
 #if CROSS_SUPPORT_LINUX
-	// for pipe2(2)
+	// for pipe2(2), accept4(2), pthread_setname_np(3), ptsname_r(3) and splice(2)
 	#define _GNU_SOURCE
 #endif
 
 #include <usockit/cross_support_misc.h>
 
 #define USOCKIT_SERVER_PIPE2_SUPPORT  (CROSS_SUPPORT_LINUX_LEAST(2,6,67) && CROSS_SUPPORT_GLIBC_LEAST(2,9))
+#define USOCKIT_SERVER_ACCEPT4_SUPPORT  (CROSS_SUPPORT_LINUX_LEAST(2,6,28) && CROSS_SUPPORT_GLIBC_LEAST(2,10))
+#define USOCKIT_SERVER_PTHREAD_SETNAME_NP_SUPPORT  (CROSS_SUPPORT_LINUX && CROSS_SUPPORT_GLIBC_LEAST(2,12))
+#define USOCKIT_SERVER_EVENTFD_SUPPORT  (CROSS_SUPPORT_LINUX_LEAST(2,6,27) && CROSS_SUPPORT_GLIBC_LEAST(2,9))
+#define USOCKIT_SERVER_PROC_SELF_STATUS_SUPPORT  CROSS_SUPPORT_LINUX
+#define USOCKIT_SERVER_PTY_SUPPORT  CROSS_SUPPORT_LINUX
+#define USOCKIT_SERVER_PIPE_FIONREAD_SUPPORT  CROSS_SUPPORT_LINUX
+#define USOCKIT_SERVER_SIOCOUTQ_SUPPORT  CROSS_SUPPORT_LINUX
+#define USOCKIT_SERVER_SPLICE_SUPPORT  (CROSS_SUPPORT_LINUX_LEAST(2,6,17) && CROSS_SUPPORT_GLIBC_LEAST(2,5))
 
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <libgen.h>
+#include <limits.h>
+#include <poll.h>
 #include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#if USOCKIT_SERVER_EVENTFD_SUPPORT
+	#include <sys/eventfd.h>
+#endif
+#if USOCKIT_SERVER_SIOCOUTQ_SUPPORT
+	#include <linux/sockios.h>
+#endif
+#if USOCKIT_SERVER_PTY_SUPPORT || USOCKIT_SERVER_PIPE_FIONREAD_SUPPORT || USOCKIT_SERVER_SIOCOUTQ_SUPPORT
+	#include <sys/ioctl.h>
+#endif
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <sys/wait.h>
+#if USOCKIT_SERVER_PTY_SUPPORT
+	#include <termios.h>
+#endif
+#include <time.h>
 #include <unistd.h>
+#include <usockit/protocol.h>
 #include <usockit/server.h>
-#ifndef NDEBUG
-	#include <usockit/shared.h>
-#endif
+#include <usockit/server/output_ring.h>
+#include <usockit/server/screen.h>
+#include <usockit/server/token_bucket.h>
+#include <usockit/shared.h>
 #include <usockit/support_types.h>
+#include <usockit/threads.h>
 #include <usockit/utils.h>
 
 #include <stdio.h> // TODO: remove this. just required for perror(3)
@@ -44,7 +74,105 @@ enum {
 	PIPE_WRITE_INDEX = 1,
 };
 
+// stack sizes of the threads; the comments state the deepest the routines' own frames go, including the functions they
+// call (measured with `-O2 -fstack-usage -fcallgraph-info=su`; re-measure when changing a routine). `--report-memory`
+// shows what the threads add up to
+#define USOCKIT_SERVER_CHILD_WAIT_THREAD_STACK_SIZE         USOCKIT_THREAD_STACK_SIZE(1 * 1024) // ~650 bytes
+#define USOCKIT_SERVER_CLIENT_CONNECTION_THREAD_STACK_SIZE  USOCKIT_THREAD_STACK_SIZE(4 * 1024) // ~2 KiB (buffer)
+#define USOCKIT_SERVER_ACCEPT_THREAD_STACK_SIZE             USOCKIT_THREAD_STACK_SIZE(1 * 1024) // ~500 bytes
+#define USOCKIT_SERVER_PTY_OUTPUT_THREAD_STACK_SIZE         USOCKIT_THREAD_STACK_SIZE(8 * 1024) // ~4.4 KiB (buffer)
+#define USOCKIT_SERVER_OBSERVERS_THREAD_STACK_SIZE          USOCKIT_THREAD_STACK_SIZE(4 * 1024) // ~3.7 KiB (arrays)
+#define USOCKIT_SERVER_CONTROL_THREAD_STACK_SIZE            USOCKIT_THREAD_STACK_SIZE(1 * 1024) // ~750 bytes (buffers)
+
+#define USOCKIT_SERVER_UPGRADE_SIGNAL  SIGUSR2
+
+enum {
+	/**
+	 * Size of the screen if the pty doesn't have one. (because stdout of the server wasn't a terminal)
+	 */
+	USOCKIT_SERVER_SCREEN_DEFAULT_ROWS = 24,
+	USOCKIT_SERVER_SCREEN_DEFAULT_COLS = 80,
+
+	/**
+	 * How long a client has to make room for output that is sent to it, before it is disconnected.
+	 */
+	USOCKIT_SERVER_CLIENT_SEND_TIMEOUT_MS = 1000,
+
+	/**
+	 * A client is sent an acknowledgement once it has nothing more to send for the moment, or once this many bytes
+	 * were delivered since the last one while it keeps on sending.
+	 */
+	USOCKIT_SERVER_ACK_INTERVAL_SIZE = 64 * 1024,
+
+	/**
+	 * Maximum number of observers that are connected at the same time; any more are rejected.
+	 */
+	USOCKIT_SERVER_OBSERVERS_MAX = 64,
+
+	/**
+	 * How many control clients may wait for their turn; any more are refused by the system.
+	 */
+	USOCKIT_SERVER_CONTROL_BACKLOG = 8,
+	/**
+	 * How long a control client has to send its command and to take the reply, before it is disconnected.
+	 */
+	USOCKIT_SERVER_CONTROL_TIMEOUT_MS = 1000,
+	/**
+	 * Longest command line (newline character not included) and longest reply line (newline character included).
+	 */
+	USOCKIT_SERVER_CONTROL_COMMAND_MAX_SIZE = 64,
+	USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE = 160,
+
+	/**
+	 * How often the child_wait thread looks for children that died in supervisor mode if it couldn't install its
+	 * SIGCHLD handler.
+	 */
+	USOCKIT_SERVER_CHILD_EXIT_POLL_INTERVAL_MS = 100,
+};
+
+/**
+ * How far observers may fall behind the output before they are disconnected.
+ */
+#define USOCKIT_SERVER_OBSERVER_RING_SIZE  ((size_t)(1024 * 1024))
+
+/**
+ * How much of the preloaded input is spliced into the stdin of the child program at once.
+ */
+#define USOCKIT_SERVER_PRELOAD_SPLICE_SIZE  ((size_t)(64 * 1024))
+
+#define USOCKIT_SERVER_OBSERVER_SOCKET_ARG_PREFIX  "--observer-socket="
+#define USOCKIT_SERVER_CONTROL_SOCKET_ARG_PREFIX   "--control-socket="
+#define USOCKIT_SERVER_RESTART_ARG_PREFIX          "--restart="
+#define USOCKIT_SERVER_RESTART_QUEUE_ARG_PREFIX    "--restart-queue="
+#define USOCKIT_SERVER_STANDBY_ARG                 "--standby"
+#define USOCKIT_SERVER_CREDIT_WINDOW_ARG_PREFIX    "--credit-window="
+#define USOCKIT_SERVER_LINGER_ARG_PREFIX           "--linger="
+#define USOCKIT_SERVER_WAIT_QUEUE_ARG_PREFIX       "--wait-queue="
+#define USOCKIT_SERVER_IDLE_TIMEOUT_ARG_PREFIX     "--idle-timeout="
+#define USOCKIT_SERVER_HEARTBEAT_ARG_PREFIX        "--heartbeat="
+
+/**
+ * Arguments that the rate limits are given with, indexed by `enum usockit_server_rate_limit_kind`.
+ */
+static const const_cstr_t usockit_server_rate_limit_arg_prefixes[USOCKIT_SERVER_RATE_LIMITS_COUNT] = {
+	[USOCKIT_SERVER_RATE_LIMIT_CONNECTION_BYTES] = "--rate-limit=",
+	[USOCKIT_SERVER_RATE_LIMIT_CONNECTION_LINES] = "--line-limit=",
+	[USOCKIT_SERVER_RATE_LIMIT_GLOBAL_BYTES]     = "--global-rate-limit=",
+	[USOCKIT_SERVER_RATE_LIMIT_GLOBAL_LINES]     = "--global-line-limit=",
+};
+
+enum {
+	/**
+	 * The accept and client_connection threads park for an upgrade (plus the pty_output thread in pty mode, the
+	 * observers thread if there is an observer socket and the control thread if there is a control socket); the
+	 * child_wait thread doesn't need to.
+	 */
+	USOCKIT_SERVER_UPGRADE_PARKING_THREADS_COUNT = 2,
+};
+
 enum usockit_server_child_error_func {
+	USOCKIT_CHILD_ERROR_FUNC_SETSID,
+	USOCKIT_CHILD_ERROR_FUNC_IOCTL,
 	USOCKIT_CHILD_ERROR_FUNC_DUP2,
 	USOCKIT_CHILD_ERROR_FUNC_EXECVE,
 };
@@ -56,43 +184,631 @@ struct usockit_server_child_error {
 struct usockit_server_child_ready_info {
 	pthread_mutex_t mutex;
 	bool condition;
+	/**
+	 * Set instead of `condition` if the child will never become ready (because starting it failed).
+	 */
+	bool aborted;
+	/**
+	 * Set while the client_connection thread writes the preloaded input into the stdin of the child program; the
+	 * accept thread only starts accepting connections once the child is ready and this is cleared.
+	 */
+	bool preloading;
+	pthread_cond_t cond;
+};
+
+enum usockit_server_wait_result {
+	USOCKIT_SERVER_WAIT_RESULT_READABLE,
+	USOCKIT_SERVER_WAIT_RESULT_UPGRADE,
+	USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN,
+	USOCKIT_SERVER_WAIT_RESULT_FAILURE,
+	/**
+	 * Only returned by usockit_server_wait_timeout(), usockit_server_wait_readable_timeout(),
+	 * usockit_server_wait_hangup(), usockit_server_wait_client_linger() & usockit_server_wait_client_input().
+	 */
+	USOCKIT_SERVER_WAIT_RESULT_TIMEOUT,
+};
+
+struct usockit_server_upgrade_info {
+	pthread_mutex_t mutex;
 	pthread_cond_t cond;
+	/**
+	 * Number of threads that are parked until the upgrade either happened or was called off.
+	 */
+	size_t parked_count;
+	/**
+	 * Number of threads that have to be parked before the upgrade can happen.
+	 */
+	size_t parking_threads_count;
+	/**
+	 * Incremented every time the main thread calls off an upgrade and releases the parked threads again.
+	 */
+	unsigned long generation;
+	/**
+	 * Set by the child_wait thread once the child died; there is nothing left to keep alive at that point.
+	 */
+	bool child_exited;
+	/**
+	 * Wait status of the child, which is sent to the clients. Only valid if `child_status_known` is set.
+	 */
+	bool child_status_known;
+	int child_status;
+	/**
+	 * Notified by the signal handler. Unlike the shutdown notifier, it is drained again when an upgrade is called off.
+	 */
+	int notify_fds[2];
+};
+
+/**
+ * The child program in supervisor mode. Shared by the child_wait thread, which restarts it, the client_connection
+ * thread, which writes into its stdin, and the main thread, which hands it over on upgrades.
+ * The PIDs and the stdins of the child program and of the standby may only be accessed while holding the mutex,
+ * except by the child_wait thread for reading, since it is the only one that changes them.
+ */
+struct usockit_server_restart_info {
+	pthread_mutex_t mutex;
+	/**
+	 * Whether or not the stdin of the child program takes input. If not, input goes into the queue instead, which is
+	 * always empty while the child program is up.
+	 */
+	bool child_up;
+	unsigned char* queue;
+	size_t queue_size;
+	size_t queue_capacity;
+	/**
+	 * Notified every time a restarted child program took the queue or the queue was flushed. The client_connection
+	 * thread waits on it while the queue is full.
+	 */
+	int notify_fds[2];
+	/**
+	 * Number of bytes that ever left the front of the queue, whether a restarted child program took them or they were
+	 * flushed, and the number of flushes. Together they tell the client_connection thread what became of the input
+	 * that it queued.
+	 */
+	uint64_t queue_head_position;
+	unsigned long queue_flush_generation;
+	/**
+	 * The standby child program, whose stdin isn't written to until it takes over, or -1 for both if there is none.
+	 */
+	pid_t standby_pid;
+	int standby_stdin_fd;
+	/**
+	 * Notified by the SIGCHLD handler, so that the child_wait thread can wait for children to die and for backoffs to
+	 * pass at the same time.
+	 */
+	int child_exit_notify_fds[2];
+	/**
+	 * Copy of the PID of the child program for the control thread, or -1 while it is down. The control thread can't
+	 * wait for the mutex, since the client_connection thread holds it while it is blocked writing into a full stdin.
+	 */
+	_Atomic(pid_t) signalable_child_pid;
+};
+
+/**
+ * What the child_wait thread keeps track of about the child program, or about the standby, in supervisor mode.
+ */
+struct usockit_server_supervised_child {
+	/**
+	 * Whether or not it is down and is to be started at `start_at_ns`.
+	 */
+	bool start_pending;
+	uint64_t start_at_ns;
+	uint64_t started_ns;
+	/**
+	 * How long to wait before starting it after it failed the next time.
+	 */
+	unsigned long backoff_ms;
 };
 
+struct usockit_server_worker {
+	pid_t pid;
+	/**
+	 * Write end of the pipe to its stdin, or -1 if it wasn't started.
+	 */
+	int stdin_fd;
+	/**
+	 * Set once writing into its stdin failed because it died; it isn't given any more input after that.
+	 */
+	bool gone;
+};
+
+/**
+ * The copies of the child program in worker mode. The PIDs and the stdins are set before any other thread uses them
+ * and never change afterwards; everything else is only accessed by the client_connection thread.
+ */
+struct usockit_server_worker_pool {
+	size_t count;
+	/**
+	 * The worker that the rest of the current line goes to, or `count` if the last line that was forwarded is
+	 * complete, in which case the next line goes to the least loaded worker.
+	 */
+	size_t current_index;
+	/**
+	 * Where looking for the least loaded worker starts, so that workers that are equally loaded take turns.
+	 */
+	size_t next_index;
+	struct usockit_server_worker workers[];
+};
+
+/**
+ * Set by the signal handler in addition to notifying the upgrade notifier, so that the client_connection thread also
+ * notices the request while it is busy forwarding and not polling anything.
+ */
+static atomic_bool usockit_server_upgrade_requested;
+/**
+ * Write end of the upgrade notifier for the signal handler, which can't be passed any arguments. -1 while the signal
+ * handler is installed means that the server can't be upgraded.
+ */
+static int usockit_server_upgrade_signal_notify_fd = -1;
+/**
+ * Write end of the child exit notifier for the SIGCHLD handler.
+ */
+static int usockit_server_child_exit_signal_notify_fd = -1;
+
 struct usockit_server_thread_routine_child_wait_arg {
 	struct usockit_server_child_ready_info* child_ready_info;
 	pid_t* child_pid_ptr;
+	/**
+	 * Once the child died, the child_wait thread notifies all other threads to shut down via this file descriptor.
+	 */
+	int shutdown_notify_fd;
+	struct usockit_server_upgrade_info* upgrade_info;
+	/**
+	 * Null pointer if not in supervisor mode, in which case the fields below are unused as well.
+	 */
+	struct usockit_server_restart_info* restart_info;
+	const struct usockit_server_restart_options* restart_options;
+	const cstr_t* child_program_argv;
+	int socket_fd;
+	/**
+	 * Write end of the pipe to the stdin of the child program; owned by the client_connection thread argument.
+	 */
+	int* child_stdin_fd_ptr;
+	/**
+	 * Null pointer if not in worker mode, otherwise it is waited for all of the workers instead of for the child.
+	 */
+	const struct usockit_server_worker_pool* worker_pool;
+};
+
+/**
+ * How much of what the connected client sent made it into the stdin of the child program, which the client is told with
+ * acknowledgements.
+ */
+struct usockit_server_delivery {
+	/**
+	 * Number of bytes from the start of the connection on that were written into the stdin of the child program (or of
+	 * a worker), without any gaps.
+	 */
+	uint64_t delivered_size;
+	/**
+	 * Set once input was lost, because it was flushed out of the queue or because the worker that it was meant for
+	 * died. `delivered_size` doesn't grow anymore from then on, since acknowledgements can't skip anything.
+	 */
+	bool lost;
+	/**
+	 * Supervisor mode only: number of bytes that went into the queue instead of into the stdin, the position in the
+	 * queue (see `queue_head_position`) right after the last of them and the flush generation from when they did.
+	 */
+	uint64_t queued_size;
+	uint64_t queued_end_position;
+	unsigned long queue_flush_generation;
+	/**
+	 * What the client was told last.
+	 */
+	uint64_t acked_size;
+
+	/**
+	 * Number of bytes that were read from the client and written into the stdin or the queue (or skipped), lost or
+	 * not, and the byte up to which the client was granted credit to send.
+	 */
+	uint64_t consumed_size;
+	uint64_t credit_limit;
+};
+
+/**
+ * A connection that waits for the client slot, and since when.
+ */
+struct usockit_server_waiting_client {
+	int fd;
+	uint64_t since_ns;
+};
+/**
+ * Connections that wait for the client slot, in the order that they arrived in, and how long they waited.
+ * Only accessed by the accept thread, except for `length`, which the control thread reads as well.
+ */
+struct usockit_server_wait_queue {
+	/**
+	 * Notified by whoever frees the client slot, so that the accept thread can admit the next connection right away.
+	 */
+	int slot_freed_notify_fds[2];
+	uint64_t timeout_ns;
+
+	/**
+	 * Ring of `capacity` connections, the longest waiting one being at `head`.
+	 */
+	struct usockit_server_waiting_client* clients;
+	size_t capacity;
+	size_t head;
+	atomic_size_t length;
+	/**
+	 * Room for polling the listening socket, the notifiers and every waiting connection at once.
+	 */
+	struct pollfd* pfds;
+
+	unsigned long long admitted_count;
+	unsigned long long timed_out_count;
+	/**
+	 * Connections that were closed by the client while they waited.
+	 */
+	unsigned long long gone_count;
+	/**
+	 * Connections that were rejected right away because the queue was full.
+	 */
+	unsigned long long full_count;
+	uint64_t waited_ns;
+	uint64_t longest_wait_ns;
 };
 
 struct usockit_server_thread_routine_client_connection_client_ready_info {
-	pthread_mutex_t mutex;
+	/**
+	 * Whether or not a client currently occupies the client slot.
+	 *
+	 * Only the accept thread occupies the slot (via compare-and-swap) and only the client_connection thread frees it
+	 * again, so neither of them ever has to wait on the other one.
+	 */
+	atomic_bool slot_occupied;
+	/**
+	 * The accept thread writes the file descriptor of the client that occupied the slot into this pipe and the
+	 * client_connection thread blocks on reading from it.
+	 * (an int is way below PIPE_BUF, so these writes & reads are atomic)
+	 */
+	int handoff_pipe[2];
+	/**
+	 * The file descriptor of the client that the client_connection thread is currently serving, or -1, and what
+	 * became of its input.
+	 * Only accessed by the client_connection thread, and by the main thread while the former is parked for an upgrade.
+	 */
 	int client_fd;
-	pthread_cond_t cond;
+	struct usockit_server_delivery client_delivery;
+	/**
+	 * Null pointer if connections are rejected right away while the slot is occupied.
+	 */
+	struct usockit_server_wait_queue* wait_queue;
+};
+/**
+ * Output of the child program in pty mode. Shared by the pty_output thread, which feeds it into the screen and
+ * forwards it to the attached client and the observers, the client_connection thread, which attaches the client that it
+ * serves, and the observers thread.
+ */
+struct usockit_server_pty_output_info {
+	pthread_mutex_t mutex;
+	struct usockit_server_screen* screen;
+	/**
+	 * The client that the output is forwarded to, or -1.
+	 */
+	int attached_client_fd;
+
+	/**
+	 * The output as messages, which the observers thread sends to every observer straight from the ring.
+	 * Null pointer if there is no observer socket, in which case the fields below are unused as well.
+	 */
+	struct usockit_server_output_ring* observer_ring;
+	/**
+	 * Notifies the observers thread of new output in the ring, or that the output ended. Only notified again once the
+	 * observers thread cleared `observers_notified`, so that busy output costs one notification per round of sending,
+	 * not one per chunk of output.
+	 */
+	int observers_notify_fds[2];
+	bool observers_notified;
+	/**
+	 * Set by the pty_output thread once it stopped reading output. `output_ended_cond` is signaled along with it for
+	 * the client_connection thread, which waits for the output to end before it tells the client that the child exited.
+	 */
+	bool output_ended;
+	pthread_cond_t output_ended_cond;
 };
+
 struct usockit_server_thread_routine_client_connection_arg {
 	struct usockit_server_thread_routine_client_connection_client_ready_info* client_ready_info;
 	int* child_stdin_fd_ptr;
+	/**
+	 * The input that is written into the stdin of the child program before any client is served, or -1. Closed by the
+	 * client_connection thread once it was read, which then clears `child_ready_info->preloading`.
+	 */
+	int stdin_preload_fd;
+	struct usockit_server_child_ready_info* child_ready_info;
+	int shutdown_fd;
+	struct usockit_server_upgrade_info* upgrade_info;
+	/**
+	 * Null pointer if not in pty mode.
+	 */
+	struct usockit_server_pty_output_info* pty_output_info;
+	/**
+	 * The client that was carried over an upgrade, or -1. It already shows the screen, so it doesn't get a snapshot.
+	 * The acknowledgements that it is sent carry on from `resumed_client_delivered_size`, unless that is -1, in which
+	 * case some of its input was lost before the upgrade, and its credit from `resumed_client_consumed_size`.
+	 */
+	int resumed_client_fd;
+	long long resumed_client_delivered_size;
+	unsigned long long resumed_client_consumed_size;
+	/**
+	 * How many bytes the client may send ahead of what was read from it, or 0 to not grant credit at all.
+	 */
+	size_t credit_window;
+	/**
+	 * How long a client that shut down its sending side stays connected, or 0 to close the connection right away.
+	 */
+	unsigned long linger_ms;
+	/**
+	 * How long the client may not send anything before it is disconnected and how often it is sent a heartbeat in the
+	 * meantime; 0 to do neither.
+	 */
+	unsigned long idle_timeout_ms;
+	unsigned long heartbeat_interval_ms;
+	const struct usockit_server_rate_limit* rate_limits;
+	/**
+	 * Null pointer if not in supervisor mode.
+	 */
+	struct usockit_server_restart_info* restart_info;
+	/**
+	 * Null pointer if not in worker mode, otherwise the input goes to the workers instead of to the child's stdin.
+	 */
+	struct usockit_server_worker_pool* worker_pool;
+};
+
+/**
+ * Token buckets of the rate limits, along with the statistics of how often and for how long clients were held back by
+ * them. Lives on the stack of the client_connection thread, which is the only one that uses it.
+ */
+struct usockit_server_rate_limiter {
+	bool enabled[USOCKIT_SERVER_RATE_LIMITS_COUNT];
+	bool any_enabled;
+	bool any_lines_enabled;
+	struct usockit_server_token_bucket buckets[USOCKIT_SERVER_RATE_LIMITS_COUNT];
+
+	/**
+	 * Whether or not the current client is being held back right now. Set when reading is paused and cleared once the
+	 * client has nothing more to send, so that holding back a client that keeps sending counts as one throttle event,
+	 * no matter how many pauses it takes.
+	 */
+	bool throttling;
+	/**
+	 * Throttle events, by the limit that caused them.
+	 */
+	unsigned long long throttle_counts[USOCKIT_SERVER_RATE_LIMITS_COUNT];
+	uint64_t throttled_ns;
+	unsigned long long connection_throttle_count;
+	uint64_t connection_throttled_ns;
+};
+
+enum usockit_server_eviction {
+	USOCKIT_SERVER_EVICTION_NONE,
+	/**
+	 * The client didn't send anything for too long.
+	 */
+	USOCKIT_SERVER_EVICTION_IDLE,
+	/**
+	 * The client didn't take what it was sent; its heartbeats, the acknowledgements of its input or its credit.
+	 */
+	USOCKIT_SERVER_EVICTION_UNRESPONSIVE,
+};
+
+/**
+ * Keeps track of how long the current client has been quiet for the idle timeout and the heartbeats. Lives on the stack
+ * of the client_connection thread, which is the only one that uses it.
+ */
+struct usockit_server_client_liveness {
+	/**
+	 * Set whenever something was read from the client; the client counts as quiet from the next wait on.
+	 */
+	bool input_since_wait;
+	/**
+	 * Whether or not the client sent anything since the last heartbeat, which would mean that it's still around,
+	 * whatever it left unread.
+	 */
+	bool input_since_heartbeat;
+	bool heartbeat_sent;
+	uint64_t idle_since_ns;
+	uint64_t heartbeat_due_ns;
+	enum usockit_server_eviction eviction;
+};
+
+struct usockit_server_thread_routine_pty_output_arg {
+	int pty_master_fd;
+	int shutdown_fd;
+	struct usockit_server_upgrade_info* upgrade_info;
+	struct usockit_server_pty_output_info* pty_output_info;
+};
+
+struct usockit_server_observer {
+	int fd;
+	/**
+	 * Offset into the observer ring of the output that is sent to the observer next.
+	 */
+	uint64_t ring_offset;
+	/**
+	 * The snapshot message (header included) that is sent before any output from the ring, or a null pointer once it
+	 * was sent.
+	 */
+	unsigned char* snapshot;
+	size_t snapshot_size;
+	size_t snapshot_sent_size;
+};
+enum usockit_server_observer_flush_result {
+	USOCKIT_SERVER_OBSERVER_FLUSH_RESULT_CAUGHT_UP,
+	/**
+	 * The observer doesn't take any more output right now.
+	 */
+	USOCKIT_SERVER_OBSERVER_FLUSH_RESULT_PENDING,
+	/**
+	 * The observer either is gone or fell too far behind.
+	 */
+	USOCKIT_SERVER_OBSERVER_FLUSH_RESULT_GONE,
+};
+
+struct usockit_server_thread_routine_observers_arg {
+	int observer_socket_fd;
+	int shutdown_fd;
+	struct usockit_server_upgrade_info* upgrade_info;
+	struct usockit_server_pty_output_info* pty_output_info;
+};
+
+struct usockit_server_thread_routine_control_arg {
+	int control_socket_fd;
+	int shutdown_fd;
+	struct usockit_server_upgrade_info* upgrade_info;
+	struct usockit_server_thread_routine_client_connection_client_ready_info* client_ready_info;
+	/**
+	 * Only used if neither in supervisor mode nor in worker mode, in which case they never change.
+	 */
+	const pid_t* child_pid_ptr;
+	const int* child_stdin_fd_ptr;
+	/**
+	 * Null pointer if not in supervisor mode.
+	 */
+	struct usockit_server_restart_info* restart_info;
+	/**
+	 * Null pointer if not in worker mode.
+	 */
+	const struct usockit_server_worker_pool* worker_pool;
+	/**
+	 * Null pointer if not in pty mode. The pty master is `*child_stdin_fd_ptr` then.
+	 */
+	struct usockit_server_pty_output_info* pty_output_info;
 };
 
 struct usockit_server_thread_routine_accept_arg {
 	struct usockit_server_child_ready_info* child_ready_info;
 	struct usockit_server_thread_routine_client_connection_client_ready_info* client_ready_info;
 	int socket_fd;
+	int shutdown_fd;
+	struct usockit_server_upgrade_info* upgrade_info;
 };
 
 
 // usockit_server
 // `--- usockit_server_check_socket_pathname
 // `--- usockit_server_setup_socket
-//      `--- usockit_server_setup_threads
-//          `--- usockit_server_thread_routine_child_wait
-//          `--- usockit_server_thread_routine_client_connection
-//          |    `--- usockit_server_thread_routine_client_connection_cleanup_routine
-//          `--- usockit_server_thread_routine_accept
-//          |    `--- usockit_server_thread_routine_accept_cleanup_routine
-//          `--- usockit_server_setup_child
-//               `--- usockit_server_child
-//               `--- usockit_server_parent
+// |    `--- usockit_server_setup_observer_socket
+// |         `--- usockit_server_setup_control_socket
+// |              `--- usockit_server_setup_threads
+// `--- usockit_server_setup_inherited_socket
+//      `--- usockit_server_setup_observer_socket
+//           `--- usockit_server_setup_control_socket
+//                `--- usockit_server_setup_threads
+//                    `--- usockit_server_thread_routine_child_wait
+//                    |    `--- usockit_server_wait_for_workers
+//                    |    `--- usockit_server_supervise_child
+//                    |         `--- usockit_server_install_child_exit_signal_handler
+//                    |         `--- usockit_server_handle_child_failure
+//                    |         |    `--- usockit_server_activate_child
+//                    |         |    `--- usockit_server_schedule_child_start
+//                    |         `--- usockit_server_handle_standby_failure
+//                    |         |    `--- usockit_server_schedule_child_start
+//                    |         `--- usockit_server_start_due_children
+//                    |         |    `--- usockit_server_start_child
+//                    |         |    `--- usockit_server_activate_child
+//                    |         |    `--- usockit_server_schedule_child_start
+//                    |         `--- usockit_server_restore_child_exit_signal_handler
+//                    `--- usockit_server_thread_routine_client_connection
+//                    |    `--- usockit_server_preload_child_stdin
+//                    |    |    `--- usockit_server_now_ns
+//                    |    `--- usockit_server_write_child_stdin
+//                    |    |    `--- usockit_server_settle_queued_delivery
+//                    |    |    `--- usockit_server_add_delivered
+//                    |    `--- usockit_server_write_workers_stdin
+//                    |    |    `--- usockit_server_pick_worker
+//                    |    |    `--- usockit_server_add_delivered
+//                    |    `--- usockit_server_settle_client_delivery
+//                    |    |    `--- usockit_server_settle_queued_delivery
+//                    |    `--- usockit_server_wait_queued_delivery
+//                    |    |    `--- usockit_server_settle_client_delivery
+//                    |    |    `--- usockit_server_park_for_upgrade
+//                    |    `--- usockit_server_send_ack
+//                    |    |    `--- usockit_server_send_size_message
+//                    |    |         `--- usockit_server_send_client_message
+//                    |    |              `--- usockit_server_send_message
+//                    |    `--- usockit_server_grant_credit
+//                    |    |    `--- usockit_server_send_size_message
+//                    |    |         `--- usockit_server_send_client_message
+//                    |    |              `--- usockit_server_send_message
+//                    |    `--- usockit_server_wait_client_input
+//                    |    |    `--- usockit_server_now_ns
+//                    |    |    `--- usockit_server_client_has_unread
+//                    |    |    `--- usockit_server_send_client_message
+//                    |    |    |    `--- usockit_server_send_message
+//                    |    |    `--- usockit_server_wait_readable_timeout
+//                    |    `--- usockit_server_wait_client_linger
+//                    |    |    `--- usockit_server_now_ns
+//                    |    |    `--- usockit_server_wait_hangup
+//                    |    |    `--- usockit_server_park_for_upgrade
+//                    |    `--- usockit_server_report_eviction
+//                    |    |    `--- usockit_server_send_client_message
+//                    |    |         `--- usockit_server_send_message
+//                    |    `--- usockit_server_attach_client
+//                    |    |    `--- usockit_server_send_message
+//                    |    `--- usockit_server_send_child_exit
+//                    |    |    `--- usockit_server_get_child_exit_payload
+//                    |    |    `--- usockit_server_send_message
+//                    |    `--- usockit_server_thread_routine_client_connection_release_client
+//                    |    |    `--- usockit_server_free_client_slot
+//                    |    `--- usockit_server_rate_limiter_reset_connection
+//                    |    `--- usockit_server_rate_limiter_allowance
+//                    |    `--- usockit_server_rate_limiter_take
+//                    |    `--- usockit_server_rate_limiter_pause
+//                    |    `--- usockit_server_rate_limiter_report
+//                    |    `--- usockit_server_park_for_upgrade
+//                    `--- usockit_server_thread_routine_accept
+//                    |    `--- usockit_server_serve_wait_queue
+//                    |    |    `--- usockit_server_dequeue_waiting_client
+//                    |    |    `--- usockit_server_hand_over_client
+//                    |    |    `--- usockit_server_reject_client
+//                    |    `--- usockit_server_wait_accept
+//                    |    `--- usockit_server_get_child_exit_payload
+//                    |    `--- usockit_server_clear_wait_queue
+//                    |    |    `--- usockit_server_dequeue_waiting_client
+//                    |    |    `--- usockit_server_reject_client
+//                    |    |    `--- usockit_server_send_message
+//                    |    `--- usockit_server_wait_queue_report
+//                    |    `--- usockit_server_park_for_upgrade
+//                    |    `--- usockit_server_hand_over_client
+//                    |    `--- usockit_server_enqueue_waiting_client
+//                    |    |    `--- usockit_server_send_message
+//                    |    `--- usockit_server_reject_client
+//                    `--- usockit_server_setup_child
+//                    |    `--- usockit_server_start_workers
+//                    |    |    `--- usockit_server_start_child
+//                    |    `--- usockit_server_start_child
+//                    |    |    `--- usockit_server_open_pty
+//                    |    |    `--- usockit_server_child
+//                    |    |    `--- usockit_server_parent
+//                    |    `--- usockit_server_signal_child_ready
+//                    `--- usockit_server_thread_routine_pty_output
+//                    |    `--- usockit_server_resize_screen
+//                    |    `--- usockit_server_forward_pty_output
+//                    |    |    `--- usockit_server_send_message
+//                    |    `--- usockit_server_end_pty_output
+//                    |    `--- usockit_server_park_for_upgrade
+//                    `--- usockit_server_thread_routine_observers
+//                    |    `--- usockit_server_get_child_exit_payload
+//                    |    `--- usockit_server_flush_observer
+//                    |    `--- usockit_server_accept_observer
+//                    |    `--- usockit_server_remove_observer
+//                    |    `--- usockit_server_park_for_upgrade
+//                    `--- usockit_server_thread_routine_control
+//                    |    `--- usockit_server_serve_control_client
+//                    |    |    `--- usockit_server_run_control_command
+//                    |    |         `--- usockit_server_control_status
+//                    |    |         `--- usockit_server_control_signal
+//                    |    |         `--- usockit_server_parse_signal
+//                    |    |         `--- usockit_server_control_flush
+//                    |    |         `--- usockit_server_parse_window_size
+//                    |    |         `--- usockit_server_control_resize
+//                    |    `--- usockit_server_park_for_upgrade
+//                    `--- usockit_server_upgrade
+//                         `--- usockit_server_settle_queued_delivery
+//                         `--- usockit_server_exec_upgrade
+//                         `--- usockit_server_hand_over_client
+//                         `--- usockit_server_release_parked_threads
 
 cross_support_nodiscard
 static inline enum usockit_server_ret_status usockit_server_check_socket_pathname(const_cstr_t socket_pathname)
@@ -100,169 +816,1463 @@ static inline enum usockit_server_ret_status usockit_server_check_socket_pathnam
 	cross_support_attr_nonnull_all
 	cross_support_attr_warn_unused_result;
 
+/**
+ * `main_pipe_read_fd` is the pty slave if `pty` is `true`, which then also becomes the child's stdout & stderr.
+ */
 cross_support_noreturn
 static inline void usockit_server_child(const cstr_t* child_program_argv,
                                         int main_pipe_read_fd,
-                                        int reporting_pipe_write_fd)
+                                        int reporting_pipe_write_fd,
+                                        bool pty)
 	                                        cross_support_attr_always_inline
 	                                        cross_support_attr_nonnull(1)
 	                                        cross_support_attr_noreturn;
 
+cross_support_noreturn
+static inline void usockit_server_child_report_error(int reporting_pipe_write_fd,
+                                                     enum usockit_server_child_error_func func)
+	                                                     cross_support_attr_always_inline
+	                                                     cross_support_attr_noreturn;
+
+/**
+ * Opens a pseudo-terminal, stores the master in `pty_fds[PIPE_WRITE_INDEX]` and the slave in `pty_fds[PIPE_READ_INDEX]`
+ * (so that it can be used in place of the main pipe) and configures it for forwarding output as it is.
+ */
 cross_support_nodiscard
-static inline enum usockit_server_ret_status usockit_server_parent(
-	int reporting_pipe_read_fd,
-	pid_t child_pid,
-	struct usockit_server_child_ready_info* child_ready_info,
-	pthread_t child_wait_thread,
-	pthread_t accept_thread
-) cross_support_attr_always_inline
-	  cross_support_attr_nonnull(3)
-	  cross_support_attr_warn_unused_result;
-
-static inline void usockit_server_wait_for_child_ready(struct usockit_server_child_ready_info* child_ready_info)
+static inline ret_status_t usockit_server_open_pty(int pty_fds[2])
 	cross_support_attr_always_inline
-	cross_support_attr_nonnull_all;
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
 
-static void* usockit_server_thread_routine_child_wait(void* arg) cross_support_attr_nonnull_all;
+/**
+ * Forwards one chunk of output from the pty master to stdout and to the attached client, and feeds it into the screen.
+ *
+ * Returns `false` once there is nothing left to forward, because no process has the slave open anymore.
+ */
+cross_support_nodiscard
+static inline bool usockit_server_forward_pty_output(int pty_master_fd,
+                                                     struct usockit_server_pty_output_info* pty_output_info)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
 
-static void  usockit_server_thread_routine_client_connection_cleanup_routine(void* arg) cross_support_attr_nonnull_all;
-static void* usockit_server_thread_routine_client_connection(void* arg) cross_support_attr_nonnull_all;
+/**
+ * Resizes the screen to the window size of the pty, if it has one.
+ */
+static inline void usockit_server_resize_screen(struct usockit_server_pty_output_info* pty_output_info,
+                                                int pty_master_fd)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
 
-static void  usockit_server_thread_routine_accept_cleanup_routine(void* arg) cross_support_attr_nonnull_all;
-static void* usockit_server_thread_routine_accept(void* arg) cross_support_attr_nonnull_all;
+/**
+ * Starts forwarding the output to `client_fd`; first sending a snapshot of the screen if `send_snapshot` is `true`.
+ */
+static inline void usockit_server_attach_client(struct usockit_server_pty_output_info* pty_output_info,
+                                                int client_fd,
+                                                bool send_snapshot)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
 
+/**
+ * Encodes the exit status of the child as the payload of a child exit message.
+ * Returns `false` if the child didn't exit or its exit status isn't known.
+ */
 cross_support_nodiscard
-static inline enum usockit_server_ret_status usockit_server_setup_child(
-	const cstr_t* child_program_argv,
-	int socket_fd,
-	struct usockit_server_child_ready_info* child_read_info,
-	pid_t* child_wait_thread_routine_arg_child_pid_ptr,
-	int* client_connection_thread_routine_arg_child_stdin_fd_ptr,
-	pthread_t child_wait_thread,
-	pthread_t accept_thread
+static inline bool usockit_server_get_child_exit_payload(
+	struct usockit_server_upgrade_info* upgrade_info,
+	unsigned char payload[USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE]
 ) cross_support_attr_always_inline
-	  cross_support_attr_nonnull(1, 3, 4, 5)
-	  cross_support_attr_warn_unused_result;
+  cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
 
+/**
+ * Tells the client that the child exited, after all of the output that the client is still due (in pty mode).
+ */
+static inline void usockit_server_send_child_exit(struct usockit_server_upgrade_info* upgrade_info,
+                                                  struct usockit_server_pty_output_info* pty_output_info,
+                                                  int client_fd)
+	                                                  cross_support_attr_always_inline
+	                                                  cross_support_attr_nonnull(1);
+
+/**
+ * Sends a message to the non-blocking socket of a client. Whenever the socket is full, the client gets
+ * `USOCKIT_SERVER_CLIENT_SEND_TIMEOUT_MS` to make room again; if it doesn't, errno is set to ETIMEDOUT.
+ * A message that failed may have been sent in part, so nothing else must be sent to the client after that.
+ */
 cross_support_nodiscard
-static inline enum usockit_server_ret_status usockit_server_setup_threads(const cstr_t* child_program_argv,
-                                                                          int socket_fd)
-	                                                                          cross_support_attr_always_inline
-	                                                                          cross_support_attr_nonnull(1)
-	                                                                          cross_support_attr_warn_unused_result;
+static inline ret_status_t usockit_server_send_message(int client_fd,
+                                                       enum usockit_protocol_message_type type,
+                                                       const void* payload,
+                                                       size_t payload_size)
+	cross_support_attr_warn_unused_result;
 
-cross_support_nodiscard
-static inline enum usockit_server_ret_status usockit_server_setup_socket(const_cstr_t socket_pathname,
-                                                                         const cstr_t* child_program_argv)
-	                                                                         cross_support_attr_always_inline
-	                                                                         cross_support_attr_nonnull_all
-	                                                                         cross_support_attr_warn_unused_result;
+/**
+ * Only enables the limits whose rate isn't 0.
+ */
+static inline void usockit_server_rate_limiter_init(struct usockit_server_rate_limiter* limiter,
+                                                    const struct usockit_server_rate_limit rate_limits[])
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
 
+/**
+ * Gives a client that just connected a full burst of the connection limits and starts its statistics over.
+ */
+static inline void usockit_server_rate_limiter_reset_connection(struct usockit_server_rate_limiter* limiter,
+                                                                const struct usockit_server_rate_limit rate_limits[])
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
 
-enum usockit_server_ret_status usockit_server(
-	const const_cstr_t socket_pathname,
-	#ifndef NDEBUG
-	const size_t child_program_argc,
-	#endif
-	const cstr_t* const child_program_argv
-) {
-	#ifndef NDEBUG
-	// extra `#ifndef NDEBUG` here so that the strlen(3) call is not executed on release builds
-	{
-		assert(socket_pathname != cross_support_nullptr);
-		const size_t socket_pathname_len = strlen(socket_pathname);
-		assert((socket_pathname_len > 0) && (socket_pathname_len <= USOCKIT_SOCKET_PATHNAME_MAX_LENGTH));
+/**
+ * Works out how much may be read from the client right now without going over any of the limits, which is at most
+ * `*size_ptr` bytes, and stores it in `*size_ptr`. With a line limit, that is found out by peeking at what the client
+ * sent into `buffer`, so that nothing that was read ever has to be held back.
+ *
+ * Returns 0 if reading may go ahead, or otherwise how many nanoseconds reading has to be paused, along with the limit
+ * that requires the longest pause in `*limiting_kind_ptr`.
+ */
+cross_support_nodiscard
+static inline uint64_t usockit_server_rate_limiter_allowance(struct usockit_server_rate_limiter* limiter,
+                                                             int client_fd,
+                                                             unsigned char buffer[],
+                                                             size_t* size_ptr,
+                                                             enum usockit_server_rate_limit_kind* limiting_kind_ptr)
+	                                                             cross_support_attr_always_inline
+	                                                             cross_support_attr_nonnull_all
+	                                                             cross_support_attr_warn_unused_result;
+
+/**
+ * Takes the bytes and lines of `data`, which was read within the allowance, out of the buckets.
+ */
+static inline void usockit_server_rate_limiter_take(struct usockit_server_rate_limiter* limiter,
+                                                    const unsigned char data[],
+                                                    size_t size)
+	                                                    cross_support_attr_always_inline
+	                                                    cross_support_attr_nonnull_all;
+
+/**
+ * Pauses reading from the client for `pause_ns` nanoseconds (unless an upgrade or the shutdown gets in the way) and
+ * records it in the statistics.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_wait_result usockit_server_rate_limiter_pause(
+	struct usockit_server_rate_limiter* limiter,
+	enum usockit_server_rate_limit_kind limiting_kind,
+	uint64_t pause_ns,
+	int shutdown_fd,
+	int upgrade_fd
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
 
-		assert(child_program_argc >= 1);
+/**
+ * Prints the statistics of the client that just disconnected (if it was held back at all) or, if `total` is `true`,
+ * of all clients to stderr.
+ */
+static inline void usockit_server_rate_limiter_report(const struct usockit_server_rate_limiter* limiter, bool total)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
 
-		assert(child_program_argv != cross_support_nullptr);
-		assert(!(str_empty(child_program_argv[0])));
-		assert(child_program_argv[child_program_argc] == cross_support_nullptr);
-	}
-	#endif
+/**
+ * Marks the end of the output and wakes up the observers thread, so that it can finish sending the rest of the output
+ * to the observers.
+ */
+static inline void usockit_server_end_pty_output(struct usockit_server_pty_output_info* pty_output_info)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
 
-	const enum usockit_server_ret_status ret_status = usockit_server_check_socket_pathname(socket_pathname);
-	if(ret_status != USOCKIT_SERVER_RET_STATUS_SUCCESS) {
-		return ret_status;
-	}
+/**
+ * Sends as much of the snapshot and the output in the ring to the observer as it takes without blocking.
+ * Must be called with the mutex of the pty output info locked.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_observer_flush_result usockit_server_flush_observer(
+	const struct usockit_server_output_ring* observer_ring,
+	struct usockit_server_observer* observer
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
 
-	return usockit_server_setup_socket(socket_pathname, child_program_argv);
-}
+/**
+ * Accepts a connection on the observer socket and adds it to `observers` (or rejects it if there already are
+ * `USOCKIT_SERVER_OBSERVERS_MAX` of them), along with a snapshot of the screen.
+ */
+static inline void usockit_server_accept_observer(int observer_socket_fd,
+                                                  struct usockit_server_pty_output_info* pty_output_info,
+                                                  struct usockit_server_observer observers[],
+                                                  size_t* observers_count_ptr)
+	                                                  cross_support_attr_always_inline
+	                                                  cross_support_attr_nonnull_all;
+
+/**
+ * Disconnects the observer at `index` and moves the last one into its place.
+ */
+static inline void usockit_server_remove_observer(struct usockit_server_observer observers[],
+                                                  size_t* observers_count_ptr,
+                                                  size_t index)
+	                                                  cross_support_attr_always_inline
+	                                                  cross_support_attr_nonnull_all;
 
+cross_support_nodiscard
+static inline enum usockit_server_ret_status usockit_server_parent(int reporting_pipe_read_fd, pid_t child_pid)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
 
-static inline enum usockit_server_ret_status usockit_server_setup_socket(
-	const const_cstr_t socket_pathname,
-	const cstr_t* const child_program_argv
-) {
-	assert(socket_pathname != cross_support_nullptr);
-	assert(child_program_argv != cross_support_nullptr);
+static inline void usockit_server_signal_child_ready(struct usockit_server_child_ready_info* child_ready_info,
+                                                     const struct usockit_server_options* options)
+	                                                     cross_support_attr_always_inline
+	                                                     cross_support_attr_nonnull_all;
 
-	errno = 0;
-	const int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
-	if(socket_fd == -1) {
-		// TODO: socket(2) error handling
-		perror("socket(2)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
-	}
+/**
+ * Returns `true` once the child is ready, or `false` if starting the child failed.
+ */
+cross_support_nodiscard
+static inline bool usockit_server_wait_for_child_ready(struct usockit_server_child_ready_info* child_ready_info)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
 
+static inline void usockit_server_abort_child_ready(struct usockit_server_child_ready_info* child_ready_info)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
 
-	struct sockaddr_un addr;
+/**
+ * Blocks until the client_connection thread is done with the preloaded input, if there is any.
+ */
+static inline void usockit_server_wait_for_stdin_preload(struct usockit_server_child_ready_info* child_ready_info)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
 
-	zeroset_lvalue(addr);
+static inline void usockit_server_end_stdin_preload(struct usockit_server_child_ready_info* child_ready_info)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
 
-	addr.sun_family = AF_UNIX;
-	strcpy(addr.sun_path, socket_pathname);
+/**
+ * Writes everything up to the end of `preload_fd` into the stdin of the child program and prints how much that was and
+ * how long it took to stderr. The input is spliced straight into the stdin if that is a pipe.
+ */
+static inline void usockit_server_preload_child_stdin(int preload_fd, int child_stdin_fd);
 
-	errno = 0;
-	int ret = bind(socket_fd, (const struct sockaddr*)&addr, sizeof addr);
-	if(ret != 0) {
-		errno_push();
-		close(socket_fd);
-		errno_pop();
+static inline void usockit_server_set_thread_name(const_cstr_t name)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
 
-		// TODO: bind(2) error handling
-		perror("bind(2)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
-	}
+cross_support_nodiscard
+static inline ret_status_t usockit_server_create_cloexec_pipe(int pipe_fds[2])
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
 
+/**
+ * A notifier is either an eventfd (both file descriptors are the same) or a pipe, both non-blocking.
+ * As long as it isn't drained, it stays readable for every thread that polls it once notified.
+ * The shutdown notifier is never drained.
+ */
+cross_support_nodiscard
+static inline ret_status_t usockit_server_create_notifier(int notifier_fds[2])
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
 
-	errno = 0;
-	ret = listen(socket_fd, 1); // we only allow one client connection at a time, so this one extra connection will be
-	                            // used to tell the extra client to fuck off
-	if(ret != 0) {
-		errno_push();
-		unlink(socket_pathname);
-		close(socket_fd);
-		errno_pop();
+static inline void usockit_server_close_notifier(const int notifier_fds[2])
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
 
-		// TODO: listen(2) error handling
-		perror("listen(2)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
-	}
+static inline void usockit_server_notify(int notify_fd)
+	cross_support_attr_always_inline;
 
+static inline void usockit_server_drain_notifier(int notifier_read_fd)
+	cross_support_attr_always_inline;
 
-	const enum usockit_server_ret_status ret_status =
-		usockit_server_setup_threads(
-			child_program_argv,
-			socket_fd
-		);
+/**
+ * Blocks until either `fd` is readable (or hung up), the upgrade notifier got notified or the shutdown notifier got
+ * notified; later ones take precedence. `upgrade_fd` may be -1.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_wait_result usockit_server_wait_readable(int fd, int shutdown_fd, int upgrade_fd)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
 
-	unlink(socket_pathname);
-	close(socket_fd);
+/**
+ * Same as usockit_server_wait_readable(), but gives up after `timeout_ms` milliseconds and returns
+ * `USOCKIT_SERVER_WAIT_RESULT_TIMEOUT` then.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_wait_result usockit_server_wait_readable_timeout(
+	int fd,
+	int shutdown_fd,
+	int upgrade_fd,
+	int timeout_ms
+) cross_support_attr_always_inline
+  cross_support_attr_warn_unused_result;
 
-	return ret_status;
-}
+/**
+ * Sleeps for `timeout_ms` milliseconds, unless the upgrade notifier or the shutdown notifier got notified before that.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_wait_result usockit_server_wait_timeout(int shutdown_fd,
+                                                                         int upgrade_fd,
+                                                                         int timeout_ms)
+	                                                                         cross_support_attr_always_inline
+	                                                                         cross_support_attr_warn_unused_result;
 
-static inline enum usockit_server_ret_status usockit_server_setup_threads(
-	const cstr_t* const child_program_argv,
-	const int socket_fd
-) {
-	assert(child_program_argv != cross_support_nullptr);
+/**
+ * Same as usockit_server_wait_timeout(), but also returns `USOCKIT_SERVER_WAIT_RESULT_READABLE` once the peer of the
+ * socket `fd` closed its end of the connection; whether `fd` is readable doesn't matter. A `timeout_ms` of -1 waits
+ * forever.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_wait_result usockit_server_wait_hangup(int fd,
+                                                                        int shutdown_fd,
+                                                                        int upgrade_fd,
+                                                                        int timeout_ms)
+	                                                                        cross_support_attr_always_inline
+	                                                                        cross_support_attr_warn_unused_result;
 
+cross_support_nodiscard
+static inline uint64_t usockit_server_now_ns(void)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
 
+static inline void usockit_server_block_sigpipe(void)
+	cross_support_attr_always_inline;
 
-	errno = 0;
-	struct usockit_server_child_ready_info* const child_ready_info =
+/**
+ * Returns a null pointer and sets errno on failure.
+ */
+cross_support_nodiscard
+static inline struct usockit_server_upgrade_info* usockit_server_create_upgrade_info(void)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
+
+static inline void usockit_server_destroy_upgrade_info(struct usockit_server_upgrade_info* upgrade_info)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
+
+/**
+ * The observer ring (and its notifier) is only created if `observers` is `true`.
+ * Returns a null pointer and sets errno on failure.
+ */
+cross_support_nodiscard
+static inline struct usockit_server_pty_output_info* usockit_server_create_pty_output_info(bool observers)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Does nothing if `pty_output_info` is a null pointer, just like free(3).
+ */
+static inline void usockit_server_destroy_pty_output_info(struct usockit_server_pty_output_info* pty_output_info)
+	cross_support_attr_always_inline;
+
+/**
+ * `child_up` starts out `true` and there is no standby.
+ * Returns a null pointer and sets errno on failure.
+ */
+cross_support_nodiscard
+static inline struct usockit_server_restart_info* usockit_server_create_restart_info(size_t queue_capacity)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Closes the stdin of the standby, if there is one.
+ * Does nothing if `restart_info` is a null pointer, just like free(3).
+ */
+static inline void usockit_server_destroy_restart_info(struct usockit_server_restart_info* restart_info)
+	cross_support_attr_always_inline;
+
+/**
+ * None of the `count` workers is started yet.
+ * Returns a null pointer and sets errno on failure.
+ */
+cross_support_nodiscard
+static inline struct usockit_server_worker_pool* usockit_server_create_worker_pool(size_t count)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Closes the stdins of the workers that were started.
+ * Does nothing if `worker_pool` is a null pointer, just like free(3).
+ */
+static inline void usockit_server_destroy_worker_pool(struct usockit_server_worker_pool* worker_pool)
+	cross_support_attr_always_inline;
+
+/**
+ * Returns a null pointer and sets errno on failure.
+ */
+cross_support_nodiscard
+static inline struct usockit_server_wait_queue* usockit_server_create_wait_queue(
+	size_t capacity,
+	unsigned long timeout_ms
+) cross_support_attr_always_inline
+  cross_support_attr_warn_unused_result;
+
+/**
+ * Closes the connections that are still waiting.
+ * Does nothing if `wait_queue` is a null pointer, just like free(3).
+ */
+static inline void usockit_server_destroy_wait_queue(struct usockit_server_wait_queue* wait_queue)
+	cross_support_attr_always_inline;
+
+/**
+ * Hands the client over to the client_connection thread; the accept thread (or the main thread while the other
+ * threads are parked) must have occupied the slot for it. If that fails, the client is closed and the slot is freed.
+ */
+static inline void usockit_server_hand_over_client(
+	struct usockit_server_thread_routine_client_connection_client_ready_info* client_ready_info,
+	int client_fd
+) cross_support_attr_nonnull_all;
+
+/**
+ * Tells the client that the server is occupied and closes the connection.
+ */
+static inline void usockit_server_reject_client(int client_fd);
+
+/**
+ * Frees the client slot and lets the accept thread know, in case connections wait for it.
+ */
+static inline void usockit_server_free_client_slot(
+	struct usockit_server_thread_routine_client_connection_client_ready_info* client_ready_info
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all;
+
+/**
+ * Puts the client at the end of the queue and tells it its position. Returns `false` if the queue is full.
+ */
+cross_support_nodiscard
+static inline bool usockit_server_enqueue_waiting_client(struct usockit_server_wait_queue* wait_queue, int client_fd)
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Removes the connection that waited the longest from the queue, which must not be empty, and records how long it
+ * waited.
+ */
+cross_support_nodiscard
+static inline int usockit_server_dequeue_waiting_client(struct usockit_server_wait_queue* wait_queue, uint64_t now_ns)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Drops the connections that the clients closed, hands the ones that waited the longest over while the slot is free
+ * and rejects the ones that waited for too long.
+ */
+static inline void usockit_server_serve_wait_queue(
+	struct usockit_server_wait_queue* wait_queue,
+	struct usockit_server_thread_routine_client_connection_client_ready_info* client_ready_info
+) cross_support_attr_nonnull_all;
+
+/**
+ * Same as usockit_server_wait_readable() for the listening socket `socket_fd`, but also returns
+ * `USOCKIT_SERVER_WAIT_RESULT_TIMEOUT` as soon as the queue has to be served again; because the slot was freed, a
+ * waiting client closed the connection or the connection that waited the longest waited for too long.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_wait_result usockit_server_wait_accept(int socket_fd,
+                                                                        int shutdown_fd,
+                                                                        int upgrade_fd,
+                                                                        struct usockit_server_wait_queue* wait_queue)
+	                                                                        cross_support_attr_nonnull(4)
+	                                                                        cross_support_attr_warn_unused_result;
+
+/**
+ * Empties the queue, either rejecting or just closing the connections. If not rejecting and `child_exit_payload` is not
+ * a null pointer, the connections are told how the child program exited before they are closed.
+ */
+static inline void usockit_server_clear_wait_queue(struct usockit_server_wait_queue* wait_queue,
+                                                   bool reject,
+                                                   const unsigned char* child_exit_payload)
+	cross_support_attr_nonnull(1);
+
+/**
+ * Prints how long connections waited to stderr, if any did.
+ */
+static inline void usockit_server_wait_queue_report(const struct usockit_server_wait_queue* wait_queue)
+	cross_support_attr_nonnull_all;
+
+/**
+ * Writes input from a client into the stdin of the child program, or, in supervisor mode while the child program is
+ * down, into the queue. If the child program dies during the write, the part that wasn't written goes into the queue.
+ * In supervisor mode, `size` must not be more than the free space of the queue while the child program is down, or
+ * more than the capacity of the queue while it is up.
+ */
+cross_support_nodiscard
+static inline ret_status_t usockit_server_write_child_stdin(const int* child_stdin_fd_ptr,
+                                                            struct usockit_server_restart_info* restart_info,
+                                                            struct usockit_server_delivery* delivery,
+                                                            const unsigned char data[],
+                                                            size_t size)
+	                                                            cross_support_attr_always_inline
+	                                                            cross_support_attr_nonnull(1, 3, 4)
+	                                                            cross_support_attr_warn_unused_result;
+
+/**
+ * Writes input from a client into the stdins of the workers, line by line: a line goes to the least loaded worker as a
+ * whole, even if it arrives in pieces. If a worker dies during the write, the rest of its line is lost.
+ *
+ * Fails with errno set to EPIPE once all workers are gone.
+ */
+cross_support_nodiscard
+static inline ret_status_t usockit_server_write_workers_stdin(struct usockit_server_worker_pool* worker_pool,
+                                                              struct usockit_server_delivery* delivery,
+                                                              const unsigned char data[],
+                                                              size_t size)
+	                                                              cross_support_attr_always_inline
+	                                                              cross_support_attr_nonnull(1, 2, 3)
+	                                                              cross_support_attr_warn_unused_result;
+
+static inline void usockit_server_add_delivered(struct usockit_server_delivery* delivery, size_t size)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
+
+/**
+ * Counts the input of the client that went into the queue as delivered once a restarted child program took all of it,
+ * or as lost if the queue was flushed in the meantime.
+ * The mutex of `restart_info` must be held.
+ */
+static inline void usockit_server_settle_queued_delivery(struct usockit_server_delivery* delivery,
+                                                         const struct usockit_server_restart_info* restart_info)
+	                                                         cross_support_attr_always_inline
+	                                                         cross_support_attr_nonnull_all;
+
+/**
+ * Same as `usockit_server_settle_queued_delivery`, but takes the mutex itself. Does nothing if not in supervisor mode.
+ */
+static inline void usockit_server_settle_client_delivery(struct usockit_server_delivery* delivery,
+                                                         struct usockit_server_restart_info* restart_info)
+	                                                         cross_support_attr_always_inline
+	                                                         cross_support_attr_nonnull(1);
+
+/**
+ * Waits until the input of the client that is still queued was taken by a restarted child program or was flushed,
+ * so that the final acknowledgement covers it. Returns `USOCKIT_SERVER_WAIT_RESULT_READABLE` once it was.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_wait_result usockit_server_wait_queued_delivery(
+	const struct usockit_server_thread_routine_client_connection_arg* arg,
+	struct usockit_server_delivery* delivery
+) cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+/**
+ * Keeps a client that shut down its sending side connected for up to `arg->linger_ms` milliseconds, so that it still
+ * receives output and the exit status of the child program. Returns `USOCKIT_SERVER_WAIT_RESULT_READABLE` once the
+ * client closed its end and `USOCKIT_SERVER_WAIT_RESULT_TIMEOUT` once the time is up.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_wait_result usockit_server_wait_client_linger(
+	const struct usockit_server_thread_routine_client_connection_arg* arg,
+	int client_fd
+) cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+/**
+ * Waits for the client to send something while keeping an eye on how long it has been quiet: sends it heartbeats every
+ * `arg->heartbeat_interval_ms` milliseconds and returns `USOCKIT_SERVER_WAIT_RESULT_TIMEOUT` once it should be
+ * disconnected, with the reason in `liveness->eviction`. Only used if idle timeouts or heartbeats are enabled.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_wait_result usockit_server_wait_client_input(
+	const struct usockit_server_thread_routine_client_connection_arg* arg,
+	int client_fd,
+	struct usockit_server_client_liveness* liveness
+) cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+/**
+ * Whether or not the client left some of what it was sent unread. Always false if that can't be told.
+ */
+cross_support_nodiscard
+static inline bool usockit_server_client_has_unread(int client_fd)
+	cross_support_attr_always_inline
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Tells the client why it is disconnected and notes it on stderr.
+ */
+static inline void usockit_server_report_eviction(
+	const struct usockit_server_thread_routine_client_connection_arg* arg,
+	int client_fd,
+	enum usockit_server_eviction eviction
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all;
+
+/**
+ * Tells the client how much of its input was delivered so far.
+ */
+cross_support_nodiscard
+static inline ret_status_t usockit_server_send_ack(struct usockit_server_delivery* delivery,
+                                                   struct usockit_server_pty_output_info* pty_output_info,
+                                                   int client_fd)
+	                                                   cross_support_attr_always_inline
+	                                                   cross_support_attr_nonnull(1)
+	                                                   cross_support_attr_warn_unused_result;
+
+/**
+ * Grants the client credit for `credit_window` bytes past what was read from it so far.
+ */
+cross_support_nodiscard
+static inline ret_status_t usockit_server_grant_credit(struct usockit_server_delivery* delivery,
+                                                       struct usockit_server_pty_output_info* pty_output_info,
+                                                       int client_fd,
+                                                       size_t credit_window)
+	                                                       cross_support_attr_always_inline
+	                                                       cross_support_attr_nonnull(1)
+	                                                       cross_support_attr_warn_unused_result;
+
+/**
+ * Sends a message with a byte count as the payload to the client that the client_connection thread serves.
+ * A client that doesn't take the message in time counts as gone, the same as with output; the connection must be
+ * closed then. A client that closed its end already is simply not sent anything.
+ */
+cross_support_nodiscard
+static inline ret_status_t usockit_server_send_size_message(struct usockit_server_pty_output_info* pty_output_info,
+                                                            int client_fd,
+                                                            enum usockit_protocol_message_type type,
+                                                            uint64_t size)
+	                                                            cross_support_attr_always_inline
+	                                                            cross_support_attr_warn_unused_result;
+
+/**
+ * Sends a message to the client that the client_connection thread serves, without interleaving it with the output in
+ * pty mode. Does nothing if the client was dropped for not keeping up with the output.
+ */
+cross_support_nodiscard
+static inline ret_status_t usockit_server_send_client_message(
+	struct usockit_server_pty_output_info* pty_output_info,
+	int client_fd,
+	enum usockit_protocol_message_type type,
+	const void* payload,
+	size_t payload_size
+) cross_support_attr_always_inline
+  cross_support_attr_warn_unused_result;
+
+/**
+ * Returns the index of the worker whose stdin pipe has the least data in it that the worker didn't read yet, or
+ * `worker_pool->count` if all workers are gone.
+ * Without a way to tell how full a pipe is, the workers simply take turns.
+ */
+cross_support_nodiscard
+static inline size_t usockit_server_pick_worker(struct usockit_server_worker_pool* worker_pool)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Writes as much of `data` to `fd` as it takes, stopping at the first error, and returns how much was written.
+ * errno is set if that is less than `size`.
+ */
+cross_support_nodiscard
+static inline size_t usockit_server_write_until_error(int fd, const unsigned char data[], size_t size)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull(2)
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Called by the child_wait thread in supervisor mode. Keeps the child program (and the standby) running, starting them
+ * again with backoff whenever they fail, until the child program exits with status 0.
+ *
+ * Returns `false` if it gave up on waiting for the child program instead, in which case `*status_ptr` is not set.
+ */
+cross_support_nodiscard
+static inline bool usockit_server_supervise_child(const struct usockit_server_thread_routine_child_wait_arg* arg,
+                                                  int* status_ptr)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Called by the child_wait thread in worker mode. Waits until all of the workers exited and stores the status of the
+ * first one that failed in `*status_ptr`, or the status of the last one if none of them failed.
+ *
+ * Returns `false` if it gave up on waiting for the workers instead, in which case `*status_ptr` is not set.
+ */
+cross_support_nodiscard
+static inline bool usockit_server_wait_for_workers(const struct usockit_server_worker_pool* worker_pool,
+                                                   int* status_ptr)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Lets the standby take over from the child program that failed if there is one, otherwise schedules the restart.
+ */
+static inline void usockit_server_handle_child_failure(const struct usockit_server_thread_routine_child_wait_arg* arg,
+                                                       struct usockit_server_supervised_child* child,
+                                                       struct usockit_server_supervised_child* standby,
+                                                       int status)
+	                                                       cross_support_attr_always_inline
+	                                                       cross_support_attr_nonnull_all;
+
+static inline void usockit_server_handle_standby_failure(
+	const struct usockit_server_thread_routine_child_wait_arg* arg,
+	struct usockit_server_supervised_child* standby,
+	int status
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all;
+
+/**
+ * Starts the child program and the standby if they are due. The standby waits until the child program is running.
+ */
+static inline void usockit_server_start_due_children(const struct usockit_server_thread_routine_child_wait_arg* arg,
+                                                     struct usockit_server_supervised_child* child,
+                                                     struct usockit_server_supervised_child* standby)
+	                                                     cross_support_attr_always_inline
+	                                                     cross_support_attr_nonnull_all;
+
+/**
+ * Makes `child_pid` the child program that input goes to, starting with the queued input.
+ * The mutex of the restart info must be held.
+ */
+static inline void usockit_server_activate_child(const struct usockit_server_thread_routine_child_wait_arg* arg,
+                                                 pid_t child_pid,
+                                                 int child_stdin_fd)
+	                                                 cross_support_attr_always_inline
+	                                                 cross_support_attr_nonnull_all;
+
+cross_support_nodiscard
+static inline unsigned long usockit_server_double_backoff_ms(
+	unsigned long backoff_ms,
+	const struct usockit_server_restart_options* restart_options
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+/**
+ * Schedules the start of `supervised_child` after its backoff and doubles the backoff for the next time.
+ */
+static inline void usockit_server_schedule_child_start(struct usockit_server_supervised_child* supervised_child,
+                                                       const struct usockit_server_restart_options* restart_options,
+                                                       uint64_t now_ns)
+	                                                       cross_support_attr_always_inline
+	                                                       cross_support_attr_nonnull_all;
+
+/**
+ * Prints that `name` exited or was killed and what happens now, e.g.: "restarting it in 100 ms".
+ */
+static inline void usockit_server_print_child_failure(const_cstr_t name, int status, const_cstr_t consequence)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
+
+static void usockit_server_child_exit_signal_handler(int signum);
+
+cross_support_nodiscard
+static inline ret_status_t usockit_server_install_child_exit_signal_handler(int notify_fd,
+                                                                            struct sigaction* old_action)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+static inline void usockit_server_restore_child_exit_signal_handler(const struct sigaction* old_action)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
+
+static void usockit_server_upgrade_signal_handler(int signum);
+
+/**
+ * `notify_fd` may be -1 if the server can't be upgraded; the signal is then only reported on stderr, so that it doesn't
+ * kill the server instead.
+ */
+cross_support_nodiscard
+static inline ret_status_t usockit_server_install_upgrade_signal_handler(int notify_fd, struct sigaction* old_action)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+static inline void usockit_server_restore_upgrade_signal_handler(const struct sigaction* old_action)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
+
+/**
+ * Called by the accept and client_connection threads once they noticed an upgrade request.
+ * Blocks until the upgrade is called off; if it isn't, the exec(3) of the main thread ends this thread along with it.
+ */
+static inline void usockit_server_park_for_upgrade(struct usockit_server_upgrade_info* upgrade_info)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_release_parked_threads(struct usockit_server_upgrade_info* upgrade_info)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
+
+/**
+ * Waits until the accept and client_connection threads are parked and then re-executes the server with everything
+ * that is needed to keep serving the same child. (see `struct usockit_server_resume_state`)
+ *
+ * Only returns if the upgrade was called off (the child died in the meantime, is being restarted in supervisor mode or
+ * exec(3) failed), after the parked threads were released again.
+ */
+static inline void usockit_server_upgrade(
+	struct usockit_server_upgrade_info* upgrade_info,
+	struct usockit_server_thread_routine_client_connection_client_ready_info* client_ready_info,
+	const_cstr_t owned_socket_pathname,
+	const cstr_t* child_program_argv,
+	int socket_fd,
+	int observer_socket_fd,
+	int control_socket_fd,
+	const pid_t* child_pid_ptr,
+	const int* child_stdin_fd_ptr,
+	struct usockit_server_restart_info* restart_info,
+	const struct usockit_server_options* options
+) cross_support_attr_always_inline
+	  cross_support_attr_nonnull(1, 2, 4, 8, 9, 11);
+
+/**
+ * Only returns on failure.
+ */
+static inline void usockit_server_exec_upgrade(
+	const_cstr_t owned_socket_pathname,
+	const cstr_t* child_program_argv,
+	int socket_fd,
+	int observer_socket_fd,
+	int control_socket_fd,
+	pid_t child_pid,
+	int child_stdin_fd,
+	pid_t standby_pid,
+	int standby_stdin_fd,
+	int client_fd,
+	long long client_delivered_size,
+	unsigned long long client_consumed_size,
+	const struct usockit_server_options* options
+) cross_support_attr_always_inline
+	  cross_support_attr_nonnull(2, 13);
+
+/**
+ * Prints the resident set size, the virtual memory size and the number of threads of this process to stderr.
+ */
+static inline void usockit_server_report_memory(void)
+	cross_support_attr_always_inline;
+
+static void* usockit_server_thread_routine_child_wait(void* arg) cross_support_attr_nonnull_all;
+
+static void  usockit_server_thread_routine_client_connection_release_client(
+	struct usockit_server_thread_routine_client_connection_client_ready_info* client_ready_info,
+	struct usockit_server_pty_output_info* pty_output_info
+) cross_support_attr_nonnull(1);
+static void* usockit_server_thread_routine_client_connection(void* arg) cross_support_attr_nonnull_all;
+
+static void* usockit_server_thread_routine_accept(void* arg) cross_support_attr_nonnull_all;
+
+static void* usockit_server_thread_routine_pty_output(void* arg) cross_support_attr_nonnull_all;
+
+static void* usockit_server_thread_routine_observers(void* arg) cross_support_attr_nonnull_all;
+
+static void* usockit_server_thread_routine_control(void* arg) cross_support_attr_nonnull_all;
+
+/**
+ * Reads a single command from a control client, runs it and sends the reply. A client that takes longer than
+ * `USOCKIT_SERVER_CONTROL_TIMEOUT_MS` for either is given up on.
+ */
+static inline void usockit_server_serve_control_client(
+	const struct usockit_server_thread_routine_control_arg* arg,
+	int control_client_fd
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull(1);
+
+/**
+ * Writes the reply line, newline character included, into `reply`.
+ */
+static inline void usockit_server_run_control_command(
+	const struct usockit_server_thread_routine_control_arg* arg,
+	const_cstr_t command,
+	char reply[USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE]
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all;
+
+static inline void usockit_server_control_status(
+	const struct usockit_server_thread_routine_control_arg* arg,
+	char reply[USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE]
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all;
+
+/**
+ * Sends `signum` to the child program, or to all of the workers in worker mode.
+ */
+static inline void usockit_server_control_signal(
+	const struct usockit_server_thread_routine_control_arg* arg,
+	int signum,
+	char reply[USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE]
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all;
+
+static inline void usockit_server_control_flush(
+	const struct usockit_server_thread_routine_control_arg* arg,
+	char reply[USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE]
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all;
+
+/**
+ * Sets the window size of the pty to `rows` and `cols` (which makes the kernel send SIGWINCH to the child program) and
+ * resizes the screen along with it, so that snapshots are drawn for the new size.
+ */
+static inline void usockit_server_control_resize(
+	const struct usockit_server_thread_routine_control_arg* arg,
+	unsigned short rows,
+	unsigned short cols,
+	char reply[USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE]
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all;
+
+/**
+ * Parses a window size of the form "<rows> <cols>", neither of which may be 0.
+ */
+cross_support_nodiscard
+static inline bool usockit_server_parse_window_size(const_cstr_t str,
+                                                    unsigned short* rows_ptr,
+                                                    unsigned short* cols_ptr)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Parses a signal given by its name, with or without the "SIG" prefix, or by its number.
+ *
+ * Returns 0 if `str` is neither.
+ */
+cross_support_nodiscard
+static inline int usockit_server_parse_signal(const_cstr_t str)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all
+	cross_support_attr_warn_unused_result;
+
+/**
+ * Starts the child program with its stdin connected to a new pipe (or pty, if `pty` is `true`) and waits until it
+ * either exec'd or failed to.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_ret_status usockit_server_start_child(const cstr_t* child_program_argv,
+                                                                        int socket_fd,
+                                                                        bool pty,
+                                                                        pid_t* child_pid_ptr,
+                                                                        int* child_stdin_fd_ptr)
+	                                                                        cross_support_attr_always_inline
+	                                                                        cross_support_attr_nonnull(1, 4, 5)
+	                                                                        cross_support_attr_warn_unused_result;
+
+/**
+ * Starts all of the workers the same way as the child program. If one of them fails to start, the stdins of the ones
+ * that were already started are closed again.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_ret_status usockit_server_start_workers(
+	const cstr_t* child_program_argv,
+	int socket_fd,
+	struct usockit_server_worker_pool* worker_pool
+) cross_support_attr_always_inline
+  cross_support_attr_nonnull_all
+  cross_support_attr_warn_unused_result;
+
+/**
+ * In worker mode, the workers are started instead of the child program and the child's PID and stdin are set to -1.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_ret_status usockit_server_setup_child(
+	const cstr_t* child_program_argv,
+	int socket_fd,
+	struct usockit_server_child_ready_info* child_read_info,
+	pid_t* child_wait_thread_routine_arg_child_pid_ptr,
+	int* client_connection_thread_routine_arg_child_stdin_fd_ptr,
+	struct usockit_server_worker_pool* worker_pool,
+	const struct usockit_server_options* options
+) cross_support_attr_always_inline
+	  cross_support_attr_nonnull(1, 3, 4, 5, 7)
+	  cross_support_attr_warn_unused_result;
+
+/**
+ * `owned_socket_pathname` is the pathname of the socket file that this server is responsible for removing, or a null
+ * pointer.
+ * `observer_socket_fd` and `control_socket_fd` are -1 if there is no observer socket or control socket respectively.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_ret_status usockit_server_setup_threads(
+	const_cstr_t owned_socket_pathname,
+	const cstr_t* child_program_argv,
+	int socket_fd,
+	int observer_socket_fd,
+	int control_socket_fd,
+	const struct usockit_server_options* options
+) cross_support_attr_always_inline
+	  cross_support_attr_nonnull(2, 6)
+	  cross_support_attr_warn_unused_result;
+
+/**
+ * Creates the control socket (or takes the one that our previous incarnation created, when resuming), if there is
+ * supposed to be one, and removes it again afterwards.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_ret_status usockit_server_setup_control_socket(
+	const_cstr_t owned_socket_pathname,
+	const cstr_t* child_program_argv,
+	int socket_fd,
+	int observer_socket_fd,
+	const struct usockit_server_options* options
+) cross_support_attr_always_inline
+	  cross_support_attr_nonnull(2, 5)
+	  cross_support_attr_warn_unused_result;
+
+/**
+ * Creates the observer socket (or takes the one that our previous incarnation created, when resuming), if there is
+ * supposed to be one, and removes it again afterwards.
+ */
+cross_support_nodiscard
+static inline enum usockit_server_ret_status usockit_server_setup_observer_socket(
+	const_cstr_t owned_socket_pathname,
+	const cstr_t* child_program_argv,
+	int socket_fd,
+	const struct usockit_server_options* options
+) cross_support_attr_always_inline
+	  cross_support_attr_nonnull(2, 4)
+	  cross_support_attr_warn_unused_result;
+
+cross_support_nodiscard
+static inline enum usockit_server_ret_status usockit_server_setup_inherited_socket(
+	int listen_fd,
+	const_cstr_t owned_socket_pathname,
+	const cstr_t* child_program_argv,
+	const struct usockit_server_options* options
+) cross_support_attr_always_inline
+	  cross_support_attr_nonnull(3, 4)
+	  cross_support_attr_warn_unused_result;
+
+cross_support_nodiscard
+static inline enum usockit_server_ret_status usockit_server_setup_socket(const_cstr_t socket_pathname,
+                                                                         const cstr_t* child_program_argv,
+                                                                         const struct usockit_server_options* options)
+	                                                                         cross_support_attr_always_inline
+	                                                                         cross_support_attr_nonnull_all
+	                                                                         cross_support_attr_warn_unused_result;
+
+
+enum usockit_server_ret_status usockit_server(
+	const const_cstr_t socket_pathname,
+	#ifndef NDEBUG
+	const size_t child_program_argc,
+	#endif
+	const cstr_t* const child_program_argv,
+	const struct usockit_server_options* const options
+) {
+	#ifndef NDEBUG
+	// extra `#ifndef NDEBUG` here so that the strlen(3) call is not executed on release builds
+	{
+		assert(options != cross_support_nullptr);
+
+		if(options->listen_fd == -1) {
+			assert(socket_pathname != cross_support_nullptr);
+			const size_t socket_pathname_len = strlen(socket_pathname);
+			assert((socket_pathname_len > 0) && (socket_pathname_len <= USOCKIT_SOCKET_PATHNAME_MAX_LENGTH));
+		} else {
+			assert(options->listen_fd >= 0);
+		}
+
+		if(options->resume != cross_support_nullptr) {
+			assert(options->listen_fd != -1);
+			assert(options->resume->child_stdin_fd >= 0);
+		}
+
+		if(options->observer_socket_pathname != cross_support_nullptr) {
+			assert(options->pty);
+			const size_t observer_socket_pathname_len = strlen(options->observer_socket_pathname);
+			assert((observer_socket_pathname_len > 0) &&
+			       (observer_socket_pathname_len <= USOCKIT_SOCKET_PATHNAME_MAX_LENGTH));
+		}
+
+		if(options->control_socket_pathname != cross_support_nullptr) {
+			const size_t control_socket_pathname_len = strlen(options->control_socket_pathname);
+			assert((control_socket_pathname_len > 0) &&
+			       (control_socket_pathname_len <= USOCKIT_SOCKET_PATHNAME_MAX_LENGTH));
+		}
+
+		if(options->workers_count > 1) {
+			assert(!(options->pty));
+			assert(options->restart == cross_support_nullptr);
+			assert(options->resume == cross_support_nullptr);
+			assert(options->executable_pathname == cross_support_nullptr);
+		}
+
+		assert(child_program_argc >= 1);
+
+		assert(child_program_argv != cross_support_nullptr);
+		assert(!(str_empty(child_program_argv[0])));
+		assert(child_program_argv[child_program_argc] == cross_support_nullptr);
+	}
+	#endif
+
+	#if !(USOCKIT_SERVER_PTY_SUPPORT)
+		if(options->pty) {
+			return USOCKIT_SERVER_RET_STATUS_PTY_UNSUPPORTED;
+		}
+	#endif
+
+	if((options->observer_socket_pathname != cross_support_nullptr) &&
+	   ((options->resume == cross_support_nullptr) || (options->resume->observer_listen_fd == -1))) {
+
+		const enum usockit_server_ret_status ret_status =
+			usockit_server_check_socket_pathname(options->observer_socket_pathname);
+
+		if(ret_status != USOCKIT_SERVER_RET_STATUS_SUCCESS) {
+			return ret_status;
+		}
+	}
+
+	if((options->control_socket_pathname != cross_support_nullptr) &&
+	   ((options->resume == cross_support_nullptr) || (options->resume->control_listen_fd == -1))) {
+
+		const enum usockit_server_ret_status ret_status =
+			usockit_server_check_socket_pathname(options->control_socket_pathname);
+
+		if(ret_status != USOCKIT_SERVER_RET_STATUS_SUCCESS) {
+			return ret_status;
+		}
+	}
+
+	if(options->listen_fd != -1) {
+		// when resuming after an upgrade, the socket was created by our previous incarnation, so it's ours to remove
+		const const_cstr_t owned_socket_pathname =
+			((options->resume != cross_support_nullptr) ? socket_pathname : cross_support_nullptr);
+
+		return usockit_server_setup_inherited_socket(
+			options->listen_fd,
+			owned_socket_pathname,
+			child_program_argv,
+			options
+		);
+	}
+
+	const enum usockit_server_ret_status ret_status = usockit_server_check_socket_pathname(socket_pathname);
+	if(ret_status != USOCKIT_SERVER_RET_STATUS_SUCCESS) {
+		return ret_status;
+	}
+
+	return usockit_server_setup_socket(socket_pathname, child_program_argv, options);
+}
+
+
+static inline enum usockit_server_ret_status usockit_server_setup_inherited_socket(
+	const int listen_fd,
+	const const_cstr_t owned_socket_pathname,
+	const cstr_t* const child_program_argv,
+	const struct usockit_server_options* const options
+) {
+	assert(child_program_argv != cross_support_nullptr);
+	assert(options != cross_support_nullptr);
+
+	int accepting_connections = 0;
+	socklen_t accepting_connections_size = sizeof accepting_connections;
+
+	errno = 0;
+	int ret = getsockopt(listen_fd, SOL_SOCKET, SO_ACCEPTCONN, &accepting_connections, &accepting_connections_size);
+	if((ret != 0) && (errno != ENOTSOCK) && (errno != EBADF)) {
+		// TODO: getsockopt(2) error handling
+		perror("getsockopt(2)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	if((ret != 0) || !accepting_connections) {
+		return USOCKIT_SERVER_RET_STATUS_NOT_A_LISTENING_SOCKET;
+	}
+
+	// the socket is not meant for the child
+	errno = 0;
+	ret = fcntl(listen_fd, F_SETFD, FD_CLOEXEC);
+	if(ret != 0) {
+		// TODO: fcntl(2) error handling
+		perror("fcntl(2)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	const enum usockit_server_ret_status ret_status =
+		usockit_server_setup_observer_socket(
+			owned_socket_pathname,
+			child_program_argv,
+			listen_fd,
+			options
+		);
+
+	// unlike in usockit_server_setup_socket(), the socket is neither closed nor unlinked afterwards; it belongs to
+	// whoever passed it down to us (unless that was our previous incarnation)
+	if(owned_socket_pathname != cross_support_nullptr) {
+		unlink(owned_socket_pathname);
+	}
+
+	return ret_status;
+}
+
+static inline enum usockit_server_ret_status usockit_server_setup_socket(
+	const const_cstr_t socket_pathname,
+	const cstr_t* const child_program_argv,
+	const struct usockit_server_options* const options
+) {
+	assert(socket_pathname != cross_support_nullptr);
+	assert(child_program_argv != cross_support_nullptr);
+	assert(options != cross_support_nullptr);
+
+	errno = 0;
+	const int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(socket_fd == -1) {
+		// TODO: socket(2) error handling
+		perror("socket(2)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+
+	struct sockaddr_un addr;
+
+	zeroset_lvalue(addr);
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_pathname);
+
+	errno = 0;
+	int ret = bind(socket_fd, (const struct sockaddr*)&addr, sizeof addr);
+	if(ret != 0) {
+		errno_push();
+		close(socket_fd);
+		errno_pop();
+
+		// TODO: bind(2) error handling
+		perror("bind(2)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+
+	errno = 0;
+	ret = listen(socket_fd, 1); // we only allow one client connection at a time, so this one extra connection will be
+	                            // used to tell the extra client to fuck off
+	if(ret != 0) {
+		errno_push();
+		unlink(socket_pathname);
+		close(socket_fd);
+		errno_pop();
+
+		// TODO: listen(2) error handling
+		perror("listen(2)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+
+	const enum usockit_server_ret_status ret_status =
+		usockit_server_setup_observer_socket(
+			socket_pathname,
+			child_program_argv,
+			socket_fd,
+			options
+		);
+
+	unlink(socket_pathname);
+	close(socket_fd);
+
+	return ret_status;
+}
+
+static inline enum usockit_server_ret_status usockit_server_setup_observer_socket(
+	const const_cstr_t owned_socket_pathname,
+	const cstr_t* const child_program_argv,
+	const int socket_fd,
+	const struct usockit_server_options* const options
+) {
+	assert(child_program_argv != cross_support_nullptr);
+	assert(options != cross_support_nullptr);
+
+	const const_cstr_t observer_socket_pathname = options->observer_socket_pathname;
+
+	if(observer_socket_pathname == cross_support_nullptr) {
+		return usockit_server_setup_control_socket(owned_socket_pathname, child_program_argv, socket_fd, -1, options);
+	}
+
+	int observer_socket_fd;
+
+	if((options->resume != cross_support_nullptr) && (options->resume->observer_listen_fd != -1)) {
+		observer_socket_fd = options->resume->observer_listen_fd;
+	} else {
+		errno = 0;
+		observer_socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(observer_socket_fd == -1) {
+			// TODO: socket(2) error handling
+			perror("socket(2)");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+
+
+		struct sockaddr_un addr;
+
+		zeroset_lvalue(addr);
+
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, observer_socket_pathname);
+
+		errno = 0;
+		int ret = bind(observer_socket_fd, (const struct sockaddr*)&addr, sizeof addr);
+		if(ret != 0) {
+			errno_push();
+			close(observer_socket_fd);
+			errno_pop();
+
+			// TODO: bind(2) error handling
+			perror("bind(2)");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+
+
+		errno = 0;
+		ret = listen(observer_socket_fd, USOCKIT_SERVER_OBSERVERS_MAX);
+		if(ret != 0) {
+			errno_push();
+			unlink(observer_socket_pathname);
+			close(observer_socket_fd);
+			errno_pop();
+
+			// TODO: listen(2) error handling
+			perror("listen(2)");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+	}
+
+	// the socket is not meant for the child
+	errno = 0;
+	const int ret = fcntl(observer_socket_fd, F_SETFD, FD_CLOEXEC);
+	if(ret != 0) {
+		errno_push();
+		unlink(observer_socket_pathname);
+		close(observer_socket_fd);
+		errno_pop();
+
+		// TODO: fcntl(2) error handling
+		perror("fcntl(2)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+
+	const enum usockit_server_ret_status ret_status =
+		usockit_server_setup_control_socket(
+			owned_socket_pathname,
+			child_program_argv,
+			socket_fd,
+			observer_socket_fd,
+			options
+		);
+
+	unlink(observer_socket_pathname);
+	close(observer_socket_fd);
+
+	return ret_status;
+}
+
+static inline enum usockit_server_ret_status usockit_server_setup_control_socket(
+	const const_cstr_t owned_socket_pathname,
+	const cstr_t* const child_program_argv,
+	const int socket_fd,
+	const int observer_socket_fd,
+	const struct usockit_server_options* const options
+) {
+	assert(child_program_argv != cross_support_nullptr);
+	assert(options != cross_support_nullptr);
+
+	const const_cstr_t control_socket_pathname = options->control_socket_pathname;
+
+	if(control_socket_pathname == cross_support_nullptr) {
+		return usockit_server_setup_threads(
+			owned_socket_pathname,
+			child_program_argv,
+			socket_fd,
+			observer_socket_fd,
+			-1,
+			options
+		);
+	}
+
+	int control_socket_fd;
+
+	if((options->resume != cross_support_nullptr) && (options->resume->control_listen_fd != -1)) {
+		control_socket_fd = options->resume->control_listen_fd;
+	} else {
+		errno = 0;
+		control_socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(control_socket_fd == -1) {
+			// TODO: socket(2) error handling
+			perror("socket(2)");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+
+
+		struct sockaddr_un addr;
+
+		zeroset_lvalue(addr);
+
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, control_socket_pathname);
+
+		errno = 0;
+		int ret = bind(control_socket_fd, (const struct sockaddr*)&addr, sizeof addr);
+		if(ret != 0) {
+			errno_push();
+			close(control_socket_fd);
+			errno_pop();
+
+			// TODO: bind(2) error handling
+			perror("bind(2)");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+
+
+		errno = 0;
+		ret = listen(control_socket_fd, USOCKIT_SERVER_CONTROL_BACKLOG);
+		if(ret != 0) {
+			errno_push();
+			unlink(control_socket_pathname);
+			close(control_socket_fd);
+			errno_pop();
+
+			// TODO: listen(2) error handling
+			perror("listen(2)");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+	}
+
+	// the socket is not meant for the child
+	errno = 0;
+	const int ret = fcntl(control_socket_fd, F_SETFD, FD_CLOEXEC);
+	if(ret != 0) {
+		errno_push();
+		unlink(control_socket_pathname);
+		close(control_socket_fd);
+		errno_pop();
+
+		// TODO: fcntl(2) error handling
+		perror("fcntl(2)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+
+	const enum usockit_server_ret_status ret_status =
+		usockit_server_setup_threads(
+			owned_socket_pathname,
+			child_program_argv,
+			socket_fd,
+			observer_socket_fd,
+			control_socket_fd,
+			options
+		);
+
+	unlink(control_socket_pathname);
+	close(control_socket_fd);
+
+	return ret_status;
+}
+
+static inline enum usockit_server_ret_status usockit_server_setup_threads(
+	const const_cstr_t owned_socket_pathname,
+	const cstr_t* const child_program_argv,
+	const int socket_fd,
+	const int observer_socket_fd,
+	const int control_socket_fd,
+	const struct usockit_server_options* const options
+) {
+	assert(child_program_argv != cross_support_nullptr);
+	assert(options != cross_support_nullptr);
+
+
+
+	errno = 0;
+	struct usockit_server_child_ready_info* const child_ready_info =
 		calloc(1, sizeof (struct usockit_server_child_ready_info));
 	cross_support_if_unlikely(child_ready_info == cross_support_nullptr) {
 		// TODO: calloc(3) error handling
@@ -270,663 +2280,5567 @@ static inline enum usockit_server_ret_status usockit_server_setup_threads(
 		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
 	}
 
-	errno = pthread_mutex_init(&(child_ready_info->mutex), cross_support_nullptr);
-	if(errno != 0) {
-		errno_push();
-		free(child_ready_info);
-		errno_pop();
+	errno = pthread_mutex_init(&(child_ready_info->mutex), cross_support_nullptr);
+	if(errno != 0) {
+		errno_push();
+		free(child_ready_info);
+		errno_pop();
+
+		// TODO: pthread_mutex_init(3p) error handling
+		perror("pthread_mutex_init(3p)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	errno = pthread_cond_init(&(child_ready_info->cond), cross_support_nullptr);
+	if(errno != 0) {
+		errno_push();
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+		errno_pop();
+
+		// TODO: pthread_cond_init(3p) error handling
+		perror("pthread_cond_init(3p)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	child_ready_info->condition = false;
+	child_ready_info->aborted = false;
+	child_ready_info->preloading = (options->stdin_preload_fd != -1);
+
+
+
+	errno = 0;
+	struct usockit_server_thread_routine_client_connection_client_ready_info* const client_ready_info =
+		calloc(1, sizeof (struct usockit_server_thread_routine_client_connection_client_ready_info));
+	cross_support_if_unlikely(client_ready_info == cross_support_nullptr) {
+		errno_push();
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+		errno_pop();
+
+		// TODO: calloc(3) error handling
+		perror("calloc(3)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	const ret_status_t handoff_pipe_ret_status = usockit_server_create_cloexec_pipe(client_ready_info->handoff_pipe);
+	if(handoff_pipe_ret_status != RET_STATUS_SUCCESS) {
+		errno_push();
+
+		free(client_ready_info);
+
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+
+		errno_pop();
+
+		// TODO: pipe(2) error handling
+		perror("pipe(2)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	atomic_init(&(client_ready_info->slot_occupied), false);
+	client_ready_info->client_fd = -1;
+
+	if((options->resume != cross_support_nullptr) && (options->resume->client_fd != -1)) {
+		// keep serving the client that our previous incarnation was serving before the upgrade
+		const int resumed_client_fd = options->resume->client_fd;
+
+		// the upgrade cleared close-on-exec (see the accept thread for why the client needs it)
+		(void)fcntl(resumed_client_fd, F_SETFD, FD_CLOEXEC);
+
+		atomic_store(&(client_ready_info->slot_occupied), true);
+
+		const ret_status_t ret_status =
+			write_all(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX], &resumed_client_fd, sizeof resumed_client_fd);
+
+		if(ret_status != RET_STATUS_SUCCESS) {
+			// the client is lost, but that's no reason to give up on the child
+			errno_push();
+			close(resumed_client_fd);
+			atomic_store(&(client_ready_info->slot_occupied), false);
+			errno_pop();
+
+			// TODO: write(2) error handling
+			perror("write(2)");
+		}
+	}
+
+
+
+	int shutdown_fds[2];
+
+	const ret_status_t shutdown_notifier_ret_status = usockit_server_create_notifier(shutdown_fds);
+	if(shutdown_notifier_ret_status != RET_STATUS_SUCCESS) {
+		errno_push();
+
+		close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+		close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+		free(client_ready_info);
+
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+
+		errno_pop();
+
+		// TODO: usockit_server_create_notifier() error handling
+		perror("usockit_server_create_notifier");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	struct usockit_server_upgrade_info* const upgrade_info = usockit_server_create_upgrade_info();
+	cross_support_if_unlikely(upgrade_info == cross_support_nullptr) {
+		errno_push();
+
+		usockit_server_close_notifier(shutdown_fds);
+
+		close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+		close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+		free(client_ready_info);
+
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+
+		errno_pop();
+
+		// TODO: usockit_server_create_upgrade_info() error handling
+		perror("usockit_server_create_upgrade_info");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	struct usockit_server_pty_output_info* pty_output_info = cross_support_nullptr;
+	if(options->pty) {
+		pty_output_info = usockit_server_create_pty_output_info(observer_socket_fd != -1);
+		cross_support_if_unlikely(pty_output_info == cross_support_nullptr) {
+			errno_push();
+
+			usockit_server_destroy_upgrade_info(upgrade_info);
+
+			usockit_server_close_notifier(shutdown_fds);
+
+			close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+			close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+			free(client_ready_info);
+
+			pthread_cond_destroy(&(child_ready_info->cond));
+			pthread_mutex_destroy(&(child_ready_info->mutex));
+			free(child_ready_info);
+
+			errno_pop();
+
+			// TODO: usockit_server_create_pty_output_info() error handling
+			perror("usockit_server_create_pty_output_info");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+	}
+
+	struct usockit_server_restart_info* restart_info = cross_support_nullptr;
+	if(options->restart != cross_support_nullptr) {
+		restart_info = usockit_server_create_restart_info(options->restart->queue_size);
+		cross_support_if_unlikely(restart_info == cross_support_nullptr) {
+			errno_push();
+
+			usockit_server_destroy_pty_output_info(pty_output_info);
+
+			usockit_server_destroy_upgrade_info(upgrade_info);
+
+			usockit_server_close_notifier(shutdown_fds);
+
+			close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+			close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+			free(client_ready_info);
+
+			pthread_cond_destroy(&(child_ready_info->cond));
+			pthread_mutex_destroy(&(child_ready_info->mutex));
+			free(child_ready_info);
+
+			errno_pop();
+
+			// TODO: usockit_server_create_restart_info() error handling
+			perror("usockit_server_create_restart_info");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+
+		if((options->resume != cross_support_nullptr) && (options->resume->standby_pid != -1)) {
+			// the standby is still running from before the upgrade, just like the child
+			restart_info->standby_pid = options->resume->standby_pid;
+			restart_info->standby_stdin_fd = options->resume->standby_stdin_fd;
+			(void)fcntl(restart_info->standby_stdin_fd, F_SETFD, FD_CLOEXEC);
+		}
+	}
+
+	struct usockit_server_worker_pool* worker_pool = cross_support_nullptr;
+	if(options->workers_count > 1) {
+		worker_pool = usockit_server_create_worker_pool(options->workers_count);
+		cross_support_if_unlikely(worker_pool == cross_support_nullptr) {
+			errno_push();
+
+			usockit_server_destroy_restart_info(restart_info);
+
+			usockit_server_destroy_pty_output_info(pty_output_info);
+
+			usockit_server_destroy_upgrade_info(upgrade_info);
+
+			usockit_server_close_notifier(shutdown_fds);
+
+			close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+			close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+			free(client_ready_info);
+
+			pthread_cond_destroy(&(child_ready_info->cond));
+			pthread_mutex_destroy(&(child_ready_info->mutex));
+			free(child_ready_info);
+
+			errno_pop();
+
+			// TODO: usockit_server_create_worker_pool() error handling
+			perror("usockit_server_create_worker_pool");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+	}
+
+	struct usockit_server_wait_queue* wait_queue = cross_support_nullptr;
+	if(options->wait_queue_length > 0) {
+		wait_queue = usockit_server_create_wait_queue(options->wait_queue_length, options->wait_timeout_ms);
+		cross_support_if_unlikely(wait_queue == cross_support_nullptr) {
+			errno_push();
+
+			usockit_server_destroy_worker_pool(worker_pool);
+
+			usockit_server_destroy_restart_info(restart_info);
+
+			usockit_server_destroy_pty_output_info(pty_output_info);
+
+			usockit_server_destroy_upgrade_info(upgrade_info);
+
+			usockit_server_close_notifier(shutdown_fds);
+
+			close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+			close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+			free(client_ready_info);
+
+			pthread_cond_destroy(&(child_ready_info->cond));
+			pthread_mutex_destroy(&(child_ready_info->mutex));
+			free(child_ready_info);
+
+			errno_pop();
+
+			// TODO: usockit_server_create_wait_queue() error handling
+			perror("usockit_server_create_wait_queue");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+
+		client_ready_info->wait_queue = wait_queue;
+	}
+
+
+
+	errno = 0;
+	struct usockit_server_thread_routine_child_wait_arg* const child_wait_thread_routine_arg =
+		calloc(1, sizeof(struct usockit_server_thread_routine_child_wait_arg));
+	cross_support_if_unlikely(child_wait_thread_routine_arg == cross_support_nullptr) {
+		errno_push();
+
+		usockit_server_destroy_wait_queue(wait_queue);
+
+		usockit_server_destroy_worker_pool(worker_pool);
+
+		usockit_server_destroy_restart_info(restart_info);
+
+		usockit_server_destroy_pty_output_info(pty_output_info);
+
+		usockit_server_destroy_upgrade_info(upgrade_info);
+
+		usockit_server_close_notifier(shutdown_fds);
+
+		close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+		close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+		free(client_ready_info);
+
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+
+		errno_pop();
+
+		// TODO: calloc(3) error handling
+		perror("calloc(3)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	errno = 0;
+	child_wait_thread_routine_arg->child_pid_ptr = malloc(sizeof *(child_wait_thread_routine_arg->child_pid_ptr));
+	cross_support_if_unlikely(child_wait_thread_routine_arg->child_pid_ptr == cross_support_nullptr) {
+		errno_push();
+
+		free(child_wait_thread_routine_arg);
+
+		usockit_server_destroy_wait_queue(wait_queue);
+
+		usockit_server_destroy_worker_pool(worker_pool);
+
+		usockit_server_destroy_restart_info(restart_info);
+
+		usockit_server_destroy_pty_output_info(pty_output_info);
+
+		usockit_server_destroy_upgrade_info(upgrade_info);
+
+		usockit_server_close_notifier(shutdown_fds);
+
+		close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+		close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+		free(client_ready_info);
+
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+
+		errno_pop();
+
+		// TODO: malloc(3) error handling
+		perror("malloc(3)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	child_wait_thread_routine_arg->child_ready_info = child_ready_info;
+	child_wait_thread_routine_arg->shutdown_notify_fd = shutdown_fds[PIPE_WRITE_INDEX];
+	child_wait_thread_routine_arg->upgrade_info = upgrade_info;
+	child_wait_thread_routine_arg->restart_info = restart_info;
+	child_wait_thread_routine_arg->restart_options = options->restart;
+	child_wait_thread_routine_arg->child_program_argv = child_program_argv;
+	child_wait_thread_routine_arg->socket_fd = socket_fd;
+	child_wait_thread_routine_arg->worker_pool = worker_pool;
+
+
+
+	errno = 0;
+	struct usockit_server_thread_routine_client_connection_arg* const client_connection_thread_routine_arg =
+		calloc(1, sizeof (struct usockit_server_thread_routine_client_connection_arg));
+	cross_support_if_unlikely(client_connection_thread_routine_arg == cross_support_nullptr) {
+		errno_push();
+
+		free(child_wait_thread_routine_arg->child_pid_ptr);
+		free(child_wait_thread_routine_arg);
+
+		usockit_server_destroy_wait_queue(wait_queue);
+
+		usockit_server_destroy_worker_pool(worker_pool);
+
+		usockit_server_destroy_restart_info(restart_info);
+
+		usockit_server_destroy_pty_output_info(pty_output_info);
+
+		usockit_server_destroy_upgrade_info(upgrade_info);
+
+		usockit_server_close_notifier(shutdown_fds);
+
+		close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+		close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+		free(client_ready_info);
+
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+
+		errno_pop();
+
+		// TODO: calloc(3) error handling
+		perror("calloc(3)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	errno = 0;
+	client_connection_thread_routine_arg->child_stdin_fd_ptr =
+		malloc(sizeof *(client_connection_thread_routine_arg->child_stdin_fd_ptr));
+	cross_support_if_unlikely(client_connection_thread_routine_arg->child_stdin_fd_ptr == cross_support_nullptr) {
+		errno_push();
+
+		free(client_connection_thread_routine_arg);
+
+		free(child_wait_thread_routine_arg->child_pid_ptr);
+		free(child_wait_thread_routine_arg);
+
+		usockit_server_destroy_wait_queue(wait_queue);
+
+		usockit_server_destroy_worker_pool(worker_pool);
+
+		usockit_server_destroy_restart_info(restart_info);
+
+		usockit_server_destroy_pty_output_info(pty_output_info);
+
+		usockit_server_destroy_upgrade_info(upgrade_info);
+
+		usockit_server_close_notifier(shutdown_fds);
+
+		close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+		close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+		free(client_ready_info);
+
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+
+		errno_pop();
+
+		// TODO: malloc(3) error handling
+		perror("malloc(3)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	client_connection_thread_routine_arg->client_ready_info = client_ready_info;
+	client_connection_thread_routine_arg->stdin_preload_fd = options->stdin_preload_fd;
+	client_connection_thread_routine_arg->child_ready_info = child_ready_info;
+	client_connection_thread_routine_arg->shutdown_fd = shutdown_fds[PIPE_READ_INDEX];
+	client_connection_thread_routine_arg->upgrade_info = upgrade_info;
+	client_connection_thread_routine_arg->pty_output_info = pty_output_info;
+	client_connection_thread_routine_arg->resumed_client_fd =
+		((options->resume != cross_support_nullptr) ? options->resume->client_fd : -1);
+	client_connection_thread_routine_arg->resumed_client_delivered_size =
+		((options->resume != cross_support_nullptr) ? options->resume->client_delivered_size : 0);
+	client_connection_thread_routine_arg->resumed_client_consumed_size =
+		((options->resume != cross_support_nullptr) ? options->resume->client_consumed_size : 0);
+	client_connection_thread_routine_arg->credit_window = options->credit_window;
+	client_connection_thread_routine_arg->linger_ms = options->linger_ms;
+	client_connection_thread_routine_arg->idle_timeout_ms = options->idle_timeout_ms;
+	client_connection_thread_routine_arg->heartbeat_interval_ms = options->heartbeat_interval_ms;
+	client_connection_thread_routine_arg->rate_limits = options->rate_limits;
+	client_connection_thread_routine_arg->restart_info = restart_info;
+	client_connection_thread_routine_arg->worker_pool = worker_pool;
+
+	child_wait_thread_routine_arg->child_stdin_fd_ptr = client_connection_thread_routine_arg->child_stdin_fd_ptr;
+
+
+
+	errno = 0;
+	struct usockit_server_thread_routine_accept_arg* const accept_thread_routine_arg =
+		calloc(1, sizeof(struct usockit_server_thread_routine_accept_arg));
+	cross_support_if_unlikely(accept_thread_routine_arg == cross_support_nullptr) {
+		errno_push();
+
+		free(client_connection_thread_routine_arg->child_stdin_fd_ptr);
+		free(client_connection_thread_routine_arg);
+
+		free(child_wait_thread_routine_arg->child_pid_ptr);
+		free(child_wait_thread_routine_arg);
+
+		usockit_server_destroy_wait_queue(wait_queue);
+
+		usockit_server_destroy_worker_pool(worker_pool);
+
+		usockit_server_destroy_restart_info(restart_info);
+
+		usockit_server_destroy_pty_output_info(pty_output_info);
+
+		usockit_server_destroy_upgrade_info(upgrade_info);
+
+		usockit_server_close_notifier(shutdown_fds);
+
+		close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+		close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+		free(client_ready_info);
+
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+
+		errno_pop();
+
+		// TODO: calloc(3) error handling
+		perror("calloc(3)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+	accept_thread_routine_arg->child_ready_info = child_ready_info;
+	accept_thread_routine_arg->client_ready_info = client_ready_info;
+	accept_thread_routine_arg->socket_fd = socket_fd;
+	accept_thread_routine_arg->shutdown_fd = shutdown_fds[PIPE_READ_INDEX];
+	accept_thread_routine_arg->upgrade_info = upgrade_info;
+
+
+
+	pthread_t child_wait_thread;
+	errno =
+		usockit_thread_create(
+			&child_wait_thread,
+			USOCKIT_SERVER_CHILD_WAIT_THREAD_STACK_SIZE,
+			&usockit_server_thread_routine_child_wait,
+			child_wait_thread_routine_arg
+		);
+	if(errno != 0) {
+		errno_push();
+
+		free(accept_thread_routine_arg);
+
+		free(client_connection_thread_routine_arg->child_stdin_fd_ptr);
+		free(client_connection_thread_routine_arg);
+
+		free(child_wait_thread_routine_arg->child_pid_ptr);
+		free(child_wait_thread_routine_arg);
+
+		usockit_server_destroy_wait_queue(wait_queue);
+
+		usockit_server_destroy_worker_pool(worker_pool);
+
+		usockit_server_destroy_restart_info(restart_info);
+
+		usockit_server_destroy_pty_output_info(pty_output_info);
+
+		usockit_server_destroy_upgrade_info(upgrade_info);
+
+		usockit_server_close_notifier(shutdown_fds);
+
+		close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+		close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+		free(client_ready_info);
+
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+
+		errno_pop();
+
+		// TODO: usockit_thread_create() error handling
+		perror("usockit_thread_create");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	pthread_t client_connection_thread;
+	errno =
+		usockit_thread_create(
+			&client_connection_thread,
+			USOCKIT_SERVER_CLIENT_CONNECTION_THREAD_STACK_SIZE,
+			&usockit_server_thread_routine_client_connection,
+			client_connection_thread_routine_arg
+		);
+	if(errno != 0) {
+		errno_push();
+
+		usockit_server_abort_child_ready(child_ready_info);
+		pthread_join(child_wait_thread, cross_support_nullptr);
+
+		free(accept_thread_routine_arg);
+
+		free(client_connection_thread_routine_arg->child_stdin_fd_ptr);
+		free(client_connection_thread_routine_arg);
+
+		free(child_wait_thread_routine_arg->child_pid_ptr);
+		free(child_wait_thread_routine_arg);
+
+		usockit_server_destroy_wait_queue(wait_queue);
+
+		usockit_server_destroy_worker_pool(worker_pool);
+
+		usockit_server_destroy_restart_info(restart_info);
+
+		usockit_server_destroy_pty_output_info(pty_output_info);
+
+		usockit_server_destroy_upgrade_info(upgrade_info);
+
+		usockit_server_close_notifier(shutdown_fds);
+
+		close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+		close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+		free(client_ready_info);
+
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+
+		errno_pop();
+
+		// TODO: usockit_thread_create() error handling
+		perror("usockit_thread_create");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	pthread_t accept_thread;
+	errno =
+		usockit_thread_create(
+			&accept_thread,
+			USOCKIT_SERVER_ACCEPT_THREAD_STACK_SIZE,
+			&usockit_server_thread_routine_accept,
+			accept_thread_routine_arg
+		);
+	if(errno != 0) {
+		errno_push();
+
+		usockit_server_abort_child_ready(child_ready_info);
+		usockit_server_notify(shutdown_fds[PIPE_WRITE_INDEX]);
+
+		pthread_join(client_connection_thread, cross_support_nullptr);
+		pthread_join(child_wait_thread, cross_support_nullptr);
+
+		free(accept_thread_routine_arg);
+
+		free(client_connection_thread_routine_arg->child_stdin_fd_ptr);
+		free(client_connection_thread_routine_arg);
+
+		free(child_wait_thread_routine_arg->child_pid_ptr);
+		free(child_wait_thread_routine_arg);
+
+		usockit_server_destroy_wait_queue(wait_queue);
+
+		usockit_server_destroy_worker_pool(worker_pool);
+
+		usockit_server_destroy_restart_info(restart_info);
+
+		usockit_server_destroy_pty_output_info(pty_output_info);
+
+		usockit_server_destroy_upgrade_info(upgrade_info);
+
+		usockit_server_close_notifier(shutdown_fds);
+
+		close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+		close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+		free(client_ready_info);
+
+		pthread_cond_destroy(&(child_ready_info->cond));
+		pthread_mutex_destroy(&(child_ready_info->mutex));
+		free(child_ready_info);
+
+		errno_pop();
+
+		// TODO: usockit_thread_create() error handling
+		perror("usockit_thread_create");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+
+
+	const enum usockit_server_ret_status ret_status =
+		usockit_server_setup_child(
+			child_program_argv,
+			socket_fd,
+			child_ready_info,
+			child_wait_thread_routine_arg->child_pid_ptr,
+			client_connection_thread_routine_arg->child_stdin_fd_ptr,
+			worker_pool,
+			options
+		);
+
+	struct usockit_server_thread_routine_pty_output_arg pty_output_thread_routine_arg;
+	pthread_t pty_output_thread;
+	bool pty_output_thread_created = false;
+
+	if((ret_status == USOCKIT_SERVER_RET_STATUS_SUCCESS) && options->pty) {
+		pty_output_thread_routine_arg.pty_master_fd = *(client_connection_thread_routine_arg->child_stdin_fd_ptr);
+		pty_output_thread_routine_arg.shutdown_fd = shutdown_fds[PIPE_READ_INDEX];
+		pty_output_thread_routine_arg.upgrade_info = upgrade_info;
+		pty_output_thread_routine_arg.pty_output_info = pty_output_info;
+
+		errno =
+			usockit_thread_create(
+				&pty_output_thread,
+				USOCKIT_SERVER_PTY_OUTPUT_THREAD_STACK_SIZE,
+				&usockit_server_thread_routine_pty_output,
+				&pty_output_thread_routine_arg
+			);
+
+		if(errno == 0) {
+			pty_output_thread_created = true;
+
+			// nothing is parked yet; the upgrade signal handler is only installed further below
+			++(upgrade_info->parking_threads_count);
+		} else {
+			// TODO: usockit_thread_create() error handling
+			// the child keeps running, only its output is lost
+			perror("usockit_thread_create");
+		}
+	}
+
+	struct usockit_server_thread_routine_observers_arg observers_thread_routine_arg;
+	pthread_t observers_thread;
+	bool observers_thread_created = false;
+
+	if(pty_output_thread_created && (observer_socket_fd != -1)) {
+		observers_thread_routine_arg.observer_socket_fd = observer_socket_fd;
+		observers_thread_routine_arg.shutdown_fd = shutdown_fds[PIPE_READ_INDEX];
+		observers_thread_routine_arg.upgrade_info = upgrade_info;
+		observers_thread_routine_arg.pty_output_info = pty_output_info;
+
+		errno =
+			usockit_thread_create(
+				&observers_thread,
+				USOCKIT_SERVER_OBSERVERS_THREAD_STACK_SIZE,
+				&usockit_server_thread_routine_observers,
+				&observers_thread_routine_arg
+			);
+
+		if(errno == 0) {
+			observers_thread_created = true;
+
+			// same as with the pty_output thread
+			++(upgrade_info->parking_threads_count);
+		} else {
+			// TODO: usockit_thread_create() error handling
+			// the child keeps running, only observers don't get served
+			perror("usockit_thread_create");
+		}
+	}
+
+	struct usockit_server_thread_routine_control_arg control_thread_routine_arg;
+	pthread_t control_thread;
+	bool control_thread_created = false;
+
+	if((ret_status == USOCKIT_SERVER_RET_STATUS_SUCCESS) && (control_socket_fd != -1)) {
+		control_thread_routine_arg.control_socket_fd = control_socket_fd;
+		control_thread_routine_arg.shutdown_fd = shutdown_fds[PIPE_READ_INDEX];
+		control_thread_routine_arg.upgrade_info = upgrade_info;
+		control_thread_routine_arg.client_ready_info = client_ready_info;
+		control_thread_routine_arg.child_pid_ptr = child_wait_thread_routine_arg->child_pid_ptr;
+		control_thread_routine_arg.child_stdin_fd_ptr = client_connection_thread_routine_arg->child_stdin_fd_ptr;
+		control_thread_routine_arg.restart_info = restart_info;
+		control_thread_routine_arg.worker_pool = worker_pool;
+		control_thread_routine_arg.pty_output_info = pty_output_info;
+
+		errno =
+			usockit_thread_create(
+				&control_thread,
+				USOCKIT_SERVER_CONTROL_THREAD_STACK_SIZE,
+				&usockit_server_thread_routine_control,
+				&control_thread_routine_arg
+			);
+
+		if(errno == 0) {
+			control_thread_created = true;
+
+			// same as with the pty_output thread
+			++(upgrade_info->parking_threads_count);
+		} else {
+			// TODO: usockit_thread_create() error handling
+			// the child keeps running, it just can't be controlled
+			perror("usockit_thread_create");
+		}
+	}
+
+	if(ret_status == USOCKIT_SERVER_RET_STATUS_SUCCESS) {
+		// ========================================================================================================== //
+		//                                                                                                            //
+		//   Main program runs now.                                                                                   //
+		//   The accept_thread is accepting connections from the socket and hands them to the                         //
+		//   client_connection_thread, which is forwarding them to the child's stdin.                                 //
+		//   Meanwhile the child_wait_thread is waiting until the child dies. When it does, it notifies all threads   //
+		//   to shut down, including us (the main thread), after which we join with all of them.                      //
+		//   Until then, we are waiting for upgrade requests.                                                         //
+		//                                                                                                            //
+		// ========================================================================================================== //
+
+		// only handled once the child is running, so that the accept & client_connection threads never park while
+		// the setup could still be aborted
+		struct sigaction old_upgrade_signal_action;
+		bool upgrade_signal_handler_installed = false;
+
+		// without an executable to upgrade to (with workers), the signal is still handled, so that it doesn't kill the
+		// server along with the stdins of all workers
+		const ret_status_t handler_ret_status =
+			usockit_server_install_upgrade_signal_handler(
+				((options->executable_pathname != cross_support_nullptr)
+				 ? upgrade_info->notify_fds[PIPE_WRITE_INDEX]
+				 : -1),
+				&old_upgrade_signal_action
+			);
+
+		if(handler_ret_status == RET_STATUS_SUCCESS) {
+			upgrade_signal_handler_installed = true;
+		} else {
+			// TODO: sigaction(2) error handling
+			perror("sigaction(2)");
+		}
+
+		enum usockit_server_wait_result wait_result;
+		do {
+			// the upgrade notifier is the file descriptor that is waited on here, so "readable" is an upgrade request
+			wait_result =
+				usockit_server_wait_readable(
+					upgrade_info->notify_fds[PIPE_READ_INDEX],
+					shutdown_fds[PIPE_READ_INDEX],
+					-1
+				);
+
+			if(wait_result == USOCKIT_SERVER_WAIT_RESULT_READABLE) {
+				usockit_server_upgrade(
+					upgrade_info,
+					client_ready_info,
+					owned_socket_pathname,
+					child_program_argv,
+					socket_fd,
+					observer_socket_fd,
+					control_socket_fd,
+					child_wait_thread_routine_arg->child_pid_ptr,
+					client_connection_thread_routine_arg->child_stdin_fd_ptr,
+					restart_info,
+					options
+				);
+			} else if(wait_result == USOCKIT_SERVER_WAIT_RESULT_FAILURE) {
+				// TODO: poll(2) error handling
+				perror("poll(2)");
+			}
+		} while(wait_result != USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN);
+
+		if(upgrade_signal_handler_installed) {
+			usockit_server_restore_upgrade_signal_handler(&old_upgrade_signal_action);
+		}
+	} else {
+		usockit_server_abort_child_ready(child_ready_info);
+		usockit_server_notify(shutdown_fds[PIPE_WRITE_INDEX]);
+	}
+
+	pthread_join(child_wait_thread, cross_support_nullptr);
+	pthread_join(accept_thread, cross_support_nullptr);
+	pthread_join(client_connection_thread, cross_support_nullptr);
+
+	if(pty_output_thread_created) {
+		pthread_join(pty_output_thread, cross_support_nullptr);
+	}
+
+	// only after the pty_output thread, which forwards the last of the output to the observers thread
+	if(observers_thread_created) {
+		pthread_join(observers_thread, cross_support_nullptr);
+	}
+
+	if(control_thread_created) {
+		pthread_join(control_thread, cross_support_nullptr);
+	}
+
+	// in supervisor mode as well; the stdin of a child that exited cleanly is still open.
+	// (the stdins of the workers are closed along with the worker pool)
+	if((ret_status == USOCKIT_SERVER_RET_STATUS_SUCCESS) && (worker_pool == cross_support_nullptr)) {
+		close(*(client_connection_thread_routine_arg->child_stdin_fd_ptr));
+	}
+
+	free(accept_thread_routine_arg);
+
+	free(client_connection_thread_routine_arg->child_stdin_fd_ptr);
+	free(client_connection_thread_routine_arg);
+
+	free(child_wait_thread_routine_arg->child_pid_ptr);
+	free(child_wait_thread_routine_arg);
+
+	usockit_server_destroy_wait_queue(wait_queue);
+
+	usockit_server_destroy_worker_pool(worker_pool);
+
+	usockit_server_destroy_restart_info(restart_info);
+
+	usockit_server_destroy_pty_output_info(pty_output_info);
+
+	usockit_server_destroy_upgrade_info(upgrade_info);
+
+	usockit_server_close_notifier(shutdown_fds);
+
+	close(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX]);
+	close(client_ready_info->handoff_pipe[PIPE_READ_INDEX]);
+	free(client_ready_info);
+
+	pthread_cond_destroy(&(child_ready_info->cond));
+	pthread_mutex_destroy(&(child_ready_info->mutex));
+	free(child_ready_info);
+
+	return ret_status;
+}
+
+static inline enum usockit_server_ret_status usockit_server_setup_child(
+	const cstr_t* const child_program_argv,
+	const int socket_fd,
+	struct usockit_server_child_ready_info* const child_read_info,
+	pid_t* const child_wait_thread_routine_arg_child_pid_ptr,
+	int* const client_connection_thread_routine_arg_child_stdin_fd_ptr,
+	struct usockit_server_worker_pool* const worker_pool,
+	const struct usockit_server_options* const options
+) {
+	assert(child_program_argv != cross_support_nullptr);
+	assert(child_read_info != cross_support_nullptr);
+	assert(child_wait_thread_routine_arg_child_pid_ptr != cross_support_nullptr);
+	assert(client_connection_thread_routine_arg_child_stdin_fd_ptr != cross_support_nullptr);
+	assert(options != cross_support_nullptr);
+
+	if(worker_pool != cross_support_nullptr) {
+		*child_wait_thread_routine_arg_child_pid_ptr = -1;
+		*client_connection_thread_routine_arg_child_stdin_fd_ptr = -1;
+
+		const enum usockit_server_ret_status ret_status =
+			usockit_server_start_workers(child_program_argv, socket_fd, worker_pool);
+
+		if(ret_status == USOCKIT_SERVER_RET_STATUS_SUCCESS) {
+			usockit_server_signal_child_ready(child_read_info, options);
+		}
+
+		return ret_status;
+	}
+
+	if(options->resume != cross_support_nullptr) {
+		// the child is still running from before the upgrade; nothing to start
+		*child_wait_thread_routine_arg_child_pid_ptr = options->resume->child_pid;
+		*client_connection_thread_routine_arg_child_stdin_fd_ptr = options->resume->child_stdin_fd;
+		// the upgrade cleared the close-on-exec flag to hand it over (see usockit_server_start_child())
+		(void)fcntl(options->resume->child_stdin_fd, F_SETFD, FD_CLOEXEC);
+
+		usockit_server_signal_child_ready(child_read_info, options);
+
+		return USOCKIT_SERVER_RET_STATUS_SUCCESS;
+	}
+
+	const enum usockit_server_ret_status ret_status =
+		usockit_server_start_child(
+			child_program_argv,
+			socket_fd,
+			options->pty,
+			child_wait_thread_routine_arg_child_pid_ptr,
+			client_connection_thread_routine_arg_child_stdin_fd_ptr
+		);
+
+	if(ret_status == USOCKIT_SERVER_RET_STATUS_SUCCESS) {
+		usockit_server_signal_child_ready(child_read_info, options);
+	}
+
+	return ret_status;
+}
+
+static inline enum usockit_server_ret_status usockit_server_start_child(
+	const cstr_t* const child_program_argv,
+	const int socket_fd,
+	const bool pty,
+	pid_t* const child_pid_ptr,
+	int* const child_stdin_fd_ptr
+) {
+	assert(child_program_argv != cross_support_nullptr);
+	assert(child_pid_ptr != cross_support_nullptr);
+	assert(child_stdin_fd_ptr != cross_support_nullptr);
+
+	// the main pipe is is used for writing to the child process' stdin.
+	// in pty mode, it is a pseudo-terminal instead, with the master as the "write end" and the slave as the "read end"
+	int main_pipe[2];
+	int ret;
+
+	if(pty) {
+		errno = 0;
+		const ret_status_t pty_ret_status = usockit_server_open_pty(main_pipe);
+		if(pty_ret_status != RET_STATUS_SUCCESS) {
+			// TODO: usockit_server_open_pty() error handling
+			perror("usockit_server_open_pty");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+	} else {
+		errno = 0;
+		ret = pipe(main_pipe);
+		if(ret != 0) {
+			// TODO: pipe(2) error handling
+			perror("pipe(2)");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+
+		// close-on-exec, so that the standby doesn't keep the stdin of the child program open or the other way around
+		errno = 0;
+		ret = fcntl(main_pipe[PIPE_WRITE_INDEX], F_SETFD, FD_CLOEXEC);
+		if(ret != 0) {
+			errno_push();
+			close(main_pipe[PIPE_WRITE_INDEX]);
+			close(main_pipe[PIPE_READ_INDEX]);
+			errno_pop();
+
+			// TODO: fcntl(2) error handling
+			perror("fcntl(2)");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+	}
+
+
+	// the reporting pipe is for the child reporting either error or success back to the parent.
+	// if the child encounters an error, it will send a struct `usockit_server_child_error` over the pipe, signaling to
+	// the parent that an error occurred.
+	// this pipe is also opened with the close-on-exec flag, which means that when the child successfully calls one of
+	// the exec(3)-family functions, the parent will receive an EOF without any data, which signals to the parent that
+	// everything went ok
+	int reporting_pipe[2];
+
+	#if USOCKIT_SERVER_PIPE2_SUPPORT
+		errno = 0;
+		ret = pipe2(reporting_pipe, O_CLOEXEC);
+		if(ret != 0) {
+			errno_push();
+			close(main_pipe[PIPE_WRITE_INDEX]);
+			close(main_pipe[PIPE_READ_INDEX]);
+			errno_pop();
+
+			// TODO: pipe2(2) error handling
+			perror("pipe2(2)");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+	#else
+		errno = 0;
+		ret = pipe(reporting_pipe);
+		if(ret != 0) {
+			errno_push();
+			close(main_pipe[PIPE_WRITE_INDEX]);
+			close(main_pipe[PIPE_READ_INDEX]);
+			errno_pop();
+
+			// TODO: pipe(2) error handling
+			perror("pipe(2)");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+
+		errno = 0;
+		ret = fcntl(reporting_pipe[PIPE_WRITE_INDEX], F_SETFD, O_CLOEXEC);
+		if(ret != 0) {
+			errno_push();
+
+			close(reporting_pipe[PIPE_WRITE_INDEX]);
+			close(reporting_pipe[PIPE_READ_INDEX]);
+
+			close(main_pipe[PIPE_WRITE_INDEX]);
+			close(main_pipe[PIPE_READ_INDEX]);
+
+			errno_pop();
+
+			// TODO: fcntl(2) error handling
+			perror("fcntl(2)");
+			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		}
+	#endif
+
+
+	errno = 0;
+	const pid_t child_pid = fork();
+	if(child_pid == -1) {
+		errno_push();
+
+		close(reporting_pipe[PIPE_WRITE_INDEX]);
+		close(reporting_pipe[PIPE_READ_INDEX]);
+
+		close(main_pipe[PIPE_WRITE_INDEX]);
+		close(main_pipe[PIPE_READ_INDEX]);
+
+		errno_pop();
+
+		// TODO: fork(2) error handling
+		perror("fork(2)");
+		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	}
+
+	if(child_pid == 0) {
+		// reporting pipe read end, main pipe write end and the socket is not needed by the child
+		close(reporting_pipe[PIPE_READ_INDEX]);
+		close(main_pipe[PIPE_WRITE_INDEX]);
+		close(socket_fd);
+
+		// noreturn
+		usockit_server_child(
+			child_program_argv,
+			main_pipe[PIPE_READ_INDEX],
+			reporting_pipe[PIPE_WRITE_INDEX],
+			pty
+		);
+	} else {
+		// reporting pipe write end and main pipe read end is not needed by the parent
+		close(reporting_pipe[PIPE_WRITE_INDEX]);
+		close(main_pipe[PIPE_READ_INDEX]);
+
+		*child_pid_ptr = child_pid;
+		*child_stdin_fd_ptr = main_pipe[PIPE_WRITE_INDEX];
+
+		const enum usockit_server_ret_status ret_status =
+			usockit_server_parent(reporting_pipe[PIPE_READ_INDEX], child_pid);
+
+		close(reporting_pipe[PIPE_READ_INDEX]);
+
+		// on success, the write end of the main pipe is closed by usockit_server_setup_threads() once the child died
+		// (or by the child_wait thread in supervisor mode)
+		if(ret_status != USOCKIT_SERVER_RET_STATUS_SUCCESS) {
+			close(main_pipe[PIPE_WRITE_INDEX]);
+		}
+
+		return ret_status;
+	}
+}
+
+static inline enum usockit_server_ret_status usockit_server_start_workers(
+	const cstr_t* const child_program_argv,
+	const int socket_fd,
+	struct usockit_server_worker_pool* const worker_pool
+) {
+	assert(child_program_argv != cross_support_nullptr);
+	assert(worker_pool != cross_support_nullptr);
+
+	for(size_t i = 0; i < worker_pool->count; ++i) {
+		struct usockit_server_worker* const worker = &(worker_pool->workers[i]);
+
+		// the main pipe is close-on-exec, so no worker keeps the stdin of another one open
+		const enum usockit_server_ret_status ret_status =
+			usockit_server_start_child(
+				child_program_argv,
+				socket_fd,
+				false,
+				&(worker->pid),
+				&(worker->stdin_fd)
+			);
+
+		if(ret_status != USOCKIT_SERVER_RET_STATUS_SUCCESS) {
+			// the workers that are already running are expected to exit on EOF, like any other program reading stdin
+			worker->stdin_fd = -1;
+
+			for(size_t j = 0; j < i; ++j) {
+				close(worker_pool->workers[j].stdin_fd);
+				worker_pool->workers[j].stdin_fd = -1;
+			}
+
+			return ret_status;
+		}
+	}
+
+	return USOCKIT_SERVER_RET_STATUS_SUCCESS;
+}
+
+static void* usockit_server_thread_routine_accept(void* const arg_ptr) {
+	assert(arg_ptr != cross_support_nullptr);
+
+	const struct usockit_server_thread_routine_accept_arg arg =
+		*(const struct usockit_server_thread_routine_accept_arg*)arg_ptr;
+
+	usockit_server_set_thread_name("accept");
+	usockit_server_block_sigpipe();
+
+	if(!usockit_server_wait_for_child_ready(arg.child_ready_info)) {
+		return cross_support_nullptr;
+	}
+
+	// connections made in the meantime wait in the socket's backlog
+	usockit_server_wait_for_stdin_preload(arg.child_ready_info);
+
+	struct usockit_server_wait_queue* const wait_queue = arg.client_ready_info->wait_queue;
+
+	do {
+		if(wait_queue != cross_support_nullptr) {
+			usockit_server_serve_wait_queue(wait_queue, arg.client_ready_info);
+		}
+
+		const int upgrade_fd = arg.upgrade_info->notify_fds[PIPE_READ_INDEX];
+		const enum usockit_server_wait_result wait_result =
+			((wait_queue == cross_support_nullptr)
+				 ? usockit_server_wait_readable(arg.socket_fd, arg.shutdown_fd, upgrade_fd)
+				 : usockit_server_wait_accept(arg.socket_fd, arg.shutdown_fd, upgrade_fd, wait_queue));
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN) {
+			if(wait_queue != cross_support_nullptr) {
+				// waiting clients exit with the status of the child program as well, instead of as if they were
+				// turned away or done
+				unsigned char child_exit_payload[USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE];
+				const bool child_exit_known =
+					usockit_server_get_child_exit_payload(arg.upgrade_info, child_exit_payload);
+
+				usockit_server_clear_wait_queue(
+					wait_queue,
+					false,
+					(child_exit_known ? child_exit_payload : cross_support_nullptr)
+				);
+				usockit_server_wait_queue_report(wait_queue);
+			}
+
+			return cross_support_nullptr;
+		}
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_UPGRADE) {
+			// pending connections stay in the backlog of the socket, which outlives the upgrade. waiting connections
+			// can't be handed over though; they are told to try again
+			if(wait_queue != cross_support_nullptr) {
+				usockit_server_clear_wait_queue(wait_queue, true, cross_support_nullptr);
+			}
+
+			usockit_server_park_for_upgrade(arg.upgrade_info);
+			continue;
+		}
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_FAILURE) {
+			// TODO: poll(2) error handling
+			perror("poll(2)");
+			continue;
+		}
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_TIMEOUT) {
+			// the queue is served at the top of the loop
+			continue;
+		}
+
+		// close-on-exec, so that a child that is restarted in supervisor mode doesn't keep clients connected
+		#if USOCKIT_SERVER_ACCEPT4_SUPPORT
+			errno = 0;
+			const int client_fd = accept4(arg.socket_fd, cross_support_nullptr, cross_support_nullptr, SOCK_CLOEXEC);
+			if(client_fd == -1) {
+				// TODO: accept4(2) error handling
+				perror("accept4(2)");
+				continue;
+			}
+		#else
+			errno = 0;
+			const int client_fd = accept(arg.socket_fd, cross_support_nullptr, cross_support_nullptr);
+			if(client_fd == -1) {
+				// TODO: accept(2) error handling
+				perror("accept(2)");
+				continue;
+			}
+
+			(void)fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+		#endif
+
+		// connections that already wait go first, even if the slot was freed just now
+		if((wait_queue == cross_support_nullptr) || (atomic_load(&(wait_queue->length)) == 0)) {
+			bool slot_occupied = false;
+			if(atomic_compare_exchange_strong(&(arg.client_ready_info->slot_occupied), &slot_occupied, true)) {
+				// we occupied the slot; hand the client over to the client_connection thread, which owns `client_fd`
+				// from now on
+				usockit_server_hand_over_client(arg.client_ready_info, client_fd);
+				continue;
+			}
+		}
+
+		if((wait_queue != cross_support_nullptr) && usockit_server_enqueue_waiting_client(wait_queue, client_fd)) {
+			continue;
+		}
+
+		// slot is occupied by another client (and there is no room to wait) -> reject the new one
+		usockit_server_reject_client(client_fd);
+	} while(true);
+}
+
+static inline void usockit_server_hand_over_client(
+	struct usockit_server_thread_routine_client_connection_client_ready_info* const client_ready_info,
+	const int client_fd
+) {
+	assert(client_ready_info != cross_support_nullptr);
+	assert(atomic_load(&(client_ready_info->slot_occupied)));
+
+	// the pipe is guaranteed to be empty at this point (the slot was free), so this write never blocks
+	const ret_status_t ret_status =
+		write_all(client_ready_info->handoff_pipe[PIPE_WRITE_INDEX], &client_fd, sizeof client_fd);
+
+	if(ret_status != RET_STATUS_SUCCESS) {
+		errno_push();
+		close(client_fd);
+		usockit_server_free_client_slot(client_ready_info);
+		errno_pop();
+
+		// TODO: write(2) error handling
+		perror("write(2)");
+	}
+}
+
+static inline void usockit_server_reject_client(const int client_fd) {
+	// the message is way smaller than the send buffer of a fresh socket (and the queued message before it, if any, is
+	// tiny as well), so this write never blocks
+
+	static const char* const msg = USOCKIT_PROTOCOL_FUCK_OFF_STRING;
+	// GCC for some reason still warns about the unused result, even with the void cast.
+	// (Clang properly suppresses it)
+	// unknown if this is a bug or intended behaviour [as at 2022-11-08, GCC version 12.2.1]
+	#define TMP_GCC_DIAGNOSTIC_IGNORED_UNUSED_RESULT_SUPPORTED  CROSS_SUPPORT_GCC_LEAST(4,6)
+	#if TMP_GCC_DIAGNOSTIC_IGNORED_UNUSED_RESULT_SUPPORTED
+		#pragma GCC diagnostic push
+		#pragma GCC diagnostic ignored "-Wunused-result"
+	#endif
+	(void)(write_all(client_fd, msg, strlen(msg)));
+	#if TMP_GCC_DIAGNOSTIC_IGNORED_UNUSED_RESULT_SUPPORTED
+		#pragma GCC diagnostic pop
+	#endif
+
+	close(client_fd);
+}
+
+static inline void usockit_server_free_client_slot(
+	struct usockit_server_thread_routine_client_connection_client_ready_info* const client_ready_info
+) {
+	assert(client_ready_info != cross_support_nullptr);
+
+	atomic_store(&(client_ready_info->slot_occupied), false);
+
+	if(client_ready_info->wait_queue != cross_support_nullptr) {
+		usockit_server_notify(client_ready_info->wait_queue->slot_freed_notify_fds[PIPE_WRITE_INDEX]);
+	}
+}
+
+static inline bool usockit_server_enqueue_waiting_client(struct usockit_server_wait_queue* const wait_queue,
+                                                         const int client_fd) {
+	assert(wait_queue != cross_support_nullptr);
+
+	const size_t length = atomic_load(&(wait_queue->length));
+	if(length == wait_queue->capacity) {
+		++(wait_queue->full_count);
+		return false;
+	}
+
+	const size_t index = ((wait_queue->head + length) % wait_queue->capacity);
+	wait_queue->clients[index].fd = client_fd;
+	wait_queue->clients[index].since_ns = usockit_server_now_ns();
+	atomic_store(&(wait_queue->length), (length + 1));
+
+	// like the rejection, this never blocks. a client that doesn't get to know its position still waits all the same
+	unsigned char payload[USOCKIT_PROTOCOL_QUEUED_PAYLOAD_SIZE];
+	usockit_protocol_encode_size_payload(payload, (uint64_t)(length + 1));
+
+	const ret_status_t ret_status =
+		usockit_server_send_message(client_fd, USOCKIT_PROTOCOL_MESSAGE_TYPE_QUEUED, payload, sizeof payload);
+	(void)ret_status;
+
+	return true;
+}
+
+static inline int usockit_server_dequeue_waiting_client(struct usockit_server_wait_queue* const wait_queue,
+                                                        const uint64_t now_ns) {
+	assert(wait_queue != cross_support_nullptr);
+
+	const size_t length = atomic_load(&(wait_queue->length));
+	assert(length > 0);
+
+	const struct usockit_server_waiting_client client = wait_queue->clients[wait_queue->head];
+	wait_queue->head = ((wait_queue->head + 1) % wait_queue->capacity);
+	atomic_store(&(wait_queue->length), (length - 1));
+
+	const uint64_t waited_ns = ((now_ns > client.since_ns) ? (now_ns - client.since_ns) : 0);
+	wait_queue->waited_ns += waited_ns;
+	if(waited_ns > wait_queue->longest_wait_ns) {
+		wait_queue->longest_wait_ns = waited_ns;
+	}
+
+	return client.fd;
+}
+
+static inline void usockit_server_serve_wait_queue(
+	struct usockit_server_wait_queue* const wait_queue,
+	struct usockit_server_thread_routine_client_connection_client_ready_info* const client_ready_info
+) {
+	assert(wait_queue != cross_support_nullptr);
+	assert(client_ready_info != cross_support_nullptr);
+
+	usockit_server_drain_notifier(wait_queue->slot_freed_notify_fds[PIPE_READ_INDEX]);
+
+	size_t length = atomic_load(&(wait_queue->length));
+	if(length == 0) {
+		return;
+	}
+
+	const uint64_t now_ns = usockit_server_now_ns();
+
+	// a client that closed the connection is hung up; asking for no events at all still reports that, but not what the
+	// client already sent
+	for(size_t i = 0; i < length; ++i) {
+		wait_queue->pfds[i].fd = wait_queue->clients[(wait_queue->head + i) % wait_queue->capacity].fd;
+		wait_queue->pfds[i].events = 0;
+		wait_queue->pfds[i].revents = 0;
+	}
+
+	if(poll(wait_queue->pfds, (nfds_t)length, 0) > 0) {
+		// the ones that are still there move up, keeping their order
+		size_t kept_count = 0;
+		for(size_t i = 0; i < length; ++i) {
+			const size_t index = ((wait_queue->head + i) % wait_queue->capacity);
+
+			if(wait_queue->pfds[i].revents != 0) {
+				const uint64_t waited_ns = (now_ns - wait_queue->clients[index].since_ns);
+				wait_queue->waited_ns += waited_ns;
+				if(waited_ns > wait_queue->longest_wait_ns) {
+					wait_queue->longest_wait_ns = waited_ns;
+				}
+
+				close(wait_queue->clients[index].fd);
+				++(wait_queue->gone_count);
+				continue;
+			}
+
+			wait_queue->clients[(wait_queue->head + kept_count) % wait_queue->capacity] = wait_queue->clients[index];
+			++kept_count;
+		}
+
+		length = kept_count;
+		atomic_store(&(wait_queue->length), length);
+	}
+
+	while(length > 0) {
+		bool slot_occupied = false;
+		if(!atomic_compare_exchange_strong(&(client_ready_info->slot_occupied), &slot_occupied, true)) {
+			break;
+		}
+
+		const int client_fd = usockit_server_dequeue_waiting_client(wait_queue, now_ns);
+		--length;
+
+		++(wait_queue->admitted_count);
+		usockit_server_hand_over_client(client_ready_info, client_fd);
+	}
+
+	while((length > 0) && ((now_ns - wait_queue->clients[wait_queue->head].since_ns) >= wait_queue->timeout_ns)) {
+		const int client_fd = usockit_server_dequeue_waiting_client(wait_queue, now_ns);
+		--length;
+
+		++(wait_queue->timed_out_count);
+		usockit_server_reject_client(client_fd);
+	}
+}
+
+static inline enum usockit_server_wait_result usockit_server_wait_accept(
+	const int socket_fd,
+	const int shutdown_fd,
+	const int upgrade_fd,
+	struct usockit_server_wait_queue* const wait_queue
+) {
+	assert(wait_queue != cross_support_nullptr);
+
+	enum {
+		POLLFD_SHUTDOWN,
+		POLLFD_UPGRADE,
+		POLLFD_SOCKET,
+		POLLFD_SLOT_FREED,
+		POLLFD_CLIENTS,
+	};
+
+	const size_t length = atomic_load(&(wait_queue->length));
+
+	struct pollfd* const pfds = wait_queue->pfds;
+	pfds[POLLFD_SHUTDOWN]   = (struct pollfd){ .fd = shutdown_fd, .events = POLLIN };
+	pfds[POLLFD_UPGRADE]    = (struct pollfd){ .fd = upgrade_fd,  .events = POLLIN };
+	pfds[POLLFD_SOCKET]     = (struct pollfd){ .fd = socket_fd,   .events = POLLIN };
+	pfds[POLLFD_SLOT_FREED] =
+		(struct pollfd){ .fd = wait_queue->slot_freed_notify_fds[PIPE_READ_INDEX], .events = POLLIN };
+
+	for(size_t i = 0; i < length; ++i) {
+		pfds[POLLFD_CLIENTS + i] =
+			(struct pollfd){ .fd = wait_queue->clients[(wait_queue->head + i) % wait_queue->capacity].fd, .events = 0 };
+	}
+
+	// the connection that waited the longest is the first one to run out of time
+	int timeout_ms = -1;
+	if(length > 0) {
+		const uint64_t deadline_ns = (wait_queue->clients[wait_queue->head].since_ns + wait_queue->timeout_ns);
+		const uint64_t now_ns = usockit_server_now_ns();
+
+		// rounded up, so that we don't wake up just before the deadline
+		const uint64_t remaining_ms = ((now_ns < deadline_ns) ? (((deadline_ns - now_ns) + 999999) / 1000000) : 0);
+		timeout_ms = ((remaining_ms > INT_MAX) ? INT_MAX : (int)remaining_ms);
+	}
+
+	int ret;
+	do {
+		errno = 0;
+		ret = poll(pfds, (nfds_t)(POLLFD_CLIENTS + length), timeout_ms);
+	} while((ret == -1) && (errno == EINTR));
+
+	if(ret == -1) {
+		return USOCKIT_SERVER_WAIT_RESULT_FAILURE;
+	}
+
+	if(pfds[POLLFD_SHUTDOWN].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN;
+	}
+
+	if(pfds[POLLFD_UPGRADE].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_UPGRADE;
+	}
+
+	if(pfds[POLLFD_SOCKET].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_READABLE;
+	}
+
+	return USOCKIT_SERVER_WAIT_RESULT_TIMEOUT;
+}
+
+static inline void usockit_server_clear_wait_queue(struct usockit_server_wait_queue* const wait_queue,
+                                                   const bool reject,
+                                                   const unsigned char* const child_exit_payload) {
+	assert(wait_queue != cross_support_nullptr);
+
+	const uint64_t now_ns = usockit_server_now_ns();
+
+	while(atomic_load(&(wait_queue->length)) > 0) {
+		const int client_fd = usockit_server_dequeue_waiting_client(wait_queue, now_ns);
+
+		if(reject) {
+			usockit_server_reject_client(client_fd);
+			continue;
+		}
+
+		if(child_exit_payload != cross_support_nullptr) {
+			// the connection is closed right after, whether the client took the message or not
+			const ret_status_t ret_status =
+				usockit_server_send_message(
+					client_fd,
+					USOCKIT_PROTOCOL_MESSAGE_TYPE_CHILD_EXIT,
+					child_exit_payload,
+					USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE
+				);
+			(void)ret_status;
+		}
+
+		close(client_fd);
+	}
+}
+
+static inline void usockit_server_wait_queue_report(const struct usockit_server_wait_queue* const wait_queue) {
+	assert(wait_queue != cross_support_nullptr);
+
+	const unsigned long long waited_count =
+		(wait_queue->admitted_count + wait_queue->timed_out_count + wait_queue->gone_count);
+
+	if((waited_count == 0) && (wait_queue->full_count == 0)) {
+		return;
+	}
+
+	fprintf(
+		stderr,
+		"usockit: %llu clients waited for %llu ms in total (longest: %llu ms;"
+		" admitted: %llu, timed out: %llu, gone: %llu, rejected because the queue was full: %llu)\n",
+		waited_count,
+		(unsigned long long)(wait_queue->waited_ns / 1000000),
+		(unsigned long long)(wait_queue->longest_wait_ns / 1000000),
+		wait_queue->admitted_count,
+		wait_queue->timed_out_count,
+		wait_queue->gone_count,
+		wait_queue->full_count
+	);
+}
+
+static void* usockit_server_thread_routine_pty_output(void* const arg_ptr) {
+	assert(arg_ptr != cross_support_nullptr);
+
+	const struct usockit_server_thread_routine_pty_output_arg arg =
+		*(const struct usockit_server_thread_routine_pty_output_arg*)arg_ptr;
+
+	usockit_server_set_thread_name("pty_output");
+	usockit_server_block_sigpipe();
+
+	usockit_server_resize_screen(arg.pty_output_info, arg.pty_master_fd);
+
+	do {
+		const enum usockit_server_wait_result wait_result =
+			usockit_server_wait_readable(
+				arg.pty_master_fd,
+				arg.shutdown_fd,
+				arg.upgrade_info->notify_fds[PIPE_READ_INDEX]
+			);
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN) {
+			// the child is gone, but whatever it wrote right before that is still waiting in the pty
+			struct pollfd pfd = { .fd = arg.pty_master_fd, .events = POLLIN };
+			while((poll(&pfd, 1, 0) > 0) && usockit_server_forward_pty_output(arg.pty_master_fd, arg.pty_output_info));
+
+			usockit_server_end_pty_output(arg.pty_output_info);
+			return cross_support_nullptr;
+		}
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_UPGRADE) {
+			// output that isn't read yet stays in the pty, which outlives the upgrade
+			usockit_server_park_for_upgrade(arg.upgrade_info);
+			continue;
+		}
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_FAILURE) {
+			// TODO: poll(2) error handling
+			perror("poll(2)");
+			continue;
+		}
+
+		if(!usockit_server_forward_pty_output(arg.pty_master_fd, arg.pty_output_info)) {
+			usockit_server_end_pty_output(arg.pty_output_info);
+			return cross_support_nullptr;
+		}
+	} while(true);
+}
+
+static void* usockit_server_thread_routine_observers(void* const arg_ptr) {
+	assert(arg_ptr != cross_support_nullptr);
+
+	const struct usockit_server_thread_routine_observers_arg arg =
+		*(const struct usockit_server_thread_routine_observers_arg*)arg_ptr;
+
+	usockit_server_set_thread_name("observers");
+	usockit_server_block_sigpipe();
+
+	struct usockit_server_pty_output_info* const pty_output_info = arg.pty_output_info;
+
+	struct usockit_server_observer observers[USOCKIT_SERVER_OBSERVERS_MAX];
+	size_t observers_count = 0;
+
+	enum {
+		POLLFD_NOTIFY,
+		POLLFD_OBSERVER_SOCKET,
+		POLLFD_SHUTDOWN,
+		POLLFD_UPGRADE,
+		POLLFD_FIRST_OBSERVER,
+	};
+	struct pollfd pfds[POLLFD_FIRST_OBSERVER + USOCKIT_SERVER_OBSERVERS_MAX];
+
+	// once shutting down, no more observers are accepted, but the ones that are connected still get the rest of the
+	// output, followed by the exit status of the child
+	bool shutting_down = false;
+	bool child_exit_pending = false;
+	unsigned char child_exit_message[USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE + USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE];
+
+	do {
+		pthread_mutex_lock(&(pty_output_info->mutex));
+
+		// drained while holding the mutex, so that output that comes in from now on notifies us again
+		usockit_server_drain_notifier(pty_output_info->observers_notify_fds[PIPE_READ_INDEX]);
+		pty_output_info->observers_notified = false;
+
+		const bool output_ended = pty_output_info->output_ended;
+		size_t pending_count = 0;
+
+		if(child_exit_pending && output_ended) {
+			usockit_server_output_ring_append(
+				pty_output_info->observer_ring,
+				child_exit_message,
+				sizeof child_exit_message
+			);
+			child_exit_pending = false;
+		}
+
+		for(size_t i = 0; i < observers_count;) {
+			const enum usockit_server_observer_flush_result flush_result =
+				usockit_server_flush_observer(pty_output_info->observer_ring, &(observers[i]));
+
+			if(flush_result == USOCKIT_SERVER_OBSERVER_FLUSH_RESULT_GONE) {
+				usockit_server_remove_observer(observers, &observers_count, i);
+				continue;
+			}
+
+			// observers that are caught up are still polled for, just to notice when they hang up
+			pfds[POLLFD_FIRST_OBSERVER + i].fd = observers[i].fd;
+			pfds[POLLFD_FIRST_OBSERVER + i].events = 0;
+
+			if(flush_result == USOCKIT_SERVER_OBSERVER_FLUSH_RESULT_PENDING) {
+				pfds[POLLFD_FIRST_OBSERVER + i].events = POLLOUT;
+				++pending_count;
+			}
+
+			++i;
+		}
+
+		pthread_mutex_unlock(&(pty_output_info->mutex));
+
+		if(shutting_down && output_ended && (pending_count == 0)) {
+			break;
+		}
+
+		// poll(2) ignores negative file descriptors
+		pfds[POLLFD_NOTIFY].fd = pty_output_info->observers_notify_fds[PIPE_READ_INDEX];
+		pfds[POLLFD_OBSERVER_SOCKET].fd = (shutting_down ? -1 : arg.observer_socket_fd);
+		pfds[POLLFD_SHUTDOWN].fd = (shutting_down ? -1 : arg.shutdown_fd);
+		pfds[POLLFD_UPGRADE].fd = (shutting_down ? -1 : arg.upgrade_info->notify_fds[PIPE_READ_INDEX]);
+		for(size_t i = 0; i < POLLFD_FIRST_OBSERVER; ++i) {
+			pfds[i].events = POLLIN;
+		}
+
+		// observers that don't take the rest of the output in time are cut off, just like slow ones are otherwise
+		const int timeout_ms = ((shutting_down && output_ended) ? USOCKIT_SERVER_CLIENT_SEND_TIMEOUT_MS : -1);
+
+		errno = 0;
+		const int ret = poll(pfds, (nfds_t)(POLLFD_FIRST_OBSERVER + observers_count), timeout_ms);
+
+		if(ret == 0) {
+			break;
+		}
+
+		if(ret == -1) {
+			if(errno != EINTR) {
+				// TODO: poll(2) error handling
+				perror("poll(2)");
+			}
+			continue;
+		}
+
+		if(pfds[POLLFD_SHUTDOWN].revents != 0) {
+			shutting_down = true;
+
+			child_exit_pending =
+				usockit_server_get_child_exit_payload(
+					arg.upgrade_info,
+					(child_exit_message + USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE)
+				);
+			usockit_protocol_encode_message_header(
+				child_exit_message,
+				USOCKIT_PROTOCOL_MESSAGE_TYPE_CHILD_EXIT,
+				USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE
+			);
+
+			continue;
+		}
+
+		if(pfds[POLLFD_UPGRADE].revents != 0) {
+			usockit_server_park_for_upgrade(arg.upgrade_info);
+			continue;
+		}
+
+		// backwards, since removing an observer moves the last one into its place
+		for(size_t i = observers_count; i > 0; --i) {
+			if((pfds[POLLFD_FIRST_OBSERVER + i - 1].revents & (POLLHUP | POLLERR | POLLNVAL)) != 0) {
+				usockit_server_remove_observer(observers, &observers_count, (i - 1));
+			}
+		}
+
+		if(pfds[POLLFD_OBSERVER_SOCKET].revents != 0) {
+			usockit_server_accept_observer(arg.observer_socket_fd, pty_output_info, observers, &observers_count);
+		}
+	} while(true);
+
+	while(observers_count > 0) {
+		usockit_server_remove_observer(observers, &observers_count, (observers_count - 1));
+	}
+
+	return cross_support_nullptr;
+}
+
+static void* usockit_server_thread_routine_control(void* const arg_ptr) {
+	assert(arg_ptr != cross_support_nullptr);
+
+	const struct usockit_server_thread_routine_control_arg arg =
+		*(const struct usockit_server_thread_routine_control_arg*)arg_ptr;
+
+	usockit_server_set_thread_name("control");
+	usockit_server_block_sigpipe();
+
+	do {
+		const enum usockit_server_wait_result wait_result =
+			usockit_server_wait_readable(
+				arg.control_socket_fd,
+				arg.shutdown_fd,
+				arg.upgrade_info->notify_fds[PIPE_READ_INDEX]
+			);
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN) {
+			return cross_support_nullptr;
+		}
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_UPGRADE) {
+			usockit_server_park_for_upgrade(arg.upgrade_info);
+			continue;
+		}
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_FAILURE) {
+			// TODO: poll(2) error handling
+			perror("poll(2)");
+			continue;
+		}
+
+		// same as with the accept thread
+		#if USOCKIT_SERVER_ACCEPT4_SUPPORT
+			errno = 0;
+			const int control_client_fd =
+				accept4(arg.control_socket_fd, cross_support_nullptr, cross_support_nullptr, SOCK_CLOEXEC);
+			if(control_client_fd == -1) {
+				// TODO: accept4(2) error handling
+				perror("accept4(2)");
+				continue;
+			}
+		#else
+			errno = 0;
+			const int control_client_fd = accept(arg.control_socket_fd, cross_support_nullptr, cross_support_nullptr);
+			if(control_client_fd == -1) {
+				// TODO: accept(2) error handling
+				perror("accept(2)");
+				continue;
+			}
+
+			(void)fcntl(control_client_fd, F_SETFD, FD_CLOEXEC);
+		#endif
+
+		usockit_server_serve_control_client(&arg, control_client_fd);
+
+		close(control_client_fd);
+	} while(true);
+}
+
+static inline void usockit_server_serve_control_client(
+	const struct usockit_server_thread_routine_control_arg* const arg,
+	const int control_client_fd
+) {
+	assert(arg != cross_support_nullptr);
+
+	char command[USOCKIT_SERVER_CONTROL_COMMAND_MAX_SIZE + 1];
+	size_t command_size = 0;
+
+	// the command ends at the first newline character or when the client shuts down writing
+	bool command_complete = false;
+	while(!command_complete && (command_size < USOCKIT_SERVER_CONTROL_COMMAND_MAX_SIZE)) {
+		struct pollfd pfd = {
+			.fd = control_client_fd,
+			.events = POLLIN,
+		};
+
+		errno = 0;
+		const int ret = poll(&pfd, 1, USOCKIT_SERVER_CONTROL_TIMEOUT_MS);
+
+		if(ret == 0) {
+			return;
+		}
+
+		if(ret == -1) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			// TODO: poll(2) error handling
+			perror("poll(2)");
+			return;
+		}
+
+		errno = 0;
+		const ssize_t readc =
+			read(
+				control_client_fd,
+				(command + command_size),
+				(USOCKIT_SERVER_CONTROL_COMMAND_MAX_SIZE - command_size)
+			);
+
+		if(readc < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			// TODO: read(2) error handling
+			perror("read(2)");
+			return;
+		}
+
+		if(readc == 0) {
+			command_complete = true;
+			break;
+		}
+
+		char* const newline = memchr((command + command_size), '\n', (size_t)readc);
+		command_size += (size_t)readc;
+
+		if(newline != cross_support_nullptr) {
+			command_size = (size_t)(newline - command);
+			command_complete = true;
+		}
+	}
+
+	char reply[USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE];
+
+	if(command_complete) {
+		if((command_size > 0) && (command[command_size - 1] == '\r')) {
+			--command_size;
+		}
+		command[command_size] = '\0';
+
+		usockit_server_run_control_command(arg, command, reply);
+	} else {
+		(void)snprintf(reply, sizeof reply, "error: command too long\n");
+	}
+
+	// the reply always fits into the socket buffer, so this doesn't block
+	const ret_status_t ret_status = write_all(control_client_fd, reply, strlen(reply));
+	if(ret_status != RET_STATUS_SUCCESS) {
+		// TODO: write(2) error handling
+		perror("write(2)");
+	}
+}
+
+static inline void usockit_server_run_control_command(
+	const struct usockit_server_thread_routine_control_arg* const arg,
+	const const_cstr_t command,
+	char reply[const USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE]
+) {
+	assert(arg != cross_support_nullptr);
+	assert(command != cross_support_nullptr);
+	assert(reply != cross_support_nullptr);
+
+	if(strcmp(command, "status") == 0) {
+		usockit_server_control_status(arg, reply);
+		return;
+	}
+
+	if(strcmp(command, "kill") == 0) {
+		usockit_server_control_signal(arg, SIGKILL, reply);
+		return;
+	}
+
+	if(strncmp(command, "signal ", 7) == 0) {
+		const int signum = usockit_server_parse_signal(command + 7);
+		if(signum == 0) {
+			(void)snprintf(
+				reply,
+				USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE,
+				"error: %s: invalid signal\n",
+				(command + 7)
+			);
+			return;
+		}
+
+		usockit_server_control_signal(arg, signum, reply);
+		return;
+	}
+
+	if(strcmp(command, "flush") == 0) {
+		usockit_server_control_flush(arg, reply);
+		return;
+	}
+
+	if(strncmp(command, "resize ", 7) == 0) {
+		unsigned short rows;
+		unsigned short cols;
+		if(!usockit_server_parse_window_size((command + 7), &rows, &cols)) {
+			(void)snprintf(
+				reply,
+				USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE,
+				"error: %s: invalid window size; expected \"<rows> <cols>\"\n",
+				(command + 7)
+			);
+			return;
+		}
+
+		usockit_server_control_resize(arg, rows, cols, reply);
+		return;
+	}
+
+	(void)snprintf(reply, USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE, "error: %s: unknown command\n", command);
+}
+
+static inline void usockit_server_control_status(
+	const struct usockit_server_thread_routine_control_arg* const arg,
+	char reply[const USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE]
+) {
+	assert(arg != cross_support_nullptr);
+	assert(reply != cross_support_nullptr);
+
+	const bool client_connected = atomic_load(&(arg->client_ready_info->slot_occupied));
+
+	// only reported if connections may wait for the slot at all
+	char waiting_str[32] = "";
+	if(arg->client_ready_info->wait_queue != cross_support_nullptr) {
+		(void)snprintf(
+			waiting_str,
+			sizeof waiting_str,
+			" waiting=%zu",
+			atomic_load(&(arg->client_ready_info->wait_queue->length))
+		);
+	}
+
+	pthread_mutex_lock(&(arg->upgrade_info->mutex));
+	const bool child_exited = arg->upgrade_info->child_exited;
+	pthread_mutex_unlock(&(arg->upgrade_info->mutex));
+
+	// how much was written into the stdin that the child program didn't read yet; -1 if unknown
+	long long stdin_pending_size = -1;
+
+	if(arg->worker_pool != cross_support_nullptr) {
+		#if USOCKIT_SERVER_PIPE_FIONREAD_SUPPORT
+			stdin_pending_size = 0;
+			for(size_t i = 0; i < arg->worker_pool->count; ++i) {
+				int pending_size = 0;
+				if(ioctl(arg->worker_pool->workers[i].stdin_fd, FIONREAD, &pending_size) == 0) {
+					stdin_pending_size += pending_size;
+				}
+			}
+		#endif
+
+		if(stdin_pending_size >= 0) {
+			(void)snprintf(
+				reply,
+				USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE,
+				"ok workers=%zu client=%s%s stdin=%lld\n",
+				arg->worker_pool->count,
+				(client_connected ? "yes" : "no"),
+				waiting_str,
+				stdin_pending_size
+			);
+		} else {
+			(void)snprintf(
+				reply,
+				USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE,
+				"ok workers=%zu client=%s%s stdin=?\n",
+				arg->worker_pool->count,
+				(client_connected ? "yes" : "no"),
+				waiting_str
+			);
+		}
+
+		return;
+	}
+
+	pid_t child_pid = -1;
+	int child_stdin_fd = -1;
+	long long queue_size = -1;
+
+	if(arg->restart_info != cross_support_nullptr) {
+		child_pid = atomic_load(&(arg->restart_info->signalable_child_pid));
+
+		// the client_connection thread may be blocked writing while holding the mutex; the sizes are unknown then
+		if(pthread_mutex_trylock(&(arg->restart_info->mutex)) == 0) {
+			if(arg->restart_info->child_up) {
+				child_stdin_fd = *(arg->child_stdin_fd_ptr);
+			}
+			queue_size = (long long)(arg->restart_info->queue_size);
+
+			#if USOCKIT_SERVER_PIPE_FIONREAD_SUPPORT
+				int pending_size = 0;
+				if((child_stdin_fd != -1) && (ioctl(child_stdin_fd, FIONREAD, &pending_size) == 0)) {
+					stdin_pending_size = pending_size;
+				}
+			#endif
+
+			pthread_mutex_unlock(&(arg->restart_info->mutex));
+		}
+	} else if(!child_exited) {
+		child_pid = *(arg->child_pid_ptr);
+		child_stdin_fd = *(arg->child_stdin_fd_ptr);
+
+		#if USOCKIT_SERVER_PIPE_FIONREAD_SUPPORT
+			// in pty mode, the stdin is the master side of the pty, where FIONREAD reports output instead
+			int pending_size = 0;
+			if(!isatty(child_stdin_fd) && (ioctl(child_stdin_fd, FIONREAD, &pending_size) == 0)) {
+				stdin_pending_size = pending_size;
+			}
+		#endif
+	}
+
+	char child_str[24] = "-";
+	if((child_pid != -1) && !child_exited) {
+		(void)snprintf(child_str, sizeof child_str, "%lld", (long long)child_pid);
+	}
+
+	char stdin_str[24] = "?";
+	if(stdin_pending_size >= 0) {
+		(void)snprintf(stdin_str, sizeof stdin_str, "%lld", stdin_pending_size);
+	}
+
+	if(arg->restart_info == cross_support_nullptr) {
+		(void)snprintf(
+			reply,
+			USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE,
+			"ok child=%s client=%s%s stdin=%s\n",
+			child_str,
+			(client_connected ? "yes" : "no"),
+			waiting_str,
+			stdin_str
+		);
+		return;
+	}
+
+	char queue_str[24] = "?";
+	if(queue_size >= 0) {
+		(void)snprintf(queue_str, sizeof queue_str, "%lld", queue_size);
+	}
+
+	(void)snprintf(
+		reply,
+		USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE,
+		"ok child=%s client=%s%s stdin=%s queue=%s\n",
+		child_str,
+		(client_connected ? "yes" : "no"),
+		waiting_str,
+		stdin_str,
+		queue_str
+	);
+}
+
+static inline void usockit_server_control_signal(
+	const struct usockit_server_thread_routine_control_arg* const arg,
+	const int signum,
+	char reply[const USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE]
+) {
+	assert(arg != cross_support_nullptr);
+	assert(signum > 0);
+	assert(reply != cross_support_nullptr);
+
+	pthread_mutex_lock(&(arg->upgrade_info->mutex));
+	const bool child_exited = arg->upgrade_info->child_exited;
+	pthread_mutex_unlock(&(arg->upgrade_info->mutex));
+
+	if(child_exited) {
+		(void)snprintf(reply, USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE, "error: the child program already exited\n");
+		return;
+	}
+
+	if(arg->worker_pool != cross_support_nullptr) {
+		size_t signaled_count = 0;
+
+		// workers that were reaped already make kill(2) fail with ESRCH, which is why they aren't counted
+		for(size_t i = 0; i < arg->worker_pool->count; ++i) {
+			if(kill(arg->worker_pool->workers[i].pid, signum) == 0) {
+				++signaled_count;
+			}
+		}
+
+		(void)snprintf(reply, USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE, "ok signaled=%zu\n", signaled_count);
+		return;
+	}
+
+	pid_t child_pid;
+	if(arg->restart_info != cross_support_nullptr) {
+		child_pid = atomic_load(&(arg->restart_info->signalable_child_pid));
+	} else {
+		child_pid = *(arg->child_pid_ptr);
+	}
+
+	if(child_pid == -1) {
+		(void)snprintf(reply, USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE, "error: the child program is down\n");
+		return;
+	}
+
+	errno = 0;
+	if(kill(child_pid, signum) != 0) {
+		(void)snprintf(reply, USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE, "error: kill(2): %s\n", strerror(errno));
+		return;
+	}
+
+	(void)snprintf(reply, USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE, "ok child=%lld\n", (long long)child_pid);
+}
+
+static inline void usockit_server_control_flush(
+	const struct usockit_server_thread_routine_control_arg* const arg,
+	char reply[const USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE]
+) {
+	assert(arg != cross_support_nullptr);
+	assert(reply != cross_support_nullptr);
+
+	struct usockit_server_restart_info* const restart_info = arg->restart_info;
+
+	if(restart_info == cross_support_nullptr) {
+		(void)snprintf(
+			reply,
+			USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE,
+			"error: there is no queue; input is only queued with --restart\n"
+		);
+		return;
+	}
+
+	if(pthread_mutex_trylock(&(restart_info->mutex)) != 0) {
+		(void)snprintf(
+			reply,
+			USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE,
+			"error: busy writing into the stdin of the child program; try again\n"
+		);
+		return;
+	}
+
+	const size_t discarded_size = restart_info->queue_size;
+	restart_info->queue_size = 0;
+	restart_info->queue_head_position += discarded_size;
+	++(restart_info->queue_flush_generation);
+
+	if(discarded_size > 0) {
+		// the client_connection thread may be waiting for room in the queue
+		usockit_server_notify(restart_info->notify_fds[PIPE_WRITE_INDEX]);
+	}
+
+	pthread_mutex_unlock(&(restart_info->mutex));
+
+	(void)snprintf(reply, USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE, "ok discarded=%zu\n", discarded_size);
+}
+
+static inline void usockit_server_control_resize(
+	const struct usockit_server_thread_routine_control_arg* const arg,
+	const unsigned short rows,
+	const unsigned short cols,
+	char reply[const USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE]
+) {
+	assert(arg != cross_support_nullptr);
+	assert((rows > 0) && (cols > 0));
+	assert(reply != cross_support_nullptr);
+
+	if(arg->pty_output_info == cross_support_nullptr) {
+		(void)snprintf(
+			reply,
+			USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE,
+			"error: there is no window; the child program only has one with --pty\n"
+		);
+		return;
+	}
+
+	pthread_mutex_lock(&(arg->upgrade_info->mutex));
+	const bool child_exited = arg->upgrade_info->child_exited;
+	pthread_mutex_unlock(&(arg->upgrade_info->mutex));
+
+	if(child_exited) {
+		(void)snprintf(reply, USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE, "error: the child program already exited\n");
+		return;
+	}
+
+	#if USOCKIT_SERVER_PTY_SUPPORT
+		// the output that the child program draws for the new size is only fed into the screen after it was resized,
+		// since the pty_output thread needs the lock for that
+		pthread_mutex_lock(&(arg->pty_output_info->mutex));
+
+		const ret_status_t ret_status = usockit_server_screen_resize(arg->pty_output_info->screen, rows, cols);
+		if(ret_status != RET_STATUS_SUCCESS) {
+			const int resize_errno = errno;
+			pthread_mutex_unlock(&(arg->pty_output_info->mutex));
+
+			(void)snprintf(
+				reply,
+				USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE,
+				"error: resizing the screen: %s\n",
+				strerror(resize_errno)
+			);
+			return;
+		}
+
+		struct winsize window_size;
+		zeroset_lvalue(window_size);
+		window_size.ws_row = rows;
+		window_size.ws_col = cols;
+
+		errno = 0;
+		const int ret = ioctl(*(arg->child_stdin_fd_ptr), TIOCSWINSZ, &window_size);
+		const int ioctl_errno = errno;
+
+		pthread_mutex_unlock(&(arg->pty_output_info->mutex));
+
+		if(ret != 0) {
+			(void)snprintf(
+				reply,
+				USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE,
+				"error: ioctl(2): %s\n",
+				strerror(ioctl_errno)
+			);
+			return;
+		}
+
+		(void)snprintf(reply, USOCKIT_SERVER_CONTROL_REPLY_MAX_SIZE, "ok rows=%u cols=%u\n", rows, cols);
+	#else
+		// pty mode isn't possible without pty support in the first place
+		cross_support_unreachable();
+	#endif
+}
+
+static inline bool usockit_server_parse_window_size(const const_cstr_t str,
+                                                    unsigned short* const rows_ptr,
+                                                    unsigned short* const cols_ptr) {
+	assert(str != cross_support_nullptr);
+	assert(rows_ptr != cross_support_nullptr);
+	assert(cols_ptr != cross_support_nullptr);
+
+	unsigned short* const dimension_ptrs[] = { rows_ptr, cols_ptr };
+	const char* it = str;
+
+	for(size_t i = 0; i < array_size(dimension_ptrs); ++i) {
+		if(i > 0) {
+			if(*it != ' ') {
+				return false;
+			}
+			++it;
+		}
+
+		if((*it < '1') || (*it > '9')) {
+			return false;
+		}
+
+		unsigned long dimension = 0;
+		for(; (*it >= '0') && (*it <= '9'); ++it) {
+			dimension = ((dimension * 10) + (unsigned long)(*it - '0'));
+
+			if(dimension > USHRT_MAX) {
+				return false;
+			}
+		}
+
+		*(dimension_ptrs[i]) = (unsigned short)dimension;
+	}
+
+	return (*it == '\0');
+}
+
+static inline int usockit_server_parse_signal(const_cstr_t str) {
+	assert(str != cross_support_nullptr);
+
+	if(strncmp(str, "SIG", 3) == 0) {
+		str += 3;
+	}
+
+	static const struct {
+		const_cstr_t name;
+		int signum;
+	} signals[] = {
+		{ "HUP",  SIGHUP  },
+		{ "INT",  SIGINT  },
+		{ "QUIT", SIGQUIT },
+		{ "KILL", SIGKILL },
+		{ "USR1", SIGUSR1 },
+		{ "USR2", SIGUSR2 },
+		{ "TERM", SIGTERM },
+		{ "CONT", SIGCONT },
+		{ "STOP", SIGSTOP },
+		{ "TSTP", SIGTSTP },
+		{ "ALRM", SIGALRM },
+	};
+
+	for(size_t i = 0; i < array_size(signals); ++i) {
+		if(strcmp(str, signals[i].name) == 0) {
+			return signals[i].signum;
+		}
+	}
+
+	if((*str < '1') || (*str > '9')) {
+		return 0;
+	}
+
+	int signum = 0;
+	for(; *str != '\0'; ++str) {
+		if((*str < '0') || (*str > '9')) {
+			return 0;
+		}
+
+		signum = ((signum * 10) + (*str - '0'));
+
+		if(signum > 128) {
+			return 0;
+		}
+	}
+
+	return signum;
+}
+
+static inline enum usockit_server_observer_flush_result usockit_server_flush_observer(
+	const struct usockit_server_output_ring* const observer_ring,
+	struct usockit_server_observer* const observer
+) {
+	assert(observer_ring != cross_support_nullptr);
+	assert(observer != cross_support_nullptr);
+
+	// the observer socket is non-blocking, so each write(2) only takes what fits into the socket buffer
+	while(observer->snapshot != cross_support_nullptr) {
+		errno = 0;
+		const ssize_t writec =
+			write(
+				observer->fd,
+				(observer->snapshot + observer->snapshot_sent_size),
+				(observer->snapshot_size - observer->snapshot_sent_size)
+			);
+
+		if(writec < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			return (((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				        ? USOCKIT_SERVER_OBSERVER_FLUSH_RESULT_PENDING
+				        : USOCKIT_SERVER_OBSERVER_FLUSH_RESULT_GONE);
+		}
+
+		observer->snapshot_sent_size += (size_t)writec;
+
+		if(observer->snapshot_sent_size == observer->snapshot_size) {
+			free(observer->snapshot);
+			observer->snapshot = cross_support_nullptr;
+		}
+	}
+
+	do {
+		struct iovec iov[2];
+		const int iovcnt = usockit_server_output_ring_peek(observer_ring, observer->ring_offset, iov);
+
+		if(iovcnt == 0) {
+			return USOCKIT_SERVER_OBSERVER_FLUSH_RESULT_CAUGHT_UP;
+		}
+
+		if(iovcnt < 0) {
+			// the output that the observer would get next is already overwritten
+			return USOCKIT_SERVER_OBSERVER_FLUSH_RESULT_GONE;
+		}
+
+		errno = 0;
+		const ssize_t writec = writev(observer->fd, iov, iovcnt);
+
+		if(writec < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			return (((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				        ? USOCKIT_SERVER_OBSERVER_FLUSH_RESULT_PENDING
+				        : USOCKIT_SERVER_OBSERVER_FLUSH_RESULT_GONE);
+		}
+
+		observer->ring_offset += (uint64_t)writec;
+	} while(true);
+}
+
+static inline void usockit_server_accept_observer(const int observer_socket_fd,
+                                                  struct usockit_server_pty_output_info* const pty_output_info,
+                                                  struct usockit_server_observer observers[const],
+                                                  size_t* const observers_count_ptr) {
+	assert(pty_output_info != cross_support_nullptr);
+	assert(observers != cross_support_nullptr);
+	assert(observers_count_ptr != cross_support_nullptr);
+
+	errno = 0;
+	const int observer_fd = accept(observer_socket_fd, cross_support_nullptr, cross_support_nullptr);
+	if(observer_fd == -1) {
+		// TODO: accept(2) error handling
+		perror("accept(2)");
+		return;
+	}
+
+	if(*observers_count_ptr == USOCKIT_SERVER_OBSERVERS_MAX) {
+		// same as in usockit_server_thread_routine_accept(); a fresh socket takes the message without blocking
+		static const char* const msg = USOCKIT_PROTOCOL_FUCK_OFF_STRING;
+		#define TMP_GCC_DIAGNOSTIC_IGNORED_UNUSED_RESULT_SUPPORTED  CROSS_SUPPORT_GCC_LEAST(4,6)
+		#if TMP_GCC_DIAGNOSTIC_IGNORED_UNUSED_RESULT_SUPPORTED
+			#pragma GCC diagnostic push
+			#pragma GCC diagnostic ignored "-Wunused-result"
+		#endif
+		(void)(write_all(observer_fd, msg, strlen(msg)));
+		#if TMP_GCC_DIAGNOSTIC_IGNORED_UNUSED_RESULT_SUPPORTED
+			#pragma GCC diagnostic pop
+		#endif
+		#undef TMP_GCC_DIAGNOSTIC_IGNORED_UNUSED_RESULT_SUPPORTED
+
+		close(observer_fd);
+		return;
+	}
+
+	// not meant for the child (nor for the server we'd re-execute ourselves with) and never allowed to block us
+	errno = 0;
+	if((fcntl(observer_fd, F_SETFD, FD_CLOEXEC) != 0) || (fcntl(observer_fd, F_SETFL, O_NONBLOCK) != 0)) {
+		errno_push();
+		close(observer_fd);
+		errno_pop();
+
+		// TODO: fcntl(2) error handling
+		perror("fcntl(2)");
+		return;
+	}
+
+	// observers only get to watch; anything they send from now on fails with EPIPE on their end
+	(void)shutdown(observer_fd, SHUT_RD);
+
+	struct usockit_server_observer* const observer = &(observers[*observers_count_ptr]);
+	zeroset_lvalue(*observer);
+	observer->fd = observer_fd;
+
+	// like in usockit_server_attach_client(), the snapshot is taken at the very offset that the observer continues at
+	pthread_mutex_lock(&(pty_output_info->mutex));
+
+	unsigned char* snapshot = cross_support_nullptr;
+	size_t snapshot_size = 0;
+	const ret_status_t ret_status = usockit_server_screen_render(pty_output_info->screen, &snapshot, &snapshot_size);
+	observer->ring_offset = usockit_server_output_ring_end(pty_output_info->observer_ring);
+
+	pthread_mutex_unlock(&(pty_output_info->mutex));
+
+	if(ret_status != RET_STATUS_SUCCESS) {
+		// TODO: usockit_server_screen_render() error handling
+		// the observer still gets the output from now on, the screen just builds up from nothing
+		perror("usockit_server_screen_render");
+	} else {
+		// the header goes in front of the snapshot, so that it can be sent in one go
+		errno = 0;
+		unsigned char* const snapshot_message =
+			realloc(snapshot, (USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE + snapshot_size));
+		cross_support_if_unlikely(snapshot_message == cross_support_nullptr) {
+			errno_push();
+			free(snapshot);
+			errno_pop();
+
+			// TODO: realloc(3) error handling
+			perror("realloc(3)");
+		} else {
+			memmove((snapshot_message + USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE), snapshot_message, snapshot_size);
+			usockit_protocol_encode_message_header(
+				snapshot_message,
+				USOCKIT_PROTOCOL_MESSAGE_TYPE_SNAPSHOT,
+				(uint32_t)snapshot_size
+			);
+
+			observer->snapshot = snapshot_message;
+			observer->snapshot_size = (USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE + snapshot_size);
+		}
+	}
+
+	++(*observers_count_ptr);
+}
+
+static inline void usockit_server_remove_observer(struct usockit_server_observer observers[const],
+                                                  size_t* const observers_count_ptr,
+                                                  const size_t index) {
+	assert(observers != cross_support_nullptr);
+	assert(observers_count_ptr != cross_support_nullptr);
+	assert(index < *observers_count_ptr);
+
+	close(observers[index].fd);
+	free(observers[index].snapshot);
+
+	--(*observers_count_ptr);
+	observers[index] = observers[*observers_count_ptr];
+}
+
+static inline bool usockit_server_forward_pty_output(const int pty_master_fd,
+                                                     struct usockit_server_pty_output_info* const pty_output_info) {
+	assert(pty_output_info != cross_support_nullptr);
+
+	unsigned char buffer[4096];
+
+	errno = 0;
+	const ssize_t readc = read(pty_master_fd, buffer, array_size(buffer));
+
+	if(readc > 0) {
+		const ret_status_t ret_status = write_all(STDOUT_FILENO, buffer, (size_t)readc);
+		if(ret_status != RET_STATUS_SUCCESS) {
+			// TODO: write(2) error handling
+			// the output is dropped, but we keep on reading it, so that the child doesn't block on a full pty
+		}
+
+		pthread_mutex_lock(&(pty_output_info->mutex));
+
+		usockit_server_screen_feed(pty_output_info->screen, buffer, (size_t)readc);
+
+		if(pty_output_info->attached_client_fd != -1) {
+			const ret_status_t send_ret_status =
+				usockit_server_send_message(
+					pty_output_info->attached_client_fd,
+					USOCKIT_PROTOCOL_MESSAGE_TYPE_OUTPUT,
+					buffer,
+					(size_t)readc
+				);
+
+			if(send_ret_status != RET_STATUS_SUCCESS) {
+				// the client either is gone or doesn't keep up with the output, in which case it would hold up the
+				// child along with it. either way, the client_connection thread notices the shutdown and releases it
+				(void)shutdown(pty_output_info->attached_client_fd, SHUT_RDWR);
+				pty_output_info->attached_client_fd = -1;
+			}
+		}
+
+		if(pty_output_info->observer_ring != cross_support_nullptr) {
+			// the only copy of the output that the observers get; the observers thread sends it to every one of them
+			// straight from the ring
+			unsigned char header[USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE];
+			usockit_protocol_encode_message_header(header, USOCKIT_PROTOCOL_MESSAGE_TYPE_OUTPUT, (uint32_t)readc);
+
+			usockit_server_output_ring_append(pty_output_info->observer_ring, header, sizeof header);
+			usockit_server_output_ring_append(pty_output_info->observer_ring, buffer, (size_t)readc);
+
+			if(!(pty_output_info->observers_notified)) {
+				pty_output_info->observers_notified = true;
+				usockit_server_notify(pty_output_info->observers_notify_fds[PIPE_WRITE_INDEX]);
+			}
+		}
+
+		pthread_mutex_unlock(&(pty_output_info->mutex));
+
+		return true;
+	}
+
+	if((readc == -1) && (errno == EINTR)) {
+		return true;
+	}
+
+	// reading from the master fails with EIO once no process has the slave open anymore
+	return false;
+}
+
+static inline void usockit_server_end_pty_output(struct usockit_server_pty_output_info* const pty_output_info) {
+	assert(pty_output_info != cross_support_nullptr);
+
+	pthread_mutex_lock(&(pty_output_info->mutex));
+
+	pty_output_info->output_ended = true;
+	pthread_cond_broadcast(&(pty_output_info->output_ended_cond));
+
+	if(pty_output_info->observer_ring != cross_support_nullptr) {
+		usockit_server_notify(pty_output_info->observers_notify_fds[PIPE_WRITE_INDEX]);
+	}
+
+	pthread_mutex_unlock(&(pty_output_info->mutex));
+}
+
+static inline void usockit_server_resize_screen(struct usockit_server_pty_output_info* const pty_output_info,
+                                                const int pty_master_fd) {
+	assert(pty_output_info != cross_support_nullptr);
+
+	#if USOCKIT_SERVER_PTY_SUPPORT
+		struct winsize window_size;
+		if((ioctl(pty_master_fd, TIOCGWINSZ, &window_size) != 0) ||
+		   (window_size.ws_row == 0) ||
+		   (window_size.ws_col == 0)) {
+
+			return;
+		}
+
+		pthread_mutex_lock(&(pty_output_info->mutex));
+		const ret_status_t ret_status =
+			usockit_server_screen_resize(pty_output_info->screen, window_size.ws_row, window_size.ws_col);
+		pthread_mutex_unlock(&(pty_output_info->mutex));
+
+		if(ret_status != RET_STATUS_SUCCESS) {
+			// TODO: usockit_server_screen_resize() error handling
+			// snapshots are drawn for the default size instead, which is still better than nothing
+			perror("usockit_server_screen_resize");
+		}
+	#else
+		(void)pty_output_info;
+		(void)pty_master_fd;
+	#endif
+}
+
+static inline void usockit_server_attach_client(struct usockit_server_pty_output_info* const pty_output_info,
+                                                const int client_fd,
+                                                const bool send_snapshot) {
+	assert(pty_output_info != cross_support_nullptr);
+
+	// the lock is held from rendering the snapshot until the client is attached, so that the output that follows the
+	// snapshot is exactly the output that the snapshot doesn't include yet
+	pthread_mutex_lock(&(pty_output_info->mutex));
+
+	if(send_snapshot) {
+		unsigned char* snapshot;
+		size_t snapshot_size;
+
+		ret_status_t ret_status = usockit_server_screen_render(pty_output_info->screen, &snapshot, &snapshot_size);
+		if(ret_status != RET_STATUS_SUCCESS) {
+			// the client still gets the output from now on, the screen just builds up from nothing
+			// TODO: usockit_server_screen_render() error handling
+			perror("usockit_server_screen_render");
+		} else {
+			ret_status =
+				usockit_server_send_message(client_fd, USOCKIT_PROTOCOL_MESSAGE_TYPE_SNAPSHOT, snapshot, snapshot_size);
+
+			free(snapshot);
+
+			if(ret_status != RET_STATUS_SUCCESS) {
+				// same as in usockit_server_forward_pty_output()
+				(void)shutdown(client_fd, SHUT_RDWR);
+
+				pthread_mutex_unlock(&(pty_output_info->mutex));
+				return;
+			}
+		}
+	}
+
+	pty_output_info->attached_client_fd = client_fd;
+
+	pthread_mutex_unlock(&(pty_output_info->mutex));
+}
+
+static inline bool usockit_server_get_child_exit_payload(
+	struct usockit_server_upgrade_info* const upgrade_info,
+	unsigned char payload[const USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE]
+) {
+	assert(upgrade_info != cross_support_nullptr);
+
+	pthread_mutex_lock(&(upgrade_info->mutex));
+	const bool status_known = (upgrade_info->child_exited && upgrade_info->child_status_known);
+	const int status = upgrade_info->child_status;
+	pthread_mutex_unlock(&(upgrade_info->mutex));
+
+	if(!status_known) {
+		return false;
+	}
+
+	if(WIFEXITED(status)) {
+		payload[0] = (unsigned char)USOCKIT_PROTOCOL_CHILD_EXIT_KIND_EXITED;
+		payload[1] = (unsigned char)(WEXITSTATUS(status));
+		return true;
+	}
+
+	if(WIFSIGNALED(status)) {
+		payload[0] = (unsigned char)USOCKIT_PROTOCOL_CHILD_EXIT_KIND_SIGNALED;
+		payload[1] = (unsigned char)(WTERMSIG(status));
+		return true;
+	}
+
+	return false;
+}
+
+static inline void usockit_server_send_child_exit(struct usockit_server_upgrade_info* const upgrade_info,
+                                                  struct usockit_server_pty_output_info* const pty_output_info,
+                                                  const int client_fd) {
+	assert(upgrade_info != cross_support_nullptr);
+
+	unsigned char payload[USOCKIT_PROTOCOL_CHILD_EXIT_PAYLOAD_SIZE];
+	if(!usockit_server_get_child_exit_payload(upgrade_info, payload)) {
+		return;
+	}
+
+	// in either case, the client is closed right after, whether it took the message or not
+	ret_status_t ret_status;
+
+	if(pty_output_info == cross_support_nullptr) {
+		ret_status =
+			usockit_server_send_message(client_fd, USOCKIT_PROTOCOL_MESSAGE_TYPE_CHILD_EXIT, payload, sizeof payload);
+		(void)ret_status;
+		return;
+	}
+
+	// the pty_output thread is still forwarding whatever the child wrote right before it exited; the exit comes last.
+	// once the shutdown was notified, the output ends without delay
+	pthread_mutex_lock(&(pty_output_info->mutex));
+
+	while(!(pty_output_info->output_ended)) {
+		pthread_cond_wait(&(pty_output_info->output_ended_cond), &(pty_output_info->mutex));
+	}
+
+	// the client may have been dropped for not keeping up with the output
+	if(pty_output_info->attached_client_fd == client_fd) {
+		ret_status =
+			usockit_server_send_message(client_fd, USOCKIT_PROTOCOL_MESSAGE_TYPE_CHILD_EXIT, payload, sizeof payload);
+		(void)ret_status;
+	}
+
+	pthread_mutex_unlock(&(pty_output_info->mutex));
+}
+
+static inline ret_status_t usockit_server_send_message(const int client_fd,
+                                                       const enum usockit_protocol_message_type type,
+                                                       const void* const payload,
+                                                       const size_t payload_size) {
+	assert((payload != cross_support_nullptr) || (payload_size == 0));
+	assert(payload_size <= UINT32_MAX);
+
+	unsigned char header[USOCKIT_PROTOCOL_MESSAGE_HEADER_SIZE];
+	usockit_protocol_encode_message_header(header, type, (uint32_t)payload_size);
+
+	// the header and the payload go out with a single call, so that a message usually takes up a single skb in the
+	// socket and the client gets it whole
+	struct iovec iov[2] = {
+		{ .iov_base = header,         .iov_len = sizeof header },
+		{ .iov_base = (void*)payload, .iov_len = payload_size  },
+	};
+	size_t iov_index = 0;
+
+	while(iov_index < array_size(iov)) {
+		if(iov[iov_index].iov_len == 0) {
+			++iov_index;
+			continue;
+		}
+
+		errno = 0;
+		const ssize_t writec = writev(client_fd, (iov + iov_index), (int)(array_size(iov) - iov_index));
+
+		if(writec >= 0) {
+			size_t remaining_writec = (size_t)writec;
+
+			while((iov_index < array_size(iov)) && (remaining_writec >= iov[iov_index].iov_len)) {
+				remaining_writec -= iov[iov_index].iov_len;
+				++iov_index;
+			}
+
+			if(remaining_writec > 0) {
+				iov[iov_index].iov_base = ((unsigned char*)(iov[iov_index].iov_base) + remaining_writec);
+				iov[iov_index].iov_len -= remaining_writec;
+			}
+
+			continue;
+		}
+
+		if(errno == EINTR) {
+			continue;
+		}
+
+		if((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+			return RET_STATUS_FAILURE;
+		}
+
+		struct pollfd pfd = { .fd = client_fd, .events = POLLOUT };
+
+		errno = 0;
+		const int ret = poll(&pfd, 1, USOCKIT_SERVER_CLIENT_SEND_TIMEOUT_MS);
+		if(ret == 0) {
+			errno = ETIMEDOUT;
+			return RET_STATUS_FAILURE;
+		}
+		if((ret < 0) && (errno != EINTR)) {
+			return RET_STATUS_FAILURE;
+		}
+	}
+
+	return RET_STATUS_SUCCESS;
+}
+
+static inline void usockit_server_add_delivered(struct usockit_server_delivery* const delivery, const size_t size) {
+	assert(delivery != cross_support_nullptr);
+
+	if(delivery->lost) {
+		return;
+	}
+
+	if(delivery->queued_size > 0) {
+		// whatever was queued is still waiting for a restarted child, so this can't be counted yet; since the queue is
+		// empty whenever the child is up, this only happens when the queue was flushed before it was settled
+		delivery->lost = true;
+		return;
+	}
+
+	delivery->delivered_size += size;
+}
+
+static inline void usockit_server_settle_queued_delivery(
+	struct usockit_server_delivery* const delivery,
+	const struct usockit_server_restart_info* const restart_info
+) {
+	assert(delivery != cross_support_nullptr);
+	assert(restart_info != cross_support_nullptr);
+
+	if((delivery->queued_size == 0) || delivery->lost) {
+		return;
+	}
+
+	if(delivery->queue_flush_generation != restart_info->queue_flush_generation) {
+		delivery->lost = true;
+		return;
+	}
+
+	if(restart_info->queue_head_position < delivery->queued_end_position) {
+		return;
+	}
+
+	delivery->delivered_size += delivery->queued_size;
+	delivery->queued_size = 0;
+}
+
+static inline void usockit_server_settle_client_delivery(struct usockit_server_delivery* const delivery,
+                                                         struct usockit_server_restart_info* const restart_info) {
+	assert(delivery != cross_support_nullptr);
+
+	if(restart_info == cross_support_nullptr) {
+		return;
+	}
+
+	pthread_mutex_lock(&(restart_info->mutex));
+	usockit_server_settle_queued_delivery(delivery, restart_info);
+	pthread_mutex_unlock(&(restart_info->mutex));
+}
+
+static inline enum usockit_server_wait_result usockit_server_wait_queued_delivery(
+	const struct usockit_server_thread_routine_client_connection_arg* const arg,
+	struct usockit_server_delivery* const delivery
+) {
+	assert(arg != cross_support_nullptr);
+	assert(delivery != cross_support_nullptr);
+
+	do {
+		usockit_server_settle_client_delivery(delivery, arg->restart_info);
+
+		if((delivery->queued_size == 0) || delivery->lost) {
+			return USOCKIT_SERVER_WAIT_RESULT_READABLE;
+		}
+
+		// input is only ever queued in supervisor mode
+		assert(arg->restart_info != cross_support_nullptr);
+
+		const enum usockit_server_wait_result wait_result =
+			usockit_server_wait_readable(
+				arg->restart_info->notify_fds[PIPE_READ_INDEX],
+				arg->shutdown_fd,
+				arg->upgrade_info->notify_fds[PIPE_READ_INDEX]
+			);
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_UPGRADE) {
+			usockit_server_park_for_upgrade(arg->upgrade_info);
+			continue;
+		}
+
+		if(wait_result != USOCKIT_SERVER_WAIT_RESULT_READABLE) {
+			return wait_result;
+		}
+
+		usockit_server_drain_notifier(arg->restart_info->notify_fds[PIPE_READ_INDEX]);
+	} while(true);
+}
+
+static inline enum usockit_server_wait_result usockit_server_wait_client_linger(
+	const struct usockit_server_thread_routine_client_connection_arg* const arg,
+	const int client_fd
+) {
+	assert(arg != cross_support_nullptr);
+	assert(arg->linger_ms > 0);
+
+	const uint64_t deadline_ns = (usockit_server_now_ns() + ((uint64_t)(arg->linger_ms) * 1000000));
+
+	do {
+		const uint64_t now_ns = usockit_server_now_ns();
+		if(now_ns >= deadline_ns) {
+			return USOCKIT_SERVER_WAIT_RESULT_TIMEOUT;
+		}
+
+		// rounded up, so that we don't wake up just before the deadline only to go back to sleep for 0 milliseconds
+		const uint64_t remaining_ms = (((deadline_ns - now_ns) + 999999) / 1000000);
+
+		const enum usockit_server_wait_result wait_result =
+			usockit_server_wait_hangup(
+				client_fd,
+				arg->shutdown_fd,
+				arg->upgrade_info->notify_fds[PIPE_READ_INDEX],
+				((remaining_ms > INT_MAX) ? INT_MAX : (int)remaining_ms)
+			);
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_UPGRADE) {
+			usockit_server_park_for_upgrade(arg->upgrade_info);
+			continue;
+		}
+
+		if(wait_result != USOCKIT_SERVER_WAIT_RESULT_TIMEOUT) {
+			return wait_result;
+		}
+	} while(true);
+}
+
+static inline enum usockit_server_wait_result usockit_server_wait_client_input(
+	const struct usockit_server_thread_routine_client_connection_arg* const arg,
+	const int client_fd,
+	struct usockit_server_client_liveness* const liveness
+) {
+	assert(arg != cross_support_nullptr);
+	assert(liveness != cross_support_nullptr);
+	assert((arg->idle_timeout_ms > 0) || (arg->heartbeat_interval_ms > 0));
+
+	const uint64_t idle_timeout_ns = ((uint64_t)(arg->idle_timeout_ms) * 1000000);
+	const uint64_t heartbeat_interval_ns = ((uint64_t)(arg->heartbeat_interval_ms) * 1000000);
+
+	if(liveness->input_since_wait) {
+		liveness->input_since_wait = false;
+		liveness->input_since_heartbeat = true;
+		liveness->idle_since_ns = usockit_server_now_ns();
+	}
+
+	do {
+		const uint64_t now_ns = usockit_server_now_ns();
+
+		if((idle_timeout_ns > 0) && ((now_ns - liveness->idle_since_ns) >= idle_timeout_ns)) {
+			liveness->eviction = USOCKIT_SERVER_EVICTION_IDLE;
+			return USOCKIT_SERVER_WAIT_RESULT_TIMEOUT;
+		}
+
+		if((heartbeat_interval_ns > 0) && (now_ns >= liveness->heartbeat_due_ns)) {
+			// outside of pty mode, the client is sent nothing but a few small messages, so if it didn't even read the
+			// last heartbeat, it's stuck. it would otherwise take a long time for its socket to fill up with heartbeats
+			if(liveness->heartbeat_sent && !(liveness->input_since_heartbeat) &&
+			   (arg->pty_output_info == cross_support_nullptr) && usockit_server_client_has_unread(client_fd)) {
+
+				liveness->eviction = USOCKIT_SERVER_EVICTION_UNRESPONSIVE;
+				return USOCKIT_SERVER_WAIT_RESULT_TIMEOUT;
+			}
+
+			const ret_status_t ret_status =
+				usockit_server_send_client_message(
+					arg->pty_output_info,
+					client_fd,
+					USOCKIT_PROTOCOL_MESSAGE_TYPE_HEARTBEAT,
+					cross_support_nullptr,
+					0
+				);
+
+			if(ret_status != RET_STATUS_SUCCESS) {
+				// the client is gone or didn't make room for the heartbeat in time
+				liveness->eviction = USOCKIT_SERVER_EVICTION_UNRESPONSIVE;
+				return USOCKIT_SERVER_WAIT_RESULT_TIMEOUT;
+			}
+
+			liveness->heartbeat_sent = true;
+			liveness->input_since_heartbeat = false;
+			liveness->heartbeat_due_ns = (now_ns + heartbeat_interval_ns);
+		}
+
+		uint64_t deadline_ns = UINT64_MAX;
+		if(idle_timeout_ns > 0) {
+			deadline_ns = (liveness->idle_since_ns + idle_timeout_ns);
+		}
+		if((heartbeat_interval_ns > 0) && (liveness->heartbeat_due_ns < deadline_ns)) {
+			deadline_ns = liveness->heartbeat_due_ns;
+		}
+
+		// rounded up, the same as when lingering
+		const uint64_t remaining_ms = (((deadline_ns - now_ns) + 999999) / 1000000);
+
+		const enum usockit_server_wait_result wait_result =
+			usockit_server_wait_readable_timeout(
+				client_fd,
+				arg->shutdown_fd,
+				arg->upgrade_info->notify_fds[PIPE_READ_INDEX],
+				((remaining_ms > INT_MAX) ? INT_MAX : (int)remaining_ms)
+			);
+
+		if(wait_result != USOCKIT_SERVER_WAIT_RESULT_TIMEOUT) {
+			return wait_result;
+		}
+	} while(true);
+}
+
+static inline bool usockit_server_client_has_unread(const int client_fd) {
+	#if USOCKIT_SERVER_SIOCOUTQ_SUPPORT
+		// for a unix socket, this is what the peer didn't read yet
+		int unread_size = 0;
+		return ((ioctl(client_fd, SIOCOUTQ, &unread_size) == 0) && (unread_size > 0));
+	#else
+		(void)client_fd;
+		return false;
+	#endif
+}
+
+static inline void usockit_server_report_eviction(
+	const struct usockit_server_thread_routine_client_connection_arg* const arg,
+	const int client_fd,
+	const enum usockit_server_eviction eviction
+) {
+	assert(arg != cross_support_nullptr);
+
+	if(eviction == USOCKIT_SERVER_EVICTION_IDLE) {
+		const ret_status_t ret_status =
+			usockit_server_send_client_message(
+				arg->pty_output_info,
+				client_fd,
+				USOCKIT_PROTOCOL_MESSAGE_TYPE_IDLE_TIMEOUT,
+				cross_support_nullptr,
+				0
+			);
+		(void)ret_status;
+
+		fprintf(stderr, "usockit: client disconnected after being idle for %lu s\n", (arg->idle_timeout_ms / 1000));
+		return;
+	}
+
+	assert(eviction == USOCKIT_SERVER_EVICTION_UNRESPONSIVE);
+
+	// there's no use in telling a client that doesn't take what it's sent
+	fprintf(stderr, "usockit: client disconnected for not taking what it is sent\n");
+}
+
+static inline ret_status_t usockit_server_send_ack(struct usockit_server_delivery* const delivery,
+                                                   struct usockit_server_pty_output_info* const pty_output_info,
+                                                   const int client_fd) {
+	assert(delivery != cross_support_nullptr);
+
+	delivery->acked_size = delivery->delivered_size;
+
+	return usockit_server_send_size_message(pty_output_info, client_fd, USOCKIT_PROTOCOL_MESSAGE_TYPE_ACK,
+	                                        delivery->delivered_size);
+}
+
+static inline ret_status_t usockit_server_grant_credit(struct usockit_server_delivery* const delivery,
+                                                       struct usockit_server_pty_output_info* const pty_output_info,
+                                                       const int client_fd,
+                                                       const size_t credit_window) {
+	assert(delivery != cross_support_nullptr);
+	assert(credit_window > 0);
+
+	delivery->credit_limit = (delivery->consumed_size + (uint64_t)credit_window);
+
+	return usockit_server_send_size_message(pty_output_info, client_fd, USOCKIT_PROTOCOL_MESSAGE_TYPE_CREDIT,
+	                                        delivery->credit_limit);
+}
+
+static inline ret_status_t usockit_server_send_size_message(
+	struct usockit_server_pty_output_info* const pty_output_info,
+	const int client_fd,
+	const enum usockit_protocol_message_type type,
+	const uint64_t size
+) {
+	unsigned char payload[USOCKIT_PROTOCOL_SIZE_PAYLOAD_SIZE];
+	usockit_protocol_encode_size_payload(payload, size);
+
+	const ret_status_t ret_status =
+		usockit_server_send_client_message(pty_output_info, client_fd, type, payload, sizeof payload);
+
+	// a client that closed its end without shutting down its sending side first may still have input for us in the
+	// socket; that is read (and delivered) all the same
+	if((ret_status != RET_STATUS_SUCCESS) && ((errno == EPIPE) || (errno == ECONNRESET))) {
+		return RET_STATUS_SUCCESS;
+	}
+
+	return ret_status;
+}
+
+static inline ret_status_t usockit_server_send_client_message(
+	struct usockit_server_pty_output_info* const pty_output_info,
+	const int client_fd,
+	const enum usockit_protocol_message_type type,
+	const void* const payload,
+	const size_t payload_size
+) {
+	if(pty_output_info == cross_support_nullptr) {
+		return usockit_server_send_message(client_fd, type, payload, payload_size);
+	}
+
+	ret_status_t ret_status = RET_STATUS_SUCCESS;
+
+	// the pty_output thread sends output to the same client; the messages must not interleave
+	pthread_mutex_lock(&(pty_output_info->mutex));
+
+	if(pty_output_info->attached_client_fd == client_fd) {
+		ret_status = usockit_server_send_message(client_fd, type, payload, payload_size);
+	}
+
+	pthread_mutex_unlock(&(pty_output_info->mutex));
+
+	return ret_status;
+}
+
+static inline void usockit_server_preload_child_stdin(const int preload_fd, const int child_stdin_fd) {
+	const uint64_t start_ns = usockit_server_now_ns();
+	uint64_t preloaded_size = 0;
+	bool done = false;
+
+	#if USOCKIT_SERVER_SPLICE_SUPPORT
+		// in pty mode, the stdin is the master side of the pty, which splice(2) refuses with EINVAL; the input goes
+		// through the buffer below then
+		while(!done) {
+			errno = 0;
+			const ssize_t splicec =
+				splice(preload_fd, cross_support_nullptr, child_stdin_fd, cross_support_nullptr,
+				       USOCKIT_SERVER_PRELOAD_SPLICE_SIZE, SPLICE_F_MOVE);
+
+			if(splicec > 0) {
+				preloaded_size += (uint64_t)splicec;
+				continue;
+			}
+
+			if(splicec == 0) {
+				done = true;
+				continue;
+			}
+
+			if(errno == EINTR) {
+				continue;
+			}
+
+			if(errno == EINVAL) {
+				break;
+			}
+
+			// TODO: splice(2) error handling
+			perror("splice(2)");
+			done = true;
+		}
+	#endif
+
+	unsigned char buffer[1024];
+
+	while(!done) {
+		errno = 0;
+		const ssize_t readc = read(preload_fd, buffer, sizeof buffer);
+
+		if(readc > 0) {
+			const ret_status_t ret_status = write_all(child_stdin_fd, buffer, (size_t)readc);
+			if(ret_status != RET_STATUS_SUCCESS) {
+				// TODO: write(2) error handling
+				perror("write(2)");
+				break;
+			}
+
+			preloaded_size += (uint64_t)readc;
+			continue;
+		}
+
+		if(readc == 0) {
+			break;
+		}
+
+		if(errno == EINTR) {
+			continue;
+		}
+
+		// TODO: read(2) error handling
+		perror("read(2)");
+		break;
+	}
+
+	fprintf(
+		stderr,
+		"usockit: preloaded %llu bytes into the stdin of the child program in %llu ms\n",
+		(unsigned long long)preloaded_size,
+		(unsigned long long)((usockit_server_now_ns() - start_ns) / 1000000)
+	);
+}
+
+static void* usockit_server_thread_routine_client_connection(void* const arg_ptr) {
+	assert(arg_ptr != cross_support_nullptr);
+
+	struct usockit_server_thread_routine_client_connection_arg arg =
+		*(const struct usockit_server_thread_routine_client_connection_arg*)arg_ptr;
+
+	usockit_server_set_thread_name("client_conn");
+	usockit_server_block_sigpipe();
+
+	struct usockit_server_rate_limiter limiter;
+	usockit_server_rate_limiter_init(&limiter, arg.rate_limits);
+
+	const bool watch_liveness = ((arg.idle_timeout_ms > 0) || (arg.heartbeat_interval_ms > 0));
+
+	// the accept thread holds off on accepting connections until this is done, so no client can get in between
+	if(arg.stdin_preload_fd != -1) {
+		if(usockit_server_wait_for_child_ready(arg.child_ready_info)) {
+			usockit_server_preload_child_stdin(arg.stdin_preload_fd, *(arg.child_stdin_fd_ptr));
+		}
+
+		close(arg.stdin_preload_fd);
+		usockit_server_end_stdin_preload(arg.child_ready_info);
+	}
+
+	do {
+		enum usockit_server_wait_result wait_result =
+			usockit_server_wait_readable(
+				arg.client_ready_info->handoff_pipe[PIPE_READ_INDEX],
+				arg.shutdown_fd,
+				arg.upgrade_info->notify_fds[PIPE_READ_INDEX]
+			);
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN) {
+			usockit_server_rate_limiter_report(&limiter, true);
+			return cross_support_nullptr;
+		}
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_UPGRADE) {
+			// a client that was already handed over is picked up out of the handoff pipe by the main thread
+			usockit_server_park_for_upgrade(arg.upgrade_info);
+			continue;
+		}
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_FAILURE) {
+			// TODO: poll(2) error handling
+			perror("poll(2)");
+			continue;
+		}
+
+		int client_fd;
+
+		errno = 0;
+		const ssize_t handoff_readc =
+			read(arg.client_ready_info->handoff_pipe[PIPE_READ_INDEX], &client_fd, sizeof client_fd);
+
+		if(handoff_readc != (ssize_t)(sizeof client_fd)) {
+			if(handoff_readc == 0) {
+				// write end was closed; the accept thread is gone
+				usockit_server_rate_limiter_report(&limiter, true);
+				return cross_support_nullptr;
+			}
+
+			// TODO: read(2) error handling
+			perror("read(2)");
+			continue;
+		}
+
+		arg.client_ready_info->client_fd = client_fd;
+
+		// the client socket is non-blocking so that we only have to wait (and with that, watch out for the shutdown
+		// notification) once the client has nothing more to say for now, instead of before every single read
+		errno = 0;
+		const int flags = fcntl(client_fd, F_GETFL);
+		if((flags == -1) || (fcntl(client_fd, F_SETFL, (flags | O_NONBLOCK)) == -1)) {
+			// TODO: fcntl(2) error handling
+			perror("fcntl(2)");
+			usockit_server_thread_routine_client_connection_release_client(arg.client_ready_info, arg.pty_output_info);
+			continue;
+		}
+
+		struct usockit_server_delivery* const delivery = &(arg.client_ready_info->client_delivery);
+		zeroset_lvalue(*delivery);
+
+		if(client_fd == arg.resumed_client_fd) {
+			if(arg.resumed_client_delivered_size < 0) {
+				delivery->lost = true;
+			} else {
+				delivery->delivered_size = (uint64_t)(arg.resumed_client_delivered_size);
+			}
+			delivery->acked_size = delivery->delivered_size;
+			delivery->consumed_size = (uint64_t)(arg.resumed_client_consumed_size);
+		}
+
+		if(arg.pty_output_info != cross_support_nullptr) {
+			usockit_server_attach_client(arg.pty_output_info, client_fd, (client_fd != arg.resumed_client_fd));
+		}
+		arg.resumed_client_fd = -1;
+
+		usockit_server_rate_limiter_reset_connection(&limiter, arg.rate_limits);
+
+		struct usockit_server_client_liveness liveness;
+		zeroset_lvalue(liveness);
+		liveness.idle_since_ns = usockit_server_now_ns();
+		liveness.heartbeat_due_ns = (liveness.idle_since_ns + ((uint64_t)(arg.heartbeat_interval_ms) * 1000000));
+
+		// before the client hears anything from us, it may send as much as it likes; the initial credit reins it in
+		if((arg.credit_window > 0) &&
+		   (usockit_server_grant_credit(delivery, arg.pty_output_info, client_fd, arg.credit_window) !=
+		    RET_STATUS_SUCCESS)) {
+
+			liveness.eviction = USOCKIT_SERVER_EVICTION_UNRESPONSIVE;
+		}
+
+		while(liveness.eviction == USOCKIT_SERVER_EVICTION_NONE) {
+			// a client that never lets us run out of data would otherwise hold off an upgrade forever.
+			// everything that was read from the client is forwarded by now, so it can be handed over as it is
+			if(atomic_load_explicit(&usockit_server_upgrade_requested, memory_order_relaxed)) {
+				usockit_server_park_for_upgrade(arg.upgrade_info);
+			}
+
+			unsigned char buffer[1024];
+			size_t read_size = array_size(buffer);
+
+			if(arg.restart_info != cross_support_nullptr) {
+				pthread_mutex_lock(&(arg.restart_info->mutex));
+				const size_t queue_space =
+					(arg.restart_info->child_up
+					 ? read_size
+					 : (arg.restart_info->queue_capacity - arg.restart_info->queue_size));
+				pthread_mutex_unlock(&(arg.restart_info->mutex));
+
+				if(queue_space == 0) {
+					// the child is down and the queue is full; the client is held back like with the rate limits
+					// until the restarted child took the queue
+					wait_result =
+						usockit_server_wait_readable(
+							arg.restart_info->notify_fds[PIPE_READ_INDEX],
+							arg.shutdown_fd,
+							arg.upgrade_info->notify_fds[PIPE_READ_INDEX]
+						);
+
+					if(wait_result == USOCKIT_SERVER_WAIT_RESULT_UPGRADE) {
+						usockit_server_park_for_upgrade(arg.upgrade_info);
+						continue;
+					}
+
+					if(wait_result != USOCKIT_SERVER_WAIT_RESULT_READABLE) {
+						// TODO: poll(2) error handling
+						break;
+					}
+
+					usockit_server_drain_notifier(arg.restart_info->notify_fds[PIPE_READ_INDEX]);
+					continue;
+				}
+
+				if(queue_space < read_size) {
+					read_size = queue_space;
+				}
+			}
+
+			if(limiter.any_enabled) {
+				enum usockit_server_rate_limit_kind limiting_kind;
+				const uint64_t pause_ns =
+					usockit_server_rate_limiter_allowance(&limiter, client_fd, buffer, &read_size, &limiting_kind);
+
+				if(pause_ns != 0) {
+					// the client is simply not read from in the meantime; once the socket is full, it is the client
+					// that blocks
+					wait_result =
+						usockit_server_rate_limiter_pause(
+							&limiter,
+							limiting_kind,
+							pause_ns,
+							arg.shutdown_fd,
+							arg.upgrade_info->notify_fds[PIPE_READ_INDEX]
+						);
+
+					if(wait_result == USOCKIT_SERVER_WAIT_RESULT_UPGRADE) {
+						usockit_server_park_for_upgrade(arg.upgrade_info);
+						continue;
+					}
+
+					if(wait_result != USOCKIT_SERVER_WAIT_RESULT_TIMEOUT) {
+						// TODO: poll(2) error handling
+						break;
+					}
+
+					continue;
+				}
+			}
+
+			errno = 0;
+			const ssize_t readc = read(client_fd, buffer, read_size);
+
+			if(readc > 0) {
+				liveness.input_since_wait = true;
+
+				if(limiter.any_enabled) {
+					usockit_server_rate_limiter_take(&limiter, buffer, (size_t)readc);
+				}
+
+				const ret_status_t ret_status =
+					((arg.worker_pool != cross_support_nullptr)
+					 ? usockit_server_write_workers_stdin(arg.worker_pool, delivery, buffer, (size_t)readc)
+					 : usockit_server_write_child_stdin(
+					       arg.child_stdin_fd_ptr,
+					       arg.restart_info,
+					       delivery,
+					       buffer,
+					       (size_t)readc
+					   ));
+				if(ret_status != RET_STATUS_SUCCESS) {
+					// TODO: write(2) error handling
+					break;
+				}
+
+				// acknowledgements are batched; a client that keeps sending still hears back every now and then
+				if(((delivery->delivered_size - delivery->acked_size) >= USOCKIT_SERVER_ACK_INTERVAL_SIZE) &&
+				   (usockit_server_send_ack(delivery, arg.pty_output_info, client_fd) != RET_STATUS_SUCCESS)) {
+
+					// a client that doesn't read would otherwise hold us up for every single acknowledgement
+					liveness.eviction = USOCKIT_SERVER_EVICTION_UNRESPONSIVE;
+					break;
+				}
+
+				// so is credit; once half of the window was taken in, the client gets it back before it runs dry
+				delivery->consumed_size += (uint64_t)readc;
+				if((arg.credit_window > 0) &&
+				   (((delivery->consumed_size + arg.credit_window) - delivery->credit_limit) >=
+				    (arg.credit_window / 2)) &&
+				   (usockit_server_grant_credit(delivery, arg.pty_output_info, client_fd, arg.credit_window) !=
+				    RET_STATUS_SUCCESS)) {
+
+					liveness.eviction = USOCKIT_SERVER_EVICTION_UNRESPONSIVE;
+					break;
+				}
+
+				continue;
+			}
+
+			if(readc == 0) {
+				wait_result = usockit_server_wait_queued_delivery(&arg, delivery);
+				if(wait_result == USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN) {
+					break;
+				}
+
+				// the final acknowledgement, which is sent even if nothing new was delivered, so that the client knows
+				// that there won't be any more
+				if(usockit_server_send_ack(delivery, arg.pty_output_info, client_fd) != RET_STATUS_SUCCESS) {
+					liveness.eviction = USOCKIT_SERVER_EVICTION_UNRESPONSIVE;
+					break;
+				}
+
+				// the client may still be waiting for what the child program has to say in response
+				if(arg.linger_ms > 0) {
+					wait_result = usockit_server_wait_client_linger(&arg, client_fd);
+				}
+
+				break;
+			}
+
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				// the client caught up with the limits
+				limiter.throttling = false;
+
+				// the client has nothing more to say for now; it is told what was delivered before we wait for it
+				usockit_server_settle_client_delivery(delivery, arg.restart_info);
+				if((delivery->delivered_size != delivery->acked_size) &&
+				   (usockit_server_send_ack(delivery, arg.pty_output_info, client_fd) != RET_STATUS_SUCCESS)) {
+
+					liveness.eviction = USOCKIT_SERVER_EVICTION_UNRESPONSIVE;
+					break;
+				}
+
+				wait_result =
+					(watch_liveness
+					 ? usockit_server_wait_client_input(&arg, client_fd, &liveness)
+					 : usockit_server_wait_readable(
+					       client_fd,
+					       arg.shutdown_fd,
+					       arg.upgrade_info->notify_fds[PIPE_READ_INDEX]
+					   ));
+
+				if(wait_result == USOCKIT_SERVER_WAIT_RESULT_UPGRADE) {
+					usockit_server_park_for_upgrade(arg.upgrade_info);
+					continue;
+				}
+
+				if(wait_result != USOCKIT_SERVER_WAIT_RESULT_READABLE) {
+					// TODO: poll(2) error handling (a timeout means that the client is evicted)
+					break;
+				}
+
+				continue;
+			}
+
+			if(errno == EINTR) {
+				continue;
+			}
+
+			// TODO: read(2) error handling
+			break;
+		}
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN) {
+			usockit_server_settle_client_delivery(delivery, arg.restart_info);
+
+			// a client that didn't take the acknowledgement wouldn't take the child exit message either
+			if((delivery->delivered_size == delivery->acked_size) ||
+			   (usockit_server_send_ack(delivery, arg.pty_output_info, client_fd) == RET_STATUS_SUCCESS)) {
+
+				usockit_server_send_child_exit(arg.upgrade_info, arg.pty_output_info, client_fd);
+			}
+		}
+
+		if(liveness.eviction != USOCKIT_SERVER_EVICTION_NONE) {
+			usockit_server_report_eviction(&arg, client_fd, liveness.eviction);
+		}
+
+		usockit_server_thread_routine_client_connection_release_client(arg.client_ready_info, arg.pty_output_info);
+
+		usockit_server_rate_limiter_report(&limiter, false);
+
+		if(wait_result == USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN) {
+			usockit_server_rate_limiter_report(&limiter, true);
+			return cross_support_nullptr;
+		}
+	} while(true);
+}
+
+static inline void usockit_server_rate_limiter_init(struct usockit_server_rate_limiter* const limiter,
+                                                    const struct usockit_server_rate_limit rate_limits[const]) {
+	assert(limiter != cross_support_nullptr);
+	assert(rate_limits != cross_support_nullptr);
+
+	zeroset_lvalue(*limiter);
+
+	const uint64_t now_ns = usockit_server_now_ns();
+
+	for(size_t kind = 0; kind < USOCKIT_SERVER_RATE_LIMITS_COUNT; ++kind) {
+		if(rate_limits[kind].rate == 0) {
+			continue;
+		}
+
+		limiter->enabled[kind] = true;
+		limiter->any_enabled = true;
+		if((kind == USOCKIT_SERVER_RATE_LIMIT_CONNECTION_LINES) || (kind == USOCKIT_SERVER_RATE_LIMIT_GLOBAL_LINES)) {
+			limiter->any_lines_enabled = true;
+		}
+
+		usockit_server_token_bucket_init(
+			&(limiter->buckets[kind]),
+			rate_limits[kind].rate,
+			rate_limits[kind].burst,
+			now_ns
+		);
+	}
+}
+
+static inline void usockit_server_rate_limiter_reset_connection(
+	struct usockit_server_rate_limiter* const limiter,
+	const struct usockit_server_rate_limit rate_limits[const]
+) {
+	assert(limiter != cross_support_nullptr);
+	assert(rate_limits != cross_support_nullptr);
+
+	const uint64_t now_ns = usockit_server_now_ns();
+
+	const enum usockit_server_rate_limit_kind connection_kinds[] = {
+		USOCKIT_SERVER_RATE_LIMIT_CONNECTION_BYTES,
+		USOCKIT_SERVER_RATE_LIMIT_CONNECTION_LINES,
+	};
+	for(size_t i = 0; i < array_size(connection_kinds); ++i) {
+		const enum usockit_server_rate_limit_kind kind = connection_kinds[i];
+
+		if(limiter->enabled[kind]) {
+			usockit_server_token_bucket_init(
+				&(limiter->buckets[kind]),
+				rate_limits[kind].rate,
+				rate_limits[kind].burst,
+				now_ns
+			);
+		}
+	}
+
+	limiter->throttling = false;
+	limiter->connection_throttle_count = 0;
+	limiter->connection_throttled_ns = 0;
+}
+
+static inline uint64_t usockit_server_rate_limiter_allowance(
+	struct usockit_server_rate_limiter* const limiter,
+	const int client_fd,
+	unsigned char buffer[const],
+	size_t* const size_ptr,
+	enum usockit_server_rate_limit_kind* const limiting_kind_ptr
+) {
+	assert(limiter != cross_support_nullptr);
+	assert(buffer != cross_support_nullptr);
+	assert(size_ptr != cross_support_nullptr);
+	assert(limiting_kind_ptr != cross_support_nullptr);
+
+	const uint64_t now_ns = usockit_server_now_ns();
+
+	size_t size = *size_ptr;
+	size_t lines = SIZE_MAX;
+	uint64_t pause_ns = 0;
+
+	for(size_t kind = 0; kind < USOCKIT_SERVER_RATE_LIMITS_COUNT; ++kind) {
+		if(!(limiter->enabled[kind])) {
+			continue;
+		}
+
+		struct usockit_server_token_bucket* const bucket = &(limiter->buckets[kind]);
+		usockit_server_token_bucket_refill(bucket, now_ns);
+
+		// an empty line bucket holds back even data without a newline; the line that it starts couldn't be finished
+		// anyway
+		const size_t available = usockit_server_token_bucket_available(bucket);
+		if(available == 0) {
+			const uint64_t wait_ns = usockit_server_token_bucket_wait_ns(bucket);
+			if(wait_ns > pause_ns) {
+				pause_ns = wait_ns;
+				*limiting_kind_ptr = (enum usockit_server_rate_limit_kind)kind;
+			}
+
+			continue;
+		}
+
+		if((kind == USOCKIT_SERVER_RATE_LIMIT_CONNECTION_LINES) || (kind == USOCKIT_SERVER_RATE_LIMIT_GLOBAL_LINES)) {
+			if(available < lines) {
+				lines = available;
+			}
+		} else if(available < size) {
+			size = available;
+		}
+	}
+
+	if(pause_ns != 0) {
+		return pause_ns;
+	}
+
+	if(limiter->any_lines_enabled) {
+		ssize_t peekc;
+		do {
+			errno = 0;
+			peekc = recv(client_fd, buffer, size, MSG_PEEK);
+		} while((peekc == -1) && (errno == EINTR));
+
+		// on failure (or EOF), the size is left as it is; the read that follows runs into the same thing and handles it
+		if(peekc > 0) {
+			size = (size_t)peekc;
+
+			const unsigned char* newline = buffer;
+			while((newline = memchr(newline, '\n', (size_t)((buffer + size) - newline))) != cross_support_nullptr) {
+				++newline;
+
+				--lines;
+				if(lines == 0) {
+					size = (size_t)(newline - buffer);
+					break;
+				}
+			}
+		}
+	}
+
+	*size_ptr = size;
+	return 0;
+}
+
+static inline void usockit_server_rate_limiter_take(struct usockit_server_rate_limiter* const limiter,
+                                                    const unsigned char data[const],
+                                                    const size_t size) {
+	assert(limiter != cross_support_nullptr);
+	assert(data != cross_support_nullptr);
+
+	size_t lines = 0;
+	if(limiter->any_lines_enabled) {
+		const unsigned char* newline = data;
+		while((newline = memchr(newline, '\n', (size_t)((data + size) - newline))) != cross_support_nullptr) {
+			++newline;
+			++lines;
+		}
+	}
+
+	for(size_t kind = 0; kind < USOCKIT_SERVER_RATE_LIMITS_COUNT; ++kind) {
+		if(!(limiter->enabled[kind])) {
+			continue;
+		}
+
+		if((kind == USOCKIT_SERVER_RATE_LIMIT_CONNECTION_LINES) || (kind == USOCKIT_SERVER_RATE_LIMIT_GLOBAL_LINES)) {
+			usockit_server_token_bucket_take(&(limiter->buckets[kind]), lines);
+		} else {
+			usockit_server_token_bucket_take(&(limiter->buckets[kind]), size);
+		}
+	}
+}
+
+static inline enum usockit_server_wait_result usockit_server_rate_limiter_pause(
+	struct usockit_server_rate_limiter* const limiter,
+	const enum usockit_server_rate_limit_kind limiting_kind,
+	const uint64_t pause_ns,
+	const int shutdown_fd,
+	const int upgrade_fd
+) {
+	assert(limiter != cross_support_nullptr);
+
+	if(!(limiter->throttling)) {
+		limiter->throttling = true;
+		++(limiter->throttle_counts[limiting_kind]);
+		++(limiter->connection_throttle_count);
+	}
+
+	// rounded up, since waking up too early just means pausing again right away
+	const uint64_t pause_ms = ((pause_ns + 999999) / 1000000);
+	const int timeout_ms = ((pause_ms > (uint64_t)INT_MAX) ? INT_MAX : (int)pause_ms);
+
+	const uint64_t start_ns = usockit_server_now_ns();
+	const enum usockit_server_wait_result wait_result =
+		usockit_server_wait_timeout(shutdown_fd, upgrade_fd, timeout_ms);
+	const uint64_t paused_ns = (usockit_server_now_ns() - start_ns);
+
+	limiter->throttled_ns += paused_ns;
+	limiter->connection_throttled_ns += paused_ns;
+
+	return wait_result;
+}
+
+static inline void usockit_server_rate_limiter_report(const struct usockit_server_rate_limiter* const limiter,
+                                                      const bool total) {
+	assert(limiter != cross_support_nullptr);
+
+	if(!(limiter->any_enabled)) {
+		return;
+	}
+
+	if(!total) {
+		if(limiter->connection_throttle_count == 0) {
+			return;
+		}
+
+		fprintf(
+			stderr,
+			"usockit: client throttled %llu times for %llu ms\n",
+			limiter->connection_throttle_count,
+			(unsigned long long)(limiter->connection_throttled_ns / 1000000)
+		);
+		return;
+	}
+
+	unsigned long long throttle_count = 0;
+	for(size_t kind = 0; kind < USOCKIT_SERVER_RATE_LIMITS_COUNT; ++kind) {
+		throttle_count += limiter->throttle_counts[kind];
+	}
+
+	fprintf(
+		stderr,
+		"usockit: clients throttled %llu times for %llu ms in total"
+		" (rate limit: %llu, line limit: %llu, global rate limit: %llu, global line limit: %llu)\n",
+		throttle_count,
+		(unsigned long long)(limiter->throttled_ns / 1000000),
+		limiter->throttle_counts[USOCKIT_SERVER_RATE_LIMIT_CONNECTION_BYTES],
+		limiter->throttle_counts[USOCKIT_SERVER_RATE_LIMIT_CONNECTION_LINES],
+		limiter->throttle_counts[USOCKIT_SERVER_RATE_LIMIT_GLOBAL_BYTES],
+		limiter->throttle_counts[USOCKIT_SERVER_RATE_LIMIT_GLOBAL_LINES]
+	);
+}
+
+static void usockit_server_thread_routine_client_connection_release_client(
+	struct usockit_server_thread_routine_client_connection_client_ready_info* const client_ready_info,
+	struct usockit_server_pty_output_info* const pty_output_info
+) {
+	assert(client_ready_info != cross_support_nullptr);
+
+	if(pty_output_info != cross_support_nullptr) {
+		pthread_mutex_lock(&(pty_output_info->mutex));
+		pty_output_info->attached_client_fd = -1;
+		pthread_mutex_unlock(&(pty_output_info->mutex));
+	}
+
+	const int client_fd = client_ready_info->client_fd;
+	client_ready_info->client_fd = -1;
+
+	// the slot is freed before closing, so that a client that connects as soon as it saw this one's connection end
+	// isn't rejected. the accept thread takes in at most one more client in the meantime
+	usockit_server_free_client_slot(client_ready_info);
+
+	close(client_fd);
+}
+
+static inline ret_status_t usockit_server_write_child_stdin(const int* const child_stdin_fd_ptr,
+                                                            struct usockit_server_restart_info* const restart_info,
+                                                            struct usockit_server_delivery* const delivery,
+                                                            const unsigned char data[const],
+                                                            const size_t size) {
+	assert(child_stdin_fd_ptr != cross_support_nullptr);
+	assert(delivery != cross_support_nullptr);
+	assert(data != cross_support_nullptr);
+
+	if(restart_info == cross_support_nullptr) {
+		const ret_status_t ret_status = write_all(*child_stdin_fd_ptr, data, size);
+		if(ret_status == RET_STATUS_SUCCESS) {
+			usockit_server_add_delivered(delivery, size);
+		}
+
+		return ret_status;
+	}
+
+	pthread_mutex_lock(&(restart_info->mutex));
+
+	// whatever was queued before is ahead of this in the stdin
+	usockit_server_settle_queued_delivery(delivery, restart_info);
+
+	size_t writtenc = 0;
+	if(restart_info->child_up) {
+		writtenc = usockit_server_write_until_error(*child_stdin_fd_ptr, data, size);
+		usockit_server_add_delivered(delivery, writtenc);
+
+		if(writtenc < size) {
+			if(errno != EPIPE) {
+				pthread_mutex_unlock(&(restart_info->mutex));
+				return RET_STATUS_FAILURE;
+			}
+
+			// the child died; the child_wait thread takes it from here
+			restart_info->child_up = false;
+		}
+	}
+
+	if(writtenc < size) {
+		assert((size - writtenc) <= (restart_info->queue_capacity - restart_info->queue_size));
+
+		memcpy((restart_info->queue + restart_info->queue_size), (data + writtenc), (size - writtenc));
+		restart_info->queue_size += (size - writtenc);
+
+		if(delivery->queued_size == 0) {
+			delivery->queue_flush_generation = restart_info->queue_flush_generation;
+		}
+		delivery->queued_size += (size - writtenc);
+		delivery->queued_end_position = (restart_info->queue_head_position + restart_info->queue_size);
+	}
+
+	pthread_mutex_unlock(&(restart_info->mutex));
+
+	return RET_STATUS_SUCCESS;
+}
+
+static inline ret_status_t usockit_server_write_workers_stdin(struct usockit_server_worker_pool* const worker_pool,
+                                                              struct usockit_server_delivery* const delivery,
+                                                              const unsigned char data[const],
+                                                              const size_t size) {
+	assert(worker_pool != cross_support_nullptr);
+	assert(delivery != cross_support_nullptr);
+	assert(data != cross_support_nullptr);
+
+	size_t offset = 0;
+
+	while(offset < size) {
+		if(worker_pool->current_index == worker_pool->count) {
+			worker_pool->current_index = usockit_server_pick_worker(worker_pool);
+
+			if(worker_pool->current_index == worker_pool->count) {
+				errno = EPIPE;
+				return RET_STATUS_FAILURE;
+			}
+		}
+
+		struct usockit_server_worker* const worker = &(worker_pool->workers[worker_pool->current_index]);
+
+		const unsigned char* const newline = memchr((data + offset), '\n', (size - offset));
+		const size_t piece_size =
+			((newline != cross_support_nullptr) ? ((size_t)(newline - (data + offset)) + 1) : (size - offset));
+
+		if(!(worker->gone)) {
+			const size_t writtenc = usockit_server_write_until_error(worker->stdin_fd, (data + offset), piece_size);
+			usockit_server_add_delivered(delivery, writtenc);
+
+			if(writtenc < piece_size) {
+				if(errno != EPIPE) {
+					return RET_STATUS_FAILURE;
+				}
+
+				// the worker died; the child_wait thread reaps it. the rest of the line is skipped
+				worker->gone = true;
+				delivery->lost = true;
+			}
+		} else {
+			delivery->lost = true;
+		}
+
+		offset += piece_size;
+
+		if(newline != cross_support_nullptr) {
+			worker_pool->current_index = worker_pool->count;
+		}
+	}
+
+	return RET_STATUS_SUCCESS;
+}
+
+static inline size_t usockit_server_pick_worker(struct usockit_server_worker_pool* const worker_pool) {
+	assert(worker_pool != cross_support_nullptr);
+
+	size_t picked_index = worker_pool->count;
+	int picked_pending_size = 0;
+
+	for(size_t i = 0; i < worker_pool->count; ++i) {
+		const size_t index = ((worker_pool->next_index + i) % worker_pool->count);
+		const struct usockit_server_worker* const worker = &(worker_pool->workers[index]);
+
+		if(worker->gone) {
+			continue;
+		}
+
+		int pending_size = 0;
+		#if USOCKIT_SERVER_PIPE_FIONREAD_SUPPORT
+			// works on the write end as well, since both ends share the same pipe buffer
+			if(ioctl(worker->stdin_fd, FIONREAD, &pending_size) != 0) {
+				pending_size = 0;
+			}
+		#endif
+
+		if((picked_index == worker_pool->count) || (pending_size < picked_pending_size)) {
+			picked_index = index;
+			picked_pending_size = pending_size;
+		}
+
+		if(picked_pending_size == 0) {
+			// a worker that is waiting for input can't be beaten
+			break;
+		}
+	}
+
+	if(picked_index != worker_pool->count) {
+		worker_pool->next_index = ((picked_index + 1) % worker_pool->count);
+	}
+
+	return picked_index;
+}
+
+static inline size_t usockit_server_write_until_error(const int fd,
+                                                      const unsigned char data[const],
+                                                      const size_t size) {
+	assert(data != cross_support_nullptr);
+
+	size_t writtenc = 0;
+
+	while(writtenc < size) {
+		errno = 0;
+		const ssize_t ret = write(fd, (data + writtenc), (size - writtenc));
+
+		if(ret >= 0) {
+			writtenc += (size_t)ret;
+			continue;
+		}
+
+		if(errno != EINTR) {
+			break;
+		}
+	}
+
+	return writtenc;
+}
+
+static void* usockit_server_thread_routine_child_wait(void* const arg_ptr) {
+	assert(arg_ptr != cross_support_nullptr);
+
+	const struct usockit_server_thread_routine_child_wait_arg arg =
+		*(const struct usockit_server_thread_routine_child_wait_arg*)arg_ptr;
+
+	usockit_server_set_thread_name("child_wait");
+
+	if(!usockit_server_wait_for_child_ready(arg.child_ready_info)) {
+		return cross_support_nullptr;
+	}
+
+	int status = 0;
+	bool status_known;
+	if(arg.worker_pool != cross_support_nullptr) {
+		status_known = usockit_server_wait_for_workers(arg.worker_pool, &status);
+	} else if(arg.restart_info == cross_support_nullptr) {
+		status_known = (waitpid(*(arg.child_pid_ptr), &status, 0) == *(arg.child_pid_ptr));
+	} else {
+		status_known = usockit_server_supervise_child(&arg, &status);
+	}
+
+	// before notifying the shutdown, so that the main thread doesn't wait for threads to park that are shutting down
+	// instead. the threads that tell the clients about the exit status only read it once they noticed the shutdown
+	pthread_mutex_lock(&(arg.upgrade_info->mutex));
+	arg.upgrade_info->child_exited = true;
+	arg.upgrade_info->child_status_known = status_known;
+	arg.upgrade_info->child_status = status;
+	pthread_mutex_unlock(&(arg.upgrade_info->mutex));
+	pthread_cond_broadcast(&(arg.upgrade_info->cond));
+
+	usockit_server_notify(arg.shutdown_notify_fd);
+
+	return cross_support_nullptr;
+}
+
+static inline bool usockit_server_supervise_child(
+	const struct usockit_server_thread_routine_child_wait_arg* const arg,
+	int* const status_ptr
+) {
+	assert(arg != cross_support_nullptr);
+	assert(status_ptr != cross_support_nullptr);
+	assert(arg->restart_info != cross_support_nullptr);
+
+	struct usockit_server_restart_info* const restart_info = arg->restart_info;
+	const struct usockit_server_restart_options* const restart_options = arg->restart_options;
+	const int child_exit_fd = restart_info->child_exit_notify_fds[PIPE_READ_INDEX];
+
+	// the child program, the standby and the children that fail to start are the only children of the server, so
+	// waiting for any child never takes one away from somebody else
+	struct sigaction old_child_exit_action;
+	errno = 0;
+	const ret_status_t handler_ret_status =
+		usockit_server_install_child_exit_signal_handler(
+			restart_info->child_exit_notify_fds[PIPE_WRITE_INDEX],
+			&old_child_exit_action
+		);
+	if(handler_ret_status != RET_STATUS_SUCCESS) {
+		// TODO: sigaction(2) error handling
+		perror("sigaction(2)");
+	}
+
+	const uint64_t now_ns = usockit_server_now_ns();
+
+	struct usockit_server_supervised_child child = {
+		.start_pending = false,
+		.start_at_ns   = 0,
+		.started_ns    = now_ns,
+		.backoff_ms    = restart_options->backoff_min_ms,
+	};
+	// a standby that was handed over by an upgrade is kept
+	struct usockit_server_supervised_child standby = {
+		.start_pending = (restart_options->standby && (restart_info->standby_pid == -1)),
+		.start_at_ns   = now_ns,
+		.started_ns    = now_ns,
+		.backoff_ms    = restart_options->backoff_min_ms,
+	};
+
+	atomic_store(&(restart_info->signalable_child_pid), *(arg->child_pid_ptr));
+
+	bool status_known = false;
+
+	do {
+		// reaping comes first, so that a SIGCHLD that arrived before the handler was installed isn't missed
+		bool child_exited = false;
+
+		do {
+			int status;
+			errno = 0;
+			const pid_t pid = waitpid(-1, &status, WNOHANG);
+
+			if(pid == -1) {
+				if(errno == EINTR) {
+					continue;
+				}
+
+				// ECHILD only happens while the child program waits for its restart
+				if(errno != ECHILD) {
+					// TODO: waitpid(2) error handling
+					perror("waitpid(2)");
+					child_exited = true;
+				}
+				break;
+			}
+
+			if(pid == 0) {
+				break;
+			}
+
+			// the PID of a child program that waits for its restart may already belong to the standby
+			if((pid == *(arg->child_pid_ptr)) && !(child.start_pending)) {
+				if(WIFEXITED(status) && (WEXITSTATUS(status) == 0)) {
+					atomic_store(&(restart_info->signalable_child_pid), -1);
+					*status_ptr = status;
+					status_known = true;
+					child_exited = true;
+					break;
+				}
+
+				usockit_server_handle_child_failure(arg, &child, &standby, status);
+			} else if(pid == restart_info->standby_pid) {
+				usockit_server_handle_standby_failure(arg, &standby, status);
+			}
+		} while(true);
+
+		if(child_exited) {
+			break;
+		}
+
+		usockit_server_start_due_children(arg, &child, &standby);
+
+		int timeout_ms = -1;
+		const uint64_t wait_now_ns = usockit_server_now_ns();
+		const struct usockit_server_supervised_child* const pending_children[] = { &child, &standby };
+		for(size_t i = 0; i < array_size(pending_children); ++i) {
+			const struct usockit_server_supervised_child* const pending_child = pending_children[i];
+
+			// the standby waits for the child program
+			if(!(pending_child->start_pending) || ((pending_child == &standby) && child.start_pending)) {
+				continue;
+			}
+
+			const uint64_t remaining_ms =
+				((pending_child->start_at_ns > wait_now_ns)
+				 ? (((pending_child->start_at_ns - wait_now_ns) + 999999) / 1000000)
+				 : 0);
+			if((timeout_ms == -1) || (remaining_ms < (uint64_t)timeout_ms)) {
+				timeout_ms = ((remaining_ms > INT_MAX) ? INT_MAX : (int)remaining_ms);
+			}
+		}
+
+		if((handler_ret_status != RET_STATUS_SUCCESS) &&
+		   ((timeout_ms == -1) || (timeout_ms > USOCKIT_SERVER_CHILD_EXIT_POLL_INTERVAL_MS))) {
+
+			timeout_ms = USOCKIT_SERVER_CHILD_EXIT_POLL_INTERVAL_MS;
+		}
+
+		struct pollfd pfd = { .fd = child_exit_fd, .events = POLLIN };
+		errno = 0;
+		const int ret = poll(&pfd, 1, timeout_ms);
+		if((ret == -1) && (errno != EINTR)) {
+			// TODO: poll(2) error handling
+			perror("poll(2)");
+		}
+
+		usockit_server_drain_notifier(child_exit_fd);
+	} while(true);
+
+	if(handler_ret_status == RET_STATUS_SUCCESS) {
+		usockit_server_restore_child_exit_signal_handler(&old_child_exit_action);
+	}
+
+	return status_known;
+}
+
+static inline bool usockit_server_wait_for_workers(const struct usockit_server_worker_pool* const worker_pool,
+                                                   int* const status_ptr) {
+	assert(worker_pool != cross_support_nullptr);
+	assert(status_ptr != cross_support_nullptr);
+
+	size_t remaining_count = worker_pool->count;
+	bool failure_seen = false;
+
+	// the workers are the only children of the server
+	while(remaining_count > 0) {
+		int status;
+		errno = 0;
+		const pid_t pid = waitpid(-1, &status, 0);
+
+		if(pid == -1) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			// TODO: waitpid(2) error handling
+			perror("waitpid(2)");
+			return false;
+		}
+
+		bool is_worker = false;
+		for(size_t i = 0; i < worker_pool->count; ++i) {
+			if(worker_pool->workers[i].pid == pid) {
+				is_worker = true;
+				break;
+			}
+		}
+
+		if(!is_worker) {
+			continue;
+		}
+
+		--remaining_count;
+
+		if(failure_seen) {
+			continue;
+		}
+
+		*status_ptr = status;
+		failure_seen = !(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+	}
+
+	return true;
+}
+
+static inline void usockit_server_handle_child_failure(
+	const struct usockit_server_thread_routine_child_wait_arg* const arg,
+	struct usockit_server_supervised_child* const child,
+	struct usockit_server_supervised_child* const standby,
+	const int status
+) {
+	assert(arg != cross_support_nullptr);
+	assert(child != cross_support_nullptr);
+	assert(standby != cross_support_nullptr);
+
+	struct usockit_server_restart_info* const restart_info = arg->restart_info;
+	const struct usockit_server_restart_options* const restart_options = arg->restart_options;
+	const uint64_t now_ns = usockit_server_now_ns();
+
+	// a child that ran for a while before failing is not failing "in a row" anymore
+	if(((now_ns - child->started_ns) / 1000000) > restart_options->backoff_max_ms) {
+		child->backoff_ms = restart_options->backoff_min_ms;
+	}
+
+	// it was reaped already, so its PID may be taken by another process any moment now
+	atomic_store(&(restart_info->signalable_child_pid), -1);
+
+	pthread_mutex_lock(&(restart_info->mutex));
+
+	restart_info->child_up = false;
+	close(*(arg->child_stdin_fd_ptr));
+	*(arg->child_stdin_fd_ptr) = -1;
+
+	const pid_t standby_pid = restart_info->standby_pid;
+	if(standby_pid != -1) {
+		// switched over while holding the mutex, so that input never goes anywhere but into the queue in between
+		usockit_server_activate_child(arg, standby_pid, restart_info->standby_stdin_fd);
+		restart_info->standby_pid = -1;
+		restart_info->standby_stdin_fd = -1;
+	}
+
+	pthread_mutex_unlock(&(restart_info->mutex));
 
-		// TODO: pthread_mutex_init(3p) error handling
-		perror("pthread_mutex_init(3p)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	if(standby_pid != -1) {
+		usockit_server_notify(restart_info->notify_fds[PIPE_WRITE_INDEX]);
+
+		usockit_server_print_child_failure("child program", status, "the standby took over");
+
+		child->started_ns = now_ns;
+
+		// the new standby waits for the backoff of the child program, so that a program that keeps failing right away
+		// isn't started over and over again
+		standby->start_pending = true;
+		standby->start_at_ns = (now_ns + ((uint64_t)(child->backoff_ms) * 1000000));
+		child->backoff_ms = usockit_server_double_backoff_ms(child->backoff_ms, restart_options);
+
+		return;
 	}
 
-	errno = pthread_cond_init(&(child_ready_info->cond), cross_support_nullptr);
-	if(errno != 0) {
-		errno_push();
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
-		errno_pop();
+	char consequence[64];
+	snprintf(consequence, sizeof consequence, "restarting it in %lu ms", child->backoff_ms);
+	usockit_server_print_child_failure("child program", status, consequence);
 
-		// TODO: pthread_cond_init(3p) error handling
-		perror("pthread_cond_init(3p)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	usockit_server_schedule_child_start(child, restart_options, now_ns);
+}
+static inline void usockit_server_handle_standby_failure(
+	const struct usockit_server_thread_routine_child_wait_arg* const arg,
+	struct usockit_server_supervised_child* const standby,
+	const int status
+) {
+	assert(arg != cross_support_nullptr);
+	assert(standby != cross_support_nullptr);
+
+	struct usockit_server_restart_info* const restart_info = arg->restart_info;
+	const struct usockit_server_restart_options* const restart_options = arg->restart_options;
+	const uint64_t now_ns = usockit_server_now_ns();
+
+	if(((now_ns - standby->started_ns) / 1000000) > restart_options->backoff_max_ms) {
+		standby->backoff_ms = restart_options->backoff_min_ms;
 	}
 
-	child_ready_info->condition = false;
+	pthread_mutex_lock(&(restart_info->mutex));
+	close(restart_info->standby_stdin_fd);
+	restart_info->standby_pid = -1;
+	restart_info->standby_stdin_fd = -1;
+	pthread_mutex_unlock(&(restart_info->mutex));
+
+	char consequence[64];
+	snprintf(consequence, sizeof consequence, "restarting it in %lu ms", standby->backoff_ms);
+	usockit_server_print_child_failure("standby child program", status, consequence);
+
+	usockit_server_schedule_child_start(standby, restart_options, now_ns);
+}
+
+static inline void usockit_server_start_due_children(
+	const struct usockit_server_thread_routine_child_wait_arg* const arg,
+	struct usockit_server_supervised_child* const child,
+	struct usockit_server_supervised_child* const standby
+) {
+	assert(arg != cross_support_nullptr);
+	assert(child != cross_support_nullptr);
+	assert(standby != cross_support_nullptr);
+
+	struct usockit_server_restart_info* const restart_info = arg->restart_info;
+	const struct usockit_server_restart_options* const restart_options = arg->restart_options;
+
+	pid_t child_pid;
+	int child_stdin_fd;
+
+	if(child->start_pending) {
+		const uint64_t now_ns = usockit_server_now_ns();
+		if(now_ns < child->start_at_ns) {
+			return;
+		}
+
+		const enum usockit_server_ret_status ret_status =
+			usockit_server_start_child(arg->child_program_argv, arg->socket_fd, false, &child_pid, &child_stdin_fd);
+
+		if(ret_status != USOCKIT_SERVER_RET_STATUS_SUCCESS) {
+			// the reason was already printed
+			fprintf(
+				stderr,
+				"usockit: restarting the child program failed; trying again in %lu ms\n",
+				child->backoff_ms
+			);
+			usockit_server_schedule_child_start(child, restart_options, now_ns);
+			return;
+		}
+
+		pthread_mutex_lock(&(restart_info->mutex));
+		usockit_server_activate_child(arg, child_pid, child_stdin_fd);
+		pthread_mutex_unlock(&(restart_info->mutex));
+
+		usockit_server_notify(restart_info->notify_fds[PIPE_WRITE_INDEX]);
+
+		child->start_pending = false;
+		child->started_ns = now_ns;
+	}
+
+	if(standby->start_pending) {
+		const uint64_t now_ns = usockit_server_now_ns();
+		if(now_ns < standby->start_at_ns) {
+			return;
+		}
+
+		const enum usockit_server_ret_status ret_status =
+			usockit_server_start_child(arg->child_program_argv, arg->socket_fd, false, &child_pid, &child_stdin_fd);
+
+		if(ret_status != USOCKIT_SERVER_RET_STATUS_SUCCESS) {
+			// the reason was already printed
+			fprintf(
+				stderr,
+				"usockit: starting the standby child program failed; trying again in %lu ms\n",
+				standby->backoff_ms
+			);
+			usockit_server_schedule_child_start(standby, restart_options, now_ns);
+			return;
+		}
+
+		pthread_mutex_lock(&(restart_info->mutex));
+		restart_info->standby_pid = child_pid;
+		restart_info->standby_stdin_fd = child_stdin_fd;
+		pthread_mutex_unlock(&(restart_info->mutex));
+
+		standby->start_pending = false;
+		standby->started_ns = now_ns;
+	}
+}
+
+static inline void usockit_server_activate_child(const struct usockit_server_thread_routine_child_wait_arg* const arg,
+                                                 const pid_t child_pid,
+                                                 const int child_stdin_fd) {
+	assert(arg != cross_support_nullptr);
+
+	struct usockit_server_restart_info* const restart_info = arg->restart_info;
+
+	*(arg->child_pid_ptr) = child_pid;
+	*(arg->child_stdin_fd_ptr) = child_stdin_fd;
+	atomic_store(&(restart_info->signalable_child_pid), child_pid);
+
+	// the queue goes first; the client_connection thread doesn't write anything until the child is marked as up
+	const size_t writtenc =
+		usockit_server_write_until_error(child_stdin_fd, restart_info->queue, restart_info->queue_size);
 
+	restart_info->queue_head_position += writtenc;
+
+	if(writtenc < restart_info->queue_size) {
+		// TODO: write(2) error handling
+		// most likely the new child died right away as well (EPIPE). the rest stays in the queue for the next one
+		memmove(restart_info->queue, (restart_info->queue + writtenc), (restart_info->queue_size - writtenc));
+		restart_info->queue_size -= writtenc;
+	} else {
+		restart_info->queue_size = 0;
+		restart_info->child_up = true;
+	}
+}
+
+static inline unsigned long usockit_server_double_backoff_ms(
+	const unsigned long backoff_ms,
+	const struct usockit_server_restart_options* const restart_options
+) {
+	assert(restart_options != cross_support_nullptr);
+
+	return ((backoff_ms > (restart_options->backoff_max_ms / 2))
+	        ? restart_options->backoff_max_ms
+	        : (backoff_ms * 2));
+}
+
+static inline void usockit_server_schedule_child_start(
+	struct usockit_server_supervised_child* const supervised_child,
+	const struct usockit_server_restart_options* const restart_options,
+	const uint64_t now_ns
+) {
+	assert(supervised_child != cross_support_nullptr);
+	assert(restart_options != cross_support_nullptr);
+
+	supervised_child->start_pending = true;
+	supervised_child->start_at_ns = (now_ns + ((uint64_t)(supervised_child->backoff_ms) * 1000000));
+	supervised_child->backoff_ms = usockit_server_double_backoff_ms(supervised_child->backoff_ms, restart_options);
+}
+
+static inline void usockit_server_print_child_failure(const const_cstr_t name,
+                                                      const int status,
+                                                      const const_cstr_t consequence) {
+	assert(name != cross_support_nullptr);
+	assert(consequence != cross_support_nullptr);
+
+	if(WIFSIGNALED(status)) {
+		fprintf(stderr, "usockit: %s was killed by signal %i; %s\n", name, WTERMSIG(status), consequence);
+	} else {
+		fprintf(stderr, "usockit: %s exited with status %i; %s\n", name, WEXITSTATUS(status), consequence);
+	}
+}
+
+static inline bool usockit_server_wait_for_child_ready(struct usockit_server_child_ready_info* const child_ready_info) {
+	pthread_mutex_lock(&(child_ready_info->mutex));
+	while(!(child_ready_info->condition) && !(child_ready_info->aborted)) {
+		pthread_cond_wait(&(child_ready_info->cond), &(child_ready_info->mutex));
+	}
+	const bool ready = child_ready_info->condition;
+	pthread_mutex_unlock(&(child_ready_info->mutex));
+
+	return ready;
+}
+
+static inline void usockit_server_abort_child_ready(struct usockit_server_child_ready_info* const child_ready_info) {
+	pthread_mutex_lock(&(child_ready_info->mutex));
+	child_ready_info->aborted = true;
+	pthread_mutex_unlock(&(child_ready_info->mutex));
+	pthread_cond_broadcast(&(child_ready_info->cond));
+}
+
+static inline void usockit_server_wait_for_stdin_preload(
+	struct usockit_server_child_ready_info* const child_ready_info
+) {
+	pthread_mutex_lock(&(child_ready_info->mutex));
+	while(child_ready_info->preloading) {
+		pthread_cond_wait(&(child_ready_info->cond), &(child_ready_info->mutex));
+	}
+	pthread_mutex_unlock(&(child_ready_info->mutex));
+}
+
+static inline void usockit_server_end_stdin_preload(struct usockit_server_child_ready_info* const child_ready_info) {
+	pthread_mutex_lock(&(child_ready_info->mutex));
+	child_ready_info->preloading = false;
+	pthread_mutex_unlock(&(child_ready_info->mutex));
+	pthread_cond_broadcast(&(child_ready_info->cond));
+}
+
+static inline ret_status_t usockit_server_create_notifier(int notifier_fds[2]) {
+	assert(notifier_fds != cross_support_nullptr);
+
+	#if USOCKIT_SERVER_EVENTFD_SUPPORT
+		errno = 0;
+		const int fd = eventfd(0, (EFD_CLOEXEC | EFD_NONBLOCK));
+		if(fd == -1) {
+			return RET_STATUS_FAILURE;
+		}
+
+		notifier_fds[PIPE_READ_INDEX]  = fd;
+		notifier_fds[PIPE_WRITE_INDEX] = fd;
+	#else
+		const ret_status_t ret_status = usockit_server_create_cloexec_pipe(notifier_fds);
+		if(ret_status != RET_STATUS_SUCCESS) {
+			return ret_status;
+		}
+
+		// non-blocking so that notifying from a signal handler never blocks and draining stops once it's empty
+		for(size_t i = 0; i < 2; ++i) {
+			errno = 0;
+			const int ret = fcntl(notifier_fds[i], F_SETFL, O_NONBLOCK);
+			if(ret != 0) {
+				errno_push();
+				close(notifier_fds[PIPE_WRITE_INDEX]);
+				close(notifier_fds[PIPE_READ_INDEX]);
+				errno_pop();
+
+				return RET_STATUS_FAILURE;
+			}
+		}
+	#endif
+
+	return RET_STATUS_SUCCESS;
+}
+
+static inline void usockit_server_close_notifier(const int notifier_fds[2]) {
+	assert(notifier_fds != cross_support_nullptr);
+
+	close(notifier_fds[PIPE_READ_INDEX]);
+
+	#if !(USOCKIT_SERVER_EVENTFD_SUPPORT)
+		close(notifier_fds[PIPE_WRITE_INDEX]);
+	#endif
+}
+
+static inline void usockit_server_drain_notifier(const int notifier_read_fd) {
+	// at least 8 bytes, which is what a read from an eventfd requires
+	unsigned char buffer[64];
+
+	ssize_t readc;
+	do {
+		errno = 0;
+		readc = read(notifier_read_fd, buffer, array_size(buffer));
+	} while((readc > 0) || ((readc == -1) && (errno == EINTR)));
+}
 
+static inline void usockit_server_notify(const int notify_fd) {
+	#if USOCKIT_SERVER_EVENTFD_SUPPORT
+		const uint64_t value = 1;
+	#else
+		const unsigned char value = 1;
+	#endif
 
 	errno = 0;
-	struct usockit_server_thread_routine_client_connection_client_ready_info* const client_ready_info =
-		calloc(1, sizeof (struct usockit_server_thread_routine_client_connection_client_ready_info));
-	cross_support_if_unlikely(client_ready_info == cross_support_nullptr) {
-		errno_push();
-		pthread_cond_destroy(&(child_ready_info->cond));
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
-		errno_pop();
+	const ret_status_t ret_status = write_all(notify_fd, &value, sizeof value);
+	if(ret_status != RET_STATUS_SUCCESS) {
+		// TODO: write(2) error handling
+		perror("write(2)");
+	}
+}
 
-		// TODO: calloc(3) error handling
-		perror("calloc(3)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+static inline enum usockit_server_wait_result usockit_server_wait_readable(
+	const int fd,
+	const int shutdown_fd,
+	const int upgrade_fd
+) {
+	// poll(2) ignores negative file descriptors, so an `upgrade_fd` of -1 simply never reports anything
+	struct pollfd pfds[3] = {
+		{ .fd = shutdown_fd, .events = POLLIN },
+		{ .fd = upgrade_fd,  .events = POLLIN },
+		{ .fd = fd,          .events = POLLIN },
+	};
+
+	int ret;
+	do {
+		errno = 0;
+		ret = poll(pfds, (nfds_t)array_size(pfds), -1);
+	} while((ret == -1) && (errno == EINTR));
+
+	if(ret == -1) {
+		return USOCKIT_SERVER_WAIT_RESULT_FAILURE;
 	}
 
-	errno = pthread_mutex_init(&(client_ready_info->mutex), cross_support_nullptr);
-	if(errno != 0) {
-		errno_push();
+	if(pfds[0].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN;
+	}
 
-		free(client_ready_info);
+	if(pfds[1].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_UPGRADE;
+	}
 
-		pthread_cond_destroy(&(child_ready_info->cond));
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
+	return USOCKIT_SERVER_WAIT_RESULT_READABLE;
+}
 
-		errno_pop();
+static inline enum usockit_server_wait_result usockit_server_wait_readable_timeout(
+	const int fd,
+	const int shutdown_fd,
+	const int upgrade_fd,
+	const int timeout_ms
+) {
+	struct pollfd pfds[3] = {
+		{ .fd = shutdown_fd, .events = POLLIN },
+		{ .fd = upgrade_fd,  .events = POLLIN },
+		{ .fd = fd,          .events = POLLIN },
+	};
 
-		// TODO: pthread_mutex_init(3p) error handling
-		perror("pthread_mutex_init(3p)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	int ret;
+	do {
+		errno = 0;
+		ret = poll(pfds, (nfds_t)array_size(pfds), timeout_ms);
+	} while((ret == -1) && (errno == EINTR));
+
+	if(ret == -1) {
+		return USOCKIT_SERVER_WAIT_RESULT_FAILURE;
+	}
+
+	if(pfds[0].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN;
+	}
+
+	if(pfds[1].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_UPGRADE;
+	}
+
+	if(pfds[2].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_READABLE;
+	}
+
+	return USOCKIT_SERVER_WAIT_RESULT_TIMEOUT;
+}
+
+static inline enum usockit_server_wait_result usockit_server_wait_timeout(
+	const int shutdown_fd,
+	const int upgrade_fd,
+	const int timeout_ms
+) {
+	struct pollfd pfds[2] = {
+		{ .fd = shutdown_fd, .events = POLLIN },
+		{ .fd = upgrade_fd,  .events = POLLIN },
+	};
+
+	int ret;
+	do {
+		errno = 0;
+		ret = poll(pfds, (nfds_t)array_size(pfds), timeout_ms);
+	} while((ret == -1) && (errno == EINTR));
+
+	if(ret == -1) {
+		return USOCKIT_SERVER_WAIT_RESULT_FAILURE;
+	}
+
+	if(pfds[0].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN;
+	}
+
+	if(pfds[1].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_UPGRADE;
+	}
+
+	return USOCKIT_SERVER_WAIT_RESULT_TIMEOUT;
+}
+
+static inline enum usockit_server_wait_result usockit_server_wait_hangup(
+	const int fd,
+	const int shutdown_fd,
+	const int upgrade_fd,
+	const int timeout_ms
+) {
+	// a socket whose peer shut down its sending side is always readable, so only the hang-up is waited for; poll(2)
+	// reports it even without asking for any events
+	struct pollfd pfds[3] = {
+		{ .fd = shutdown_fd, .events = POLLIN },
+		{ .fd = upgrade_fd,  .events = POLLIN },
+		{ .fd = fd,          .events = 0 },
+	};
+
+	int ret;
+	do {
+		errno = 0;
+		ret = poll(pfds, (nfds_t)array_size(pfds), timeout_ms);
+	} while((ret == -1) && (errno == EINTR));
+
+	if(ret == -1) {
+		return USOCKIT_SERVER_WAIT_RESULT_FAILURE;
+	}
+
+	if(pfds[0].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_SHUTDOWN;
+	}
+
+	if(pfds[1].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_UPGRADE;
+	}
+
+	if(pfds[2].revents != 0) {
+		return USOCKIT_SERVER_WAIT_RESULT_READABLE;
+	}
+
+	return USOCKIT_SERVER_WAIT_RESULT_TIMEOUT;
+}
+
+static inline uint64_t usockit_server_now_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (((uint64_t)(now.tv_sec) * 1000000000) + (uint64_t)(now.tv_nsec));
+}
+
+static inline void usockit_server_block_sigpipe(void) {
+	// with SIGPIPE blocked, a call to write() on a closed socket or pipe (e.g.: a client that disconnected or a child
+	// that died) will return with `errno` set to `EPIPE` instead of killing the entire server.
+	// the signal mask is per thread, so the child (which is forked off the main thread) is not affected by this
+	sigset_t sigset;
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &sigset, cross_support_nullptr);
+}
+
+static inline struct usockit_server_upgrade_info* usockit_server_create_upgrade_info(void) {
+	errno = 0;
+	struct usockit_server_upgrade_info* const upgrade_info = calloc(1, sizeof (struct usockit_server_upgrade_info));
+	cross_support_if_unlikely(upgrade_info == cross_support_nullptr) {
+		return cross_support_nullptr;
 	}
 
-	errno = pthread_cond_init(&(client_ready_info->cond), cross_support_nullptr);
+	errno = pthread_mutex_init(&(upgrade_info->mutex), cross_support_nullptr);
 	if(errno != 0) {
 		errno_push();
+		free(upgrade_info);
+		errno_pop();
 
-		pthread_mutex_destroy(&(client_ready_info->mutex));
-		free(client_ready_info);
+		return cross_support_nullptr;
+	}
 
-		pthread_cond_destroy(&(child_ready_info->cond));
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
+	errno = pthread_cond_init(&(upgrade_info->cond), cross_support_nullptr);
+	if(errno != 0) {
+		errno_push();
+		pthread_mutex_destroy(&(upgrade_info->mutex));
+		free(upgrade_info);
+		errno_pop();
+
+		return cross_support_nullptr;
+	}
 
+	const ret_status_t ret_status = usockit_server_create_notifier(upgrade_info->notify_fds);
+	if(ret_status != RET_STATUS_SUCCESS) {
+		errno_push();
+		pthread_cond_destroy(&(upgrade_info->cond));
+		pthread_mutex_destroy(&(upgrade_info->mutex));
+		free(upgrade_info);
 		errno_pop();
 
-		// TODO: pthread_mutex_init(3p) error handling
-		perror("pthread_mutex_init(3p)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		return cross_support_nullptr;
 	}
 
-	client_ready_info->client_fd = -1;
+	upgrade_info->parked_count = 0;
+	upgrade_info->parking_threads_count = USOCKIT_SERVER_UPGRADE_PARKING_THREADS_COUNT;
+	upgrade_info->generation = 0;
+	upgrade_info->child_exited = false;
+	upgrade_info->child_status_known = false;
+	upgrade_info->child_status = 0;
+
+	return upgrade_info;
+}
 
+static inline void usockit_server_destroy_upgrade_info(struct usockit_server_upgrade_info* const upgrade_info) {
+	assert(upgrade_info != cross_support_nullptr);
 
+	usockit_server_close_notifier(upgrade_info->notify_fds);
+	pthread_cond_destroy(&(upgrade_info->cond));
+	pthread_mutex_destroy(&(upgrade_info->mutex));
+	free(upgrade_info);
+}
 
+static inline struct usockit_server_pty_output_info* usockit_server_create_pty_output_info(const bool observers) {
 	errno = 0;
-	struct usockit_server_thread_routine_child_wait_arg* const child_wait_thread_routine_arg =
-		calloc(1, sizeof(struct usockit_server_thread_routine_child_wait_arg));
-	cross_support_if_unlikely(child_wait_thread_routine_arg == cross_support_nullptr) {
+	struct usockit_server_pty_output_info* const pty_output_info =
+		calloc(1, sizeof (struct usockit_server_pty_output_info));
+	cross_support_if_unlikely(pty_output_info == cross_support_nullptr) {
+		return cross_support_nullptr;
+	}
+
+	errno = pthread_mutex_init(&(pty_output_info->mutex), cross_support_nullptr);
+	if(errno != 0) {
 		errno_push();
+		free(pty_output_info);
+		errno_pop();
 
-		pthread_cond_destroy(&(client_ready_info->cond));
-		pthread_mutex_destroy(&(client_ready_info->mutex));
-		free(client_ready_info);
+		return cross_support_nullptr;
+	}
 
-		pthread_cond_destroy(&(child_ready_info->cond));
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
+	errno = pthread_cond_init(&(pty_output_info->output_ended_cond), cross_support_nullptr);
+	if(errno != 0) {
+		errno_push();
+		pthread_mutex_destroy(&(pty_output_info->mutex));
+		free(pty_output_info);
+		errno_pop();
+
+		return cross_support_nullptr;
+	}
 
+	// resized by the pty_output thread once it knows the size of the pty
+	pty_output_info->screen =
+		usockit_server_screen_create(USOCKIT_SERVER_SCREEN_DEFAULT_ROWS, USOCKIT_SERVER_SCREEN_DEFAULT_COLS);
+	cross_support_if_unlikely(pty_output_info->screen == cross_support_nullptr) {
+		errno_push();
+		pthread_cond_destroy(&(pty_output_info->output_ended_cond));
+		pthread_mutex_destroy(&(pty_output_info->mutex));
+		free(pty_output_info);
 		errno_pop();
 
-		// TODO: calloc(3) error handling
-		perror("calloc(3)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		return cross_support_nullptr;
+	}
+
+	pty_output_info->attached_client_fd = -1;
+
+	if(!observers) {
+		return pty_output_info;
 	}
 
-	errno = 0;
-	child_wait_thread_routine_arg->child_pid_ptr = malloc(sizeof *(child_wait_thread_routine_arg->child_pid_ptr));
-	cross_support_if_unlikely(child_wait_thread_routine_arg->child_pid_ptr == cross_support_nullptr) {
+	pty_output_info->observer_ring = usockit_server_output_ring_create(USOCKIT_SERVER_OBSERVER_RING_SIZE);
+	cross_support_if_unlikely(pty_output_info->observer_ring == cross_support_nullptr) {
 		errno_push();
+		usockit_server_screen_destroy(pty_output_info->screen);
+		pthread_cond_destroy(&(pty_output_info->output_ended_cond));
+		pthread_mutex_destroy(&(pty_output_info->mutex));
+		free(pty_output_info);
+		errno_pop();
 
-		free(child_wait_thread_routine_arg);
+		return cross_support_nullptr;
+	}
 
-		pthread_cond_destroy(&(client_ready_info->cond));
-		pthread_mutex_destroy(&(client_ready_info->mutex));
-		free(client_ready_info);
+	const ret_status_t ret_status = usockit_server_create_notifier(pty_output_info->observers_notify_fds);
+	if(ret_status != RET_STATUS_SUCCESS) {
+		errno_push();
+		usockit_server_output_ring_destroy(pty_output_info->observer_ring);
+		usockit_server_screen_destroy(pty_output_info->screen);
+		pthread_cond_destroy(&(pty_output_info->output_ended_cond));
+		pthread_mutex_destroy(&(pty_output_info->mutex));
+		free(pty_output_info);
+		errno_pop();
 
-		pthread_cond_destroy(&(child_ready_info->cond));
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
+		return cross_support_nullptr;
+	}
 
-		errno_pop();
+	return pty_output_info;
+}
 
-		// TODO: malloc(3) error handling
-		perror("malloc(3)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+static inline void usockit_server_destroy_pty_output_info(
+	struct usockit_server_pty_output_info* const pty_output_info
+) {
+	if(pty_output_info == cross_support_nullptr) {
+		return;
 	}
 
-	child_wait_thread_routine_arg->child_ready_info = child_ready_info;
+	if(pty_output_info->observer_ring != cross_support_nullptr) {
+		usockit_server_close_notifier(pty_output_info->observers_notify_fds);
+		usockit_server_output_ring_destroy(pty_output_info->observer_ring);
+	}
 
+	usockit_server_screen_destroy(pty_output_info->screen);
+	pthread_cond_destroy(&(pty_output_info->output_ended_cond));
+	pthread_mutex_destroy(&(pty_output_info->mutex));
+	free(pty_output_info);
+}
 
+static inline struct usockit_server_restart_info* usockit_server_create_restart_info(const size_t queue_capacity) {
+	errno = 0;
+	struct usockit_server_restart_info* const restart_info = calloc(1, sizeof (struct usockit_server_restart_info));
+	cross_support_if_unlikely(restart_info == cross_support_nullptr) {
+		return cross_support_nullptr;
+	}
 
 	errno = 0;
-	struct usockit_server_thread_routine_client_connection_arg* const client_connection_thread_routine_arg =
-		calloc(1, sizeof (struct usockit_server_thread_routine_client_connection_arg));
-	cross_support_if_unlikely(client_connection_thread_routine_arg == cross_support_nullptr) {
+	restart_info->queue = malloc(queue_capacity);
+	cross_support_if_unlikely(restart_info->queue == cross_support_nullptr) {
 		errno_push();
+		free(restart_info);
+		errno_pop();
 
-		free(child_wait_thread_routine_arg->child_pid_ptr);
-		free(child_wait_thread_routine_arg);
+		return cross_support_nullptr;
+	}
 
-		pthread_cond_destroy(&(client_ready_info->cond));
-		pthread_mutex_destroy(&(client_ready_info->mutex));
-		free(client_ready_info);
+	errno = pthread_mutex_init(&(restart_info->mutex), cross_support_nullptr);
+	if(errno != 0) {
+		errno_push();
+		free(restart_info->queue);
+		free(restart_info);
+		errno_pop();
 
-		pthread_cond_destroy(&(child_ready_info->cond));
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
+		return cross_support_nullptr;
+	}
 
+	const ret_status_t notifier_ret_status = usockit_server_create_notifier(restart_info->notify_fds);
+	if(notifier_ret_status != RET_STATUS_SUCCESS) {
+		errno_push();
+		pthread_mutex_destroy(&(restart_info->mutex));
+		free(restart_info->queue);
+		free(restart_info);
 		errno_pop();
 
-		// TODO: calloc(3) error handling
-		perror("calloc(3)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+		return cross_support_nullptr;
 	}
 
-	errno = 0;
-	client_connection_thread_routine_arg->child_stdin_fd_ptr =
-		malloc(sizeof *(client_connection_thread_routine_arg->child_stdin_fd_ptr));
-	cross_support_if_unlikely(client_connection_thread_routine_arg->child_stdin_fd_ptr == cross_support_nullptr) {
+	const ret_status_t child_exit_notifier_ret_status =
+		usockit_server_create_notifier(restart_info->child_exit_notify_fds);
+	if(child_exit_notifier_ret_status != RET_STATUS_SUCCESS) {
 		errno_push();
+		usockit_server_close_notifier(restart_info->notify_fds);
+		pthread_mutex_destroy(&(restart_info->mutex));
+		free(restart_info->queue);
+		free(restart_info);
+		errno_pop();
 
-		free(client_connection_thread_routine_arg);
-
-		free(child_wait_thread_routine_arg->child_pid_ptr);
-		free(child_wait_thread_routine_arg);
+		return cross_support_nullptr;
+	}
 
-		pthread_cond_destroy(&(client_ready_info->cond));
-		pthread_mutex_destroy(&(client_ready_info->mutex));
-		free(client_ready_info);
+	restart_info->child_up = true;
+	restart_info->queue_size = 0;
+	restart_info->queue_capacity = queue_capacity;
+	restart_info->standby_pid = -1;
+	restart_info->standby_stdin_fd = -1;
+	atomic_init(&(restart_info->signalable_child_pid), -1);
 
-		pthread_cond_destroy(&(child_ready_info->cond));
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
+	return restart_info;
+}
 
-		errno_pop();
+static inline void usockit_server_destroy_restart_info(struct usockit_server_restart_info* const restart_info) {
+	if(restart_info == cross_support_nullptr) {
+		return;
+	}
 
-		// TODO: malloc(3) error handling
-		perror("malloc(3)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	// the standby isn't waited for; like any other program reading from stdin, it is expected to exit on EOF
+	if(restart_info->standby_stdin_fd != -1) {
+		close(restart_info->standby_stdin_fd);
 	}
 
-	client_connection_thread_routine_arg->client_ready_info = client_ready_info;
+	usockit_server_close_notifier(restart_info->child_exit_notify_fds);
+	usockit_server_close_notifier(restart_info->notify_fds);
+	pthread_mutex_destroy(&(restart_info->mutex));
+	free(restart_info->queue);
+	free(restart_info);
+}
 
+static inline struct usockit_server_worker_pool* usockit_server_create_worker_pool(const size_t count) {
+	errno = 0;
+	struct usockit_server_worker_pool* const worker_pool =
+		calloc(1, (sizeof (struct usockit_server_worker_pool) + (count * sizeof (struct usockit_server_worker))));
+	cross_support_if_unlikely(worker_pool == cross_support_nullptr) {
+		return cross_support_nullptr;
+	}
 
+	worker_pool->count = count;
+	worker_pool->current_index = count;
+	worker_pool->next_index = 0;
 
-	errno = 0;
-	struct usockit_server_thread_routine_accept_arg* const accept_thread_routine_arg =
-		calloc(1, sizeof(struct usockit_server_thread_routine_accept_arg));
-	cross_support_if_unlikely(accept_thread_routine_arg == cross_support_nullptr) {
-		errno_push();
+	for(size_t i = 0; i < count; ++i) {
+		worker_pool->workers[i].pid = -1;
+		worker_pool->workers[i].stdin_fd = -1;
+		worker_pool->workers[i].gone = false;
+	}
 
-		free(client_connection_thread_routine_arg->child_stdin_fd_ptr);
-		free(client_connection_thread_routine_arg);
+	return worker_pool;
+}
 
-		free(child_wait_thread_routine_arg->child_pid_ptr);
-		free(child_wait_thread_routine_arg);
+static inline void usockit_server_destroy_worker_pool(struct usockit_server_worker_pool* const worker_pool) {
+	if(worker_pool == cross_support_nullptr) {
+		return;
+	}
 
-		pthread_cond_destroy(&(client_ready_info->cond));
-		pthread_mutex_destroy(&(client_ready_info->mutex));
-		free(client_ready_info);
+	for(size_t i = 0; i < worker_pool->count; ++i) {
+		if(worker_pool->workers[i].stdin_fd != -1) {
+			close(worker_pool->workers[i].stdin_fd);
+		}
+	}
 
-		pthread_cond_destroy(&(child_ready_info->cond));
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
+	free(worker_pool);
+}
 
-		errno_pop();
+static inline struct usockit_server_wait_queue* usockit_server_create_wait_queue(const size_t capacity,
+                                                                                 const unsigned long timeout_ms) {
+	assert(capacity > 0);
 
-		// TODO: calloc(3) error handling
-		perror("calloc(3)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	errno = 0;
+	struct usockit_server_wait_queue* const wait_queue = calloc(1, sizeof (struct usockit_server_wait_queue));
+	cross_support_if_unlikely(wait_queue == cross_support_nullptr) {
+		return cross_support_nullptr;
 	}
-	accept_thread_routine_arg->child_ready_info = child_ready_info;
-	accept_thread_routine_arg->client_ready_info = client_ready_info;
-	accept_thread_routine_arg->socket_fd = socket_fd;
-
 
+	errno = 0;
+	wait_queue->clients = calloc(capacity, sizeof *(wait_queue->clients));
+	wait_queue->pfds = calloc((capacity + 4), sizeof *(wait_queue->pfds));
+	cross_support_if_unlikely((wait_queue->clients == cross_support_nullptr) ||
+	                          (wait_queue->pfds == cross_support_nullptr)) {
 
-	pthread_t child_wait_thread;
-	errno =
-		pthread_create(
-			&child_wait_thread,
-			cross_support_nullptr,
-			&usockit_server_thread_routine_child_wait,
-			child_wait_thread_routine_arg
-		);
-	if(errno != 0) {
 		errno_push();
+		free(wait_queue->pfds);
+		free(wait_queue->clients);
+		free(wait_queue);
+		errno_pop();
 
-		free(accept_thread_routine_arg);
-
-		free(client_connection_thread_routine_arg->child_stdin_fd_ptr);
-		free(client_connection_thread_routine_arg);
+		return cross_support_nullptr;
+	}
 
-		free(child_wait_thread_routine_arg->child_pid_ptr);
-		free(child_wait_thread_routine_arg);
+	const ret_status_t ret_status = usockit_server_create_notifier(wait_queue->slot_freed_notify_fds);
+	if(ret_status != RET_STATUS_SUCCESS) {
+		errno_push();
+		free(wait_queue->pfds);
+		free(wait_queue->clients);
+		free(wait_queue);
+		errno_pop();
 
-		pthread_cond_destroy(&(client_ready_info->cond));
-		pthread_mutex_destroy(&(client_ready_info->mutex));
-		free(client_ready_info);
+		return cross_support_nullptr;
+	}
 
-		pthread_cond_destroy(&(child_ready_info->cond));
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
+	wait_queue->timeout_ns = ((uint64_t)timeout_ms * 1000000);
+	wait_queue->capacity = capacity;
+	wait_queue->head = 0;
+	atomic_init(&(wait_queue->length), 0);
 
-		errno_pop();
+	return wait_queue;
+}
 
-		// TODO: pthread_create(3) error handling
-		perror("pthread_create(3)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+static inline void usockit_server_destroy_wait_queue(struct usockit_server_wait_queue* const wait_queue) {
+	if(wait_queue == cross_support_nullptr) {
+		return;
 	}
 
-	pthread_t client_connection_thread;
-	errno =
-		pthread_create(
-			&client_connection_thread,
-			cross_support_nullptr,
-			&usockit_server_thread_routine_client_connection,
-			client_connection_thread_routine_arg
-		);
-	if(errno != 0) {
-		errno_push();
+	usockit_server_clear_wait_queue(wait_queue, false, cross_support_nullptr);
 
-		pthread_cancel(child_wait_thread);
-		pthread_join(child_wait_thread, cross_support_nullptr);
+	usockit_server_close_notifier(wait_queue->slot_freed_notify_fds);
+	free(wait_queue->pfds);
+	free(wait_queue->clients);
+	free(wait_queue);
+}
 
-		free(accept_thread_routine_arg);
+static void usockit_server_upgrade_signal_handler(const int signum) {
+	(void)signum;
 
-		free(client_connection_thread_routine_arg->child_stdin_fd_ptr);
-		free(client_connection_thread_routine_arg);
+	// only async-signal-safe stuff in here
+	const int saved_errno = errno;
 
-		free(child_wait_thread_routine_arg->child_pid_ptr);
-		free(child_wait_thread_routine_arg);
+	if(usockit_server_upgrade_signal_notify_fd == -1) {
+		static const char msg[] = "usockit: ignoring upgrade request; upgrades are not supported with workers\n";
+		const ssize_t writec = write(STDERR_FILENO, msg, (sizeof msg - 1));
+		(void)writec;
 
-		pthread_cond_destroy(&(client_ready_info->cond));
-		pthread_mutex_destroy(&(client_ready_info->mutex));
-		free(client_ready_info);
+		errno = saved_errno;
+		return;
+	}
 
-		pthread_cond_destroy(&(child_ready_info->cond));
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
+	atomic_store(&usockit_server_upgrade_requested, true);
 
-		errno_pop();
+	#if USOCKIT_SERVER_EVENTFD_SUPPORT
+		const uint64_t value = 1;
+	#else
+		const unsigned char value = 1;
+	#endif
 
-		// TODO: pthread_create(3) error handling
-		perror("pthread_create(3)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
-	}
+	// the notifier is non-blocking; if the write fails because it is full, it is readable already anyway
+	const ssize_t writec = write(usockit_server_upgrade_signal_notify_fd, &value, sizeof value);
+	(void)writec;
 
-	pthread_t accept_thread;
-	errno =
-		pthread_create(
-			&accept_thread,
-			cross_support_nullptr,
-			&usockit_server_thread_routine_accept,
-			accept_thread_routine_arg
-		);
-	if(errno != 0) {
-		errno_push();
+	errno = saved_errno;
+}
 
-		pthread_cancel(client_connection_thread);
-		pthread_join(client_connection_thread, cross_support_nullptr);
+static inline ret_status_t usockit_server_install_upgrade_signal_handler(const int notify_fd,
+                                                                         struct sigaction* const old_action) {
+	assert(old_action != cross_support_nullptr);
 
-		pthread_cancel(child_wait_thread);
-		pthread_join(child_wait_thread, cross_support_nullptr);
+	usockit_server_upgrade_signal_notify_fd = notify_fd;
 
-		free(accept_thread_routine_arg);
+	struct sigaction action;
+	zeroset_lvalue(action);
 
-		free(client_connection_thread_routine_arg->child_stdin_fd_ptr);
-		free(client_connection_thread_routine_arg);
+	action.sa_handler = &usockit_server_upgrade_signal_handler;
+	sigemptyset(&(action.sa_mask));
+	action.sa_flags = SA_RESTART;
 
-		free(child_wait_thread_routine_arg->child_pid_ptr);
-		free(child_wait_thread_routine_arg);
+	errno = 0;
+	const int ret = sigaction(USOCKIT_SERVER_UPGRADE_SIGNAL, &action, old_action);
+	if(ret != 0) {
+		usockit_server_upgrade_signal_notify_fd = -1;
+		return RET_STATUS_FAILURE;
+	}
 
-		pthread_cond_destroy(&(client_ready_info->cond));
-		pthread_mutex_destroy(&(client_ready_info->mutex));
-		free(client_ready_info);
+	return RET_STATUS_SUCCESS;
+}
 
-		pthread_cond_destroy(&(child_ready_info->cond));
-		pthread_mutex_destroy(&(child_ready_info->mutex));
-		free(child_ready_info);
+static inline void usockit_server_restore_upgrade_signal_handler(const struct sigaction* const old_action) {
+	assert(old_action != cross_support_nullptr);
 
-		errno_pop();
+	sigaction(USOCKIT_SERVER_UPGRADE_SIGNAL, old_action, cross_support_nullptr);
+	usockit_server_upgrade_signal_notify_fd = -1;
+}
 
-		// TODO: pthread_create(3) error handling
-		perror("pthread_create(3)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
-	}
+static void usockit_server_child_exit_signal_handler(const int signum) {
+	(void)signum;
 
+	// only async-signal-safe stuff in here
+	const int saved_errno = errno;
 
+	#if USOCKIT_SERVER_EVENTFD_SUPPORT
+		const uint64_t value = 1;
+	#else
+		const unsigned char value = 1;
+	#endif
 
-	const enum usockit_server_ret_status ret_status =
-		usockit_server_setup_child(
-			child_program_argv,
-			socket_fd,
-			child_ready_info,
-			child_wait_thread_routine_arg->child_pid_ptr,
-			client_connection_thread_routine_arg->child_stdin_fd_ptr,
-			child_wait_thread,
-			accept_thread
-		);
+	// the notifier is non-blocking; if the write fails because it is full, it is readable already anyway
+	const ssize_t writec = write(usockit_server_child_exit_signal_notify_fd, &value, sizeof value);
+	(void)writec;
 
-	pthread_cancel(accept_thread);
-	pthread_join(accept_thread, cross_support_nullptr);
+	errno = saved_errno;
+}
 
-	pthread_cancel(client_connection_thread);
-	pthread_join(client_connection_thread, cross_support_nullptr);
+static inline ret_status_t usockit_server_install_child_exit_signal_handler(const int notify_fd,
+                                                                            struct sigaction* const old_action) {
+	assert(old_action != cross_support_nullptr);
 
-	pthread_cancel(child_wait_thread);
-	pthread_join(child_wait_thread, cross_support_nullptr);
+	usockit_server_child_exit_signal_notify_fd = notify_fd;
 
-	free(accept_thread_routine_arg);
+	struct sigaction action;
+	zeroset_lvalue(action);
 
-	free(client_connection_thread_routine_arg->child_stdin_fd_ptr);
-	free(client_connection_thread_routine_arg);
+	action.sa_handler = &usockit_server_child_exit_signal_handler;
+	sigemptyset(&(action.sa_mask));
+	// the handler is also run in the other threads; SA_RESTART keeps it from interrupting most of what they do
+	action.sa_flags = (SA_RESTART | SA_NOCLDSTOP);
 
-	free(child_wait_thread_routine_arg->child_pid_ptr);
-	free(child_wait_thread_routine_arg);
+	errno = 0;
+	const int ret = sigaction(SIGCHLD, &action, old_action);
+	if(ret != 0) {
+		usockit_server_child_exit_signal_notify_fd = -1;
+		return RET_STATUS_FAILURE;
+	}
 
-	pthread_cond_destroy(&(client_ready_info->cond));
-	pthread_mutex_destroy(&(client_ready_info->mutex));
-	free(client_ready_info);
+	return RET_STATUS_SUCCESS;
+}
 
-	pthread_cond_destroy(&(child_ready_info->cond));
-	pthread_mutex_destroy(&(child_ready_info->mutex));
-	free(child_ready_info);
+static inline void usockit_server_restore_child_exit_signal_handler(const struct sigaction* const old_action) {
+	assert(old_action != cross_support_nullptr);
 
-	return ret_status;
+	sigaction(SIGCHLD, old_action, cross_support_nullptr);
+	usockit_server_child_exit_signal_notify_fd = -1;
 }
 
-static inline enum usockit_server_ret_status usockit_server_setup_child(
-	const cstr_t* const child_program_argv,
-	const int socket_fd,
-	struct usockit_server_child_ready_info* const child_read_info,
-	pid_t* const child_wait_thread_routine_arg_child_pid_ptr,
-	int* const client_connection_thread_routine_arg_child_stdin_fd_ptr,
-	pthread_t child_wait_thread,
-	pthread_t accept_thread
-) {
-	assert(child_program_argv != cross_support_nullptr);
-	assert(child_read_info != cross_support_nullptr);
-	assert(child_wait_thread_routine_arg_child_pid_ptr != cross_support_nullptr);
-	assert(client_connection_thread_routine_arg_child_stdin_fd_ptr != cross_support_nullptr);
+static inline void usockit_server_park_for_upgrade(struct usockit_server_upgrade_info* const upgrade_info) {
+	assert(upgrade_info != cross_support_nullptr);
 
-	// the main pipe is is used for writing to the child process' stdin
-	int main_pipe[2];
+	pthread_mutex_lock(&(upgrade_info->mutex));
 
-	errno = 0;
-	int ret = pipe(main_pipe);
-	if(ret != 0) {
-		// TODO: pipe(2) error handling
-		perror("pipe(2)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	// the request is only ever withdrawn while holding the mutex, so if it is still set here, the main thread will
+	// either wait for us or has yet to notice the request at all
+	if(!atomic_load(&usockit_server_upgrade_requested)) {
+		pthread_mutex_unlock(&(upgrade_info->mutex));
+		return;
 	}
 
+	const unsigned long generation = upgrade_info->generation;
 
-	// the reporting pipe is for the child reporting either error or success back to the parent.
-	// if the child encounters an error, it will send a struct `usockit_server_child_error` over the pipe, signaling to
-	// the parent that an error occurred.
-	// this pipe is also opened with the close-on-exec flag, which means that when the child successfully calls one of
-	// the exec(3)-family functions, the parent will receive an EOF without any data, which signals to the parent that
-	// everything went ok
-	int reporting_pipe[2];
+	++(upgrade_info->parked_count);
+	pthread_cond_broadcast(&(upgrade_info->cond));
 
-	#if USOCKIT_SERVER_PIPE2_SUPPORT
-		errno = 0;
-		ret = pipe2(reporting_pipe, O_CLOEXEC);
-		if(ret != 0) {
-			errno_push();
-			close(main_pipe[PIPE_WRITE_INDEX]);
-			close(main_pipe[PIPE_READ_INDEX]);
-			errno_pop();
+	while(upgrade_info->generation == generation) {
+		pthread_cond_wait(&(upgrade_info->cond), &(upgrade_info->mutex));
+	}
 
-			// TODO: pipe2(2) error handling
-			perror("pipe2(2)");
-			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
-		}
-	#else
-		errno = 0;
-		ret = pipe(reporting_pipe);
-		if(ret != 0) {
-			errno_push();
-			close(main_pipe[PIPE_WRITE_INDEX]);
-			close(main_pipe[PIPE_READ_INDEX]);
-			errno_pop();
+	--(upgrade_info->parked_count);
+	pthread_cond_broadcast(&(upgrade_info->cond));
 
-			// TODO: pipe(2) error handling
-			perror("pipe(2)");
-			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
-		}
+	pthread_mutex_unlock(&(upgrade_info->mutex));
+}
 
-		errno = 0;
-		ret = fcntl(reporting_pipe[PIPE_WRITE_INDEX], F_SETFD, O_CLOEXEC);
-		if(ret != 0) {
-			errno_push();
+static inline void usockit_server_release_parked_threads(struct usockit_server_upgrade_info* const upgrade_info) {
+	assert(upgrade_info != cross_support_nullptr);
 
-			close(reporting_pipe[PIPE_WRITE_INDEX]);
-			close(reporting_pipe[PIPE_READ_INDEX]);
+	pthread_mutex_lock(&(upgrade_info->mutex));
 
-			close(main_pipe[PIPE_WRITE_INDEX]);
-			close(main_pipe[PIPE_READ_INDEX]);
+	// the signal handler sets the flag before it notifies, so as long as the notifier is readable, the request stands.
+	// withdrawing it is repeated until a request that came in while withdrawing didn't leave the notifier readable
+	// behind; such a request simply coincides with the one that was just called off
+	struct pollfd pfd = { .fd = upgrade_info->notify_fds[PIPE_READ_INDEX], .events = POLLIN };
+	do {
+		usockit_server_drain_notifier(upgrade_info->notify_fds[PIPE_READ_INDEX]);
+		atomic_store(&usockit_server_upgrade_requested, false);
+	} while(poll(&pfd, 1, 0) > 0);
 
-			errno_pop();
+	++(upgrade_info->generation);
+	pthread_cond_broadcast(&(upgrade_info->cond));
 
-			// TODO: fcntl(2) error handling
-			perror("fcntl(2)");
-			return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
-		}
-	#endif
+	// wait until every thread actually left, so that none of them is still counted as parked for the next upgrade
+	while(upgrade_info->parked_count > 0) {
+		pthread_cond_wait(&(upgrade_info->cond), &(upgrade_info->mutex));
+	}
 
+	pthread_mutex_unlock(&(upgrade_info->mutex));
+}
 
-	errno = 0;
-	const pid_t child_pid = fork();
-	if(child_pid == -1) {
-		errno_push();
+static inline void usockit_server_upgrade(
+	struct usockit_server_upgrade_info* const upgrade_info,
+	struct usockit_server_thread_routine_client_connection_client_ready_info* const client_ready_info,
+	const const_cstr_t owned_socket_pathname,
+	const cstr_t* const child_program_argv,
+	const int socket_fd,
+	const int observer_socket_fd,
+	const int control_socket_fd,
+	const pid_t* const child_pid_ptr,
+	const int* const child_stdin_fd_ptr,
+	struct usockit_server_restart_info* const restart_info,
+	const struct usockit_server_options* const options
+) {
+	assert(upgrade_info != cross_support_nullptr);
+	assert(client_ready_info != cross_support_nullptr);
+	assert(child_program_argv != cross_support_nullptr);
+	assert(child_pid_ptr != cross_support_nullptr);
+	assert(child_stdin_fd_ptr != cross_support_nullptr);
+	assert(options != cross_support_nullptr);
 
-		close(reporting_pipe[PIPE_WRITE_INDEX]);
-		close(reporting_pipe[PIPE_READ_INDEX]);
+	pthread_mutex_lock(&(upgrade_info->mutex));
+	while((upgrade_info->parked_count < upgrade_info->parking_threads_count) &&
+	      !(upgrade_info->child_exited)) {
 
-		close(main_pipe[PIPE_WRITE_INDEX]);
-		close(main_pipe[PIPE_READ_INDEX]);
+		pthread_cond_wait(&(upgrade_info->cond), &(upgrade_info->mutex));
+	}
+	const bool child_exited = upgrade_info->child_exited;
+	pthread_mutex_unlock(&(upgrade_info->mutex));
 
-		errno_pop();
+	if(child_exited) {
+		usockit_server_release_parked_threads(upgrade_info);
+		return;
+	}
 
-		// TODO: fork(2) error handling
-		perror("fork(2)");
-		return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+	// held until the exec(3), so that the child_wait thread can't replace the child in the meantime
+	if(restart_info != cross_support_nullptr) {
+		pthread_mutex_lock(&(restart_info->mutex));
+
+		if(!(restart_info->child_up)) {
+			pthread_mutex_unlock(&(restart_info->mutex));
+
+			fputs("usockit: upgrade called off; the child program is being restarted\n", stderr);
+			usockit_server_release_parked_threads(upgrade_info);
+			return;
+		}
 	}
 
-	if(child_pid == 0) {
-		// reporting pipe read end, main pipe write end and the socket is not needed by the child
-		close(reporting_pipe[PIPE_READ_INDEX]);
-		close(main_pipe[PIPE_WRITE_INDEX]);
-		close(socket_fd);
+	// either the client_connection thread is serving a client, or the accept thread handed one over that the
+	// client_connection thread didn't pick up anymore (the slot is occupied, but the client is still in the pipe) or
+	// there is no client at all
+	int client_fd = client_ready_info->client_fd;
+	bool client_fd_from_handoff_pipe = false;
 
-		// noreturn
-		usockit_server_child(
-			child_program_argv,
-			main_pipe[PIPE_READ_INDEX],
-			reporting_pipe[PIPE_WRITE_INDEX]
-		);
-	} else {
-		// reporting pipe write end and main pipe read end is not needed by the parent
-		close(reporting_pipe[PIPE_WRITE_INDEX]);
-		close(main_pipe[PIPE_READ_INDEX]);
+	if((client_fd == -1) && atomic_load(&(client_ready_info->slot_occupied))) {
+		errno = 0;
+		const ssize_t readc = read(client_ready_info->handoff_pipe[PIPE_READ_INDEX], &client_fd, sizeof client_fd);
+		if(readc != (ssize_t)(sizeof client_fd)) {
+			// TODO: read(2) error handling
+			errno_push();
+			if(restart_info != cross_support_nullptr) {
+				pthread_mutex_unlock(&(restart_info->mutex));
+			}
+			errno_pop();
 
-		*child_wait_thread_routine_arg_child_pid_ptr = child_pid;
-		*client_connection_thread_routine_arg_child_stdin_fd_ptr = main_pipe[PIPE_WRITE_INDEX];
+			perror("read(2)");
+			usockit_server_release_parked_threads(upgrade_info);
+			return;
+		}
 
-		const enum usockit_server_ret_status ret_status =
-			usockit_server_parent(
-				reporting_pipe[PIPE_READ_INDEX],
-				child_pid,
-				child_read_info,
-				child_wait_thread,
-				accept_thread
-			);
+		client_fd_from_handoff_pipe = true;
+	}
 
-		close(reporting_pipe[PIPE_READ_INDEX]);
-		close(main_pipe[PIPE_WRITE_INDEX]);
+	// a client that is still in the handoff pipe didn't send anything yet. the queue is empty while the child is up,
+	// so whatever the client that is being served sent was either delivered or lost by now
+	long long client_delivered_size = 0;
+	unsigned long long client_consumed_size = 0;
+	if((client_fd != -1) && !client_fd_from_handoff_pipe) {
+		struct usockit_server_delivery* const delivery = &(client_ready_info->client_delivery);
 
-		return ret_status;
+		if(restart_info != cross_support_nullptr) {
+			usockit_server_settle_queued_delivery(delivery, restart_info);
+		}
+
+		client_delivered_size = (delivery->lost ? -1 : (long long)(delivery->delivered_size));
+		client_consumed_size = (unsigned long long)(delivery->consumed_size);
 	}
-}
 
-static void usockit_server_thread_routine_accept_cleanup_routine(void* arg) {
-	const int client_fd = *(const int*)arg;
+	usockit_server_exec_upgrade(
+		owned_socket_pathname,
+		child_program_argv,
+		socket_fd,
+		observer_socket_fd,
+		control_socket_fd,
+		*child_pid_ptr,
+		*child_stdin_fd_ptr,
+		((restart_info != cross_support_nullptr) ? restart_info->standby_pid : -1),
+		((restart_info != cross_support_nullptr) ? restart_info->standby_stdin_fd : -1),
+		client_fd,
+		client_delivered_size,
+		client_consumed_size,
+		options
+	);
+
+	// still here, so the upgrade failed; back to business as usual
+
+	if(restart_info != cross_support_nullptr) {
+		pthread_mutex_unlock(&(restart_info->mutex));
+	}
 
-	close(client_fd);
-}
+	if(client_fd_from_handoff_pipe) {
+		// the slot is still occupied by the client that we took out of the pipe
+		usockit_server_hand_over_client(client_ready_info, client_fd);
+	}
 
-static void* usockit_server_thread_routine_accept(void* const arg_ptr) {
-	assert(arg_ptr != cross_support_nullptr);
+	usockit_server_release_parked_threads(upgrade_info);
+}
 
-	const struct usockit_server_thread_routine_accept_arg arg =
-		*(const struct usockit_server_thread_routine_accept_arg*)arg_ptr;
+static inline void usockit_server_exec_upgrade(
+	const const_cstr_t owned_socket_pathname,
+	const cstr_t* const child_program_argv,
+	const int socket_fd,
+	const int observer_socket_fd,
+	const int control_socket_fd,
+	const pid_t child_pid,
+	const int child_stdin_fd,
+	const pid_t standby_pid,
+	const int standby_stdin_fd,
+	const int client_fd,
+	const long long client_delivered_size,
+	const unsigned long long client_consumed_size,
+	const struct usockit_server_options* const options
+) {
+	assert(child_program_argv != cross_support_nullptr);
+	assert(options != cross_support_nullptr);
+	assert(options->executable_pathname != cross_support_nullptr);
 
-	usockit_server_wait_for_child_ready(arg.child_ready_info);
+	// these file descriptors must survive the exec(3); every other one either is close-on-exec already or belongs to
+	// the threads that the exec(3) ends. (the observers are among the latter; they are disconnected by the upgrade)
+	const int inherited_fds[] = {
+		socket_fd, observer_socket_fd, control_socket_fd, child_stdin_fd, standby_stdin_fd, client_fd,
+	};
+	for(size_t i = 0; i < array_size(inherited_fds); ++i) {
+		if(inherited_fds[i] == -1) {
+			continue;
+		}
 
-	do {
 		errno = 0;
-		int client_fd = accept(arg.socket_fd, cross_support_nullptr, cross_support_nullptr);
-		if(client_fd == -1) {
-			// TODO: accept(2) error handling
-			perror("accept(2)");
-			continue;
+		const int ret = fcntl(inherited_fds[i], F_SETFD, 0);
+		if(ret != 0) {
+			// TODO: fcntl(2) error handling
+			perror("fcntl(2)");
+			return;
 		}
+	}
 
-		bool do_cleanup;
-		pthread_cleanup_push(usockit_server_thread_routine_accept_cleanup_routine, &client_fd);
+	char listen_fd_arg[32];
+	snprintf(listen_fd_arg, sizeof listen_fd_arg, "--listen-fd=%i", socket_fd);
+
+	// the standby is always given (as -1 if there is none), so that the control socket and the sizes of the client come
+	// at fixed positions
+	char resume_arg[192];
+	snprintf(
+		resume_arg,
+		sizeof resume_arg,
+		"--resume=%lld,%i,%i,%i,%lld,%i,%i,%lld,%llu",
+		(long long)child_pid,
+		child_stdin_fd,
+		client_fd,
+		observer_socket_fd,
+		(long long)standby_pid,
+		standby_stdin_fd,
+		control_socket_fd,
+		client_delivered_size,
+		client_consumed_size
+	);
+
+	char observer_socket_arg[
+		array_size(USOCKIT_SERVER_OBSERVER_SOCKET_ARG_PREFIX) + USOCKIT_SOCKET_PATHNAME_MAX_LENGTH
+	];
+	if(options->observer_socket_pathname != cross_support_nullptr) {
+		snprintf(
+			observer_socket_arg,
+			sizeof observer_socket_arg,
+			USOCKIT_SERVER_OBSERVER_SOCKET_ARG_PREFIX "%s",
+			options->observer_socket_pathname
+		);
+	}
 
-		do {
-			errno = pthread_mutex_trylock(&(arg.client_ready_info->mutex));
-			if(errno != EBUSY) {
-				// client_connection thread currently waiting on the conditional variable
+	char control_socket_arg[
+		array_size(USOCKIT_SERVER_CONTROL_SOCKET_ARG_PREFIX) + USOCKIT_SOCKET_PATHNAME_MAX_LENGTH
+	];
+	if(options->control_socket_pathname != cross_support_nullptr) {
+		snprintf(
+			control_socket_arg,
+			sizeof control_socket_arg,
+			USOCKIT_SERVER_CONTROL_SOCKET_ARG_PREFIX "%s",
+			options->control_socket_pathname
+		);
+	}
 
-				do_cleanup = false;
+	char rate_limit_args[USOCKIT_SERVER_RATE_LIMITS_COUNT][64];
+	for(size_t kind = 0; kind < USOCKIT_SERVER_RATE_LIMITS_COUNT; ++kind) {
+		snprintf(
+			rate_limit_args[kind],
+			sizeof rate_limit_args[kind],
+			"%s%lu:%lu",
+			usockit_server_rate_limit_arg_prefixes[kind],
+			options->rate_limits[kind].rate,
+			options->rate_limits[kind].burst
+		);
+	}
 
-				arg.client_ready_info->client_fd = client_fd;
-				pthread_mutex_unlock(&(arg.client_ready_info->mutex));
+	char credit_window_arg[64];
+	snprintf(credit_window_arg, sizeof credit_window_arg, USOCKIT_SERVER_CREDIT_WINDOW_ARG_PREFIX "%zu",
+	         options->credit_window);
 
-				pthread_testcancel(); // only cancellation point in this branch
+	char linger_arg[64];
+	if(options->linger_ms > 0) {
+		snprintf(linger_arg, sizeof linger_arg, USOCKIT_SERVER_LINGER_ARG_PREFIX "%lu", (options->linger_ms / 1000));
+	}
 
-				pthread_cond_signal(&(arg.client_ready_info->cond));
-			} else {
-				// client_connection thread has mutex currently locked, either because the thread is actually working on
-				// an active connection, or because we caught it during a spurious wakeup
+	char wait_queue_arg[64];
+	if(options->wait_queue_length > 0) {
+		snprintf(
+			wait_queue_arg,
+			sizeof wait_queue_arg,
+			USOCKIT_SERVER_WAIT_QUEUE_ARG_PREFIX "%zu:%lu",
+			options->wait_queue_length,
+			(options->wait_timeout_ms / 1000)
+		);
+	}
 
-				do_cleanup = true;
+	char idle_timeout_arg[64];
+	if(options->idle_timeout_ms > 0) {
+		snprintf(
+			idle_timeout_arg,
+			sizeof idle_timeout_arg,
+			USOCKIT_SERVER_IDLE_TIMEOUT_ARG_PREFIX "%lu",
+			(options->idle_timeout_ms / 1000)
+		);
+	}
 
-				if(arg.client_ready_info->client_fd == -1) {
-					// case of spurious wakeup -> try again
-					pthread_testcancel();
-					continue;
-				}
+	char heartbeat_arg[64];
+	if(options->heartbeat_interval_ms > 0) {
+		snprintf(
+			heartbeat_arg,
+			sizeof heartbeat_arg,
+			USOCKIT_SERVER_HEARTBEAT_ARG_PREFIX "%lu",
+			(options->heartbeat_interval_ms / 1000)
+		);
+	}
 
-				// case of thread working on connection -> reject new client
-				static const char* const msg = "fuck off";
-				// GCC for some reason still warns about the unused result, even with the void cast.
-				// (Clang properly suppresses it)
-				// unknown if this is a bug or intended behaviour [as at 2022-11-08, GCC version 12.2.1]
-				#define TMP_GCC_DIAGNOSTIC_IGNORED_UNUSED_RESULT_SUPPORTED  CROSS_SUPPORT_GCC_LEAST(4,6)
-				#if TMP_GCC_DIAGNOSTIC_IGNORED_UNUSED_RESULT_SUPPORTED
-					#pragma GCC diagnostic push
-					#pragma GCC diagnostic ignored "-Wunused-result"
-				#endif
-				(void)(write_all(client_fd, msg, strlen(msg)));
-				#if TMP_GCC_DIAGNOSTIC_IGNORED_UNUSED_RESULT_SUPPORTED
-					#pragma GCC diagnostic pop
-				#endif
-			}
-		} while(false);
-
-		pthread_cleanup_pop(do_cleanup ? 1 : 0);
-	} while(true);
-}
+	char restart_arg[64];
+	char restart_queue_arg[64];
+	if(options->restart != cross_support_nullptr) {
+		snprintf(
+			restart_arg,
+			sizeof restart_arg,
+			USOCKIT_SERVER_RESTART_ARG_PREFIX "%lu:%lu",
+			options->restart->backoff_min_ms,
+			options->restart->backoff_max_ms
+		);
+		snprintf(
+			restart_queue_arg,
+			sizeof restart_queue_arg,
+			USOCKIT_SERVER_RESTART_QUEUE_ARG_PREFIX "%zu",
+			options->restart->queue_size
+		);
+	}
 
-static void* usockit_server_thread_routine_client_connection(void* const arg_ptr) {
-	assert(arg_ptr != cross_support_nullptr);
+	size_t child_program_argc = 0;
+	while(child_program_argv[child_program_argc] != cross_support_nullptr) {
+		++child_program_argc;
+	}
 
-	struct usockit_server_thread_routine_client_connection_arg arg =
-		*(const struct usockit_server_thread_routine_client_connection_arg*)arg_ptr;
+	// <executable> [--report-memory] [--pty] [--observer-socket=<path>] [--control-socket=<path>]
+	//   [--rate-limit=<limit>] [--line-limit=<limit>] [--global-rate-limit=<limit>] [--global-line-limit=<limit>]
+	//   --credit-window=<size> [--linger=<seconds>] [--wait-queue=<length>:<seconds>] [--idle-timeout=<seconds>]
+	//   [--heartbeat=<seconds>] [--restart=<backoff> --restart-queue=<size> [--standby]] --listen-fd=<fd>
+	//   --resume=<state> [<socket_path>] -- <program> [<args>...]
+	errno = 0;
+	const_cstr_t* const argv = calloc((child_program_argc + 18 + USOCKIT_SERVER_RATE_LIMITS_COUNT), sizeof *argv);
+	cross_support_if_unlikely(argv == cross_support_nullptr) {
+		// TODO: calloc(3) error handling
+		perror("calloc(3)");
+		return;
+	}
 
-	do {
-		pthread_mutex_lock(&(arg.client_ready_info->mutex));
-		while(arg.client_ready_info->client_fd == -1) {
-			pthread_cond_wait(&(arg.client_ready_info->cond), &(arg.client_ready_info->mutex));
+	size_t argc = 0;
+	argv[argc++] = options->executable_pathname;
+	if(options->report_memory) {
+		argv[argc++] = "--report-memory";
+	}
+	if(options->pty) {
+		argv[argc++] = "--pty";
+	}
+	if(options->observer_socket_pathname != cross_support_nullptr) {
+		argv[argc++] = observer_socket_arg;
+	}
+	if(options->control_socket_pathname != cross_support_nullptr) {
+		argv[argc++] = control_socket_arg;
+	}
+	for(size_t kind = 0; kind < USOCKIT_SERVER_RATE_LIMITS_COUNT; ++kind) {
+		if(options->rate_limits[kind].rate != 0) {
+			argv[argc++] = rate_limit_args[kind];
+		}
+	}
+	argv[argc++] = credit_window_arg;
+	if(options->linger_ms > 0) {
+		argv[argc++] = linger_arg;
+	}
+	if(options->wait_queue_length > 0) {
+		argv[argc++] = wait_queue_arg;
+	}
+	if(options->idle_timeout_ms > 0) {
+		argv[argc++] = idle_timeout_arg;
+	}
+	if(options->heartbeat_interval_ms > 0) {
+		argv[argc++] = heartbeat_arg;
+	}
+	if(options->restart != cross_support_nullptr) {
+		argv[argc++] = restart_arg;
+		argv[argc++] = restart_queue_arg;
+
+		if(options->restart->standby) {
+			argv[argc++] = USOCKIT_SERVER_STANDBY_ARG;
 		}
+	}
+	argv[argc++] = listen_fd_arg;
+	argv[argc++] = resume_arg;
+	if(owned_socket_pathname != cross_support_nullptr) {
+		argv[argc++] = owned_socket_pathname;
+	}
+	argv[argc++] = "--";
+	for(size_t i = 0; i < child_program_argc; ++i) {
+		argv[argc++] = child_program_argv[i];
+	}
+	argv[argc] = cross_support_nullptr;
 
-		pthread_cleanup_push(usockit_server_thread_routine_client_connection_cleanup_routine, arg.client_ready_info);
+	// an ignored signal stays ignored across exec(3), so another request arriving before the new server installed its
+	// handler doesn't kill it (and with that, the child)
+	struct sigaction ignore_action;
+	zeroset_lvalue(ignore_action);
+	ignore_action.sa_handler = SIG_IGN;
+	sigemptyset(&(ignore_action.sa_mask));
 
-		do {
-			unsigned char buffer[1024];
-			const ssize_t readc = read(arg.client_ready_info->client_fd, buffer, array_size(buffer));
+	struct sigaction old_action;
+	sigaction(USOCKIT_SERVER_UPGRADE_SIGNAL, &ignore_action, &old_action);
 
-			if(readc > 0) {
-				const ret_status_t ret_status = write_all(*(arg.child_stdin_fd_ptr), buffer, (size_t)readc);
-				if(ret_status != RET_STATUS_SUCCESS) {
-					// TODO: write(2) error handling
-					break;
-				}
-			}
+	errno = 0;
+	execvp(options->executable_pathname, (char* const*)argv);
 
-			if(readc == 0) {
-				break;
-			}
+	errno_push();
+	sigaction(USOCKIT_SERVER_UPGRADE_SIGNAL, &old_action, cross_support_nullptr);
+	free(argv);
+	errno_pop();
 
-			if(readc < 0) {
-				// TODO: read(2) error handling
-				break;
-			}
-		} while(true);
+	// TODO: execvp(3) error handling
+	perror("execvp(3)");
+}
 
-		pthread_cleanup_pop(1);
-	} while(true);
+static inline void usockit_server_set_thread_name(const const_cstr_t name) {
+	assert(name != cross_support_nullptr);
+
+	#if USOCKIT_SERVER_PTHREAD_SETNAME_NP_SUPPORT
+		// purely cosmetic (shows up in ps(1), top(1) and /proc), so failures are ignored
+		(void)pthread_setname_np(pthread_self(), name);
+	#else
+		(void)name;
+	#endif
 }
 
-static void usockit_server_thread_routine_client_connection_cleanup_routine(void* const arg) {
-	assert(arg != cross_support_nullptr);
+static inline ret_status_t usockit_server_create_cloexec_pipe(int pipe_fds[2]) {
+	assert(pipe_fds != cross_support_nullptr);
 
-	struct usockit_server_thread_routine_client_connection_client_ready_info* client_ready_info =
-		(struct usockit_server_thread_routine_client_connection_client_ready_info*)arg;
+	#if USOCKIT_SERVER_PIPE2_SUPPORT
+		errno = 0;
+		const int ret = pipe2(pipe_fds, O_CLOEXEC);
+		if(ret != 0) {
+			return RET_STATUS_FAILURE;
+		}
+	#else
+		errno = 0;
+		int ret = pipe(pipe_fds);
+		if(ret != 0) {
+			return RET_STATUS_FAILURE;
+		}
 
-	const int client_fd = client_ready_info->client_fd;
-	client_ready_info->client_fd = -1;
+		for(size_t i = 0; i < 2; ++i) {
+			errno = 0;
+			ret = fcntl(pipe_fds[i], F_SETFD, FD_CLOEXEC);
+			if(ret != 0) {
+				errno_push();
+				close(pipe_fds[PIPE_WRITE_INDEX]);
+				close(pipe_fds[PIPE_READ_INDEX]);
+				errno_pop();
 
-	pthread_mutex_unlock(&(client_ready_info->mutex));
+				return RET_STATUS_FAILURE;
+			}
+		}
+	#endif
 
-	close(client_fd);
+	return RET_STATUS_SUCCESS;
 }
 
-static void* usockit_server_thread_routine_child_wait(void* const arg_ptr) {
-	assert(arg_ptr != cross_support_nullptr);
-
-	const struct usockit_server_thread_routine_child_wait_arg arg =
-		*(const struct usockit_server_thread_routine_child_wait_arg*)arg_ptr;
+static inline void usockit_server_report_memory(void) {
+	#if USOCKIT_SERVER_PROC_SELF_STATUS_SUPPORT
+		errno = 0;
+		FILE* const status_file = fopen("/proc/self/status", "r");
+		if(status_file == cross_support_nullptr) {
+			// TODO: fopen(3) error handling
+			perror("fopen(3)");
+			return;
+		}
 
-	usockit_server_wait_for_child_ready(arg.child_ready_info);
+		unsigned long rss_kib = 0;
+		unsigned long vsz_kib = 0;
+		unsigned long threads = 0;
 
-	waitpid(*(arg.child_pid_ptr), cross_support_nullptr, 0);
+		char line[256];
+		while(fgets(line, sizeof line, status_file) != cross_support_nullptr) {
+			// the return values are ignored on purpose; values that couldn't be parsed are simply reported as 0
+			(void)(sscanf(line, "VmRSS: %lu kB", &rss_kib));
+			(void)(sscanf(line, "VmSize: %lu kB", &vsz_kib));
+			(void)(sscanf(line, "Threads: %lu", &threads));
+		}
 
-	return cross_support_nullptr;
-}
+		fclose(status_file);
 
-static inline void usockit_server_wait_for_child_ready(struct usockit_server_child_ready_info* const child_ready_info) {
-	pthread_mutex_lock(&(child_ready_info->mutex));
-	while(!(child_ready_info->condition)) {
-		pthread_cond_wait(&(child_ready_info->cond), &(child_ready_info->mutex));
-	}
-	pthread_mutex_unlock(&(child_ready_info->mutex));
+		fprintf(stderr, "usockit: rss: %lu KiB, vsz: %lu KiB, threads: %lu\n", rss_kib, vsz_kib, threads);
+	#else
+		fputs("usockit: memory reports are not supported on this platform\n", stderr);
+	#endif
 }
 
-static inline enum usockit_server_ret_status usockit_server_parent(
-	const int reporting_pipe_read_fd,
-	const pid_t child_pid,
-	struct usockit_server_child_ready_info* const child_ready_info,
-	pthread_t child_wait_thread,
-	pthread_t accept_thread
-) {
-	assert(child_ready_info != cross_support_nullptr);
-
+static inline enum usockit_server_ret_status usockit_server_parent(const int reporting_pipe_read_fd,
+                                                                   const pid_t child_pid) {
 	struct usockit_server_child_error child_error;
 	ssize_t readc = read(reporting_pipe_read_fd, &child_error, sizeof child_error);
 
@@ -942,6 +7856,18 @@ static inline enum usockit_server_ret_status usockit_server_parent(
 			waitpid(child_pid, cross_support_nullptr, 0);
 
 			switch(child_error.func) {
+				case USOCKIT_CHILD_ERROR_FUNC_SETSID: {
+					// TODO: setsid(2) error handling
+					errno = child_error.func_errno;
+					perror("setsid(2)");
+					return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+				}
+				case USOCKIT_CHILD_ERROR_FUNC_IOCTL: {
+					// TODO: ioctl(2) error handling
+					errno = child_error.func_errno;
+					perror("ioctl(2)");
+					return USOCKIT_SERVER_RET_STATUS_UNKNOWN;
+				}
 				case USOCKIT_CHILD_ERROR_FUNC_DUP2: {
 					// TODO: dup2(2) error handling
 					errno = child_error.func_errno;
@@ -970,38 +7896,50 @@ static inline enum usockit_server_ret_status usockit_server_parent(
 		}
 	}
 
+	return USOCKIT_SERVER_RET_STATUS_SUCCESS;
+}
+
+static inline void usockit_server_signal_child_ready(struct usockit_server_child_ready_info* const child_ready_info,
+                                                     const struct usockit_server_options* const options) {
+	assert(child_ready_info != cross_support_nullptr);
+	assert(options != cross_support_nullptr);
 
 	pthread_mutex_lock(&(child_ready_info->mutex));
 	child_ready_info->condition = true;
 	pthread_mutex_unlock(&(child_ready_info->mutex));
 	pthread_cond_broadcast(&(child_ready_info->cond));
 
-
-	// ============================================================================================================== //
-	//                                                                                                                //
-	//   Main program runs now.                                                                                       //
-	//   The accept_thread is accepting connections from the socket and is forwarding it to the child's stdin.        //
-	//   Meanwhile the child_wait_thread is waiting until the child dies. When it does, we (the main thread) join     //
-	//   with it and cancel the accept_thread.                                                                        //
-	//                                                                                                                //
-	// ============================================================================================================== //
-
-
-	pthread_join(child_wait_thread, cross_support_nullptr);
-
-	pthread_cancel(accept_thread);
-	pthread_join(accept_thread, cross_support_nullptr);
-
-	return USOCKIT_SERVER_RET_STATUS_SUCCESS;
+	if(options->report_memory) {
+		usockit_server_report_memory();
+	}
 }
 
 static inline void usockit_server_child(
 	const cstr_t* const child_program_argv,
 	const int main_pipe_read_fd,
-	const int reporting_pipe_write_fd
+	const int reporting_pipe_write_fd,
+	const bool pty
 ) {
 	assert(child_program_argv != cross_support_nullptr);
 
+	#if USOCKIT_SERVER_PTY_SUPPORT
+		if(pty) {
+			// a session of its own, so that the pty becomes the controlling terminal of the child; with that, the
+			// child gets line discipline, job control and a SIGHUP once the server is gone
+			errno = 0;
+			const pid_t sid = setsid();
+			if(sid == -1) {
+				usockit_server_child_report_error(reporting_pipe_write_fd, USOCKIT_CHILD_ERROR_FUNC_SETSID);
+			}
+
+			errno = 0;
+			const int ret = ioctl(main_pipe_read_fd, TIOCSCTTY, 0);
+			if(ret == -1) {
+				usockit_server_child_report_error(reporting_pipe_write_fd, USOCKIT_CHILD_ERROR_FUNC_IOCTL);
+			}
+		}
+	#endif
+
 	errno = 0;
 	const int new_fd = dup2(main_pipe_read_fd, STDIN_FILENO);
 	if(new_fd != STDIN_FILENO) {
@@ -1009,16 +7947,21 @@ static inline void usockit_server_child(
 		close(main_pipe_read_fd);
 		errno_pop();
 
-		struct usockit_server_child_error error = {
-			.func = USOCKIT_CHILD_ERROR_FUNC_DUP2,
-			.func_errno = errno,
-		};
-		write(reporting_pipe_write_fd, &error, sizeof error);
-		close(reporting_pipe_write_fd);
-		// no error handling here, we just hope that it works >.<
+		usockit_server_child_report_error(reporting_pipe_write_fd, USOCKIT_CHILD_ERROR_FUNC_DUP2);
+	}
+
+	if(pty) {
+		// the output goes through the terminal as well, otherwise it would still be fully buffered
+		for(int fd = STDOUT_FILENO; fd <= STDERR_FILENO; ++fd) {
+			errno = 0;
+			if(dup2(main_pipe_read_fd, fd) != fd) {
+				errno_push();
+				close(main_pipe_read_fd);
+				errno_pop();
 
-		// one of the only times we ever use exit(3)
-		exit(EXIT_FAILURE);
+				usockit_server_child_report_error(reporting_pipe_write_fd, USOCKIT_CHILD_ERROR_FUNC_DUP2);
+			}
+		}
 	}
 
 	// no need for this file descriptor anymore, we have stdin now
@@ -1028,8 +7971,13 @@ static inline void usockit_server_child(
 	errno = 0;
 	execvp(child_program_argv[0], child_program_argv);
 
+	usockit_server_child_report_error(reporting_pipe_write_fd, USOCKIT_CHILD_ERROR_FUNC_EXECVE);
+}
+
+static inline void usockit_server_child_report_error(const int reporting_pipe_write_fd,
+                                                     const enum usockit_server_child_error_func func) {
 	struct usockit_server_child_error error = {
-		.func = USOCKIT_CHILD_ERROR_FUNC_EXECVE,
+		.func = func,
 		.func_errno = errno,
 	};
 	write(reporting_pipe_write_fd, &error, sizeof error);
@@ -1040,6 +7988,82 @@ static inline void usockit_server_child(
 	exit(EXIT_FAILURE);
 }
 
+static inline ret_status_t usockit_server_open_pty(int pty_fds[2]) {
+	assert(pty_fds != cross_support_nullptr);
+
+	#if USOCKIT_SERVER_PTY_SUPPORT
+		errno = 0;
+		const int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+		if(master_fd == -1) {
+			return RET_STATUS_FAILURE;
+		}
+
+		char slave_pathname[64];
+
+		errno = 0;
+		if((grantpt(master_fd) != 0) ||
+		   (unlockpt(master_fd) != 0) ||
+		   ((errno = ptsname_r(master_fd, slave_pathname, sizeof slave_pathname)) != 0)) {
+
+			errno_push();
+			close(master_fd);
+			errno_pop();
+
+			return RET_STATUS_FAILURE;
+		}
+
+		errno = 0;
+		const int slave_fd = open(slave_pathname, (O_RDWR | O_NOCTTY));
+		if(slave_fd == -1) {
+			errno_push();
+			close(master_fd);
+			errno_pop();
+
+			return RET_STATUS_FAILURE;
+		}
+
+		// the input comes from clients, which already see what they send; echoing it back would only end up in the
+		// output. output post-processing is disabled as well, so that the output arrives exactly as the child wrote it
+		// (i.e.: no "\n" -> "\r\n" translation)
+		struct termios attrs;
+
+		errno = 0;
+		int ret = tcgetattr(slave_fd, &attrs);
+		if(ret == 0) {
+			attrs.c_lflag &= ~(tcflag_t)(ECHO | ECHOE | ECHOK | ECHONL);
+			attrs.c_oflag &= ~(tcflag_t)OPOST;
+
+			errno = 0;
+			ret = tcsetattr(slave_fd, TCSANOW, &attrs);
+		}
+		if(ret != 0) {
+			errno_push();
+			close(slave_fd);
+			close(master_fd);
+			errno_pop();
+
+			return RET_STATUS_FAILURE;
+		}
+
+		// the output ends up on our stdout, so if that is a terminal, its size is the one that matters for the child.
+		// purely cosmetic, so failures are ignored
+		struct winsize window_size;
+		if(isatty(STDOUT_FILENO) && (ioctl(STDOUT_FILENO, TIOCGWINSZ, &window_size) == 0)) {
+			(void)ioctl(slave_fd, TIOCSWINSZ, &window_size);
+		}
+
+		pty_fds[PIPE_READ_INDEX]  = slave_fd;
+		pty_fds[PIPE_WRITE_INDEX] = master_fd;
+
+		return RET_STATUS_SUCCESS;
+	#else
+		(void)pty_fds;
+
+		errno = ENOSYS;
+		return RET_STATUS_FAILURE;
+	#endif
+}
+
 static inline enum usockit_server_ret_status usockit_server_check_socket_pathname(const const_cstr_t socket_pathname) {
 	assert(socket_pathname != cross_support_nullptr);
 
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <usockit/cross_support.h>
+#include <usockit/server/output_ring.h>
+#include <usockit/utils.h>
+
+struct usockit_server_output_ring {
+	unsigned char* data;
+	size_t capacity;
+	/**
+	 * Total number of bytes that were ever appended; `end % capacity` is where the next output goes.
+	 */
+	uint64_t end;
+};
+
+
+struct usockit_server_output_ring* usockit_server_output_ring_create(const size_t capacity) {
+	assert(capacity > 0);
+
+	errno = 0;
+	struct usockit_server_output_ring* const ring = calloc(1, sizeof *ring);
+	cross_support_if_unlikely(ring == cross_support_nullptr) {
+		return cross_support_nullptr;
+	}
+
+	// not calloc(3); only the part that is actually written to is ever read, so there's no need to touch it all
+	errno = 0;
+	ring->data = malloc(capacity);
+	cross_support_if_unlikely(ring->data == cross_support_nullptr) {
+		errno_push();
+		free(ring);
+		errno_pop();
+
+		return cross_support_nullptr;
+	}
+
+	ring->capacity = capacity;
+	ring->end = 0;
+
+	return ring;
+}
+
+void usockit_server_output_ring_destroy(struct usockit_server_output_ring* const ring) {
+	assert(ring != cross_support_nullptr);
+
+	free(ring->data);
+	free(ring);
+}
+
+void usockit_server_output_ring_append(struct usockit_server_output_ring* const ring,
+                                       const void* const data,
+                                       const size_t size) {
+	assert(ring != cross_support_nullptr);
+	assert((data != cross_support_nullptr) || (size == 0));
+	assert(size <= ring->capacity);
+
+	if(size == 0) {
+		return;
+	}
+
+	const size_t start = (size_t)(ring->end % ring->capacity);
+	const size_t first_size = (((ring->capacity - start) < size) ? (ring->capacity - start) : size);
+
+	memcpy((ring->data + start), data, first_size);
+	memcpy(ring->data, ((const unsigned char*)data + first_size), (size - first_size));
+
+	ring->end += size;
+}
+
+uint64_t usockit_server_output_ring_end(const struct usockit_server_output_ring* const ring) {
+	assert(ring != cross_support_nullptr);
+
+	return ring->end;
+}
+
+int usockit_server_output_ring_peek(const struct usockit_server_output_ring* const ring,
+                                    const uint64_t offset,
+                                    struct iovec iov[const 2]) {
+	assert(ring != cross_support_nullptr);
+	assert(offset <= ring->end);
+	assert(iov != cross_support_nullptr);
+
+	if((ring->end - offset) > ring->capacity) {
+		return -1;
+	}
+
+	const size_t size = (size_t)(ring->end - offset);
+	if(size == 0) {
+		return 0;
+	}
+
+	const size_t start = (size_t)(offset % ring->capacity);
+	const size_t first_size = (((ring->capacity - start) < size) ? (ring->capacity - start) : size);
+
+	iov[0].iov_base = (ring->data + start);
+	iov[0].iov_len = first_size;
+
+	if(first_size == size) {
+		return 1;
+	}
+
+	iov[1].iov_base = ring->data;
+	iov[1].iov_len = (size - first_size);
+
+	return 2;
+}
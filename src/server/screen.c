@@ -0,0 +1,1300 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <usockit/cross_support.h>
+#include <usockit/server/screen.h>
+#include <usockit/support_types.h>
+#include <usockit/utils.h>
+
+enum {
+	USOCKIT_SERVER_SCREEN_CSI_PARAMS_MAX = 16,
+	USOCKIT_SERVER_SCREEN_CSI_PARAM_MAX = 9999,
+	USOCKIT_SERVER_SCREEN_TAB_WIDTH = 8,
+};
+
+#define USOCKIT_SERVER_SCREEN_REPLACEMENT_CHARACTER  UINT32_C(0xFFFD)
+
+// colors are either the default color, an index into the 256 color palette or a 24-bit RGB color
+#define USOCKIT_SERVER_SCREEN_COLOR_DEFAULT       UINT32_C(0)
+#define USOCKIT_SERVER_SCREEN_COLOR_PALETTE_FLAG  (UINT32_C(1) << 24)
+#define USOCKIT_SERVER_SCREEN_COLOR_RGB_FLAG      (UINT32_C(2) << 24)
+#define USOCKIT_SERVER_SCREEN_COLOR_VALUE_MASK    UINT32_C(0xFFFFFF)
+
+enum usockit_server_screen_attr {
+	USOCKIT_SERVER_SCREEN_ATTR_BOLD          = (1 << 0),
+	USOCKIT_SERVER_SCREEN_ATTR_DIM           = (1 << 1),
+	USOCKIT_SERVER_SCREEN_ATTR_ITALIC        = (1 << 2),
+	USOCKIT_SERVER_SCREEN_ATTR_UNDERLINE     = (1 << 3),
+	USOCKIT_SERVER_SCREEN_ATTR_BLINK         = (1 << 4),
+	USOCKIT_SERVER_SCREEN_ATTR_REVERSE       = (1 << 5),
+	USOCKIT_SERVER_SCREEN_ATTR_INVISIBLE     = (1 << 6),
+	USOCKIT_SERVER_SCREEN_ATTR_STRIKETHROUGH = (1 << 7),
+};
+
+/**
+ * SGR parameter of every attribute, in the order of the bits in `enum usockit_server_screen_attr`.
+ */
+static const unsigned char usockit_server_screen_attr_sgr_params[] = { 1, 2, 3, 4, 5, 7, 8, 9 };
+
+struct usockit_server_screen_pen {
+	uint32_t fg;
+	uint32_t bg;
+	/**
+	 * Bitwise OR of `enum usockit_server_screen_attr` values.
+	 */
+	unsigned char attrs;
+};
+
+struct usockit_server_screen_cell {
+	/**
+	 * 0 if nothing was drawn in the cell (or it was erased), which is rendered as a space.
+	 */
+	uint32_t codepoint;
+	struct usockit_server_screen_pen pen;
+};
+
+struct usockit_server_screen_cursor {
+	unsigned short row;
+	unsigned short col;
+	/**
+	 * Set after a character was drawn in the last column; the next character then wraps onto the next line.
+	 */
+	bool wrap_pending;
+	struct usockit_server_screen_pen pen;
+};
+
+enum usockit_server_screen_parser_state {
+	USOCKIT_SERVER_SCREEN_PARSER_STATE_GROUND,
+	USOCKIT_SERVER_SCREEN_PARSER_STATE_ESCAPE,
+	USOCKIT_SERVER_SCREEN_PARSER_STATE_ESCAPE_INTERMEDIATE,
+	USOCKIT_SERVER_SCREEN_PARSER_STATE_CSI,
+	/**
+	 * OSC, DCS, SOS, PM & APC strings; none of them change the screen, so they are skipped until the terminator.
+	 */
+	USOCKIT_SERVER_SCREEN_PARSER_STATE_STRING,
+	USOCKIT_SERVER_SCREEN_PARSER_STATE_STRING_ESCAPE,
+};
+
+struct usockit_server_screen {
+	unsigned short rows;
+	unsigned short cols;
+
+	/**
+	 * The cells of the main and the alternate screen, `rows * cols` each, row by row.
+	 */
+	struct usockit_server_screen_cell* grids[2];
+	bool alternate_active;
+
+	struct usockit_server_screen_cursor cursor;
+	/**
+	 * Saved by DECSC (ESC 7) and restored by DECRC (ESC 8).
+	 */
+	struct usockit_server_screen_cursor saved_cursor;
+	/**
+	 * Saved when switching to the alternate screen with mode 1049 and restored when switching back.
+	 */
+	struct usockit_server_screen_cursor alternate_saved_cursor;
+
+	/**
+	 * Inclusive bounds of the scrolling region.
+	 */
+	unsigned short scroll_top;
+	unsigned short scroll_bottom;
+
+	bool autowrap;
+	bool cursor_visible;
+	bool application_cursor_keys;
+	bool application_keypad;
+	bool bracketed_paste;
+
+	enum usockit_server_screen_parser_state parser_state;
+	unsigned int csi_params[USOCKIT_SERVER_SCREEN_CSI_PARAMS_MAX];
+	size_t csi_params_count;
+	/**
+	 * One of '<', '=', '>' or '?' if the CSI sequence started with it, otherwise '\0'.
+	 */
+	char csi_private_marker;
+	bool csi_intermediate;
+
+	uint32_t utf8_codepoint;
+	/**
+	 * Number of continuation bytes that the UTF-8 sequence in progress still needs.
+	 */
+	unsigned int utf8_remaining;
+};
+
+struct usockit_server_screen_render_buffer {
+	unsigned char* data;
+	size_t size;
+	size_t capacity;
+	bool failed;
+};
+
+
+static inline struct usockit_server_screen_cell* usockit_server_screen_cell_at(struct usockit_server_screen* screen,
+                                                                               unsigned short row,
+                                                                               unsigned short col)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_erase(struct usockit_server_screen* screen,
+                                               unsigned short row,
+                                               unsigned short from_col,
+                                               unsigned short to_col)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_scroll_up(struct usockit_server_screen* screen,
+                                                   unsigned short top,
+                                                   unsigned short bottom,
+                                                   unsigned int count)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_scroll_down(struct usockit_server_screen* screen,
+                                                     unsigned short top,
+                                                     unsigned short bottom,
+                                                     unsigned int count)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_reset(struct usockit_server_screen* screen)
+	cross_support_attr_nonnull_all;
+
+static void usockit_server_screen_feed_byte(struct usockit_server_screen* screen, unsigned char byte)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_put(struct usockit_server_screen* screen, uint32_t codepoint)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_execute_control(struct usockit_server_screen* screen, unsigned char byte)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_index(struct usockit_server_screen* screen)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_reverse_index(struct usockit_server_screen* screen)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_dispatch_escape(struct usockit_server_screen* screen, unsigned char final)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_dispatch_csi(struct usockit_server_screen* screen, unsigned char final)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_set_private_mode(struct usockit_server_screen* screen,
+                                                          unsigned int mode,
+                                                          bool enabled)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_set_alternate(struct usockit_server_screen* screen, bool active, bool clear)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_select_graphic_rendition(struct usockit_server_screen* screen)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_render_append(struct usockit_server_screen_render_buffer* buffer,
+                                                       const void* data,
+                                                       size_t size)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_render_append_str(struct usockit_server_screen_render_buffer* buffer,
+                                                           const_cstr_t str)
+	cross_support_attr_always_inline
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_render_append_uint(struct usockit_server_screen_render_buffer* buffer,
+                                                            unsigned int n)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_render_append_codepoint(struct usockit_server_screen_render_buffer* buffer,
+                                                                 uint32_t codepoint)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_render_append_pen(struct usockit_server_screen_render_buffer* buffer,
+                                                           struct usockit_server_screen_pen pen)
+	cross_support_attr_nonnull_all;
+
+static inline void usockit_server_screen_render_append_color(struct usockit_server_screen_render_buffer* buffer,
+                                                             uint32_t color,
+                                                             unsigned int base_sgr_param)
+	cross_support_attr_nonnull_all;
+
+
+struct usockit_server_screen* usockit_server_screen_create(const unsigned short rows, const unsigned short cols) {
+	assert((rows > 0) && (cols > 0));
+
+	errno = 0;
+	struct usockit_server_screen* const screen = calloc(1, sizeof *screen);
+	cross_support_if_unlikely(screen == cross_support_nullptr) {
+		return cross_support_nullptr;
+	}
+
+	for(size_t i = 0; i < array_size(screen->grids); ++i) {
+		errno = 0;
+		screen->grids[i] = calloc(((size_t)rows * (size_t)cols), sizeof *(screen->grids[i]));
+		cross_support_if_unlikely(screen->grids[i] == cross_support_nullptr) {
+			errno_push();
+			free(screen->grids[0]);
+			free(screen);
+			errno_pop();
+
+			return cross_support_nullptr;
+		}
+	}
+
+	screen->rows = rows;
+	screen->cols = cols;
+
+	usockit_server_screen_reset(screen);
+
+	return screen;
+}
+
+void usockit_server_screen_destroy(struct usockit_server_screen* const screen) {
+	assert(screen != cross_support_nullptr);
+
+	free(screen->grids[1]);
+	free(screen->grids[0]);
+	free(screen);
+}
+
+ret_status_t usockit_server_screen_resize(struct usockit_server_screen* const screen,
+                                          const unsigned short rows,
+                                          const unsigned short cols) {
+	assert(screen != cross_support_nullptr);
+	assert((rows > 0) && (cols > 0));
+
+	if((rows == screen->rows) && (cols == screen->cols)) {
+		return RET_STATUS_SUCCESS;
+	}
+
+	struct usockit_server_screen_cell* new_grids[2];
+
+	for(size_t i = 0; i < array_size(new_grids); ++i) {
+		errno = 0;
+		new_grids[i] = calloc(((size_t)rows * (size_t)cols), sizeof *(new_grids[i]));
+		cross_support_if_unlikely(new_grids[i] == cross_support_nullptr) {
+			errno_push();
+			free(new_grids[0]);
+			errno_pop();
+
+			return RET_STATUS_FAILURE;
+		}
+	}
+
+	const unsigned short kept_rows = ((rows < screen->rows) ? rows : screen->rows);
+	const unsigned short kept_cols = ((cols < screen->cols) ? cols : screen->cols);
+
+	for(size_t i = 0; i < array_size(new_grids); ++i) {
+		for(unsigned short row = 0; row < kept_rows; ++row) {
+			memcpy(
+				(new_grids[i] + ((size_t)row * cols)),
+				(screen->grids[i] + ((size_t)row * screen->cols)),
+				(kept_cols * sizeof *(new_grids[i]))
+			);
+		}
+
+		free(screen->grids[i]);
+		screen->grids[i] = new_grids[i];
+	}
+
+	screen->rows = rows;
+	screen->cols = cols;
+
+	struct usockit_server_screen_cursor* const cursors[] = {
+		&(screen->cursor),
+		&(screen->saved_cursor),
+		&(screen->alternate_saved_cursor),
+	};
+	for(size_t i = 0; i < array_size(cursors); ++i) {
+		if(cursors[i]->row >= rows) {
+			cursors[i]->row = (unsigned short)(rows - 1);
+		}
+		if(cursors[i]->col >= cols) {
+			cursors[i]->col = (unsigned short)(cols - 1);
+		}
+		cursors[i]->wrap_pending = false;
+	}
+
+	screen->scroll_top = 0;
+	screen->scroll_bottom = (unsigned short)(rows - 1);
+
+	return RET_STATUS_SUCCESS;
+}
+
+void usockit_server_screen_feed(struct usockit_server_screen* const screen,
+                                const void* const data,
+                                const size_t size) {
+	assert(screen != cross_support_nullptr);
+	assert((data != cross_support_nullptr) || (size == 0));
+
+	for(size_t i = 0; i < size; ++i) {
+		usockit_server_screen_feed_byte(screen, ((const unsigned char*)data)[i]);
+	}
+}
+
+ret_status_t usockit_server_screen_render(const struct usockit_server_screen* const screen,
+                                          unsigned char** const data_ptr,
+                                          size_t* const size_ptr) {
+	assert(screen != cross_support_nullptr);
+	assert(data_ptr != cross_support_nullptr);
+	assert(size_ptr != cross_support_nullptr);
+
+	struct usockit_server_screen_render_buffer buffer;
+	zeroset_lvalue(buffer);
+
+	usockit_server_screen_render_append_str(&buffer, "\x1B[0m");
+	if(screen->alternate_active) {
+		// the terminal of the client keeps its own main screen; just like it would when the child program had been
+		// running in it
+		usockit_server_screen_render_append_str(&buffer, "\x1B[?1049h");
+	}
+	usockit_server_screen_render_append_str(&buffer, "\x1B[H\x1B[2J");
+
+	const struct usockit_server_screen_cell* const grid = screen->grids[screen->alternate_active ? 1 : 0];
+
+	struct usockit_server_screen_pen current_pen;
+	zeroset_lvalue(current_pen);
+
+	for(unsigned short row = 0; row < screen->rows; ++row) {
+		const struct usockit_server_screen_cell* const row_cells = (grid + ((size_t)row * screen->cols));
+
+		// trailing blank cells are already taken care of by clearing the screen
+		unsigned short end_col = screen->cols;
+		while(end_col > 0) {
+			const struct usockit_server_screen_cell* const cell = (row_cells + end_col - 1);
+
+			if(((cell->codepoint != 0) && (cell->codepoint != ' ')) ||
+			   (cell->pen.bg != USOCKIT_SERVER_SCREEN_COLOR_DEFAULT) ||
+			   (cell->pen.attrs != 0)) {
+
+				break;
+			}
+
+			--end_col;
+		}
+
+		if(end_col == 0) {
+			continue;
+		}
+
+		usockit_server_screen_render_append_str(&buffer, "\x1B[");
+		usockit_server_screen_render_append_uint(&buffer, (unsigned int)row + 1);
+		usockit_server_screen_render_append_str(&buffer, "H");
+
+		for(unsigned short col = 0; col < end_col; ++col) {
+			const struct usockit_server_screen_cell* const cell = (row_cells + col);
+
+			if((cell->pen.fg != current_pen.fg) ||
+			   (cell->pen.bg != current_pen.bg) ||
+			   (cell->pen.attrs != current_pen.attrs)) {
+
+				usockit_server_screen_render_append_pen(&buffer, cell->pen);
+				current_pen = cell->pen;
+			}
+
+			usockit_server_screen_render_append_codepoint(&buffer, ((cell->codepoint != 0) ? cell->codepoint : ' '));
+		}
+	}
+
+	if((screen->scroll_top != 0) || (screen->scroll_bottom != (screen->rows - 1))) {
+		usockit_server_screen_render_append_str(&buffer, "\x1B[");
+		usockit_server_screen_render_append_uint(&buffer, (unsigned int)(screen->scroll_top) + 1);
+		usockit_server_screen_render_append_str(&buffer, ";");
+		usockit_server_screen_render_append_uint(&buffer, (unsigned int)(screen->scroll_bottom) + 1);
+		usockit_server_screen_render_append_str(&buffer, "r");
+	}
+
+	if(!(screen->autowrap)) {
+		usockit_server_screen_render_append_str(&buffer, "\x1B[?7l");
+	}
+	if(screen->application_cursor_keys) {
+		usockit_server_screen_render_append_str(&buffer, "\x1B[?1h");
+	}
+	if(screen->bracketed_paste) {
+		usockit_server_screen_render_append_str(&buffer, "\x1B[?2004h");
+	}
+	if(screen->application_keypad) {
+		usockit_server_screen_render_append_str(&buffer, "\x1B=");
+	}
+
+	usockit_server_screen_render_append_pen(&buffer, screen->cursor.pen);
+
+	usockit_server_screen_render_append_str(&buffer, "\x1B[");
+	usockit_server_screen_render_append_uint(&buffer, (unsigned int)(screen->cursor.row) + 1);
+	usockit_server_screen_render_append_str(&buffer, ";");
+	usockit_server_screen_render_append_uint(&buffer, (unsigned int)(screen->cursor.col) + 1);
+	usockit_server_screen_render_append_str(&buffer, "H");
+
+	usockit_server_screen_render_append_str(&buffer, (screen->cursor_visible ? "\x1B[?25h" : "\x1B[?25l"));
+
+	cross_support_if_unlikely(buffer.failed) {
+		errno_push();
+		free(buffer.data);
+		errno_pop();
+
+		return RET_STATUS_FAILURE;
+	}
+
+	*data_ptr = buffer.data;
+	*size_ptr = buffer.size;
+
+	return RET_STATUS_SUCCESS;
+}
+
+
+static inline struct usockit_server_screen_cell* usockit_server_screen_cell_at(
+	struct usockit_server_screen* const screen,
+	const unsigned short row,
+	const unsigned short col
+) {
+	assert((row < screen->rows) && (col < screen->cols));
+
+	return (screen->grids[screen->alternate_active ? 1 : 0] + ((size_t)row * screen->cols) + col);
+}
+
+/**
+ * Erases the cells from `from_col` up to, but not including, `to_col` in `row`.
+ * Erased cells keep the background color of the cursor, like they do in most terminals.
+ */
+static inline void usockit_server_screen_erase(struct usockit_server_screen* const screen,
+                                               const unsigned short row,
+                                               const unsigned short from_col,
+                                               const unsigned short to_col) {
+	struct usockit_server_screen_cell blank;
+	zeroset_lvalue(blank);
+	blank.pen.bg = screen->cursor.pen.bg;
+
+	for(unsigned short col = from_col; col < to_col; ++col) {
+		*usockit_server_screen_cell_at(screen, row, col) = blank;
+	}
+}
+
+/**
+ * Moves the rows from `top` to `bottom` (inclusive) up by `count` rows and erases the rows that were uncovered.
+ */
+static inline void usockit_server_screen_scroll_up(struct usockit_server_screen* const screen,
+                                                   const unsigned short top,
+                                                   const unsigned short bottom,
+                                                   unsigned int count) {
+	const unsigned int region_rows = ((unsigned int)(bottom - top) + 1);
+	if(count > region_rows) {
+		count = region_rows;
+	}
+
+	if(count < region_rows) {
+		memmove(
+			usockit_server_screen_cell_at(screen, top, 0),
+			usockit_server_screen_cell_at(screen, (unsigned short)(top + count), 0),
+			((size_t)(region_rows - count) * screen->cols * sizeof (struct usockit_server_screen_cell))
+		);
+	}
+
+	for(unsigned int row = ((bottom + 1U) - count); row <= bottom; ++row) {
+		usockit_server_screen_erase(screen, (unsigned short)row, 0, screen->cols);
+	}
+}
+
+/**
+ * Moves the rows from `top` to `bottom` (inclusive) down by `count` rows and erases the rows that were uncovered.
+ */
+static inline void usockit_server_screen_scroll_down(struct usockit_server_screen* const screen,
+                                                     const unsigned short top,
+                                                     const unsigned short bottom,
+                                                     unsigned int count) {
+	const unsigned int region_rows = ((unsigned int)(bottom - top) + 1);
+	if(count > region_rows) {
+		count = region_rows;
+	}
+
+	if(count < region_rows) {
+		memmove(
+			usockit_server_screen_cell_at(screen, (unsigned short)(top + count), 0),
+			usockit_server_screen_cell_at(screen, top, 0),
+			((size_t)(region_rows - count) * screen->cols * sizeof (struct usockit_server_screen_cell))
+		);
+	}
+
+	for(unsigned int row = top; row < (top + count); ++row) {
+		usockit_server_screen_erase(screen, (unsigned short)row, 0, screen->cols);
+	}
+}
+
+static inline void usockit_server_screen_reset(struct usockit_server_screen* const screen) {
+	const size_t cells_count = ((size_t)(screen->rows) * (size_t)(screen->cols));
+	for(size_t i = 0; i < array_size(screen->grids); ++i) {
+		memset(screen->grids[i], 0, (cells_count * sizeof *(screen->grids[i])));
+	}
+
+	screen->alternate_active = false;
+
+	zeroset_lvalue(screen->cursor);
+	zeroset_lvalue(screen->saved_cursor);
+	zeroset_lvalue(screen->alternate_saved_cursor);
+
+	screen->scroll_top = 0;
+	screen->scroll_bottom = (unsigned short)(screen->rows - 1);
+
+	screen->autowrap = true;
+	screen->cursor_visible = true;
+	screen->application_cursor_keys = false;
+	screen->application_keypad = false;
+	screen->bracketed_paste = false;
+
+	screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_GROUND;
+	screen->utf8_remaining = 0;
+}
+
+static void usockit_server_screen_feed_byte(struct usockit_server_screen* const screen, const unsigned char byte) {
+	switch(screen->parser_state) {
+		case USOCKIT_SERVER_SCREEN_PARSER_STATE_STRING: {
+			if(byte == 0x07) {
+				screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_GROUND;
+			} else if(byte == 0x1B) {
+				screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_STRING_ESCAPE;
+			}
+			return;
+		}
+		case USOCKIT_SERVER_SCREEN_PARSER_STATE_STRING_ESCAPE: {
+			// ST (ESC \) terminates the string. any other escape sequence does as well, and then starts right away
+			screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_GROUND;
+			if(byte != '\\') {
+				screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_ESCAPE;
+				usockit_server_screen_feed_byte(screen, byte);
+			}
+			return;
+		}
+		default: {
+			break;
+		}
+	}
+
+	if(screen->utf8_remaining > 0) {
+		if((byte & 0xC0) == 0x80) {
+			screen->utf8_codepoint = ((screen->utf8_codepoint << 6) | (byte & 0x3F));
+			--(screen->utf8_remaining);
+
+			if(screen->utf8_remaining == 0) {
+				usockit_server_screen_put(screen, screen->utf8_codepoint);
+			}
+			return;
+		}
+
+		// the sequence was cut short; the byte that cut it short is handled as usual
+		screen->utf8_remaining = 0;
+		usockit_server_screen_put(screen, USOCKIT_SERVER_SCREEN_REPLACEMENT_CHARACTER);
+	}
+
+	if(byte == 0x1B) {
+		screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_ESCAPE;
+		return;
+	}
+
+	if((byte == 0x18) || (byte == 0x1A)) { // CAN & SUB cancel the sequence in progress
+		screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_GROUND;
+		return;
+	}
+
+	if((byte < 0x20) || (byte == 0x7F)) {
+		// control characters are executed even in the middle of an escape sequence
+		usockit_server_screen_execute_control(screen, byte);
+		return;
+	}
+
+	switch(screen->parser_state) {
+		case USOCKIT_SERVER_SCREEN_PARSER_STATE_GROUND: {
+			if(byte < 0x80) {
+				usockit_server_screen_put(screen, byte);
+			} else if((byte & 0xE0) == 0xC0) {
+				screen->utf8_codepoint = (byte & 0x1F);
+				screen->utf8_remaining = 1;
+			} else if((byte & 0xF0) == 0xE0) {
+				screen->utf8_codepoint = (byte & 0x0F);
+				screen->utf8_remaining = 2;
+			} else if((byte & 0xF8) == 0xF0) {
+				screen->utf8_codepoint = (byte & 0x07);
+				screen->utf8_remaining = 3;
+			} else {
+				usockit_server_screen_put(screen, USOCKIT_SERVER_SCREEN_REPLACEMENT_CHARACTER);
+			}
+			break;
+		}
+		case USOCKIT_SERVER_SCREEN_PARSER_STATE_ESCAPE: {
+			if(byte == '[') {
+				screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_CSI;
+				screen->csi_params_count = 0;
+				screen->csi_private_marker = '\0';
+				screen->csi_intermediate = false;
+			} else if((byte == ']') || (byte == 'P') || (byte == 'X') || (byte == '^') || (byte == '_')) {
+				screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_STRING;
+			} else if((byte >= 0x20) && (byte <= 0x2F)) {
+				// e.g.: character set designations; none of them are of interest
+				screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_ESCAPE_INTERMEDIATE;
+			} else {
+				screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_GROUND;
+				usockit_server_screen_dispatch_escape(screen, byte);
+			}
+			break;
+		}
+		case USOCKIT_SERVER_SCREEN_PARSER_STATE_ESCAPE_INTERMEDIATE: {
+			if((byte < 0x20) || (byte > 0x2F)) {
+				screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_GROUND;
+			}
+			break;
+		}
+		case USOCKIT_SERVER_SCREEN_PARSER_STATE_CSI: {
+			if((byte >= '0') && (byte <= '9')) {
+				if(screen->csi_params_count == 0) {
+					screen->csi_params[0] = 0;
+					screen->csi_params_count = 1;
+				}
+
+				unsigned int* const param = &(screen->csi_params[screen->csi_params_count - 1]);
+				*param = ((*param * 10) + (unsigned int)(byte - '0'));
+				if(*param > USOCKIT_SERVER_SCREEN_CSI_PARAM_MAX) {
+					*param = USOCKIT_SERVER_SCREEN_CSI_PARAM_MAX;
+				}
+			} else if((byte == ';') || (byte == ':')) {
+				// sub-parameters are treated just like parameters
+				if(screen->csi_params_count == 0) {
+					screen->csi_params[0] = 0;
+					screen->csi_params_count = 1;
+				}
+
+				if(screen->csi_params_count < USOCKIT_SERVER_SCREEN_CSI_PARAMS_MAX) {
+					screen->csi_params[screen->csi_params_count] = 0;
+					++(screen->csi_params_count);
+				}
+			} else if((byte >= '<') && (byte <= '?')) {
+				screen->csi_private_marker = (char)byte;
+			} else if((byte >= 0x20) && (byte <= 0x2F)) {
+				screen->csi_intermediate = true;
+			} else if((byte >= 0x40) && (byte <= 0x7E)) {
+				screen->parser_state = USOCKIT_SERVER_SCREEN_PARSER_STATE_GROUND;
+				usockit_server_screen_dispatch_csi(screen, byte);
+			}
+			break;
+		}
+		default: {
+			cross_support_unreachable();
+		}
+	}
+}
+
+static inline void usockit_server_screen_put(struct usockit_server_screen* const screen, const uint32_t codepoint) {
+	if((codepoint >= 0x80) && (codepoint < 0xA0)) {
+		// C1 control characters; not used in practice
+		return;
+	}
+
+	struct usockit_server_screen_cursor* const cursor = &(screen->cursor);
+
+	if(cursor->wrap_pending) {
+		cursor->col = 0;
+		cursor->wrap_pending = false;
+		usockit_server_screen_index(screen);
+	}
+
+	struct usockit_server_screen_cell* const cell = usockit_server_screen_cell_at(screen, cursor->row, cursor->col);
+	cell->codepoint = codepoint;
+	cell->pen = cursor->pen;
+
+	if((cursor->col + 1) < screen->cols) {
+		++(cursor->col);
+	} else if(screen->autowrap) {
+		cursor->wrap_pending = true;
+	}
+}
+
+static inline void usockit_server_screen_execute_control(struct usockit_server_screen* const screen,
+                                                         const unsigned char byte) {
+	struct usockit_server_screen_cursor* const cursor = &(screen->cursor);
+
+	switch(byte) {
+		case '\b': {
+			if(cursor->col > 0) {
+				--(cursor->col);
+			}
+			cursor->wrap_pending = false;
+			break;
+		}
+		case '\t': {
+			unsigned int col = ((((unsigned int)(cursor->col) / USOCKIT_SERVER_SCREEN_TAB_WIDTH) + 1) *
+			                    USOCKIT_SERVER_SCREEN_TAB_WIDTH);
+			if(col >= screen->cols) {
+				col = (screen->cols - 1U);
+			}
+			cursor->col = (unsigned short)col;
+			break;
+		}
+		case '\n':
+		case '\v':
+		case '\f': {
+			// output post-processing is disabled in the pty, but the terminals that the output ends up on translate
+			// line feeds into carriage return + line feed (ONLCR), so this is what the output looks like there
+			cursor->col = 0;
+			cursor->wrap_pending = false;
+			usockit_server_screen_index(screen);
+			break;
+		}
+		case '\r': {
+			cursor->col = 0;
+			cursor->wrap_pending = false;
+			break;
+		}
+		default: {
+			// BEL and the like don't change the screen
+			break;
+		}
+	}
+}
+
+static inline void usockit_server_screen_index(struct usockit_server_screen* const screen) {
+	struct usockit_server_screen_cursor* const cursor = &(screen->cursor);
+
+	if(cursor->row == screen->scroll_bottom) {
+		usockit_server_screen_scroll_up(screen, screen->scroll_top, screen->scroll_bottom, 1);
+	} else if((cursor->row + 1) < screen->rows) {
+		++(cursor->row);
+	}
+}
+
+static inline void usockit_server_screen_reverse_index(struct usockit_server_screen* const screen) {
+	struct usockit_server_screen_cursor* const cursor = &(screen->cursor);
+
+	if(cursor->row == screen->scroll_top) {
+		usockit_server_screen_scroll_down(screen, screen->scroll_top, screen->scroll_bottom, 1);
+	} else if(cursor->row > 0) {
+		--(cursor->row);
+	}
+}
+
+static inline void usockit_server_screen_dispatch_escape(struct usockit_server_screen* const screen,
+                                                         const unsigned char final) {
+	struct usockit_server_screen_cursor* const cursor = &(screen->cursor);
+
+	switch(final) {
+		case '7': { // DECSC
+			screen->saved_cursor = *cursor;
+			break;
+		}
+		case '8': { // DECRC
+			*cursor = screen->saved_cursor;
+			break;
+		}
+		case 'D': { // IND
+			cursor->wrap_pending = false;
+			usockit_server_screen_index(screen);
+			break;
+		}
+		case 'E': { // NEL
+			cursor->col = 0;
+			cursor->wrap_pending = false;
+			usockit_server_screen_index(screen);
+			break;
+		}
+		case 'M': { // RI
+			cursor->wrap_pending = false;
+			usockit_server_screen_reverse_index(screen);
+			break;
+		}
+		case 'c': { // RIS
+			usockit_server_screen_reset(screen);
+			break;
+		}
+		case '=': { // DECKPAM
+			screen->application_keypad = true;
+			break;
+		}
+		case '>': { // DECKPNM
+			screen->application_keypad = false;
+			break;
+		}
+		default: {
+			break;
+		}
+	}
+}
+
+static inline void usockit_server_screen_dispatch_csi(struct usockit_server_screen* const screen,
+                                                      const unsigned char final) {
+	if(screen->csi_intermediate) {
+		// e.g.: DECSCUSR (cursor style); nothing that changes the screen
+		return;
+	}
+
+	if(screen->csi_private_marker == '?') {
+		if((final == 'h') || (final == 'l')) {
+			for(size_t i = 0; i < screen->csi_params_count; ++i) {
+				usockit_server_screen_set_private_mode(screen, screen->csi_params[i], (final == 'h'));
+			}
+		}
+		return;
+	}
+
+	if(screen->csi_private_marker != '\0') {
+		return;
+	}
+
+	#define USOCKIT_SERVER_SCREEN_CSI_PARAM(index, default_value) \
+		((((index) < screen->csi_params_count) && (screen->csi_params[(index)] != 0)) \
+		 ? screen->csi_params[(index)] \
+		 : (unsigned int)(default_value))
+
+	struct usockit_server_screen_cursor* const cursor = &(screen->cursor);
+	const unsigned int n = USOCKIT_SERVER_SCREEN_CSI_PARAM(0, 1);
+
+	const unsigned int last_row = (screen->rows - 1U);
+	const unsigned int last_col = (screen->cols - 1U);
+
+	// the cursor stops at the bounds of the scrolling region if it starts out within it
+	const unsigned int upper_bound = ((cursor->row >= screen->scroll_top) ? screen->scroll_top : 0U);
+	const unsigned int lower_bound = ((cursor->row <= screen->scroll_bottom) ? screen->scroll_bottom : last_row);
+
+	if(final != 'm') {
+		cursor->wrap_pending = false;
+	}
+
+	switch(final) {
+		case 'A':   // CUU
+		case 'F': { // CPL
+			cursor->row = (unsigned short)((cursor->row >= (upper_bound + n)) ? (cursor->row - n) : upper_bound);
+			if(final == 'F') {
+				cursor->col = 0;
+			}
+			break;
+		}
+		case 'B':   // CUD
+		case 'e':   // VPR
+		case 'E': { // CNL
+			cursor->row = (unsigned short)(((cursor->row + n) <= lower_bound) ? (cursor->row + n) : lower_bound);
+			if(final == 'E') {
+				cursor->col = 0;
+			}
+			break;
+		}
+		case 'C':   // CUF
+		case 'a': { // HPR
+			cursor->col = (unsigned short)(((cursor->col + n) <= last_col) ? (cursor->col + n) : last_col);
+			break;
+		}
+		case 'D': { // CUB
+			cursor->col = (unsigned short)((cursor->col >= n) ? (cursor->col - n) : 0U);
+			break;
+		}
+		case 'G':   // CHA
+		case '`': { // HPA
+			cursor->col = (unsigned short)((n <= last_col) ? (n - 1) : last_col);
+			break;
+		}
+		case 'd': { // VPA
+			cursor->row = (unsigned short)((n <= last_row) ? (n - 1) : last_row);
+			break;
+		}
+		case 'H':   // CUP
+		case 'f': { // HVP
+			const unsigned int col = USOCKIT_SERVER_SCREEN_CSI_PARAM(1, 1);
+			cursor->row = (unsigned short)((n <= last_row) ? (n - 1) : last_row);
+			cursor->col = (unsigned short)((col <= last_col) ? (col - 1) : last_col);
+			break;
+		}
+		case 'J': { // ED
+			switch(USOCKIT_SERVER_SCREEN_CSI_PARAM(0, 0)) {
+				case 0: {
+					usockit_server_screen_erase(screen, cursor->row, cursor->col, screen->cols);
+					for(unsigned int row = (cursor->row + 1U); row <= last_row; ++row) {
+						usockit_server_screen_erase(screen, (unsigned short)row, 0, screen->cols);
+					}
+					break;
+				}
+				case 1: {
+					for(unsigned int row = 0; row < cursor->row; ++row) {
+						usockit_server_screen_erase(screen, (unsigned short)row, 0, screen->cols);
+					}
+					usockit_server_screen_erase(screen, cursor->row, 0, (unsigned short)(cursor->col + 1));
+					break;
+				}
+				case 2:
+				case 3: {
+					for(unsigned int row = 0; row <= last_row; ++row) {
+						usockit_server_screen_erase(screen, (unsigned short)row, 0, screen->cols);
+					}
+					break;
+				}
+				default: {
+					break;
+				}
+			}
+			break;
+		}
+		case 'K': { // EL
+			switch(USOCKIT_SERVER_SCREEN_CSI_PARAM(0, 0)) {
+				case 0: {
+					usockit_server_screen_erase(screen, cursor->row, cursor->col, screen->cols);
+					break;
+				}
+				case 1: {
+					usockit_server_screen_erase(screen, cursor->row, 0, (unsigned short)(cursor->col + 1));
+					break;
+				}
+				case 2: {
+					usockit_server_screen_erase(screen, cursor->row, 0, screen->cols);
+					break;
+				}
+				default: {
+					break;
+				}
+			}
+			break;
+		}
+		case 'L': { // IL
+			if((cursor->row >= screen->scroll_top) && (cursor->row <= screen->scroll_bottom)) {
+				usockit_server_screen_scroll_down(screen, cursor->row, screen->scroll_bottom, n);
+				cursor->col = 0;
+			}
+			break;
+		}
+		case 'M': { // DL
+			if((cursor->row >= screen->scroll_top) && (cursor->row <= screen->scroll_bottom)) {
+				usockit_server_screen_scroll_up(screen, cursor->row, screen->scroll_bottom, n);
+				cursor->col = 0;
+			}
+			break;
+		}
+		case '@':   // ICH
+		case 'P': { // DCH
+			const unsigned int remaining = (screen->cols - (unsigned int)(cursor->col));
+			const unsigned int count = ((n < remaining) ? n : remaining);
+
+			struct usockit_server_screen_cell* const cell =
+				usockit_server_screen_cell_at(screen, cursor->row, cursor->col);
+
+			if(final == '@') {
+				memmove((cell + count), cell, ((remaining - count) * sizeof *cell));
+				usockit_server_screen_erase(screen, cursor->row, cursor->col, (unsigned short)(cursor->col + count));
+			} else {
+				memmove(cell, (cell + count), ((remaining - count) * sizeof *cell));
+				usockit_server_screen_erase(screen, cursor->row, (unsigned short)(screen->cols - count), screen->cols);
+			}
+			break;
+		}
+		case 'X': { // ECH
+			const unsigned int end_col = (((cursor->col + n) <= screen->cols) ? (cursor->col + n) : screen->cols);
+			usockit_server_screen_erase(screen, cursor->row, cursor->col, (unsigned short)end_col);
+			break;
+		}
+		case 'S': { // SU
+			usockit_server_screen_scroll_up(screen, screen->scroll_top, screen->scroll_bottom, n);
+			break;
+		}
+		case 'T': { // SD (with more than one parameter, it's the mouse tracking sequence of xterm instead)
+			if(screen->csi_params_count <= 1) {
+				usockit_server_screen_scroll_down(screen, screen->scroll_top, screen->scroll_bottom, n);
+			}
+			break;
+		}
+		case 'r': { // DECSTBM
+			const unsigned int top = USOCKIT_SERVER_SCREEN_CSI_PARAM(0, 1);
+			const unsigned int bottom = USOCKIT_SERVER_SCREEN_CSI_PARAM(1, screen->rows);
+
+			if((top < bottom) && (bottom <= screen->rows)) {
+				screen->scroll_top = (unsigned short)(top - 1);
+				screen->scroll_bottom = (unsigned short)(bottom - 1);
+				cursor->row = 0;
+				cursor->col = 0;
+			}
+			break;
+		}
+		case 's': { // SCOSC
+			screen->saved_cursor = *cursor;
+			break;
+		}
+		case 'u': { // SCORC
+			*cursor = screen->saved_cursor;
+			break;
+		}
+		case 'm': { // SGR
+			usockit_server_screen_select_graphic_rendition(screen);
+			break;
+		}
+		default: {
+			break;
+		}
+	}
+
+	#undef USOCKIT_SERVER_SCREEN_CSI_PARAM
+}
+
+static inline void usockit_server_screen_set_private_mode(struct usockit_server_screen* const screen,
+                                                          const unsigned int mode,
+                                                          const bool enabled) {
+	switch(mode) {
+		case 1: { // DECCKM
+			screen->application_cursor_keys = enabled;
+			break;
+		}
+		case 7: { // DECAWM
+			screen->autowrap = enabled;
+			if(!enabled) {
+				screen->cursor.wrap_pending = false;
+			}
+			break;
+		}
+		case 25: { // DECTCEM
+			screen->cursor_visible = enabled;
+			break;
+		}
+		case 47:
+		case 1047: {
+			usockit_server_screen_set_alternate(screen, enabled, false);
+			break;
+		}
+		case 1048: {
+			if(enabled) {
+				screen->saved_cursor = screen->cursor;
+			} else {
+				screen->cursor = screen->saved_cursor;
+			}
+			break;
+		}
+		case 1049: {
+			if(enabled) {
+				if(!(screen->alternate_active)) {
+					screen->alternate_saved_cursor = screen->cursor;
+				}
+				usockit_server_screen_set_alternate(screen, true, true);
+			} else if(screen->alternate_active) {
+				usockit_server_screen_set_alternate(screen, false, false);
+				screen->cursor = screen->alternate_saved_cursor;
+			}
+			break;
+		}
+		case 2004: {
+			screen->bracketed_paste = enabled;
+			break;
+		}
+		default: {
+			break;
+		}
+	}
+}
+
+static inline void usockit_server_screen_set_alternate(struct usockit_server_screen* const screen,
+                                                       const bool active,
+                                                       const bool clear) {
+	screen->alternate_active = active;
+
+	if(active && clear) {
+		for(unsigned short row = 0; row < screen->rows; ++row) {
+			usockit_server_screen_erase(screen, row, 0, screen->cols);
+		}
+	}
+}
+
+static inline void usockit_server_screen_select_graphic_rendition(struct usockit_server_screen* const screen) {
+	struct usockit_server_screen_pen* const pen = &(screen->cursor.pen);
+
+	if(screen->csi_params_count == 0) {
+		zeroset_lvalue(*pen);
+		return;
+	}
+
+	for(size_t i = 0; i < screen->csi_params_count; ++i) {
+		const unsigned int param = screen->csi_params[i];
+
+		if((param == 38) || (param == 48)) {
+			uint32_t color = USOCKIT_SERVER_SCREEN_COLOR_DEFAULT;
+
+			if(((i + 2) < screen->csi_params_count) && (screen->csi_params[i + 1] == 5)) {
+				color = (USOCKIT_SERVER_SCREEN_COLOR_PALETTE_FLAG | (screen->csi_params[i + 2] & 0xFF));
+				i += 2;
+			} else if(((i + 4) < screen->csi_params_count) && (screen->csi_params[i + 1] == 2)) {
+				color = (USOCKIT_SERVER_SCREEN_COLOR_RGB_FLAG |
+				         ((uint32_t)(screen->csi_params[i + 2] & 0xFF) << 16) |
+				         ((uint32_t)(screen->csi_params[i + 3] & 0xFF) <<  8) |
+				          (uint32_t)(screen->csi_params[i + 4] & 0xFF));
+				i += 4;
+			} else {
+				// malformed; the rest of the parameters can't be interpreted anymore
+				return;
+			}
+
+			*((param == 38) ? &(pen->fg) : &(pen->bg)) = color;
+			continue;
+		}
+
+		if((param >= 30) && (param <= 37)) {
+			pen->fg = (USOCKIT_SERVER_SCREEN_COLOR_PALETTE_FLAG | (param - 30));
+			continue;
+		}
+		if((param >= 40) && (param <= 47)) {
+			pen->bg = (USOCKIT_SERVER_SCREEN_COLOR_PALETTE_FLAG | (param - 40));
+			continue;
+		}
+		if((param >= 90) && (param <= 97)) {
+			pen->fg = (USOCKIT_SERVER_SCREEN_COLOR_PALETTE_FLAG | (param - 90 + 8));
+			continue;
+		}
+		if((param >= 100) && (param <= 107)) {
+			pen->bg = (USOCKIT_SERVER_SCREEN_COLOR_PALETTE_FLAG | (param - 100 + 8));
+			continue;
+		}
+
+		if(param == 0) {
+			zeroset_lvalue(*pen);
+			continue;
+		}
+		if(param == 22) { // normal intensity; neither bold nor dim
+			pen->attrs &= (unsigned char)~(USOCKIT_SERVER_SCREEN_ATTR_BOLD | USOCKIT_SERVER_SCREEN_ATTR_DIM);
+			continue;
+		}
+		if(param == 6) { // rapid blink
+			pen->attrs |= USOCKIT_SERVER_SCREEN_ATTR_BLINK;
+			continue;
+		}
+
+		// the parameters that turn attributes off are the ones that turn them on plus 20
+		for(size_t bit = 0; bit < array_size(usockit_server_screen_attr_sgr_params); ++bit) {
+			if(param == usockit_server_screen_attr_sgr_params[bit]) {
+				pen->attrs |= (unsigned char)(1U << bit);
+			} else if(param == (usockit_server_screen_attr_sgr_params[bit] + 20U)) {
+				pen->attrs &= (unsigned char)~(1U << bit);
+			}
+		}
+	}
+}
+
+static inline void usockit_server_screen_render_append(struct usockit_server_screen_render_buffer* const buffer,
+                                                       const void* const data,
+                                                       const size_t size) {
+	if(buffer->failed) {
+		return;
+	}
+
+	if((buffer->size + size) > buffer->capacity) {
+		size_t new_capacity = ((buffer->capacity > 0) ? (buffer->capacity * 2) : 4096);
+		while((buffer->size + size) > new_capacity) {
+			new_capacity *= 2;
+		}
+
+		errno = 0;
+		unsigned char* const new_data = realloc(buffer->data, new_capacity);
+		cross_support_if_unlikely(new_data == cross_support_nullptr) {
+			buffer->failed = true;
+			return;
+		}
+
+		buffer->data = new_data;
+		buffer->capacity = new_capacity;
+	}
+
+	memcpy((buffer->data + buffer->size), data, size);
+	buffer->size += size;
+}
+
+static inline void usockit_server_screen_render_append_str(struct usockit_server_screen_render_buffer* const buffer,
+                                                           const const_cstr_t str) {
+	usockit_server_screen_render_append(buffer, str, strlen(str));
+}
+
+static inline void usockit_server_screen_render_append_uint(struct usockit_server_screen_render_buffer* const buffer,
+                                                            const unsigned int n) {
+	char str[16];
+	const int len = snprintf(str, sizeof str, "%u", n);
+
+	usockit_server_screen_render_append(buffer, str, (size_t)len);
+}
+
+static inline void usockit_server_screen_render_append_codepoint(
+	struct usockit_server_screen_render_buffer* const buffer,
+	const uint32_t codepoint
+) {
+	unsigned char bytes[4];
+	size_t size;
+
+	if(codepoint < 0x80) {
+		bytes[0] = (unsigned char)codepoint;
+		size = 1;
+	} else if(codepoint < 0x800) {
+		bytes[0] = (unsigned char)(0xC0 | (codepoint >> 6));
+		bytes[1] = (unsigned char)(0x80 | (codepoint & 0x3F));
+		size = 2;
+	} else if(codepoint < 0x10000) {
+		bytes[0] = (unsigned char)(0xE0 | (codepoint >> 12));
+		bytes[1] = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+		bytes[2] = (unsigned char)(0x80 | (codepoint & 0x3F));
+		size = 3;
+	} else {
+		bytes[0] = (unsigned char)(0xF0 | ((codepoint >> 18) & 0x07));
+		bytes[1] = (unsigned char)(0x80 | ((codepoint >> 12) & 0x3F));
+		bytes[2] = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+		bytes[3] = (unsigned char)(0x80 | (codepoint & 0x3F));
+		size = 4;
+	}
+
+	usockit_server_screen_render_append(buffer, bytes, size);
+}
+
+/**
+ * Appends an SGR sequence that resets the rendition and then applies `pen`.
+ */
+static inline void usockit_server_screen_render_append_pen(struct usockit_server_screen_render_buffer* const buffer,
+                                                           const struct usockit_server_screen_pen pen) {
+	usockit_server_screen_render_append_str(buffer, "\x1B[0");
+
+	for(size_t i = 0; i < array_size(usockit_server_screen_attr_sgr_params); ++i) {
+		if((pen.attrs & (1U << i)) != 0) {
+			usockit_server_screen_render_append_str(buffer, ";");
+			usockit_server_screen_render_append_uint(buffer, usockit_server_screen_attr_sgr_params[i]);
+		}
+	}
+
+	usockit_server_screen_render_append_color(buffer, pen.fg, 30);
+	usockit_server_screen_render_append_color(buffer, pen.bg, 40);
+
+	usockit_server_screen_render_append_str(buffer, "m");
+}
+
+/**
+ * `base_sgr_param` is 30 for the foreground color and 40 for the background color.
+ */
+static inline void usockit_server_screen_render_append_color(struct usockit_server_screen_render_buffer* const buffer,
+                                                             const uint32_t color,
+                                                             const unsigned int base_sgr_param) {
+	const uint32_t value = (color & USOCKIT_SERVER_SCREEN_COLOR_VALUE_MASK);
+
+	if((color & USOCKIT_SERVER_SCREEN_COLOR_PALETTE_FLAG) != 0) {
+		// the 16 basic colors are sent with their own parameters, for terminals that don't support 256 colors
+		usockit_server_screen_render_append_str(buffer, ";");
+
+		if(value < 8) {
+			usockit_server_screen_render_append_uint(buffer, (base_sgr_param + value));
+		} else if(value < 16) {
+			usockit_server_screen_render_append_uint(buffer, (base_sgr_param + 60 + (value - 8)));
+		} else {
+			usockit_server_screen_render_append_uint(buffer, (base_sgr_param + 8));
+			usockit_server_screen_render_append_str(buffer, ";5;");
+			usockit_server_screen_render_append_uint(buffer, value);
+		}
+		return;
+	}
+
+	if((color & USOCKIT_SERVER_SCREEN_COLOR_RGB_FLAG) != 0) {
+		usockit_server_screen_render_append_str(buffer, ";");
+		usockit_server_screen_render_append_uint(buffer, (base_sgr_param + 8));
+		usockit_server_screen_render_append_str(buffer, ";2;");
+		usockit_server_screen_render_append_uint(buffer, ((value >> 16) & 0xFF));
+		usockit_server_screen_render_append_str(buffer, ";");
+		usockit_server_screen_render_append_uint(buffer, ((value >> 8) & 0xFF));
+		usockit_server_screen_render_append_str(buffer, ";");
+		usockit_server_screen_render_append_uint(buffer, (value & 0xFF));
+	}
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2022 Michael Federczuk
+ * SPDX-License-Identifier: MPL-2.0 AND Apache-2.0
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <usockit/cross_support.h>
+#include <usockit/server/token_bucket.h>
+
+#define USOCKIT_SERVER_TOKEN_BUCKET_NS_PER_S  1000000000.0
+
+
+void usockit_server_token_bucket_init(struct usockit_server_token_bucket* const bucket,
+                                      const unsigned long rate,
+                                      const unsigned long burst,
+                                      const uint64_t now_ns) {
+	assert(bucket != cross_support_nullptr);
+	assert(rate > 0);
+	assert(burst > 0);
+
+	bucket->rate = (double)rate;
+	bucket->burst = (double)burst;
+	bucket->tokens = bucket->burst;
+	bucket->refill_ns = now_ns;
+}
+
+void usockit_server_token_bucket_refill(struct usockit_server_token_bucket* const bucket, const uint64_t now_ns) {
+	assert(bucket != cross_support_nullptr);
+
+	if(now_ns <= bucket->refill_ns) {
+		return;
+	}
+
+	bucket->tokens += (((double)(now_ns - bucket->refill_ns) * bucket->rate) / USOCKIT_SERVER_TOKEN_BUCKET_NS_PER_S);
+	if(bucket->tokens > bucket->burst) {
+		bucket->tokens = bucket->burst;
+	}
+
+	bucket->refill_ns = now_ns;
+}
+
+size_t usockit_server_token_bucket_available(const struct usockit_server_token_bucket* const bucket) {
+	assert(bucket != cross_support_nullptr);
+
+	if(bucket->tokens < 1.0) {
+		return 0;
+	}
+
+	if(bucket->tokens >= (double)SIZE_MAX) {
+		return SIZE_MAX;
+	}
+
+	return (size_t)(bucket->tokens);
+}
+
+void usockit_server_token_bucket_take(struct usockit_server_token_bucket* const bucket, const size_t count) {
+	assert(bucket != cross_support_nullptr);
+	assert(count <= usockit_server_token_bucket_available(bucket));
+
+	bucket->tokens -= (double)count;
+}
+
+uint64_t usockit_server_token_bucket_wait_ns(const struct usockit_server_token_bucket* const bucket) {
+	assert(bucket != cross_support_nullptr);
+
+	if(bucket->tokens >= 1.0) {
+		return 0;
+	}
+
+	// rounded up, so that the unit is actually available after waiting this long
+	return (uint64_t)((((1.0 - bucket->tokens) * USOCKIT_SERVER_TOKEN_BUCKET_NS_PER_S) / bucket->rate) + 1.0);
+}